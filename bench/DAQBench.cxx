@@ -0,0 +1,173 @@
+/*********************************************************************************
+DAQBench.cxx
+
+Benchmark harness of restDAQBench, see DAQBench.h
+
+*********************************************************************************/
+
+#include "DAQBench.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <thread>
+
+namespace {
+  std::atomic<uint64_t> nAllocations{0};
+  thread_local bool trackAllocations = false;
+
+  std::vector<std::pair<std::string, DAQBench::benchmark> >& GetBenchmarks(){
+    static std::vector<std::pair<std::string, DAQBench::benchmark> > benchmarks;
+    return benchmarks;
+  }
+}
+
+//Every allocation of the program goes through here, the benchmarks report the allocations per item
+void* operator new(std::size_t size){
+  if(trackAllocations)nAllocations.fetch_add(1, std::memory_order_relaxed);
+  if(void* ptr = std::malloc(size ? size : 1))return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+uint64_t DAQBench::GetAllocations(){ return nAllocations.load(std::memory_order_relaxed); }
+void DAQBench::TrackAllocations(bool track){ trackAllocations = track; }
+
+bool DAQBench::State::KeepRunning(){
+
+    if(!started){
+      started = true;
+      ResumeTiming();
+      return true;
+    }
+
+  iterations++;
+    if(maxIterations > 0){
+      if(iterations < maxIterations && error.empty())return true;
+    } else if(running){//Check the time without stopping the timer
+      const double now = elapsed + std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - start).count();
+      if(now < minTime && error.empty())return true;
+    } else if(elapsed < minTime && error.empty()){
+      return true;
+    }
+
+  PauseTiming();
+  return false;
+}
+
+void DAQBench::State::PauseTiming(){
+  if(!running)return;
+  elapsed += std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - start).count();
+  allocations += GetAllocations() - allocStart;
+  running = false;
+}
+
+void DAQBench::State::ResumeTiming(){
+  if(running)return;
+  allocStart = GetAllocations();
+  start = std::chrono::steady_clock::now();
+  running = true;
+}
+
+DAQBench::result DAQBench::State::GetResult(const std::string& name) const {
+
+  result res;
+  res.name = name;
+  res.iterations = iterations;
+  res.realTime = iterations > 0 ? elapsed * 1E9 / iterations : 0;
+  res.counters = counters;
+    if(elapsed > 0){
+      if(itemsProcessed > 0)res.counters["items_per_second"] = itemsProcessed / elapsed;
+      if(bytesProcessed > 0)res.counters["bytes_per_second"] = bytesProcessed / elapsed;
+    }
+  if(itemsProcessed > 0)res.counters["allocs_per_item"] = (double)allocations / itemsProcessed;
+  else if(iterations > 0)res.counters["allocs_per_iteration"] = (double)allocations / iterations;
+
+  return res;
+}
+
+void DAQBench::Register(const std::string& name, benchmark bench){
+  GetBenchmarks().emplace_back(name, bench);
+}
+
+std::vector<DAQBench::result> DAQBench::Run(const std::string& filter, double minTime){
+
+  std::vector<result> results;
+  printf("%-32s %14s %12s %16s %14s\n", "Benchmark", "Time (ns)", "Iterations", "Items/s", "Allocs/item");
+
+    for(auto &[name, bench] : GetBenchmarks()){
+      if(!filter.empty() && name.find(filter) == std::string::npos)continue;
+
+      State state(minTime);
+      bench(state);
+        if(!state.GetError().empty()){
+          printf("%-32s skipped: %s\n", name.c_str(), state.GetError().c_str());
+          continue;
+        }
+
+      results.emplace_back(state.GetResult(name));
+      const auto &res = results.back();
+      auto counter = [&res](const std::string& c){ auto it = res.counters.find(c); return it == res.counters.end() ? 0. : it->second; };
+      const double allocs = res.counters.count("allocs_per_item") ? counter("allocs_per_item") : counter("allocs_per_iteration");
+      printf("%-32s %14.1f %12lu %16.1f %14.2f\n", name.c_str(), res.realTime, (unsigned long)res.iterations, counter("items_per_second"), allocs);
+        for(const auto &[c, value] : res.counters){
+          if(c == "items_per_second" || c == "allocs_per_item" || c == "allocs_per_iteration")continue;
+          printf("    %-28s %g\n", c.c_str(), value);
+        }
+    }
+
+  return results;
+}
+
+//Nearest rank percentile, p in [0, 100]
+double DAQBench::Percentile(std::vector<double>& values, double p){
+  if(values.empty())return 0;
+  std::sort(values.begin(), values.end());
+  const size_t rank = std::min(values.size() - 1, (size_t)(p / 100. * values.size()));
+  return values[rank];
+}
+
+bool DAQBench::WriteJSON(const std::string& fileName, const std::vector<result>& results){
+
+  std::ofstream file(fileName);
+    if(!file.is_open()){
+      std::cerr << "Cannot open " << fileName << std::endl;
+      return false;
+    }
+
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  char date[64];
+  const time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+  file << "{\n  \"context\": {\n";
+  file << "    \"date\": \"" << date << "\",\n";
+  file << "    \"host_name\": \"" << host << "\",\n";
+  file << "    \"executable\": \"restDAQBench\",\n";
+  file << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "\n  },\n";
+  file << "  \"benchmarks\": [\n";
+    for(size_t i=0; i<results.size(); i++){
+      const auto &res = results[i];
+      file << "    {\n      \"name\": \"" << res.name << "\",\n";
+      file << "      \"run_type\": \"iteration\",\n";
+      file << "      \"iterations\": " << res.iterations << ",\n";
+      file << "      \"real_time\": " << res.realTime << ",\n";
+      file << "      \"cpu_time\": " << res.realTime << ",\n";
+      file << "      \"time_unit\": \"ns\"";
+      for(const auto &[c, value] : res.counters)file << ",\n      \"" << c << "\": " << value;
+      file << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+  file << "  ]\n}\n";
+
+  return true;
+}
@@ -0,0 +1,85 @@
+/*********************************************************************************
+DAQBench.h
+
+Minimal benchmark harness of restDAQBench, modelled after Google Benchmark:
+every benchmark loops on KeepRunning() until the minimum time is reached and
+reports the time per iteration, the processed items and bytes and the number
+of heap allocations. The results are written as a Google Benchmark compatible
+JSON file so they can be compared between builds.
+
+*********************************************************************************/
+
+#ifndef __DAQ_BENCH__
+#define __DAQ_BENCH__
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace DAQBench {
+
+  //Heap allocations of the tracked threads, counted by the global operator new. The
+  //emulators run in the same process, only the threads of the DAQ are tracked
+  uint64_t GetAllocations();
+  void TrackAllocations(bool track);
+
+  struct result {
+    std::string name;
+    uint64_t iterations = 0;
+    double realTime = 0;//ns per iteration
+    std::map<std::string, double> counters;//items_per_second, bytes_per_second, allocs_per_item...
+  };
+
+  class State {
+    public:
+      State(double minTime) : minTime(minTime) { }
+
+      //Returns false once the minimum time is reached, the timer runs between calls
+      bool KeepRunning();
+
+      void PauseTiming();
+      void ResumeTiming();
+
+      //Macro benchmarks run a fixed number of iterations
+      inline void SetMaxIterations(uint64_t n){ maxIterations = n; }
+      inline void SetItemsProcessed(uint64_t items){ itemsProcessed = items; }
+      inline void SetBytesProcessed(uint64_t bytes){ bytesProcessed = bytes; }
+      inline void SetCounter(const std::string& name, double value){ counters[name] = value; }
+      inline void SkipWithError(const std::string& msg){ error = msg; }
+
+      inline uint64_t GetIterations() const { return iterations; }
+      inline const std::string& GetError() const { return error; }
+
+      result GetResult(const std::string& name) const;
+
+    private:
+      const double minTime;//Seconds
+      uint64_t iterations = 0;
+      uint64_t maxIterations = 0;
+      bool started = false;
+      bool running = false;
+      std::chrono::steady_clock::time_point start;
+      double elapsed = 0;//Seconds
+      uint64_t allocStart = 0;
+      uint64_t allocations = 0;
+      uint64_t itemsProcessed = 0;
+      uint64_t bytesProcessed = 0;
+      std::map<std::string, double> counters;
+      std::string error;
+  };
+
+  typedef std::function<void(State&)> benchmark;
+
+  void Register(const std::string& name, benchmark bench);
+  //Runs the benchmarks whose name contains the filter
+  std::vector<result> Run(const std::string& filter, double minTime);
+
+  double Percentile(std::vector<double>& values, double p);
+  bool WriteJSON(const std::string& fileName, const std::vector<result>& results);
+
+}
+
+#endif
@@ -0,0 +1,667 @@
+/*********************************************************************************
+restDAQBench.cxx
+
+Throughput and latency benchmarks of the data path: micro benchmarks of the
+decoders and of the tree filling, and macro benchmarks running the
+receive -> build -> write pipeline against the emulators of the emulator
+folder on the loopback interface or against raw archives
+
+The frames of the micro benchmarks are captured once from the emulators.
+The pipeline benchmarks run the FEMINOS, ARC and REPLAY backends created
+from the sections of restDAQBench.rml as restDAQManager does, measuring
+the latency from the time the emulator sends an event till it is written
+
+*********************************************************************************/
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DAQBench.h"
+#include "DCCEmulator.h"
+#include "FEMEmulator.h"
+#include "FrameRing.h"
+#include "RawArchive.h"
+#include "SignalBatch.h"
+#include "TRestRawPackedEvent.h"
+#include "TRESTDAQDCC.h"
+#include "TRESTDAQDummy.h"
+#include "TRESTDAQManager.h"
+
+//FEMINOSPacket.h and ARCPacket.h can't be included in the same translation unit, only the decoders are needed
+namespace FEMINOSPacket {
+  bool GetNextEvent(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs);
+}
+namespace ARCPacket {
+  bool GetNextEvent(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs);
+}
+
+typedef bool (*decoder)(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs);
+
+//Writes the events as the DAQ of restDAQManager, they are built in the event attached to the tree
+class BenchWriter : public TRESTDAQDummy {
+  public:
+    using TRESTDAQDummy::TRESTDAQDummy;
+    inline TRestRawSignalEvent* GetTreeEvent() { return &fSignalEvent; }
+};
+
+struct benchOptions {
+  double minTime = 1;//Seconds per micro benchmark
+  double pipelineTime = 5;//Seconds per loopback pipeline benchmark
+  double rate = 500;//Event rate of the emulators in the pipeline benchmarks
+  int nSamples = 512;
+  bool zeroSuppress = false;
+  std::string replayFile;
+  std::string pipelineCfg = DAQ_BENCH_CFG;//Sections of the backends of the pipeline benchmarks
+  TRestRun* run = nullptr;//Output of the tree filling, only when a config file is provided
+  TRestRawSignalEvent* treeEvent = nullptr;//Event attached to the tree of the run
+  DAQRunControl runControl;//Events written by FillTree
+  BenchWriter* writer = nullptr;
+};
+
+benchOptions opt;
+
+void help() {
+    std::cout << " Rest DAQ Bench options:" << std::endl;
+    std::cout << "    --c <cfg.rml>     : Config file used to create the output file of the FillTree benchmark" << std::endl;
+    std::cout << "    --json <file>     : Write the results to <file> in Google Benchmark JSON format" << std::endl;
+    std::cout << "    --filter <str>    : Only run the benchmarks whose name contains <str>" << std::endl;
+    std::cout << "    --min-time <s>    : Minimum time of every micro benchmark (default 1)" << std::endl;
+    std::cout << "    --pipeline-time <s>: Duration of the loopback pipeline benchmarks (default 5)" << std::endl;
+    std::cout << "    --rate <Hz>       : Event rate of the emulators in the pipeline benchmarks, 0 as fast as possible (default 500)" << std::endl;
+    std::cout << "    --samples <n>     : Number of time bins per channel (default 512, 511 max for the DCC)" << std::endl;
+    std::cout << "    --zs              : Zero suppressed events instead of all channels in the micro benchmarks" << std::endl;
+    std::cout << "    --replay <file>   : Raw archive (FEMINOS or ARC) replayed in the pipeline/replay benchmark" << std::endl;
+    std::cout << "    --pipeline-cfg <cfg.rml>: Config file of the backends of the pipeline benchmarks (default " << DAQ_BENCH_CFG << ")" << std::endl;
+    std::cout << "    --h               : Print this help" << std::endl;
+}
+
+//Client socket on the loopback interface, the emulators reply to the source address
+int OpenClient(){
+  const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if(sock < 0)throw (TRESTDAQException("Socket opening failed: " + std::string(strerror(errno))));
+
+  //Large buffer to absorb the bursts, SO_RCVBUFFORCE requires CAP_NET_ADMIN
+  int size = 64*1024*1024;
+  if(setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0)
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 100000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = 0;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+      close(sock);
+      throw (TRESTDAQException("Cannot bind the client socket: " + std::string(strerror(errno))));
+    }
+
+  return sock;
+}
+
+void SendCommand(int sock, const std::string& ip, const std::string& cmd){
+  struct sockaddr_in dst;
+  memset(&dst, 0, sizeof(dst));
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons(REMOTE_DST_PORT);
+  inet_pton(AF_INET, ip.c_str(), &dst.sin_addr);
+  sendto(sock, cmd.c_str(), cmd.size(), 0, (struct sockaddr*)&dst, sizeof(dst));
+}
+
+//Drop the replies till the socket is quiet
+void Drain(int sock){
+  uint8_t buf[8192];
+  while(recv(sock, buf, sizeof(buf), 0) > 0);
+}
+
+FEMEmulator::settings EmulatorSettings(double rate){
+  FEMEmulator::settings s;
+  s.rate = rate;
+  s.nSamples = opt.nSamples;
+  return s;
+}
+
+//Commands starting the data stream of an emulated FEMINOS or ARC, the data frames are the only ones sent afterwards
+void StartFEM(int sock, const std::string& ip, int eventLimit){
+  std::vector<std::string> cmds = {"serve_target 1"};
+    if(opt.zeroSuppress){
+      cmds.push_back("thr * * 300");//Over the baseline
+      cmds.push_back("zero_suppress 1");
+    }
+  cmds.push_back("event_limit " + std::to_string(eventLimit));
+  cmds.push_back("sca enable 1");
+  for(const auto &cmd : cmds)SendCommand(sock, ip, cmd);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  Drain(sock);
+  SendCommand(sock, ip, "daq 0xFFFFFF F");
+}
+
+//Data frames of 100 events without the padding word, as pushed to the FEM buffers by the receive thread
+bool CaptureFEM(const std::string& electronics, std::vector<uint16_t>& words){
+
+  static std::map<std::string, std::vector<uint16_t> > captured;
+    if(captured.count(electronics)){
+      words = captured[electronics];
+      return !words.empty();
+    }
+
+  try {
+    const std::string ip = "127.0.0.2";
+    std::unique_ptr<FEMEmulator> em(FEMEmulator::Create(electronics, ip, 2, EmulatorSettings(500)));
+    const int sock = OpenClient();
+    em->Start();
+    StartFEM(sock, ip, 3);//10^(3-1) events
+
+    //Till the stream stops, the first frame is waited for 5 s
+    uint16_t buf[8192/sizeof(uint16_t)];
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+      while(true){
+        const ssize_t length = recv(sock, buf, sizeof(buf), 0);
+          if(length <= 0){
+            if(!words.empty() || std::chrono::steady_clock::now() > deadline)break;
+            continue;
+          }
+        words.insert(words.end(), &buf[1], &buf[length/sizeof(uint16_t)]);
+      }
+
+    em->Stop();
+    close(sock);
+  } catch (const TRESTDAQException& e) {
+    std::cerr << "Cannot capture " << electronics << " frames: " << e.what() << std::endl;
+    words.clear();
+  }
+
+  captured[electronics] = words;
+  return !words.empty();
+}
+
+//Packets of the readout of the 4 ASICs of a FEC without the padding word, the binary replies of the DCC
+bool CaptureDCC(std::vector<std::vector<uint8_t> >& packets){
+
+  static std::vector<std::vector<uint8_t> > captured;
+    if(!captured.empty()){
+      packets = captured;
+      return true;
+    }
+
+  try {
+    const std::string ip = "127.0.0.4";
+    DCCEmulator dcc(ip, EmulatorSettings(0));
+    const int sock = OpenClient();
+    dcc.Start();
+    if(opt.zeroSuppress)SendCommand(sock, ip, "hped setthr 0 * 0:78 300 0");
+    for(const auto &cmd : {"fem 0", "isobus 0x6C", "isobus 0x1C", "wait 1000000"})SendCommand(sock, ip, cmd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Drain(sock);
+
+      for(int a=0; a<DCCEmulator::nAsics; a++){
+        char cmd[200];
+        sprintf(cmd, "areq %d 0 %d 0 %d", opt.zeroSuppress ? 1 : 0, a, DCCEmulator::nChannels - 1);
+        SendCommand(sock, ip, cmd);
+        uint8_t buf[8192];
+        ssize_t length;
+          while((length = recv(sock, buf, sizeof(buf), 0)) > 4){
+            captured.emplace_back(&buf[2], &buf[length]);
+            const DCCPacket::DataPacket* dp = (const DCCPacket::DataPacket*)&buf[2];
+            if(GET_FRAME_TY_V2(ntohs(dp->dcchdr)) & FRAME_FLAG_EORQ)break;
+          }
+      }
+
+    dcc.Stop();
+    close(sock);
+  } catch (const TRESTDAQException& e) {
+    std::cerr << "Cannot capture DCC packets: " << e.what() << std::endl;
+    captured.clear();
+  }
+
+  packets = captured;
+  return !packets.empty();
+}
+
+void DecodeBenchmark(DAQBench::State& state, const std::string& electronics, decoder GetNextEvent){
+
+  std::vector<uint16_t> words;
+    if(!CaptureFEM(electronics, words)){
+      state.SkipWithError("no frames captured from the " + electronics + " emulator");
+      return;
+    }
+
+  FrameRing buffer;
+  buffer.Allocate(words.size() * sizeof(uint16_t));
+  TRestRawSignalEvent sEvent;
+  uint64_t ts = 0;
+  uint32_t ev_count = 0;
+  uint64_t events = 0, bytes = 0;
+
+    while(state.KeepRunning()){
+      state.PauseTiming();
+      buffer.clear();
+      buffer.push_back(words.data(), words.data() + words.size());
+      state.ResumeTiming();
+        while(!buffer.empty()){
+          const size_t size = buffer.size();
+            if(GetNextEvent(buffer, &sEvent, ts, ev_count, nullptr)){
+              events++;
+              sEvent.Initialize();
+            } else if(buffer.size() == size){
+              break;//Nothing decoded
+            }
+        }
+      bytes += words.size() * sizeof(uint16_t);
+    }
+
+  state.SetItemsProcessed(events);
+  state.SetBytesProcessed(bytes);
+}
+
+void DCCSaveEventBenchmark(DAQBench::State& state){
+
+  std::vector<std::vector<uint8_t> > packets;
+    if(!CaptureDCC(packets)){
+      state.SkipWithError("no packets captured from the DCC emulator");
+      return;
+    }
+
+  TRestRawSignalEvent sEvent;
+  uint64_t nPackets = 0, bytes = 0;
+    while(state.KeepRunning()){
+      for(auto &pck : packets)TRESTDAQDCC::saveEvent(pck.data(), pck.size(), &sEvent);
+      sEvent.Initialize();
+      nPackets += packets.size();
+      for(const auto &pck : packets)bytes += pck.size();
+    }
+
+  state.SetItemsProcessed(nPackets);
+  state.SetBytesProcessed(bytes);
+}
+
+void Arg12Benchmark(DAQBench::State& state){
+
+  //Every valid argument of a DCC, the inverse of Arg12ToFecAsicChannel
+  std::vector<std::pair<unsigned short, unsigned short> > args;
+    for(int fec=0; fec<DCCEmulator::nFecs; fec++)
+      for(int asic=0; asic<DCCEmulator::nAsics; asic++)
+        for(int c=0; c<DCCEmulator::nChannels; c++){
+          const int index = fec * 4 + asic;
+          args.emplace_back(c * 6 + index / 5, index % 5);
+        }
+
+  uint64_t items = 0;
+  volatile unsigned int sink = 0;
+    while(state.KeepRunning()){
+      unsigned short fec, asic, channel;
+      unsigned int sum = 0;
+        for(const auto &[arg1, arg2] : args){
+          DCCPacket::Arg12ToFecAsicChannel(arg1, arg2, fec, asic, channel);
+          sum += fec + asic + channel;
+        }
+      sink = sink + sum;
+      items += args.size();
+    }
+
+  state.SetItemsProcessed(items);
+}
+
+void FillTreeBenchmark(DAQBench::State& state){
+
+  if(!opt.run){
+    state.SkipWithError("a config file is needed (--c)");
+    return;
+  }
+
+  //First FEMINOS event, 4 ASICs with 72 channels
+  std::vector<uint16_t> words;
+    if(!CaptureFEM("FEMINOS", words)){
+      state.SkipWithError("no frames captured from the FEMINOS emulator");
+      return;
+    }
+  FrameRing buffer;
+  buffer.Allocate(words.size() * sizeof(uint16_t));
+  buffer.push_back(words.data(), words.data() + words.size());
+  uint64_t ts = 0;
+  uint32_t ev_count = 0;
+  opt.treeEvent->Initialize();
+  while(!buffer.empty() && !FEMINOSPacket::GetNextEvent(buffer, opt.treeEvent, ts, ev_count, nullptr));
+
+  uint64_t eventSize = 0;
+  for(int s=0; s<opt.treeEvent->GetNumberOfSignals(); s++)eventSize += opt.treeEvent->GetSignal(s)->GetNumberOfPoints() * sizeof(Short_t);
+
+  uint64_t events = 0;
+    while(state.KeepRunning()){
+      opt.treeEvent->SetID(events);
+      opt.writer->FillTree(opt.treeEvent);
+      events++;
+    }
+
+  opt.treeEvent->Initialize();
+  state.SetItemsProcessed(events);
+  state.SetBytesProcessed(events * eventSize);
+}
+
+//First FEMINOS event decoded, false if the emulator frames can't be captured
+bool FirstFEMINOSEvent(DAQBench::State& state, TRestRawSignalEvent& sEvent){
+
+  std::vector<uint16_t> words;
+    if(!CaptureFEM("FEMINOS", words)){
+      state.SkipWithError("no frames captured from the FEMINOS emulator");
+      return false;
+    }
+  FrameRing buffer;
+  buffer.Allocate(words.size() * sizeof(uint16_t));
+  buffer.push_back(words.data(), words.data() + words.size());
+  uint64_t ts = 0;
+  uint32_t ev_count = 0;
+  sEvent.Initialize();
+  while(!buffer.empty() && !FEMINOSPacket::GetNextEvent(buffer, &sEvent, ts, ev_count, nullptr));
+
+  return true;
+}
+
+//Baseline and amplitude of every signal of the first FEMINOS event, per signal as the GUI did or batched
+void AmplitudeBenchmark(DAQBench::State& state, bool batched){
+
+  TRestRawSignalEvent sEvent;
+  if(!FirstFEMINOSEvent(state, sEvent))return;
+
+  uint64_t eventSize = 0;
+  for(int s=0; s<sEvent.GetNumberOfSignals(); s++)eventSize += sEvent.GetSignal(s)->GetNumberOfPoints() * sizeof(Short_t);
+
+  const TVector2 range(5, 55);
+  const double threshold = 2;
+  SignalBatch batch;
+  uint64_t events = 0;
+  volatile double sink = 0;
+    while(state.KeepRunning()){
+      double sum = 0;
+        if(batched){
+          batch.Load(&sEvent);
+          batch.Process(range.X(), range.Y(), threshold);
+          for(size_t s=0; s<batch.GetNumberOfSignals(); s++)sum += batch.amplitude[s];
+        } else {
+          for(int s=0; s<sEvent.GetNumberOfSignals(); s++)sum += sEvent.GetSignal(s)->GetAmplitudeFast(range, threshold);
+        }
+      sink = sink + sum;
+      events++;
+    }
+
+  state.SetItemsProcessed(events * sEvent.GetNumberOfSignals());
+  state.SetBytesProcessed(events * eventSize);
+}
+
+//Packed event format of the first FEMINOS event, the size ratio is reported as a counter
+void PackedEventBenchmark(DAQBench::State& state, bool decode){
+
+  TRestRawSignalEvent sEvent, unpacked;
+  if(!FirstFEMINOSEvent(state, sEvent))return;
+
+  uint64_t eventSize = 0;
+  for(int s=0; s<sEvent.GetNumberOfSignals(); s++)eventSize += sEvent.GetSignal(s)->GetNumberOfPoints() * sizeof(Short_t);
+
+  TRestRawPackedEvent packed;
+  packed.Encode(&sEvent);
+  uint64_t events = 0;
+    while(state.KeepRunning()){
+      if(decode)packed.Decode(&unpacked);
+      else packed.Encode(&sEvent);
+      events++;
+    }
+
+  state.SetItemsProcessed(events);
+  state.SetBytesProcessed(events * eventSize);
+  state.SetCounter("packed_ratio", eventSize ? (double)packed.GetDataSize() / eventSize : 0);
+}
+
+//Build latency of the events written by a backend, from the time the emulator starts sending the frames of the event
+class LatencyProbe {
+  public:
+    void Sent(uint32_t ev){
+      std::lock_guard<std::mutex> lock(mutex);
+      sent[ev] = std::chrono::steady_clock::now();
+    }
+
+    //Called by the event builder thread of the backend through TRESTDAQ::eventBuilt
+    void Built(const TRestRawSignalEvent* sEvent){
+      DAQBench::TrackAllocations(true);
+      const auto now = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = sent.find(sEvent->GetID());
+      if(it == sent.end())return;
+      latencies.push_back(std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(now - it->second).count());
+      sent.erase(sent.begin(), ++it);//Older events are lost or already built
+    }
+
+    std::vector<double> latencies;//us
+
+  private:
+    std::mutex mutex;
+    std::map<uint32_t, std::chrono::steady_clock::time_point> sent;
+};
+
+//Backend created from the section <electronics> of the pipeline config file, as restDAQManager does
+struct benchRun {
+  TRestRun run;
+  std::unique_ptr<TRestRawDAQMetadata> daqMetadata;
+  std::unique_ptr<TRestDAQManagerMetadata> managerMetadata;
+  DAQRunControl runControl;
+  std::unique_ptr<TRESTDAQ> daq;
+
+  benchRun(const std::string& electronics, const std::string& replayFile = ""){
+    daqMetadata = std::make_unique<TRestRawDAQMetadata>(opt.pipelineCfg.c_str(), electronics);
+    managerMetadata = std::make_unique<TRestDAQManagerMetadata>(opt.pipelineCfg.c_str());
+    if(!replayFile.empty())managerMetadata->SetReplayFile(replayFile);
+    run.LoadConfigFromFile(opt.pipelineCfg);
+    run.SetRunTag("bench" + electronics);
+    run.SetRunType(daqMetadata->GetAcquisitionType());
+    run.FormOutputFile();
+    run.SetStartTimeStamp(TRESTDAQ::getCurrentTime());
+    daq = TRESTDAQManager::CreateDAQ(&run, daqMetadata.get(), managerMetadata.get(), &runControl);
+    if(!daq)throw (TRESTDAQException("Cannot create the " + electronics + " backend, please check " + opt.pipelineCfg));
+  }
+
+  //Closes the output file once the backend is destroyed
+  ~benchRun(){
+    daq.reset();
+    run.SetEndTimeStamp(TRESTDAQ::getCurrentTime());
+    run.UpdateOutputFile();
+    run.CloseFile();
+  }
+};
+
+void SetPipelineCounters(DAQBench::State& state, uint64_t events, uint64_t bytes, double elapsed){
+  state.SetItemsProcessed(events);
+  state.SetBytesProcessed(bytes);
+  state.SetCounter("events", events);
+  state.SetCounter("elapsed_s", elapsed);
+}
+
+//Emulated FEM streaming on the loopback interface, received, built and written by the FEMINOS or ARC backend
+void LoopbackBenchmark(DAQBench::State& state, const std::string& electronics){
+
+  state.SetMaxIterations(1);
+  try {
+    LatencyProbe probe;
+    //FEM of the sections FEMINOS and ARC of the pipeline config file
+    std::unique_ptr<FEMEmulator> em(FEMEmulator::Create(electronics, "127.0.0.3", 3, EmulatorSettings(opt.rate)));
+    em->SetEventCallback([&probe](uint32_t ev){ probe.Sent(ev); });
+    em->Start();
+
+    benchRun bench(electronics);
+    TRESTDAQ::eventBuilt = [&probe](const TRestRawSignalEvent* sEvent){ probe.Built(sEvent); };
+    bench.daq->configure();
+
+    uint64_t bytesStart = 0;
+    double elapsed = 0;
+      while(state.KeepRunning()){
+        //Stopped as restDAQManager does when the run is aborted
+        std::thread timer([&](){
+          bench.runControl.WaitForAbort(std::chrono::duration<double>(opt.pipelineTime));
+          bench.runControl.Abort();
+        });
+        bytesStart = em->GetBytesSent();
+        const auto start = std::chrono::steady_clock::now();
+          try {
+            bench.daq->startDAQ();
+            bench.daq->stopDAQ();//The pending frames are built
+          } catch (...) {
+            bench.runControl.Abort();
+            timer.join();
+            throw;
+          }
+        elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - start).count();
+        timer.join();
+      }
+    TRESTDAQ::eventBuilt = nullptr;
+    em->Stop();
+
+    SetPipelineCounters(state, bench.runControl.GetEvents(), em->GetBytesSent() - bytesStart, elapsed);
+    state.SetCounter("latency_p50_us", DAQBench::Percentile(probe.latencies, 50));
+    state.SetCounter("latency_p99_us", DAQBench::Percentile(probe.latencies, 99));
+  } catch (const TRESTDAQException& e) {
+    TRESTDAQ::eventBuilt = nullptr;
+    state.SkipWithError(e.what());
+  }
+}
+
+//Frames of a raw archive replayed as fast as possible by the REPLAY backend, through the event builder of the electronics
+void ReplayBenchmark(DAQBench::State& state){
+
+  if(opt.replayFile.empty()){
+    state.SkipWithError("no raw archive provided (--replay)");
+    return;
+  }
+
+  RawArchive::Reader reader(opt.replayFile);
+    if(!reader.IsOpen()){
+      state.SkipWithError("cannot open " + opt.replayFile);
+      return;
+    }
+
+  uint64_t bytes = 0;
+  std::vector<RawArchive::Reader::frame> frames;
+    for(size_t c=0; c<reader.GetNumberOfChunks(); c++){
+      reader.GetFrames(c, frames);
+      for(const auto &f : frames)bytes += f.size;
+    }
+
+  state.SetMaxIterations(1);
+  try {
+    benchRun bench("REPLAY", opt.replayFile);
+    TRESTDAQ::eventBuilt = [](const TRestRawSignalEvent*){ DAQBench::TrackAllocations(true); };
+    bench.daq->configure();
+    double elapsed = 0;
+      while(state.KeepRunning()){
+        const auto start = std::chrono::steady_clock::now();
+        bench.daq->startDAQ();
+        bench.daq->stopDAQ();
+        elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - start).count();
+      }
+    TRESTDAQ::eventBuilt = nullptr;
+    SetPipelineCounters(state, bench.runControl.GetEvents(), bytes, elapsed);
+  } catch (const TRESTDAQException& e) {
+    TRESTDAQ::eventBuilt = nullptr;
+    state.SkipWithError(e.what());
+  }
+}
+
+int main(int argc, char** argv) {
+
+    DAQBench::TrackAllocations(true);
+    std::string cfgFile, jsonFile, filter;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--c" && hasValue) {
+            cfgFile = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            jsonFile = argv[++i];
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            opt.minTime = std::stod(argv[++i]);
+        } else if (arg == "--pipeline-time" && hasValue) {
+            opt.pipelineTime = std::stod(argv[++i]);
+        } else if (arg == "--rate" && hasValue) {
+            opt.rate = std::stod(argv[++i]);
+        } else if (arg == "--samples" && hasValue) {
+            opt.nSamples = std::stoi(argv[++i]);
+        } else if (arg == "--zs") {
+            opt.zeroSuppress = true;
+        } else if (arg == "--replay" && hasValue) {
+            opt.replayFile = argv[++i];
+        } else if (arg == "--pipeline-cfg" && hasValue) {
+            opt.pipelineCfg = argv[++i];
+        } else if (arg == "--h") {
+            help();
+            return 0;
+        } else {  // unmatched options
+            std::cerr << "Warning argument " << arg << " not found" << std::endl;
+            help();
+            return -1;
+        }
+    }
+
+    if (opt.nSamples < 1 || opt.nSamples > 512) {
+        std::cerr << "Number of samples must be between 1 and 512" << std::endl;
+        return -1;
+    }
+
+    //Output file created as in restDAQManager, the events are written to its event tree
+    std::unique_ptr<TRestRun> restRun;
+    std::unique_ptr<TRestRawDAQMetadata> daqMetadata;
+    std::unique_ptr<TRestDAQManagerMetadata> managerMetadata;
+    std::unique_ptr<BenchWriter> writer;
+    if (!cfgFile.empty()) {
+        restRun = std::make_unique<TRestRun>();
+        restRun->LoadConfigFromFile(cfgFile);
+        restRun->SetRunTag("bench");
+        restRun->FormOutputFile();
+        restRun->SetStartTimeStamp(TRESTDAQ::getCurrentTime());
+        daqMetadata = std::make_unique<TRestRawDAQMetadata>(cfgFile.c_str());
+        managerMetadata = std::make_unique<TRestDAQManagerMetadata>(cfgFile.c_str());
+        writer = std::make_unique<BenchWriter>(restRun.get(), daqMetadata.get(), managerMetadata.get(), &opt.runControl);
+        opt.run = restRun.get();
+        opt.writer = writer.get();
+        opt.treeEvent = writer->GetTreeEvent();
+    }
+
+    DAQBench::Register("FEMINOSPacket/GetNextEvent", [](DAQBench::State& s) { DecodeBenchmark(s, "FEMINOS", FEMINOSPacket::GetNextEvent); });
+    DAQBench::Register("ARCPacket/GetNextEvent", [](DAQBench::State& s) { DecodeBenchmark(s, "ARC", ARCPacket::GetNextEvent); });
+    DAQBench::Register("TRESTDAQDCC/saveEvent", DCCSaveEventBenchmark);
+    DAQBench::Register("DCCPacket/Arg12ToFecAsicChannel", Arg12Benchmark);
+    DAQBench::Register("TRESTDAQ/FillTree", FillTreeBenchmark);
+    DAQBench::Register("TRestRawSignal/GetAmplitudeFast", [](DAQBench::State& s) { AmplitudeBenchmark(s, false); });
+    DAQBench::Register("SignalBatch/Process", [](DAQBench::State& s) { AmplitudeBenchmark(s, true); });
+    DAQBench::Register("TRestRawPackedEvent/Encode", [](DAQBench::State& s) { PackedEventBenchmark(s, false); });
+    DAQBench::Register("TRestRawPackedEvent/Decode", [](DAQBench::State& s) { PackedEventBenchmark(s, true); });
+    DAQBench::Register("pipeline/loopback/FEMINOS", [](DAQBench::State& s) { LoopbackBenchmark(s, "FEMINOS"); });
+    DAQBench::Register("pipeline/loopback/ARC", [](DAQBench::State& s) { LoopbackBenchmark(s, "ARC"); });
+    DAQBench::Register("pipeline/replay", ReplayBenchmark);
+
+    const auto results = DAQBench::Run(filter, opt.minTime);
+
+    if (restRun) {
+        writer.reset();//Pending events of the event filter
+        restRun->SetEndTimeStamp(TRESTDAQ::getCurrentTime());
+        restRun->UpdateOutputFile();
+        restRun->CloseFile();
+        std::cout << "Events written to " << restRun->GetOutputFileName() << std::endl;
+    }
+
+    if (!jsonFile.empty() && !DAQBench::WriteJSON(jsonFile, results)) return -1;
+
+    return 0;
+}
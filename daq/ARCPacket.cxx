@@ -1,7 +1,10 @@
 
 #include <ARCPacket.h>
+#include "DAQTrace.h"
+#include "ZeroSuppression.h"
 
 #include <cstdio>
+#include <string>
 #include <inttypes.h>
 
 void ARCPacket::DataPacket_Print (uint16_t *fr, const uint16_t &size){
@@ -24,6 +27,10 @@ void ARCPacket::DataPacket_Print (uint16_t *fr, const uint16_t &size){
       printf( "Chip %01d Channel_Hit_Count %02d\n", r0, r1 );
       fr++;
       sz_rd++;
+    } else if ((*fr & PFX_9_BIT_CONTENT_MASK) == PFX_FRAME_SEQ_NB) {
+      printf( "Frame sequence number %03d\n", GET_FRAME_SEQ_NB(*fr) );
+      fr++;
+      sz_rd++;
     } else if ((*fr & PFX_0_BIT_CONTENT_MASK) == PFX_EXTD_CARD_CHIP_CHAN_HIT_IX){
       fr++;
       sz_rd++;
@@ -351,8 +358,9 @@ uint32_t ARCPacket::GetUInt32FromBufferInv(uint16_t *fr, int & sz_rd){
   return res;
 }
 
-bool ARCPacket::GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count){
+bool ARCPacket::GetNextEvent(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs){
 
+  DAQ_TRACE_SPAN(GET_NEXT_EVENT);
   bool endOfEvent = false;
   //std::cout<<__PRETTY_FUNCTION__<<" START "<<buffer.size()<<std::endl;
   //std::cout<<__PRETTY_FUNCTION__<<"  "<<buffer.size()<<std::endl;
@@ -390,7 +398,10 @@ bool ARCPacket::GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent*
       buffer.pop_front();
       //printf("Ped Channel %02d Mean/Std_dev : %.2f  %.2f\n", physChannel, (float)mean/100., (float)std_dev/100.);
       TRestRawSignal rawSignal(physChannel, sData);
-      sEvent->AddSignal(rawSignal);
+      {
+        DAQ_TRACE_COUNT(ADD_SIGNAL);
+        sEvent->AddSignal(rawSignal);
+      }
     } else if ((buffer.front() & PFX_8_BIT_CONTENT_MASK) == PFX_START_OF_EVENT){
       //std::cout<<"START OF EVENT "<<std::endl;
       buffer.pop_front();
@@ -411,6 +422,8 @@ bool ARCPacket::GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent*
     } else if ((buffer.front() & PFX_9_BIT_CONTENT_MASK) == PFX_CHIP_CHAN_HIT_CNT) {
       //printf( "Card %02d Chip %01d Channel_Hit_Count %02d\n", GET_CARD_IX(buffer.front()), GET_CHIP_IX(buffer.front()), GET_CHAN_IX(buffer.front()) );
       buffer.pop_front();
+    } else if ((buffer.front() & PFX_9_BIT_CONTENT_MASK) == PFX_FRAME_SEQ_NB) {
+      buffer.pop_front();
     } else if ((buffer.front() & PFX_11_BIT_CONTENT_MASK) == PFX_CHIP_LAST_CELL_READ) {
       buffer.pop_front();
     } else if ( (buffer.front() & PFX_0_BIT_CONTENT_MASK) == PFX_EXTD_CARD_CHIP_CHAN_HIT_IX ) {
@@ -437,8 +450,12 @@ bool ARCPacket::GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent*
           if(buffer.empty())break;
         }
 
+      if(zs && !zs->Apply(physChannel, sData))continue;
       TRestRawSignal rawSignal(physChannel, sData);
-      sEvent->AddSignal(rawSignal);
+      {
+        DAQ_TRACE_COUNT(ADD_SIGNAL);
+        sEvent->AddSignal(rawSignal);
+      }
 
     } else if ( (buffer.front() & PFX_6_BIT_CONTENT_MASK) == PFX_END_OF_EVENT ){
       endOfEvent=true;
@@ -477,3 +494,18 @@ bool ARCPacket::isMFrame(uint16_t *fr){
 
 }
 
+//The start of event follows the start of frame header and the frame sequence number
+bool ARCPacket::isEventStart(const uint16_t *fr, size_t size){
+
+  size_t i = 2;
+  if(size > i && (fr[i] & PFX_9_BIT_CONTENT_MASK) == PFX_FRAME_SEQ_NB)i++;
+  return size > i && (fr[i] & PFX_8_BIT_CONTENT_MASK) == PFX_START_OF_EVENT;
+
+}
+
+//End of event and 3 words of event size, followed by the end of frame
+bool ARCPacket::isEventEnd(const uint16_t *fr, size_t size){
+
+  return size >= 5 && fr[size-1] == PFX_END_OF_FRAME && (fr[size-5] & PFX_6_BIT_CONTENT_MASK) == PFX_END_OF_EVENT;
+
+}
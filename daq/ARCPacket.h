@@ -166,9 +166,10 @@
 #define FRAME_PRINT_EBBND            0x00002000
 #define FRAME_PRINT_LISTS_FOR_ARC    0x00004000
 
+#include "FrameRing.h"
 #include "TRestRawSignalEvent.h"
 
-#include <deque>
+class ZeroSuppression;
 
 namespace ARCPacket {
 
@@ -179,9 +180,13 @@ namespace ARCPacket {
   int HistoStat_Print (uint16_t *fr, int &sz_rd, const uint16_t &hitCount);
   uint32_t GetUInt32FromBuffer(uint16_t *fr, int & sz_rd);
   uint32_t GetUInt32FromBufferInv(uint16_t *fr, int & sz_rd);
-  bool GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count);
+  //The signals are zero suppressed by zs if it is given
+  bool GetNextEvent(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs = nullptr);
   bool isDataFrame(uint16_t *fr);
   bool isMFrame(uint16_t *fr);
+  //First and last data frames of an event, size in words
+  bool isEventStart(const uint16_t *fr, size_t size);
+  bool isEventEnd(const uint16_t *fr, size_t size);
 
 }
 
@@ -0,0 +1,129 @@
+/*********************************************************************************
+DAQInstance.cxx
+
+Instance of restDAQManager on this machine, see DAQInstance.h
+
+*********************************************************************************/
+
+#include "DAQInstance.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//Open file description locks are not released when another descriptor of the file is closed
+#ifndef F_OFD_SETLK
+#define F_OFD_SETLK F_SETLK
+#define F_OFD_GETLK F_GETLK
+#endif
+
+bool DAQInstance::Set(int inst){
+
+    if(inst < 0 || inst >= maxInstances){
+      std::cerr << "Instance " << inst << " out of range, valid instances 0 to " << maxInstances - 1 << std::endl;
+      return false;
+    }
+
+  instance = inst;
+  return true;
+}
+
+std::string DAQInstance::GetLockDirectory(){
+  const char* dir = std::getenv("REST_DAQ_LOCK_DIR");
+  return (dir && dir[0]) ? std::string(dir) : std::string("/tmp");
+}
+
+std::string DAQInstance::GetLockFile(int inst){
+  return GetLockDirectory() + "/restDAQManager." + std::to_string(inst) + ".lock";
+}
+
+bool DAQInstance::Lock(){
+
+  if(lockFd >= 0)return true;
+
+  const std::string file = GetLockFile(instance);
+  const int fd = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if(fd < 0){
+      std::cerr << "Cannot open lock file " << file << " " << std::strerror(errno) << std::endl;
+      return false;
+    }
+  fchmod(fd, 0666);//Managers of other users, regardless of the umask
+
+  struct flock fl;
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+    if(fcntl(fd, F_OFD_SETLK, &fl) == -1){
+      if(errno != EAGAIN && errno != EACCES)std::cerr << "Cannot lock " << file << " " << std::strerror(errno) << std::endl;
+      close(fd);
+      return false;
+    }
+
+  char pid[32];
+  const int len = snprintf(pid, sizeof(pid), "%d\n", (int)getpid());
+    if(ftruncate(fd, 0) != 0 || pwrite(fd, pid, len, 0) != len)
+      std::cerr << "Cannot write the pid to " << file << " " << std::strerror(errno) << std::endl;
+
+  lockFd = fd;
+  return true;
+}
+
+//The file is not removed, a manager starting meanwhile could lock a file no longer listed
+void DAQInstance::Unlock(){
+  if(lockFd < 0)return;
+  close(lockFd);
+  lockFd = -1;
+}
+
+int DAQInstance::LockOwner(const std::string& file){
+
+  const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0)return 0;
+
+  struct flock fl;
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+    if(fcntl(fd, F_OFD_GETLK, &fl) == -1 || fl.l_type == F_UNLCK){
+      close(fd);
+      return 0;
+    }
+
+  char buf[32] = {0};
+  int pid = -1;//Running but unknown pid
+  if(pread(fd, buf, sizeof(buf) - 1, 0) > 0)pid = std::max(-1, atoi(buf));
+  close(fd);
+
+  return pid == 0 ? -1 : pid;
+}
+
+bool DAQInstance::IsRunning(int inst){
+  return LockOwner(GetLockFile(inst)) != 0;
+}
+
+std::vector<DAQInstance::info> DAQInstance::List(){
+
+  std::vector<info> instances;
+  DIR* dir = opendir(GetLockDirectory().c_str());
+  if(!dir)return instances;
+
+  struct dirent* ent;
+    while((ent = readdir(dir)) != NULL){
+      int inst;
+      if(sscanf(ent->d_name, "restDAQManager.%d", &inst) != 1 || inst < 0 || inst >= maxInstances)continue;
+      if(std::string(ent->d_name) != "restDAQManager." + std::to_string(inst) + ".lock")continue;
+      const int pid = LockOwner(GetLockFile(inst));
+      if(pid != 0)instances.push_back({inst, pid});
+    }
+  closedir(dir);
+
+  std::sort(instances.begin(), instances.end(), [](const info& a, const info& b){ return a.instance < b.instance; });
+  return instances;
+}
@@ -0,0 +1,68 @@
+/*********************************************************************************
+DAQInstance.h
+
+Instance of restDAQManager on this machine, several managers (e.g. one per
+detector) can run at the same time. Every instance has its own shared memory
+segments, their keys are consecutive from the base key of the instance:
+
+  control block 0x12367 + 0x10*instance, event ring +1, monitor +2
+
+so instance 0 keeps the keys of a single manager. The instance is selected
+with --i of restDAQManager, the instance parameter of TRestDAQManagerMetadata
+or of TRestDAQGUIMetadata.
+
+A running manager holds a write lock on its lock file, restDAQManager.<n>.lock
+in /tmp (or $REST_DAQ_LOCK_DIR), with its pid. The lock is an open file
+description lock, it is released by the kernel when the manager exits or
+crashes, so the running instances are found by testing the locks without
+scanning /proc and without stale entries.
+
+*********************************************************************************/
+
+#ifndef __DAQ_INSTANCE__
+#define __DAQ_INSTANCE__
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+class DAQInstance {
+  public:
+    static constexpr key_t baseKey = 0x12367;
+    static constexpr int keysPerInstance = 0x10;
+    static constexpr int maxInstances = 256;
+
+    enum class segment { CONTROL = 0, EVENT_RING = 1, MONITOR = 2 };
+
+    struct info {
+      int instance;
+      int pid;
+    };
+
+    //False if the instance is out of range, the previous instance is kept
+    static bool Set(int inst);
+    static inline int Get() { return instance; }
+    static inline key_t GetKey(segment s) { return baseKey + keysPerInstance * instance + (int)s; }
+
+    static std::string GetLockDirectory();
+    static std::string GetLockFile(int inst);
+
+    //Lock of the selected instance, held till Unlock or the end of the process. False if
+    //another manager holds it
+    static bool Lock();
+    static void Unlock();
+
+    //Running instances, with the pid of their manager
+    static std::vector<info> List();
+    static bool IsRunning(int inst);
+
+  private:
+    //Pid of the manager holding the lock of the file, 0 if none
+    static int LockOwner(const std::string& file);
+
+    inline static int instance = 0;
+    inline static int lockFd = -1;
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*********************************************************************************
+DAQMonitor.cxx
+
+Online monitoring histograms in shared memory, see DAQMonitor.h
+
+*********************************************************************************/
+
+#include "DAQMonitor.h"
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+  double Now(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
+  }
+
+  size_t SegmentSize(uint32_t nBins, uint32_t nChannels){
+    return sizeof(DAQMonitor::header) + nBins*sizeof(uint64_t) + nChannels*(sizeof(uint32_t) + sizeof(float));
+  }
+}
+
+DAQMonitor::DAQMonitor(int shmid, header* hdr, bool writer) : shmid(shmid), hdr(hdr), writer(writer) { }
+
+DAQMonitor::~DAQMonitor(){
+
+    if(writer && publishThread.joinable()){
+      std::unique_lock<std::mutex> lock(mutex);
+      stop = true;
+      lock.unlock();
+      cv.notify_all();
+      publishThread.join();
+      Publish();
+    }
+
+  shmdt(hdr);
+}
+
+std::unique_ptr<DAQMonitor> DAQMonitor::Create(const settings& st){
+
+  const size_t size = SegmentSize(st.nBins, st.nChannels);
+
+  //Reuse the segment of a previous run if the layout is the same
+  int sid = shmget(GetKey(), 0, 0);
+  header* hdr = nullptr;
+    if(sid != -1){
+      hdr = (header*)shmat(sid, NULL, 0);
+        if(hdr != (header*)-1 && !(hdr->magic == magic && hdr->version == version && hdr->nBins == st.nBins && hdr->nChannels == st.nChannels)){
+          shmdt(hdr);
+          hdr = (header*)-1;
+        }
+        if(hdr == (header*)-1){
+          shmctl(sid, IPC_RMID, NULL);
+          hdr = nullptr;
+        }
+    }
+
+    if(!hdr){
+      if((sid = shmget(GetKey(), size, IPC_CREAT | 0666)) == -1){
+        std::cerr << "Error while creating the monitor shared memory (shmget) of " << size << " bytes " << std::strerror(errno) << std::endl;
+        return nullptr;
+      }
+      hdr = (header*)shmat(sid, NULL, 0);
+        if(hdr == (header*)-1){
+          std::cerr << "Error while creating the monitor shared memory (shmat) " << std::strerror(errno) << std::endl;
+          return nullptr;
+        }
+    }
+
+  hdr->nBins = st.nBins;
+  hdr->nChannels = st.nChannels;
+  hdr->version = version;
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr->magic = magic;
+
+  std::unique_ptr<DAQMonitor> monitor(new DAQMonitor(sid, hdr, true));
+  monitor->set = st;
+  monitor->spectrum.resize(st.nBins, 0);
+  monitor->hits.resize(st.nChannels, 0);
+  monitor->amplitudeSum.resize(st.nChannels, 0);
+  monitor->Reset(0, Now());
+  monitor->publishThread = std::thread(&DAQMonitor::PublishThread, monitor.get());
+
+  return monitor;
+}
+
+std::unique_ptr<DAQMonitor> DAQMonitor::Attach(){
+
+  const int sid = shmget(GetKey(), 0, 0);
+  if(sid == -1)return nullptr;
+
+  header* hdr = (header*)shmat(sid, NULL, SHM_RDONLY);
+  if(hdr == (header*)-1)return nullptr;
+
+    if(hdr->magic != magic || hdr->version != version){
+      shmdt(hdr);
+      return nullptr;
+    }
+
+  return std::unique_ptr<DAQMonitor>(new DAQMonitor(sid, hdr, false));
+}
+
+void DAQMonitor::Remove(){
+  const int sid = shmget(GetKey(), 0, 0);
+  if(sid != -1)shmctl(sid, IPC_RMID, NULL);
+}
+
+void DAQMonitor::Reset(int run, double start){
+
+  std::unique_lock<std::mutex> lock(mutex);
+  runNumber = run;
+  startTime = start;
+  lastTime = start;
+  events = lastEvents = overflow = 0;
+  std::fill(spectrum.begin(), spectrum.end(), 0);
+  std::fill(hits.begin(), hits.end(), 0);
+  std::fill(amplitudeSum.begin(), amplitudeSum.end(), 0);
+  lock.unlock();
+
+  Publish();
+}
+
+void DAQMonitor::AddEvent(TRestRawSignalEvent* sEvent){
+
+  batch.Load(sEvent);
+  batch.Process(set.baselineStart, set.baselineEnd, set.threshold);
+
+  double evAmplitude = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+
+    for(size_t s=0; s<batch.GetNumberOfSignals(); s++){
+      const double amplitude = batch.amplitude[s];
+      if(amplitude <= 0)continue;
+
+      evAmplitude += amplitude;
+      const int id = batch.id[s];
+        if(id >= 0 && (uint32_t)id < set.nChannels){
+          hits[id]++;
+          amplitudeSum[id] += amplitude;
+        } else {
+          overflow++;
+        }
+    }
+
+    if(evAmplitude > 0 && evAmplitude < set.spectrumMax){
+      const size_t bin = evAmplitude / set.spectrumMax * set.nBins;
+      spectrum[std::min<size_t>(bin, set.nBins - 1)]++;
+    }
+
+  events++;
+}
+
+void DAQMonitor::PublishThread(){
+  ThreadPolicy::Apply(ThreadPolicy::stage::CONTROL, "daqMonitor");
+
+  std::unique_lock<std::mutex> lock(mutex);
+    while(!stop){
+      cv.wait_for(lock, std::chrono::duration<double>(set.interval));
+      if(stop)break;
+      lock.unlock();
+      Publish();
+      lock.lock();
+    }
+}
+
+void DAQMonitor::Publish(){
+
+  std::unique_lock<std::mutex> lock(mutex);
+  const double now = Now();
+
+  const uint64_t seq = hdr->seq.load(std::memory_order_relaxed);
+  hdr->seq.store(seq + 1, std::memory_order_relaxed);//Odd, the readers retry
+  std::atomic_thread_fence(std::memory_order_release);
+
+  hdr->spectrumMax = set.spectrumMax;
+  hdr->interval = set.interval;
+  hdr->runNumber = runNumber;
+  hdr->startTime = startTime;
+  hdr->time = now;
+  hdr->events = events;
+  hdr->overflow = overflow;
+  hdr->instantRate = now > lastTime ? (events - lastEvents) / (now - lastTime) : 0;
+  hdr->meanRate = now > startTime ? events / (now - startTime) : 0;
+
+  char* data = (char*)hdr + sizeof(header);
+  memcpy(data, spectrum.data(), set.nBins*sizeof(uint64_t));
+  data += set.nBins*sizeof(uint64_t);
+  memcpy(data, hits.data(), set.nChannels*sizeof(uint32_t));
+  data += set.nChannels*sizeof(uint32_t);
+  float* amplitude = (float*)data;
+  for(uint32_t c=0; c<set.nChannels; c++)amplitude[c] = hits[c] ? amplitudeSum[c] / hits[c] : 0;
+
+  hdr->seq.store(seq + 2, std::memory_order_release);
+
+  lastEvents = events;
+  lastTime = now;
+}
+
+bool DAQMonitor::Read(snapshot& snap){
+
+    for(int retry=0; retry<100; retry++){
+      const uint64_t seq = hdr->seq.load(std::memory_order_acquire);
+      if(seq == lastSeq)return false;
+        if(seq & 1){
+          std::this_thread::yield();
+          continue;
+        }
+
+      const uint32_t nBins = hdr->nBins;
+      const uint32_t nChannels = hdr->nChannels;
+      snap.runNumber = hdr->runNumber;
+      snap.startTime = hdr->startTime;
+      snap.time = hdr->time;
+      snap.events = hdr->events;
+      snap.overflow = hdr->overflow;
+      snap.instantRate = hdr->instantRate;
+      snap.meanRate = hdr->meanRate;
+      snap.spectrumMax = hdr->spectrumMax;
+
+      const char* data = (const char*)hdr + sizeof(header);
+      snap.spectrum.resize(nBins);
+      memcpy(snap.spectrum.data(), data, nBins*sizeof(uint64_t));
+      data += nBins*sizeof(uint64_t);
+      snap.hits.resize(nChannels);
+      memcpy(snap.hits.data(), data, nChannels*sizeof(uint32_t));
+      data += nChannels*sizeof(uint32_t);
+      snap.amplitude.resize(nChannels);
+      memcpy(snap.amplitude.data(), data, nChannels*sizeof(float));
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+        if(hdr->seq.load(std::memory_order_relaxed) == seq){
+          snap.seq = lastSeq = seq;
+          return true;
+        }
+    }
+
+  return false;
+}
@@ -0,0 +1,139 @@
+/*********************************************************************************
+DAQMonitor.h
+
+Online monitoring computed in restDAQManager: every built event goes through
+the batch amplitude kernel (SignalBatch) and is accumulated in pre-binned
+histograms (event amplitude spectrum, hits and mean amplitude per channel, rates), published as
+a snapshot in a System V shared memory segment at a fixed interval. The GUI
+only redraws the snapshots, so its load doesn't depend on the event rate.
+
+Segment layout:
+  header
+  uint64 spectrum[nBins]
+  uint32 hits[nChannels]
+  float amplitude[nChannels], mean amplitude of the hits
+
+The snapshot is protected by a sequence counter (odd while it is written),
+readers retry if it changed while they copied it.
+
+*********************************************************************************/
+
+#ifndef __DAQ_MONITOR__
+#define __DAQ_MONITOR__
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DAQInstance.h"
+#include "SignalBatch.h"
+#include "TRestRawSignalEvent.h"
+
+class DAQMonitor {
+  public:
+    static constexpr uint32_t magic = 0x4E4F4D44;//"DMON"
+    static constexpr uint32_t version = 1;
+
+    struct settings {
+      double interval = 1;//Seconds between snapshots
+      int baselineStart = 5;
+      int baselineEnd = 55;
+      double threshold = 2;//Sigmas of the baseline
+      uint32_t nBins = 1000;
+      double spectrumMax = 100000;
+      uint32_t nChannels = 65536;
+    };
+
+    struct header {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t nBins;
+      uint32_t nChannels;
+      double spectrumMax;
+      double interval;
+      std::atomic<uint64_t> seq;
+      int32_t runNumber;
+      int32_t reserved;
+      double startTime;//Of the run
+      double time;//Of the snapshot
+      uint64_t events;//Since the start of the run
+      uint64_t overflow;//Hits in channels above nChannels
+      double instantRate;//Over the last interval
+      double meanRate;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Lock free atomics are required in shared memory");
+
+    //Copy of the shared memory snapshot
+    struct snapshot {
+      uint64_t seq = 0;
+      int runNumber = 0;
+      double startTime = 0;
+      double time = 0;
+      uint64_t events = 0;
+      uint64_t overflow = 0;
+      double instantRate = 0;
+      double meanRate = 0;
+      double spectrumMax = 0;
+      std::vector<uint64_t> spectrum;
+      std::vector<uint32_t> hits;
+      std::vector<float> amplitude;
+    };
+
+    ~DAQMonitor();
+
+    //Writer, starts the thread publishing the snapshots, nullptr on error
+    static std::unique_ptr<DAQMonitor> Create(const settings& st);
+    //Reader, nullptr if the segment doesn't exist
+    static std::unique_ptr<DAQMonitor> Attach();
+    static void Remove();
+
+    inline bool SameSettings(const settings& st) const {
+      return st.interval == set.interval && st.baselineStart == set.baselineStart && st.baselineEnd == set.baselineEnd &&
+             st.threshold == set.threshold && st.nBins == set.nBins && st.spectrumMax == set.spectrumMax && st.nChannels == set.nChannels;
+    }
+
+    //Clears the histograms at the start of a run
+    void Reset(int runNumber, double startTime);
+    void AddEvent(TRestRawSignalEvent* sEvent);
+
+    //Copies the last snapshot, false if it was already read
+    bool Read(snapshot& snap);
+
+  private:
+    DAQMonitor(int shmid, header* hdr, bool writer);
+
+    void PublishThread();
+    void Publish();
+
+    int shmid;
+    header* hdr;
+    const bool writer;
+    settings set;
+    uint64_t lastSeq = 0;//Reader
+
+    //Accumulated by AddEvent, copied to shared memory by the publish thread
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+    std::thread publishThread;
+    int runNumber = 0;
+    double startTime = 0;
+    uint64_t events = 0, lastEvents = 0, overflow = 0;
+    double lastTime = 0;
+    std::vector<uint64_t> spectrum;
+    std::vector<uint32_t> hits;
+    std::vector<double> amplitudeSum;
+    SignalBatch batch;//Only used by AddEvent
+
+    static inline key_t GetKey() { return DAQInstance::GetKey(DAQInstance::segment::MONITOR); }
+};
+
+#endif
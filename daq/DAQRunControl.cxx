@@ -0,0 +1,78 @@
+/*********************************************************************************
+DAQRunControl.cxx
+
+Run control state of one acquisition pipeline, see DAQRunControl.h
+
+*********************************************************************************/
+
+#include "DAQRunControl.h"
+#include "DAQMonitor.h"
+#include "SharedEventRing.h"
+#include "TRESTDAQException.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+StopToken::StopToken(){
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(fd < 0)throw (TRESTDAQException("eventfd failed: " + std::string(strerror(errno))));
+}
+
+StopToken::~StopToken(){
+  close(fd);
+}
+
+void StopToken::Request(){
+  if(requested.exchange(true, std::memory_order_acq_rel))return;
+  const uint64_t one = 1;
+  if(write(fd, &one, sizeof(one)) < 0)
+    std::cerr << "Cannot signal the stop token: " << strerror(errno) << std::endl;
+}
+
+void StopToken::Clear(){
+  uint64_t value;
+  while(read(fd, &value, sizeof(value)) > 0);
+  requested.store(false, std::memory_order_release);
+}
+
+DAQRunControl::DAQRunControl(){ }
+
+DAQRunControl::~DAQRunControl(){ }
+
+void DAQRunControl::Reset(){
+  std::lock_guard<std::mutex> lock(mutex);
+  abortToken.Clear();
+  abort.store(false, std::memory_order_release);
+  nextFile.store(false, std::memory_order_release);
+  events.store(0, std::memory_order_relaxed);
+  replay = replayPosition();
+}
+
+//The flags are set under the mutex, so the request is not lost by a thread about to wait
+void DAQRunControl::Abort(){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    abort.store(true, std::memory_order_release);
+  }
+  abortToken.Request();
+  cv.notify_all();
+}
+
+void DAQRunControl::RequestNextFile(){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    nextFile.store(true, std::memory_order_release);
+  }
+  cv.notify_all();
+}
+
+void DAQRunControl::ClearNextFile(){
+  std::lock_guard<std::mutex> lock(mutex);
+  nextFile.store(false, std::memory_order_release);
+}
@@ -0,0 +1,127 @@
+/*********************************************************************************
+DAQRunControl.h
+
+Run control state of one acquisition pipeline: abort and next file requests
+and the number of events written. Owned by restDAQManager (or by the DAQ
+itself if none is given) and shared by the acquisition loops, the receive and
+event builder threads, the writer and the control threads of one DAQ, so
+several DAQs can run in the same process.
+
+The event counter is written for every event while the flags are only read
+in the loops, they are kept in different cache lines. The counter only
+bounds the acquisition loops and is reported to the GUI, it doesn't publish
+any other data, so relaxed ordering is enough. The flags are stored with
+release and loaded with acquire ordering.
+
+The requests wake the threads blocked in WaitForStop/WaitForAbort, which
+replace the fixed sleeps of the polling loops. The threads blocked in select
+(e.g. the receive threads) wait for the file descriptor of a StopToken.
+
+It also keeps what outlives the DAQ of one file: the monitoring and the event
+ring, set up by the DAQ writing the events, the position of a replay in its
+archive and the merger the events are pushed to when the DAQ is a backend of
+another one.
+
+*********************************************************************************/
+
+#ifndef __DAQ_RUN_CONTROL__
+#define __DAQ_RUN_CONTROL__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class DAQMonitor;
+class SharedEventRing;
+class EventMerger;
+
+//Stop request of the threads of one DAQ, the file descriptor (eventfd) is readable once it is requested
+//so it can be waited for in select together with the sockets
+class StopToken {
+  public:
+    StopToken();
+    ~StopToken();
+    StopToken(const StopToken&) = delete;
+    StopToken& operator=(const StopToken&) = delete;
+
+    void Request();
+    void Clear();
+    inline bool Requested() const { return requested.load(std::memory_order_acquire); }
+    inline int GetFd() const { return fd; }
+
+  private:
+    std::atomic<bool> requested{false};
+    int fd;
+};
+
+class DAQRunControl {
+  public:
+    DAQRunControl();
+    ~DAQRunControl();
+
+    //Reset before every run
+    void Reset();
+
+    void Abort();
+    void RequestNextFile();
+    void ClearNextFile();
+
+    inline bool Aborted() const { return abort.load(std::memory_order_acquire); }
+    inline bool NextFile() const { return nextFile.load(std::memory_order_acquire); }
+    inline bool Stopped() const { return Aborted() || NextFile(); }
+
+    inline int GetEvents() const { return events.load(std::memory_order_relaxed); }
+    inline void AddEvent() { events.fetch_add(1, std::memory_order_relaxed); }
+    inline void SetEvents(int n) { events.store(n, std::memory_order_relaxed); }
+    //True while the acquisition loops have to keep running, nEvents 0 means no limit
+    inline bool Running(int nEvents) const { return !Stopped() && (nEvents == 0 || GetEvents() < nEvents); }
+
+    //Readable once the run is aborted, till the next Reset
+    inline int GetAbortFd() const { return abortToken.GetFd(); }
+
+    //Merger of the DAQ this one is a backend of, set before the DAQ is created
+    inline void SetMerger(EventMerger* m) { merger = m; }
+    inline EventMerger* GetMerger() const { return merger; }
+
+    //Kept for all the files of the run, the manager releases them
+    std::unique_ptr<DAQMonitor> monitor;
+    std::unique_ptr<SharedEventRing> eventRing;
+
+    //Start of the first event not replayed yet, where the replay of the next file of the run continues
+    struct replayPosition {
+      std::string file;
+      size_t chunk = 0;
+      size_t frame = 0;
+    };
+    replayPosition replay;
+
+    //Sleep till the timeout or the abort or next file request, true if it was requested
+    template <class Rep, class Period>
+    bool WaitForStop(const std::chrono::duration<Rep, Period>& timeout) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return cv.wait_for(lock, timeout, [this] { return Stopped(); });
+    }
+
+    //Sleep till the timeout or the abort request, true if the run was aborted
+    template <class Rep, class Period>
+    bool WaitForAbort(const std::chrono::duration<Rep, Period>& timeout) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return cv.wait_for(lock, timeout, [this] { return Aborted(); });
+    }
+
+  private:
+    static constexpr size_t cacheLine = 64;
+
+    alignas(cacheLine) std::atomic<int> events{0};
+    alignas(cacheLine) std::atomic<bool> abort{false};
+    std::atomic<bool> nextFile{false};
+    alignas(cacheLine) std::mutex mutex;
+    std::condition_variable cv;
+    StopToken abortToken;
+    EventMerger* merger = nullptr;
+};
+
+#endif
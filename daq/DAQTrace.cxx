@@ -0,0 +1,279 @@
+/*********************************************************************************
+DAQTrace.cxx
+
+Hot path instrumentation, see DAQTrace.h
+
+*********************************************************************************/
+
+#include "DAQTrace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  constexpr size_t nProbes = (size_t)DAQTrace::probe::N_PROBES;
+  constexpr size_t ringSize = 1 << 16;//Spans per thread, power of 2
+
+  const char* probeNames[nProbes] = {"recvfrom", "buffer_insert", "event_builder", "GetNextEvent", "AddSignal",
+                                     "FillTree", "TreeFill", "AutoSave", "SendCommand"};
+
+  struct spanRecord {
+    uint64_t start;
+    uint64_t end;
+    uint16_t probe;
+  };
+
+  //Single producer (the owner thread), single consumer (the writer thread)
+  struct threadRing {
+    uint16_t id = 0;//Reused with the ring, so it is bounded by the threads alive at the same time
+    std::atomic<bool> released{false};//The owner thread exited
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> count[nProbes] = {};
+    std::atomic<uint64_t> ticks[nProbes] = {};
+    spanRecord records[ringSize];
+  };
+
+  //Only written by the owner thread, relaxed load and store avoid the locked instructions
+  inline void Add(std::atomic<uint64_t>& counter, uint64_t value){
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  class Tracer {
+    public:
+      static Tracer& Get(){
+        static Tracer tracer;
+        return tracer;
+      }
+
+      //The rings of the exited threads are reused, a new one is allocated only if there are none free
+      threadRing* Register(){
+        std::lock_guard<std::mutex> lock(mutex);
+        if(stopped)return nullptr;
+        nThreads++;
+          if(!freeRings.empty()){
+            threadRing* ring = freeRings.back();
+            freeRings.pop_back();
+            ring->released.store(false, std::memory_order_relaxed);
+            active.push_back(ring);
+            return ring;
+          }
+        if(rings.size() >= UINT16_MAX)return nullptr;
+        rings.emplace_back(new threadRing);
+        rings.back()->id = rings.size();
+        active.push_back(rings.back().get());
+        return rings.back().get();
+      }
+
+      void Stop(){
+        std::unique_lock<std::mutex> lock(mutex);
+        if(stopped)return;
+        stopped = true;
+        lock.unlock();
+        cv.notify_all();
+        if(writer.joinable())writer.join();
+
+        Flush();
+          if(file){
+            if(json)fprintf(file, "\n]}\n");
+            fclose(file);
+            file = nullptr;
+          }
+        PrintSummary();
+      }
+
+      ~Tracer(){ Stop(); }
+
+    private:
+      Tracer(){
+        const char* env = getenv("REST_DAQ_TRACE_FILE");
+        fileName = env ? env : "restDAQTrace.json";
+        json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+        file = fopen(fileName.c_str(), json ? "w" : "wb");
+          if(!file){
+            fprintf(stderr, "DAQ trace: cannot open %s, only the totals are kept\n", fileName.c_str());
+          } else if(json){
+            fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+          } else {
+            fwrite("RDAQTRC1", 1, 8, file);
+            const uint32_t n = nProbes;
+            fwrite(&n, sizeof(n), 1, file);
+              for(const auto name : probeNames){
+                const uint16_t len = strlen(name);
+                fwrite(&len, sizeof(len), 1, file);
+                fwrite(name, 1, len, file);
+              }
+          }
+
+        tick0 = DAQTrace::Now();
+        time0 = std::chrono::steady_clock::now();
+        writer = std::thread(&Tracer::WriterThread, this);
+      }
+
+      //Nanoseconds per tick from the elapsed time since the start, the time stamp counter runs at a constant rate
+      void Calibrate(){
+        const uint64_t ticks = DAQTrace::Now() - tick0;
+        const double ns = std::chrono::duration_cast<std::chrono::duration<double, std::nano> >(std::chrono::steady_clock::now() - time0).count();
+        if(ticks > 0 && ns > 1E6)nsPerTick = ns / ticks;
+      }
+
+      void WriterThread(){
+        std::unique_lock<std::mutex> lock(mutex);
+          while(!stopped){
+            cv.wait_for(lock, std::chrono::milliseconds(100));
+            if(stopped)break;
+            lock.unlock();
+            Flush();
+            lock.lock();
+          }
+      }
+
+      void Flush(){
+        std::vector<threadRing*> current;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          current = active;
+        }
+
+        Calibrate();
+        std::vector<threadRing*> released;
+          for(auto ring : current){
+            //Checked before the drain, the last spans of the thread are visible once it is set
+            if(ring->released.load(std::memory_order_acquire))released.push_back(ring);
+            const uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+              for(; tail < head; tail++){
+                const spanRecord &rec = ring->records[tail & (ringSize - 1)];
+                if(file)Write(rec, ring->id);
+              }
+            ring->tail.store(tail, std::memory_order_release);
+          }
+        if(file)fflush(file);
+
+        if(released.empty())return;
+        std::lock_guard<std::mutex> lock(mutex);
+          for(auto ring : released){
+            Retire(ring);
+            active.erase(std::find(active.begin(), active.end(), ring));
+            freeRings.push_back(ring);
+          }
+      }
+
+      //Keep the totals of an exited thread and clear its ring for the next one
+      void Retire(threadRing* ring){
+          for(size_t p=0; p<nProbes; p++){
+            retiredCount[p] += ring->count[p].exchange(0, std::memory_order_relaxed);
+            retiredTicks[p] += ring->ticks[p].exchange(0, std::memory_order_relaxed);
+          }
+        retiredDropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->tail.store(0, std::memory_order_relaxed);
+      }
+
+      void Write(const spanRecord& rec, uint16_t thread){
+        const double start = (int64_t)(rec.start - tick0) * nsPerTick;
+        const double duration = (rec.end - rec.start) * nsPerTick;
+          if(json){
+            fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", firstEvent ? "" : ",",
+                    probeNames[rec.probe], thread, start / 1E3, duration / 1E3);
+            firstEvent = false;
+          } else {
+            const uint16_t hdr[4] = {rec.probe, thread, 0, 0};
+            const uint64_t times[2] = {(uint64_t)std::max(start, 0.), (uint64_t)duration};
+            fwrite(hdr, sizeof(hdr), 1, file);
+            fwrite(times, sizeof(times), 1, file);
+          }
+      }
+
+      void PrintSummary(){
+        uint64_t count[nProbes], ticks[nProbes], dropped = retiredDropped;
+        std::copy(retiredCount, retiredCount + nProbes, count);
+        std::copy(retiredTicks, retiredTicks + nProbes, ticks);
+          for(auto ring : active){
+            for(size_t p=0; p<nProbes; p++){
+              count[p] += ring->count[p].load(std::memory_order_relaxed);
+              ticks[p] += ring->ticks[p].load(std::memory_order_relaxed);
+            }
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+          }
+
+        printf("DAQ trace (%s): %lu threads, %lu spans dropped\n", fileName.c_str(), (unsigned long)nThreads, (unsigned long)dropped);
+        printf("  %-16s %12s %14s %12s\n", "Probe", "Count", "Total (ms)", "Mean (us)");
+          for(size_t p=0; p<nProbes; p++){
+            if(count[p] == 0)continue;
+            const double total = ticks[p] * nsPerTick;
+            printf("  %-16s %12lu %14.3f %12.3f\n", probeNames[p], (unsigned long)count[p], total / 1E6, total / count[p] / 1E3);
+          }
+      }
+
+      std::string fileName;
+      FILE* file = nullptr;
+      bool json = true;
+      bool firstEvent = true;
+
+      uint64_t tick0 = 0;
+      std::chrono::steady_clock::time_point time0;
+      double nsPerTick = 1;
+
+      std::mutex mutex;
+      std::condition_variable cv;
+      bool stopped = false;
+      std::thread writer;
+      std::vector<std::unique_ptr<threadRing> > rings;
+      std::vector<threadRing*> active;
+      std::vector<threadRing*> freeRings;
+      uint64_t nThreads = 0;
+      uint64_t retiredCount[nProbes] = {};
+      uint64_t retiredTicks[nProbes] = {};
+      uint64_t retiredDropped = 0;
+  };
+
+  //Hands the ring back to the tracer when the thread exits
+  struct localRing {
+    threadRing* ring = nullptr;
+    bool registered = false;
+    ~localRing(){ if(ring)ring->released.store(true, std::memory_order_release); }
+  };
+
+  thread_local localRing local;
+}
+
+const char* DAQTrace::GetProbeName(probe p){
+  return p < probe::N_PROBES ? probeNames[(size_t)p] : "unknown";
+}
+
+void DAQTrace::Record(probe p, uint64_t start, uint64_t end, bool counterOnly){
+
+    if(!local.registered){
+      local.registered = true;
+      local.ring = Tracer::Get().Register();
+    }
+  threadRing* ring = local.ring;
+  if(!ring)return;
+
+  const size_t i = (size_t)p;
+  Add(ring->count[i], 1);
+  Add(ring->ticks[i], end - start);
+  if(counterOnly)return;
+
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if(head - ring->tail.load(std::memory_order_acquire) >= ringSize){//Full, the writer is late
+      Add(ring->dropped, 1);
+      return;
+    }
+  ring->records[head & (ringSize - 1)] = {start, end, (uint16_t)p};
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void DAQTrace::Stop(){
+  Tracer::Get().Stop();
+}
@@ -0,0 +1,91 @@
+/*********************************************************************************
+DAQTrace.h
+
+Instrumentation of the hot path of the DAQ, enabled at compile time with
+REST_DAQ_TRACE (cmake -DREST_DAQ_TRACE=ON), the probes are empty otherwise
+
+Every probe is a span measured with the time stamp counter (steady_clock on
+non x86 hosts). The spans are accumulated in per thread counters and, except
+for the counter only probes, pushed to a per thread lock-free ring which is
+drained by a background thread to the trace file set in REST_DAQ_TRACE_FILE
+(restDAQTrace.json by default). The ring of a thread is reused by the next
+thread once it exits, so the thread ids in the trace are ring slots. Files ending in .json are written in the
+Chrome trace format (chrome://tracing, Perfetto), any other name in the
+compact binary format below. The totals per probe are printed at exit.
+
+Binary format: "RDAQTRC1", uint32 number of probes and their names (uint16
+length + chars), then one record per span: uint16 probe, uint16 thread,
+uint32 reserved, uint64 start and uint64 duration in ns
+
+*********************************************************************************/
+
+#ifndef __DAQ_TRACE__
+#define __DAQ_TRACE__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace DAQTrace {
+
+  enum class probe : uint16_t {
+    RECEIVE = 0,//recvfrom of the data frames
+    BUFFER_INSERT,//Frame copy to the FEM buffer
+    EVENT_BUILDER,//Decoding pass over the FEM buffers
+    GET_NEXT_EVENT,
+    ADD_SIGNAL,//Counter only
+    FILL_TREE,
+    TREE_FILL,//Event and analysis tree Fill
+    AUTOSAVE,
+    SEND_COMMAND,
+    N_PROBES
+  };
+
+  const char* GetProbeName(probe p);
+
+  inline uint64_t Now(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  //Called at the end of every span, the first call of a thread registers its ring
+  void Record(probe p, uint64_t start, uint64_t end, bool counterOnly);
+
+  class Span {
+    public:
+      Span(probe p, bool counterOnly = false) : p(p), counterOnly(counterOnly), start(Now()) { }
+      ~Span(){ Record(p, start, Now(), counterOnly); }
+
+      Span(const Span&) = delete;
+      Span& operator=(const Span&) = delete;
+
+    private:
+      const probe p;
+      const bool counterOnly;
+      const uint64_t start;
+  };
+
+  //Flush the rings, close the trace file and print the totals, also done at exit
+  void Stop();
+
+}
+
+#define DAQ_TRACE_CONCAT_(a, b) a##b
+#define DAQ_TRACE_CONCAT(a, b) DAQ_TRACE_CONCAT_(a, b)
+
+#ifdef REST_DAQ_TRACE
+#define DAQ_TRACE_SPAN(p) DAQTrace::Span DAQ_TRACE_CONCAT(daqTraceSpan_, __LINE__)(DAQTrace::probe::p)
+#define DAQ_TRACE_COUNT(p) DAQTrace::Span DAQ_TRACE_CONCAT(daqTraceSpan_, __LINE__)(DAQTrace::probe::p, true)
+#else
+#define DAQ_TRACE_SPAN(p)
+#define DAQ_TRACE_COUNT(p)
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+/*********************************************************************************
+EventFilter.cxx
+
+Online software trigger, see EventFilter.h
+
+*********************************************************************************/
+
+#include "EventFilter.h"
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+EventFilter::EventFilter(const settings& st, writer write) : set(st), write(write) {
+
+    if(set.nThreads > 0){
+      slots.resize(4 * set.nThreads);
+      for(int t=0; t<set.nThreads; t++)workers.emplace_back(&EventFilter::WorkerThread, this);
+      writerThread = std::thread(&EventFilter::WriterThread, this);
+    }
+}
+
+EventFilter::~EventFilter(){
+
+  Flush();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  stop = true;
+  lock.unlock();
+  workCv.notify_all();
+  doneCv.notify_all();
+  for(auto &t : workers)t.join();
+  if(writerThread.joinable())writerThread.join();
+}
+
+bool EventFilter::ParseChannels(const std::string& str, std::vector<std::pair<int, int> >& ranges){
+
+  ranges.clear();
+  std::stringstream ss(str);
+  std::string item;
+    while(std::getline(ss, item, ',')){
+      if(item.find_first_not_of(" ") == std::string::npos)continue;
+      int first, last;
+      char dash;
+      std::stringstream is(item);
+        if(!(is >> first))return false;
+        if(is >> dash){
+          if(dash != '-' || !(is >> last))return false;
+        } else {
+          last = first;
+        }
+      if(last < first)return false;
+      ranges.emplace_back(first, last);
+    }
+
+  return true;
+}
+
+EventFilter::cut EventFilter::Evaluate(TRestRawSignalEvent* sEvent, double timeDiff, SignalBatch& batch) const {
+
+  batch.Load(sEvent);
+  batch.Process(set.baselineStart, set.baselineEnd, set.threshold);
+
+  int multiplicity = 0;
+  double amplitude = 0;
+  bool channelHit = set.channels.empty();
+    for(size_t s=0; s<batch.GetNumberOfSignals(); s++){
+      if(batch.amplitude[s] <= 0)continue;
+      multiplicity++;
+      amplitude += batch.amplitude[s];
+        if(!channelHit){
+          const int id = batch.id[s];
+          for(const auto &[first, last] : set.channels)channelHit |= id >= first && id <= last;
+        }
+    }
+
+  if(multiplicity < set.minMultiplicity || (set.maxMultiplicity > 0 && multiplicity > set.maxMultiplicity))return cut::MULTIPLICITY;
+  if(amplitude < set.minAmplitude || (set.maxAmplitude > 0 && amplitude > set.maxAmplitude))return cut::AMPLITUDE;
+  if(!channelHit)return cut::CHANNELS;
+  if(timeDiff < set.minTimeDiff)return cut::TIMEDIFF;
+
+  return cut::NONE;
+}
+
+void EventFilter::Process(TRestRawSignalEvent* sEvent){
+
+  //Sequential, the time difference is computed before the events are distributed to the workers
+  const double time = sEvent->GetTime();
+  const double timeDiff = lastTime < 0 ? std::numeric_limits<double>::max() : time - lastTime;
+  lastTime = time;
+
+    if(workers.empty()){
+      Write(sEvent, Evaluate(sEvent, timeDiff, batch));
+      return;
+    }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  freeCv.wait(lock, [this]{ return submitted - written < slots.size(); });
+  const uint64_t seq = submitted++;
+  lock.unlock();
+
+  //The slot is not used by the workers nor the writer till it is queued
+  slot &sl = slots[seq % slots.size()];
+  sl.event = *sEvent;
+  sl.timeDiff = timeDiff;
+
+  lock.lock();
+  work.push_back(seq);
+  lock.unlock();
+  workCv.notify_one();
+}
+
+void EventFilter::WorkerThread(){
+  ThreadPolicy::Apply(ThreadPolicy::stage::WRITER, "filterWorker");
+
+  SignalBatch workerBatch;
+  std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+      workCv.wait(lock, [this]{ return stop || !work.empty(); });
+      if(work.empty())break;//Stopped
+      const uint64_t seq = work.front();
+      work.pop_front();
+      lock.unlock();
+
+      slot &sl = slots[seq % slots.size()];
+      sl.result = Evaluate(&sl.event, sl.timeDiff, workerBatch);
+
+      lock.lock();
+      sl.done = true;
+      if(seq == written)doneCv.notify_one();
+    }
+}
+
+void EventFilter::WriterThread(){
+  ThreadPolicy::Apply(ThreadPolicy::stage::WRITER, "filterWriter");
+
+  std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+      doneCv.wait(lock, [this]{ return (written < submitted && slots[written % slots.size()].done) || (stop && written == submitted); });
+      if(written == submitted)break;//Stopped
+      slot &sl = slots[written % slots.size()];
+      lock.unlock();
+
+      //In the order the events were built
+      Write(&sl.event, sl.result);
+
+      lock.lock();
+      sl.done = false;
+      written++;
+      freeCv.notify_all();
+    }
+}
+
+void EventFilter::Write(TRestRawSignalEvent* sEvent, cut result){
+
+  bool accepted = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    count.events++;
+      switch(result){
+        case cut::MULTIPLICITY: count.multiplicity++; break;
+        case cut::AMPLITUDE: count.amplitude++; break;
+        case cut::CHANNELS: count.channels++; break;
+        case cut::TIMEDIFF: count.timeDiff++; break;
+        case cut::NONE:
+            if(acceptedCnt++ % std::max(1, set.prescale) == 0){
+              count.accepted++;
+              accepted = true;
+            } else {
+              count.prescaled++;
+            }
+          break;
+      }
+  }
+
+  if(accepted)write(sEvent);
+}
+
+void EventFilter::Flush(){
+
+  if(workers.empty())return;
+  std::unique_lock<std::mutex> lock(mutex);
+  freeCv.wait(lock, [this]{ return written == submitted; });
+}
+
+EventFilter::counters EventFilter::GetCounters(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+void EventFilter::PrintSummary(){
+
+  const counters c = GetCounters();
+  std::cout << "Event filter: " << c.accepted << " of " << c.events << " events written, rejected by multiplicity " << c.multiplicity
+            << ", amplitude " << c.amplitude << ", channels " << c.channels << ", time difference " << c.timeDiff
+            << ", prescaled " << c.prescaled << std::endl;
+}
@@ -0,0 +1,109 @@
+/*********************************************************************************
+EventFilter.h
+
+Online software trigger between the event builders and the writer: cheap
+features of every built event (multiplicity and summed amplitude of the
+signals over threshold, hits in a set of channels, time since the previous
+event) are compared with the cuts of TRestDAQManagerMetadata and only the
+accepted events, prescaled, are written.
+
+Without worker threads the events are evaluated and written in the caller
+thread. With worker threads the events are copied to a pool of slots and
+evaluated in parallel, a writer thread writes the accepted ones in the order
+they were built, the caller only waits when all the slots are in use.
+
+*********************************************************************************/
+
+#ifndef __EVENT_FILTER__
+#define __EVENT_FILTER__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SignalBatch.h"
+#include "TRestRawSignalEvent.h"
+
+class EventFilter {
+  public:
+    struct settings {
+      int baselineStart = 5;
+      int baselineEnd = 55;
+      double threshold = 3;//Sigmas of the baseline
+      int minMultiplicity = 1;
+      int maxMultiplicity = 0;//0 no limit
+      double minAmplitude = 0;
+      double maxAmplitude = 0;//0 no limit
+      std::vector<std::pair<int, int> > channels;//At least one signal over threshold in these ranges, empty any channel
+      double minTimeDiff = 0;//Seconds since the previous built event
+      int prescale = 1;//One of every N accepted events is written
+      int nThreads = 0;
+    };
+
+    struct counters {
+      uint64_t events = 0;
+      uint64_t accepted = 0;//Written
+      uint64_t multiplicity = 0;//Rejected by every cut, in this order
+      uint64_t amplitude = 0;
+      uint64_t channels = 0;
+      uint64_t timeDiff = 0;
+      uint64_t prescaled = 0;
+    };
+
+    typedef std::function<void(TRestRawSignalEvent*)> writer;
+
+    EventFilter(const settings& st, writer write);
+    ~EventFilter();
+
+    //Channel ranges as "0-71,288-359", false if the string can't be parsed
+    static bool ParseChannels(const std::string& str, std::vector<std::pair<int, int> >& ranges);
+
+    void Process(TRestRawSignalEvent* sEvent);
+    //Waits till all the events processed are written
+    void Flush();
+
+    counters GetCounters();
+    void PrintSummary();
+
+  private:
+    enum class cut { NONE, MULTIPLICITY, AMPLITUDE, CHANNELS, TIMEDIFF };
+
+    struct slot {
+      TRestRawSignalEvent event;
+      double timeDiff = 0;
+      cut result = cut::NONE;
+      bool done = false;
+    };
+
+    cut Evaluate(TRestRawSignalEvent* sEvent, double timeDiff, SignalBatch& batch) const;
+    //Counts the result and writes the event if it is accepted and not prescaled
+    void Write(TRestRawSignalEvent* sEvent, cut result);
+
+    void WorkerThread();
+    void WriterThread();
+
+    const settings set;
+    writer write;
+    double lastTime = -1;
+    SignalBatch batch;//Without worker threads
+    counters count;
+    uint64_t acceptedCnt = 0;
+
+    std::mutex mutex;
+    std::condition_variable workCv, doneCv, freeCv;
+    std::vector<slot> slots;
+    std::deque<uint64_t> work;//Slots to be evaluated
+    uint64_t submitted = 0, written = 0;
+    bool stop = false;
+    std::vector<std::thread> workers;
+    std::thread writerThread;
+};
+
+#endif
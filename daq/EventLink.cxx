@@ -0,0 +1,166 @@
+/*********************************************************************************
+EventLink.cxx
+
+TCP link between the DAQ nodes and the event builder, see EventLink.h
+
+*********************************************************************************/
+
+#include "EventLink.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+bool EventLink::ParseAddress(const std::string& address, std::string& host, int& port){
+
+  const size_t pos = address.rfind(':');
+  if(pos == std::string::npos || pos == 0 || pos + 1 == address.size())return false;
+
+  host = address.substr(0, pos);
+  char* end;
+  port = strtol(address.c_str() + pos + 1, &end, 10);
+  return *end == '\0' && port > 0 && port < 65536;
+}
+
+int EventLink::Connect(const std::string& host, int port, double timeout){
+
+  struct addrinfo hints, *res = nullptr;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  const int err = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if(err != 0){
+      std::cerr << "Cannot resolve " << host << ": " << gai_strerror(err) << std::endl;
+      return -1;
+    }
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+  int fd = -1;
+    do {
+      fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+      if(fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) == 0)break;
+      if(fd >= 0)close(fd);
+      fd = -1;
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    } while(std::chrono::steady_clock::now() < deadline);
+  freeaddrinfo(res);
+
+    if(fd < 0){
+      std::cerr << "Cannot connect to " << host << ":" << port << " " << std::strerror(errno) << std::endl;
+      return -1;
+    }
+
+  SetOptions(fd);
+  return fd;
+}
+
+int EventLink::Listen(int port){
+
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+      std::cerr << "Cannot open the builder socket " << std::strerror(errno) << std::endl;
+      return -1;
+    }
+
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));//Restarted between runs
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0){
+      std::cerr << "Cannot listen on port " << port << " " << std::strerror(errno) << std::endl;
+      close(fd);
+      return -1;
+    }
+
+  return fd;
+}
+
+void EventLink::SetOptions(int fd){
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));//The credits are small messages
+  struct timeval tv;
+  tv.tv_sec = ioTimeout;
+  tv.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+void EventLink::AppendHeader(std::vector<char>& buffer, messageType type, uint32_t size){
+  const messageHeader hdr{magic, version, (uint16_t)type, size};
+  const char* in = (const char*)&hdr;
+  buffer.insert(buffer.end(), in, in + sizeof(hdr));
+}
+
+bool EventLink::Send(int fd, const void* data, size_t size){
+
+  const char* in = (const char*)data;
+    while(size > 0){
+      const ssize_t n = send(fd, in, size, MSG_NOSIGNAL);
+        if(n < 0){
+          if(errno == EINTR)continue;
+          return false;
+        }
+      in += n;
+      size -= n;
+    }
+
+  return true;
+}
+
+bool EventLink::SendMessage(int fd, messageType type, const void* payload, uint32_t size){
+  std::vector<char> buffer;
+  AppendHeader(buffer, type, size);
+  if(size > 0)buffer.insert(buffer.end(), (const char*)payload, (const char*)payload + size);
+  return Send(fd, buffer.data(), buffer.size());
+}
+
+namespace {
+  bool Receive(int fd, void* data, size_t size){
+    char* out = (char*)data;
+      while(size > 0){
+        const ssize_t n = recv(fd, out, size, 0);
+          if(n <= 0){
+            if(n < 0 && errno == EINTR)continue;
+            return false;//Closed, broken or timed out
+          }
+        out += n;
+        size -= n;
+      }
+    return true;
+  }
+}
+
+bool EventLink::ReceiveMessage(int fd, messageHeader& hdr, std::vector<char>& payload){
+
+  if(!Receive(fd, &hdr, sizeof(hdr)))return false;
+    if(hdr.magic != magic || hdr.version != version || hdr.size > maxMessageSize){
+      std::cerr << "Wrong event link message: magic 0x" << std::hex << hdr.magic << std::dec << " version " << hdr.version
+                << " size " << hdr.size << std::endl;
+      return false;
+    }
+
+  payload.resize(hdr.size);
+  return Receive(fd, payload.data(), hdr.size);
+}
+
+bool EventLink::Readable(int fd, int timeout){
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, timeout) > 0;
+}
@@ -0,0 +1,68 @@
+/*********************************************************************************
+EventLink.h
+
+TCP link between the DAQ nodes and the event builder (see EventSender and
+TRESTDAQBuilder). Every message is a header followed by its payload:
+
+  HELLO     node -> builder, name of the node
+  FRAGMENT  node -> builder, fragmentHeader and the signals of the event
+            packed with TRestRawPackedEvent::Serialize
+  CREDIT    builder -> node, number of fragments the node can send
+  END       node -> builder, last message of the node, number of fragments
+
+The node only sends fragments while it has credits, the builder returns them
+as the fragments are queued in the merger, so the fragments in flight and
+the memory of the builder are bounded and a slow builder slows down the
+nodes instead of dropping events. The messages are in the byte order of the
+hosts, the magic number of the header detects a different one.
+
+*********************************************************************************/
+
+#ifndef __EVENT_LINK__
+#define __EVENT_LINK__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class EventLink {
+  public:
+    static constexpr uint32_t magic = 0x4C514144;
+    static constexpr uint16_t version = 1;
+    static constexpr uint32_t maxMessageSize = 64 * 1024 * 1024;
+    static constexpr int ioTimeout = 10;//Seconds, a link without progress is closed
+
+    enum class messageType : uint16_t { HELLO = 1, FRAGMENT = 2, CREDIT = 3, END = 4 };
+
+    struct messageHeader {
+      uint32_t magic;
+      uint16_t version;
+      uint16_t type;
+      uint32_t size;//Payload bytes
+    };
+
+    struct fragmentHeader {
+      int32_t id;//Event counter of the node
+      int32_t reserved;
+      double time;//Seconds since the start of the run of the node
+    };
+
+    //"host:port"
+    static bool ParseAddress(const std::string& address, std::string& host, int& port);
+    //Retried till timeout seconds, e.g. the builder is not listening yet. -1 on failure
+    static int Connect(const std::string& host, int port, double timeout);
+    static int Listen(int port);
+    //Timeouts and no delay of a connected socket
+    static void SetOptions(int fd);
+
+    //Header of a message to be sent, the payload follows
+    static void AppendHeader(std::vector<char>& buffer, messageType type, uint32_t size);
+    //Blocking, false if the link is broken or timed out
+    static bool Send(int fd, const void* data, size_t size);
+    static bool SendMessage(int fd, messageType type, const void* payload, uint32_t size);
+    static bool ReceiveMessage(int fd, messageHeader& hdr, std::vector<char>& payload);
+    //Waits for data till timeout milliseconds
+    static bool Readable(int fd, int timeout);
+};
+
+#endif
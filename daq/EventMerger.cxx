@@ -0,0 +1,187 @@
+/*********************************************************************************
+EventMerger.cxx
+
+Merges the events of several backends, see EventMerger.h
+
+*********************************************************************************/
+
+#include "EventMerger.h"
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <iostream>
+
+EventMerger::EventMerger(const settings& st, writer write) : set(st), write(write) {
+  thread = std::thread(&EventMerger::MergerThread, this);
+}
+
+EventMerger::~EventMerger(){
+
+  std::unique_lock<std::mutex> lock(mutex);
+  stop = true;//The queued events are still written
+  lock.unlock();
+  pushCv.notify_all();
+  freeCv.notify_all();
+  if(thread.joinable())thread.join();
+}
+
+void EventMerger::AddInput(const DAQRunControl* rc, const std::string& name){
+  std::lock_guard<std::mutex> lock(mutex);
+  input in;
+  in.rc = rc;
+  in.name = name;
+  inputs.push_back(std::move(in));
+}
+
+bool EventMerger::IsInput(const DAQRunControl* rc) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  for(const auto &in : inputs)if(in.rc == rc)return true;
+  return false;
+}
+
+void EventMerger::EndInput(const DAQRunControl* rc){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    input* in = Find(rc);
+    if(in)in->idle = true;//Till it pushes again
+  }
+  pushCv.notify_one();
+}
+
+EventMerger::input* EventMerger::Find(const DAQRunControl* rc){
+  for(auto &in : inputs)if(in.rc == rc)return &in;
+  return nullptr;
+}
+
+bool EventMerger::Push(const DAQRunControl* rc, TRestRawSignalEvent* sEvent){
+
+  std::unique_lock<std::mutex> lock(mutex);
+  input* in = Find(rc);
+  if(!in)return false;
+
+  freeCv.wait(lock, [&]{ return in->queue.size() < set.queueSize || stop; });
+  in->queue.emplace_back(*sEvent, clock::now());
+  in->lastTime = std::max(in->lastTime, sEvent->GetTime());
+  in->idle = false;
+  in->events++;
+  lock.unlock();
+  pushCv.notify_one();
+
+  return true;
+}
+
+int EventMerger::Next(clock::time_point now) const {
+
+  int first = -1;
+    for(size_t i=0; i<inputs.size(); i++){
+      if(inputs[i].queue.empty())continue;
+      if(first < 0 || inputs[i].queue.front().first.GetTime() < inputs[first].queue.front().first.GetTime())first = i;
+    }
+  if(first < 0 || flushing || stop)return first;
+
+  if(now - inputs[first].queue.front().second >= std::chrono::duration<double>(set.timeout))return first;
+
+  //Wait till the other backends can't build an event within the window
+  const double end = inputs[first].queue.front().first.GetTime() + set.window;
+    for(const auto &in : inputs){
+      if(in.queue.empty() && in.lastTime < end && !in.idle)return -1;
+    }
+
+  return first;
+}
+
+void EventMerger::MergerThread(){
+  ThreadPolicy::Apply(ThreadPolicy::stage::WRITER, "eventMerger");
+
+  std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+      const int first = Next(clock::now());
+        if(first < 0){
+          if(stop)break;//Drained
+          if(flushing)freeCv.notify_all();
+          pushCv.wait_for(lock, std::chrono::milliseconds(50));
+          continue;
+        }
+
+      const TRestRawSignalEvent &head = inputs[first].queue.front().first;
+      const double end = head.GetTime() + set.window;
+      const int id = head.GetID();
+      mergedEvent.Initialize();
+      mergedEvent.SetEventInfo(const_cast<TRestRawSignalEvent*>(&head));
+
+      merging.clear();
+        for(auto &in : inputs){
+            if(in.queue.empty() || in.queue.front().first.GetTime() > end){
+              //Released by the timeout, the next events don't wait for this backend
+              if(in.queue.empty() && in.lastTime < end && !flushing && !stop)in.idle = true;
+              continue;
+            }
+          TRestRawSignalEvent &ev = in.queue.front().first;
+            if(set.matchIds && ev.GetID() != id){
+              if(ev.GetID() != in.lastMismatch)in.mismatched++;
+              in.lastMismatch = ev.GetID();
+              continue;
+            }
+          for(int s=0; s<ev.GetNumberOfSignals(); s++)mergedEvent.AddSignal(*ev.GetSignal(s));
+          in.queue.pop_front();
+          merging.push_back(&in);
+        }
+      if(merging.size() > 1)for(auto in : merging)in->merged++;
+
+      writing = true;
+      lock.unlock();
+      freeCv.notify_all();
+
+      write(&mergedEvent);
+
+      lock.lock();
+      writing = false;
+      written++;
+    }
+
+  writing = false;
+  freeCv.notify_all();
+}
+
+void EventMerger::Flush(){
+
+  std::unique_lock<std::mutex> lock(mutex);
+  flushing = true;
+  pushCv.notify_one();
+    freeCv.wait(lock, [this]{
+      if(writing)return false;
+      for(const auto &in : inputs)if(!in.queue.empty())return false;
+      return true;
+    });
+  flushing = false;
+}
+
+std::vector<EventMerger::inputStats> EventMerger::GetStats(){
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<inputStats> stats;
+    for(const auto &in : inputs){
+      inputStats st;
+      st.name = in.name;
+      st.events = in.events;
+      st.merged = in.merged;
+      st.queued = in.queue.size();
+      st.mismatched = in.mismatched;
+      stats.push_back(st);
+    }
+
+  return stats;
+}
+
+void EventMerger::PrintSummary(){
+
+  uint64_t nWritten;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    nWritten = written;
+  }
+  std::cout << "Event merger: " << nWritten << " events written" << std::endl;
+  for(const auto &st : GetStats())
+    std::cout << "  " << st.name << ": " << st.events << " events built, " << st.merged << " merged with other backends"
+              << (set.matchIds ? ", " + std::to_string(st.mismatched) + " with a different id" : std::string()) << std::endl;
+}
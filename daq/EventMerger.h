@@ -0,0 +1,110 @@
+/*********************************************************************************
+EventMerger.h
+
+Merges the events built by several backends (e.g. ARC and FEMINOS crates) of
+one run into a single event stream, written by one thread
+
+Every backend pushes its built events, in time order, to its own bounded
+queue (the backend waits when it is full). The merger thread takes the
+earliest queued event and adds the signals of the first queued event of every
+other backend within the merge window, the merged event gets the id and time
+of the earliest one. An event is merged once every other backend has a
+queued event or has already built an event after the end of the window, or
+after a timeout, so an idle backend doesn't stall the others.
+
+The event times of the backends have to share the same time base, e.g. a
+common clock distributed by the trigger module. When the ids are matched (e.g.
+the event counters of the FEMs of several nodes, see TRESTDAQBuilder) only the
+events with the same id within the window are merged.
+
+*********************************************************************************/
+
+#ifndef __EVENT_MERGER__
+#define __EVENT_MERGER__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "DAQRunControl.h"
+#include "TRestRawSignalEvent.h"
+
+class EventMerger {
+  public:
+    struct settings {
+      double window = 1E-5;//Seconds
+      double timeout = 1;//Seconds waiting for the other backends
+      size_t queueSize = 256;//Events per backend
+      bool matchIds = false;//Only the events with the same id are merged
+    };
+
+    struct inputStats {
+      std::string name;
+      uint64_t events = 0;//Built by the backend
+      uint64_t merged = 0;//Merged with the events of other backends
+      size_t queued = 0;
+      uint64_t mismatched = 0;//Within the window of another event but with a different id
+    };
+
+    typedef std::function<void(TRestRawSignalEvent*)> writer;
+
+    EventMerger(const settings& st, writer write);
+    ~EventMerger();
+
+    //The backends are identified by their run control, added before the events are pushed
+    void AddInput(const DAQRunControl* rc, const std::string& name);
+    bool IsInput(const DAQRunControl* rc) const;
+
+    //Copies the event to the queue of the backend, false if rc is not an input
+    bool Push(const DAQRunControl* rc, TRestRawSignalEvent* sEvent);
+    //No more events from rc, the events of the other backends don't wait for it
+    void EndInput(const DAQRunControl* rc);
+    //Merges and writes all the queued events, once the backends are stopped
+    void Flush();
+
+    std::vector<inputStats> GetStats();
+    void PrintSummary();
+
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    struct input {
+      const DAQRunControl* rc;
+      std::string name;
+      std::deque<std::pair<TRestRawSignalEvent, clock::time_point> > queue;//Event and arrival time
+      double lastTime = -1;//Time of the last event pushed
+      uint64_t events = 0;
+      uint64_t merged = 0;
+      uint64_t mismatched = 0;
+      int lastMismatch = -1;//Id of the last mismatched event, counted once
+      bool idle = false;//Not waited for till it pushes again
+    };
+
+    input* Find(const DAQRunControl* rc);
+    //Input with the earliest event if it can be merged, -1 otherwise
+    int Next(clock::time_point now) const;
+    void MergerThread();
+
+    const settings set;
+    writer write;
+    TRestRawSignalEvent mergedEvent;
+    std::vector<input*> merging;//Inputs of the merged event
+    uint64_t written = 0;
+
+    mutable std::mutex mutex;
+    std::condition_variable pushCv, freeCv;
+    std::vector<input> inputs;
+    bool flushing = false;
+    bool writing = false;
+    bool stop = false;
+    std::thread thread;
+};
+
+#endif
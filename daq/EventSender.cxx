@@ -0,0 +1,190 @@
+/*********************************************************************************
+EventSender.cxx
+
+Sends the built events of a DAQ node to the event builder, see EventSender.h
+
+*********************************************************************************/
+
+#include "EventSender.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#include "DAQInstance.h"
+#include "ThreadPolicy.h"
+#include "TRESTDAQException.h"
+
+namespace {
+  double Seconds(std::chrono::steady_clock::duration d){ return std::chrono::duration<double>(d).count(); }
+}
+
+EventSender::EventSender(const settings& st, DAQRunControl* rc) : set(st), runControl(rc) {
+
+  fd = EventLink::Connect(set.host, set.port, set.connectTimeout);
+  if(fd < 0)throw (TRESTDAQException("Cannot connect to the event builder " + set.host + ":" + std::to_string(set.port)));
+
+    if(!EventLink::SendMessage(fd, EventLink::messageType::HELLO, set.name.data(), set.name.size())){
+      close(fd);
+      throw (TRESTDAQException("Cannot send to the event builder " + set.host + ":" + std::to_string(set.port)));
+    }
+
+  std::cout << "Sending the events to the builder " << set.host << ":" << set.port << " as " << set.name << std::endl;
+  thread = std::thread(&EventSender::SenderThread, this);
+}
+
+EventSender::~EventSender(){
+  Close();
+}
+
+void EventSender::Close(){
+
+  if(fd < 0)return;
+  std::unique_lock<std::mutex> lock(mutex);
+  stop = true;//The queued events are still sent
+  lock.unlock();
+  pushCv.notify_all();
+  freeCv.notify_all();
+  if(thread.joinable())thread.join();
+  close(fd);
+  fd = -1;
+}
+
+void EventSender::Send(TRestRawSignalEvent* sEvent, double startTime){
+
+  std::vector<char> buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(failed)return;//The run is being aborted
+      if(!freeBuffers.empty()){
+        buffer = std::move(freeBuffers.back());
+        freeBuffers.pop_back();
+      }
+  }
+
+  packed.Encode(sEvent);
+  uint64_t rawBytes = 0;
+  for(int s=0; s<sEvent->GetNumberOfSignals(); s++)rawBytes += sEvent->GetSignal(s)->GetNumberOfPoints() * sizeof(Short_t);
+
+  buffer.clear();
+  EventLink::AppendHeader(buffer, EventLink::messageType::FRAGMENT, 0);
+  const EventLink::fragmentHeader fh{sEvent->GetID(), 0, sEvent->GetTime() - startTime};
+  buffer.insert(buffer.end(), (const char*)&fh, (const char*)&fh + sizeof(fh));
+  packed.Serialize(buffer);
+  const uint32_t size = buffer.size() - sizeof(EventLink::messageHeader);
+  memcpy(buffer.data() + offsetof(EventLink::messageHeader, size), &size, sizeof(size));
+
+  std::unique_lock<std::mutex> lock(mutex);
+  freeCv.wait(lock, [&]{ return queue.size() < set.queueSize || failed || stop; });
+  if(failed)return;
+  queue.push_back(std::move(buffer));
+  cnt.rawBytes += rawBytes;
+  lock.unlock();
+  pushCv.notify_one();
+}
+
+bool EventSender::ReadCredits(int timeout){
+
+  if(!EventLink::Readable(fd, timeout))return true;
+
+  EventLink::messageHeader hdr;
+  if(!EventLink::ReceiveMessage(fd, hdr, payload))return false;//Closed by the builder
+    if(hdr.type == (uint16_t)EventLink::messageType::CREDIT && payload.size() == sizeof(uint32_t)){
+      uint32_t n;
+      memcpy(&n, payload.data(), sizeof(n));
+      credits += n;
+    }
+
+  return true;
+}
+
+bool EventSender::WaitForCredit(){
+
+  if(credits > 0)return true;
+
+  const auto start = std::chrono::steady_clock::now();
+  bool ok = true;
+    while(ok && credits == 0){
+      ok = ReadCredits(100);
+      std::lock_guard<std::mutex> lock(mutex);
+        if(stop && std::chrono::steady_clock::now() - start > std::chrono::seconds(EventLink::ioTimeout)){
+          std::cerr << "No credits from the event builder in " << EventLink::ioTimeout << " s, the queued events are lost" << std::endl;
+          ok = false;
+        }
+    }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  cnt.stalled += Seconds(std::chrono::steady_clock::now() - start);
+  return ok;
+}
+
+void EventSender::SenderThread(){
+  ThreadPolicy::Apply(ThreadPolicy::stage::WRITER, "eventSender");
+
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+      pushCv.wait(lock, [this]{ return !queue.empty() || stop; });
+      if(queue.empty())break;//Stopped and drained
+
+      std::vector<char> buffer = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      freeCv.notify_all();
+
+      const bool sent = WaitForCredit() && EventLink::Send(fd, buffer.data(), buffer.size());
+        if(sent){
+          credits--;
+          ReadCredits(0);
+        }
+
+      lock.lock();
+        if(sent){
+          cnt.fragments++;
+          cnt.bytes += buffer.size();
+        }
+      freeBuffers.push_back(std::move(buffer));
+        if(!sent){
+          failed = true;
+          queue.clear();
+          break;
+        }
+    }
+  cnt.elapsed = Seconds(std::chrono::steady_clock::now() - start);
+  const bool linkFailed = failed;
+  const uint64_t fragments = cnt.fragments;
+  lock.unlock();
+  freeCv.notify_all();
+
+    if(linkFailed){
+      std::cerr << "Event builder link " << set.host << ":" << set.port << " broken " << std::strerror(errno) << ", aborting the run" << std::endl;
+      runControl->Abort();
+    } else {
+      EventLink::SendMessage(fd, EventLink::messageType::END, &fragments, sizeof(fragments));
+    }
+}
+
+EventSender::counters EventSender::GetCounters(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return cnt;
+}
+
+void EventSender::PrintSummary(){
+
+  const counters c = GetCounters();
+  const double mb = c.bytes / (1024. * 1024.);
+  std::cout << "Event sender to " << set.host << ":" << set.port << ": " << c.fragments << " events, " << mb << " MB sent ("
+            << (c.bytes > 0 ? (double)c.rawBytes / c.bytes : 0) << " compression), " << (c.elapsed > 0 ? mb / c.elapsed : 0) << " MB/s, "
+            << c.stalled << " s waiting for the builder" << std::endl;
+}
+
+std::string EventSender::GetNodeName(){
+
+  char host[256] = {0};
+  if(gethostname(host, sizeof(host) - 1) != 0)snprintf(host, sizeof(host), "node");
+  if(DAQInstance::Get() == 0)return std::string(host);
+  return std::string(host) + "." + std::to_string(DAQInstance::Get());
+}
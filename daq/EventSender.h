@@ -0,0 +1,90 @@
+/*********************************************************************************
+EventSender.h
+
+Sends the events built by a DAQ node to the event builder of a distributed
+DAQ (see TRESTDAQBuilder) instead of writing them. Selected with the
+builderAddress of TRestDAQManagerMetadata.
+
+The events are packed (TRestRawPackedEvent, only the non zero samples) by the
+thread calling Send and queued, a sender thread writes them to the link while
+it has credits of the builder (see EventLink.h). Send waits when the queue is
+full, so the flow control of the builder reaches the event builder of the
+node. If the link is broken the run of the node is aborted.
+
+*********************************************************************************/
+
+#ifndef __EVENT_SENDER__
+#define __EVENT_SENDER__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DAQRunControl.h"
+#include "EventLink.h"
+#include "TRestRawPackedEvent.h"
+#include "TRestRawSignalEvent.h"
+
+class EventSender {
+  public:
+    struct settings {
+      std::string host;
+      int port = 0;
+      std::string name;//Of the node, shown by the builder
+      size_t queueSize = 64;//Packed events waiting for credits
+      double connectTimeout = 10;//Seconds
+    };
+
+    struct counters {
+      uint64_t fragments = 0;
+      uint64_t rawBytes = 0;//16 bit samples of the events
+      uint64_t bytes = 0;//Sent
+      double stalled = 0;//Seconds waiting for credits
+      double elapsed = 0;
+    };
+
+    //Throws TRESTDAQException if the builder can't be reached
+    EventSender(const settings& st, DAQRunControl* rc);
+    ~EventSender();
+
+    //Sends the queued events and the end of the node, the link is closed
+    void Close();
+
+    //time of the event relative to startTime, the start of the run of the node
+    void Send(TRestRawSignalEvent* sEvent, double startTime);
+
+    counters GetCounters();
+    void PrintSummary();
+
+    static std::string GetNodeName();
+
+  private:
+    void SenderThread();
+    bool WaitForCredit();
+    bool ReadCredits(int timeout);
+
+    const settings set;
+    DAQRunControl* runControl;
+    int fd = -1;
+
+    TRestRawPackedEvent packed;//Only used by Send
+
+    std::mutex mutex;
+    std::condition_variable pushCv, freeCv;
+    std::deque<std::vector<char> > queue;
+    std::vector<std::vector<char> > freeBuffers;
+    bool stop = false;
+    bool failed = false;
+    counters cnt;
+    std::thread thread;
+
+    //Sender thread only
+    uint64_t credits = 0;
+    std::vector<char> payload;
+};
+
+#endif
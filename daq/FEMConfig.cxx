@@ -0,0 +1,323 @@
+/*********************************************************************************
+FEMConfig.cxx
+
+Configuration command compiler for FEMINOS and ARC based readout
+
+*********************************************************************************/
+
+#include "FEMConfig.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+  const std::set<std::string> registerCommands = {"aget", "forceon", "forceoff", "forceon_all", "polarity", "mode", "asic_mask", "sca",
+                                                 "rst_len", "mmpol", "keep_fco", "test_zbt", "test_enable", "test_mode", "tdata",
+                                                 "ped", "thr"};
+
+  const std::set<std::string> scaRegisters = {"wckdiv", "cnt", "autostart"};
+
+  std::vector<std::string> Tokenize(const std::string& cmd) {
+    std::vector<std::string> tokens;
+    std::istringstream str(cmd);
+    std::string tk;
+    while (str >> tk) tokens.push_back(tk);
+    return tokens;
+  }
+
+  // Expand "*", "a:b" or a single index in the range [0, max)
+  std::vector<int> ExpandIndex(const std::string& tk, int max) {
+    std::vector<int> idx;
+    if (tk == "*") {
+      for (int i = 0; i < max; i++) idx.push_back(i);
+      return idx;
+    }
+    const size_t colon = tk.find(':');
+    if (colon != std::string::npos) {
+      int first = atoi(tk.substr(0, colon).c_str());
+      int last = atoi(tk.substr(colon + 1).c_str());
+      if (first > last) std::swap(first, last);
+      for (int i = first; i <= last && i < max; i++) idx.push_back(i);
+      return idx;
+    }
+    idx.push_back(atoi(tk.c_str()));
+    return idx;
+  }
+
+  // Commands to set a per channel register to the target values, starting from a
+  // global default, then ASIC defaults and finally the channel exceptions
+  std::vector<std::string> PlanRegister(const std::string& reg, const std::vector<std::vector<int>>& target, int globalValue) {
+    std::vector<std::string> cmds;
+    char cmd[200];
+    sprintf(cmd, "%s * * 0x%X", reg.c_str(), globalValue);
+    cmds.push_back(cmd);
+
+      for (size_t a = 0; a < target.size(); a++) {
+        std::vector<std::string> plan[2];
+          for (int asicValue : {0, 1}) {
+              if (asicValue != globalValue) {
+                sprintf(cmd, "%s %zu * 0x%X", reg.c_str(), a, asicValue);
+                plan[asicValue].push_back(cmd);
+              }
+              for (size_t c = 0; c < target[a].size(); c++) {
+                if (target[a][c] == asicValue) continue;
+                sprintf(cmd, "%s %zu %zu 0x%X", reg.c_str(), a, c, 1 - asicValue);
+                plan[asicValue].push_back(cmd);
+              }
+          }
+        const auto& best = plan[0].size() <= plan[1].size() ? plan[0] : plan[1];
+        cmds.insert(cmds.end(), best.begin(), best.end());
+      }
+
+    return cmds;
+  }
+
+  // Numbers are stored in decimal so 0x1 and 1 are the same value
+  std::string Normalize(const std::string& value) {
+    char* endptr;
+    const long v = strtol(value.c_str(), &endptr, 0);
+    if (*endptr != '\0' || value.empty()) return value;
+    return std::to_string(v);
+  }
+
+}
+
+std::vector<std::vector<std::string>> FEMConfig::Compile(const TRestRawDAQMetadata::FECMetadata& fec, dialect d) {
+
+  std::vector<std::vector<std::string>> blocks;
+  char cmd[200];
+  // ARC firmware uses 3:0 to address all the ASICs
+  const std::string allAsics = d == dialect::ARC ? "3:0" : "*";
+
+  auto add = [&blocks](const std::string& c) { blocks.push_back({c}); };
+
+  sprintf(cmd, "sca wckdiv 0x%X", fec.clockDiv);  // Clock div
+  add(cmd);
+  add("sca cnt 0x200");
+  add("sca autostart 1");
+
+  if (d == dialect::ARC) {
+    add("rst_len 1");
+    add("mmpol 0x3");
+    //Test mode settings
+    add("keep_fco 0");
+    add("test_zbt 0");
+    add("test_enable 0");
+    add("test_mode 0");
+    add("tdata A 0x40");
+  } else {
+    add("rst_len 0");
+  }
+
+  //AGET settings
+  add("aget " + allAsics + " autoreset_bank 0x1");
+  if (d == dialect::ARC) add("aget " + allAsics + " dis_multiplicity_out 0x0");
+
+    for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
+      if(!fec.asic_isActive[a])continue;
+      sprintf(cmd, "aget %d vicm 0x%X", a, fec.asic_polarity[a] == 0 ? 0x1 : 0x2);
+      add(cmd);
+      sprintf(cmd, "aget %d polarity 0x%X", a, fec.asic_polarity[a] == 0 ? 0x0 : 0x1);
+      add(cmd);
+    }
+
+  add("aget " + allAsics + " en_mkr_rst 0x0");
+  add("aget " + allAsics + " rst_level 0x1");
+  add("aget " + allAsics + " short_read " + (d == dialect::ARC ? "0x0" : "0x1"));
+  add("aget " + allAsics + " tst_digout " + (d == dialect::ARC ? "0x0" : "0x1"));
+  add("aget " + allAsics + " mode 0x1");
+
+    for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
+      if(!fec.asic_isActive[a])continue;
+      sprintf(cmd, "aget %d gain * 0x%X",a, (fec.asic_gain[a] & 0x3) ); //Gain
+      add(cmd);
+      sprintf(cmd, "aget %d time 0x%X",a, (fec.asic_shappingTime[a] & 0xF) );  //Shapping time
+      add(cmd);
+    }
+  add("aget " + allAsics + " dac 0x0");
+
+  //The channel mask is not configured with the ARC firmware, all the channels are read
+  if (d == dialect::ARC) return blocks;
+
+  //# Channel ena/disable (AGET only), commands override each other so they are kept in a single block
+  blocks.push_back(PlanChannelMask(fec));
+
+  return blocks;
+}
+
+std::vector<std::string> FEMConfig::PlanChannelMask(const TRestRawDAQMetadata::FECMetadata& fec) {
+  // forceoff is set for the disabled channels and forceon for the enabled ones
+  std::vector<std::vector<int>> forceoff(TRestRawDAQMetadata::nAsics, std::vector<int>(TRestRawDAQMetadata::nChannels));
+  std::vector<std::vector<int>> forceon = forceoff;
+    for (int a = 0; a < TRestRawDAQMetadata::nAsics; a++) {
+      for (int c = 0; c < TRestRawDAQMetadata::nChannels; c++) {
+        const bool active = fec.asic_isActive[a] && fec.asic_channelActive[a][c];
+        forceoff[a][c] = active ? 0 : 1;
+        forceon[a][c] = active ? 1 : 0;
+      }
+    }
+
+  std::vector<std::string> mask = {"forceon_all 1"};
+    for (const auto& [reg, target] : {std::make_pair("forceoff", forceoff), std::make_pair("forceon", forceon)}) {
+      auto plan = PlanRegister(reg, target, 0);
+      auto alt = PlanRegister(reg, target, 1);
+      if (alt.size() < plan.size()) plan = alt;
+      mask.insert(mask.end(), plan.begin(), plan.end());
+    }
+
+  return mask;
+}
+
+int FEMConfig::LegacyChannelMaskSize(const TRestRawDAQMetadata::FECMetadata& fec) {
+  // One command per register and disabled channel on top of the global and ASIC settings
+  int size = 3;
+    for (int a = 0; a < TRestRawDAQMetadata::nAsics; a++) {
+      if (!fec.asic_isActive[a]) continue;
+      size += 2;
+      for (int c = 0; c < TRestRawDAQMetadata::nChannels; c++)
+        if (!fec.asic_channelActive[a][c]) size += 2;
+    }
+  return size;
+}
+
+bool FEMConfig::IsRegisterCommand(const std::string& cmd) {
+  const auto tokens = Tokenize(cmd);
+  if (tokens.size() < 2 || registerCommands.count(tokens[0]) == 0) return false;
+  if (tokens[0] == "sca") return tokens.size() == 3 && scaRegisters.count(tokens[1]) > 0;
+  return true;
+}
+
+bool FEMConfig::ResetsRegisters(const std::string& cmd) {
+  // FEC power cycle, the ASIC registers go back to default values
+  const auto tokens = Tokenize(cmd);
+  return !tokens.empty() && (tokens[0] == "fec_enable" || tokens[0] == "power_inv");
+}
+
+std::vector<std::string> FEMConfig::ExpandRegisters(const std::string& cmd, std::string& value) {
+  std::vector<std::string> keys;
+  if (!IsRegisterCommand(cmd)) return keys;
+
+  auto tokens = Tokenize(cmd);
+  value = Normalize(tokens.back());
+  tokens.pop_back();
+
+  // Positions of the ASIC and channel indexes
+  int asicPos = -1;
+  std::vector<int> chanPos;
+  if (tokens[0] == "aget" || tokens[0] == "polarity") {
+    asicPos = 1;
+    for (size_t i = 3; i < tokens.size(); i++) chanPos.push_back(i);
+  } else if (tokens[0] == "forceon" || tokens[0] == "forceoff" || tokens[0] == "ped" || tokens[0] == "thr") {
+    asicPos = 1;
+    if (tokens.size() > 2) chanPos.push_back(2);
+  }
+
+  keys.push_back("");
+  for (size_t i = 0; i < tokens.size(); i++) {
+    std::vector<int> idx;
+    if ((int)i == asicPos) {
+      idx = ExpandIndex(tokens[i], TRestRawDAQMetadata::nAsics);
+    } else if (std::find(chanPos.begin(), chanPos.end(), (int)i) != chanPos.end()) {
+      idx = ExpandIndex(tokens[i], TRestRawDAQMetadata::nChannels);
+    }
+
+    std::vector<std::string> expanded;
+    for (const auto& k : keys) {
+      const std::string sep = k.empty() ? "" : " ";
+      if (idx.empty()) {
+        expanded.push_back(k + sep + tokens[i]);
+      } else {
+        for (const auto& id : idx) expanded.push_back(k + sep + std::to_string(id));
+      }
+    }
+    keys = std::move(expanded);
+  }
+
+  return keys;
+}
+
+bool FEMConfig::IsApplied(const std::vector<std::string>& block, const registerMap& registers) {
+  // Simulate the block over the registers it touches and compare with the current state
+  registerMap touched;
+  for (const auto& cmd : block) {
+    std::string value;
+    const auto keys = ExpandRegisters(cmd, value);
+    if (keys.empty()) return false;  // Not a register, always sent
+      for (const auto& k : keys) {
+        auto it = registers.find(k);
+        if (it == registers.end()) return false;  // Unknown state
+        touched[k] = value;
+      }
+  }
+
+  for (const auto& [k, v] : touched) {
+    if (registers.at(k) != v) return false;
+  }
+
+  return true;
+}
+
+void FEMConfig::Apply(const std::string& cmd, registerMap& registers) {
+  if (ResetsRegisters(cmd)) {
+    registers.clear();
+    return;
+  }
+
+  std::string value;
+  for (const auto& k : ExpandRegisters(cmd, value)) registers[k] = value;
+}
+
+void FEMConfig::Invalidate(const std::string& cmd, registerMap& registers) {
+  if (ResetsRegisters(cmd)) {
+    registers.clear();
+    return;
+  }
+
+  std::string value;
+  for (const auto& k : ExpandRegisters(cmd, value)) registers.erase(k);
+}
+
+std::string FEMConfig::GetCacheFile(const std::string& cacheDir, const TRestRawDAQMetadata::FECMetadata& fec) {
+  char name[256];
+  sprintf(name, "/FEM_%d_%d.%d.%d.%d.cfg", fec.id, fec.ip[0], fec.ip[1], fec.ip[2], fec.ip[3]);
+  return cacheDir + name;
+}
+
+bool FEMConfig::LoadCache(const std::string& fileName, registerMap& registers) {
+  registers.clear();
+  std::ifstream file(fileName);
+  if (!file.is_open()) return false;
+
+  std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      const size_t tab = line.find('\t');
+      if (tab == std::string::npos) continue;
+      registers[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+
+  return true;
+}
+
+bool FEMConfig::SaveCache(const std::string& fileName, const registerMap& registers) {
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(fileName).parent_path(), ec);
+
+  std::ofstream file(fileName, std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write FEM config cache " << fileName << std::endl;
+    return false;
+  }
+
+  file << "# restDAQ FEM register cache, delete this file to force a full configuration" << std::endl;
+  for (const auto& [k, v] : registers) file << k << '\t' << v << std::endl;
+
+  return true;
+}
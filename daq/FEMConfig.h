@@ -0,0 +1,49 @@
+/*********************************************************************************
+FEMConfig.h
+
+Configuration command compiler for FEMINOS and ARC based readout
+
+Translates the FEC/ASIC settings of TRestRawDAQMetadata into the list of
+commands needed to configure a FEM, and keeps track of the register values
+already written to the FEM so only the differences are sent.
+
+*********************************************************************************/
+
+#ifndef __FEM_CONFIG__
+#define __FEM_CONFIG__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TRestRawDAQMetadata.h"
+
+namespace FEMConfig {
+
+  enum class dialect { FEMINOS = 0, ARC = 1 };
+
+  // Register key (command without value) and last value written
+  typedef std::map<std::string, std::string> registerMap;
+
+  // Commands grouped in blocks, commands inside a block override each other and are sent together
+  std::vector<std::vector<std::string>> Compile(const TRestRawDAQMetadata::FECMetadata& fec, dialect d);
+
+  // Fewest forceon/forceoff commands (wildcards and exceptions) matching asic_channelActive, FEMINOS only
+  std::vector<std::string> PlanChannelMask(const TRestRawDAQMetadata::FECMetadata& fec);
+  // Number of commands of the channel by channel mask sequence, used to report the savings
+  int LegacyChannelMaskSize(const TRestRawDAQMetadata::FECMetadata& fec);
+
+  std::vector<std::string> ExpandRegisters(const std::string& cmd, std::string& value);
+  bool IsRegisterCommand(const std::string& cmd);
+  bool ResetsRegisters(const std::string& cmd);
+  bool IsApplied(const std::vector<std::string>& block, const registerMap& registers);
+  void Apply(const std::string& cmd, registerMap& registers);
+  void Invalidate(const std::string& cmd, registerMap& registers);
+
+  std::string GetCacheFile(const std::string& cacheDir, const TRestRawDAQMetadata::FECMetadata& fec);
+  bool LoadCache(const std::string& fileName, registerMap& registers);
+  bool SaveCache(const std::string& fileName, const registerMap& registers);
+
+}
+
+#endif
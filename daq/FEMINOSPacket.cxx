@@ -1,5 +1,7 @@
 
 #include <FEMINOSPacket.h>
+#include "DAQTrace.h"
+#include "ZeroSuppression.h"
 
 #include <cstdio>
 #include <inttypes.h>
@@ -283,8 +285,9 @@ uint32_t FEMINOSPacket::GetUInt32FromBufferInv(uint16_t *fr, int & sz_rd){
   return res;
 }
 
-bool FEMINOSPacket::GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count){
+bool FEMINOSPacket::GetNextEvent(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs){
 
+  DAQ_TRACE_SPAN(GET_NEXT_EVENT);
   bool endOfEvent = false;
   int physChannel;
   //std::cout<<__PRETTY_FUNCTION__<<"  "<<buffer.size()<<std::endl;
@@ -340,8 +343,12 @@ bool FEMINOSPacket::GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEv
           if(buffer.empty())break;
         }
 
+      if(zs && !zs->Apply(physChannel, sData))continue;
       TRestRawSignal rawSignal(physChannel, sData);
-      sEvent->AddSignal(rawSignal);
+      {
+        DAQ_TRACE_COUNT(ADD_SIGNAL);
+        sEvent->AddSignal(rawSignal);
+      }
 
     } else if ( (buffer.front() & PFX_4_BIT_CONTENT_MASK) == PFX_END_OF_EVENT ){
       endOfEvent=true;
@@ -371,4 +378,16 @@ bool FEMINOSPacket::isDataFrame(uint16_t *fr){
 
 }
 
+//The start of event follows the start of frame header
+bool FEMINOSPacket::isEventStart(const uint16_t *fr, size_t size){
 
+  return size > 2 && (fr[2] & PFX_4_BIT_CONTENT_MASK) == PFX_START_OF_EVENT;
+
+}
+
+//End of event and event size, followed by the end of frame
+bool FEMINOSPacket::isEventEnd(const uint16_t *fr, size_t size){
+
+  return size >= 3 && fr[size-1] == PFX_END_OF_FRAME && (fr[size-3] & PFX_4_BIT_CONTENT_MASK) == PFX_END_OF_EVENT;
+
+}
@@ -157,9 +157,10 @@
 
 #define CURRENT_FRAMING_VERSION 0
 
+#include "FrameRing.h"
 #include "TRestRawSignalEvent.h"
 
-#include <deque>
+class ZeroSuppression;
 
 namespace FEMINOSPacket {
 
@@ -170,8 +171,12 @@ namespace FEMINOSPacket {
   int HistoStat_Print (uint16_t *fr, int &sz_rd, const uint16_t &hitCount);
   uint32_t GetUInt32FromBuffer(uint16_t *fr, int & sz_rd);
   uint32_t GetUInt32FromBufferInv(uint16_t *fr, int & sz_rd);
-  bool GetNextEvent(std::deque <uint16_t> &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count);
+  //The signals are zero suppressed by zs if it is given
+  bool GetNextEvent(FrameRing &buffer, TRestRawSignalEvent* sEvent, uint64_t &tS, uint32_t &ev_count, ZeroSuppression* zs = nullptr);
   bool isDataFrame(uint16_t *fr);
+  //First and last data frames of an event, size in words
+  bool isEventStart(const uint16_t *fr, size_t size);
+  bool isEventEnd(const uint16_t *fr, size_t size);
 
 }
 
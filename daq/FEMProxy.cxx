@@ -0,0 +1,97 @@
+/*********************************************************************************
+FEMProxy.cxx
+
+Author: JuanAn Garcia 18/08/2021
+
+Based on mclient program from Denis Calvet
+
+*********************************************************************************/
+
+#include "FEMProxy.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+void FEMProxy::AllocateBuffer(int size, bool hugePages){
+  buffer.Allocate((size_t)std::max(1, size) * 1024 * 1024, hugePages);
+}
+
+//Called by the receive thread, which serves all the FEMs: waiting here for the builder would stop the frames of the other FEMs
+size_t FEMProxy::PushFrame(const uint16_t* first, const uint16_t* last){
+
+  std::unique_lock<std::mutex> lock(mutex_mem);
+  lastData = std::chrono::steady_clock::now();
+    if(!buffer.push_back(first, last)){
+        if(bufferDrops++ == 0){
+          std::cerr << "Buffer of FEM " << fecMetadata.id << " full (" << buffer.capacity() * sizeof(uint16_t) / (1024 * 1024)
+                    << " MB), dropping data frames, please increase femBufferSize" << std::endl;
+        }
+      return 0;
+    }
+
+  const size_t size = buffer.size();
+  lock.unlock();
+  data_cv.notify_all();
+  return size;
+}
+
+void FEMProxy::WaitForData(std::vector<FEMProxy> &FEMA, std::chrono::milliseconds timeout){
+
+    if(FEMA.empty()){
+      std::this_thread::sleep_for(timeout);
+      return;
+    }
+
+  std::unique_lock<std::mutex> lock(FEMA.front().mutex_mem);
+  FEMA.front().data_cv.wait_for(lock, timeout, [&FEMA]{
+    for (const auto &FEM : FEMA)if(!FEM.buffer.empty())return true;
+    return false;
+  });
+}
+
+std::vector<TRESTDAQSocket::counters> FEMProxy::GetCounters(std::vector<FEMProxy> &FEMA){
+
+  std::vector<TRESTDAQSocket::counters> counters;
+  if(FEMA.empty())return counters;
+  std::unique_lock<std::mutex> lock(FEMA.front().mutex_socket);
+  std::unique_lock<std::mutex> lock_mem(FEMA.front().mutex_mem);
+    for (const auto &FEM : FEMA){
+      counters.push_back(FEM.TRESTDAQSocket::GetCounters(FEM.fecMetadata.id));
+      counters.back().bufferDrops = FEM.bufferDrops;
+    }
+  return counters;
+}
+
+bool FEMProxy::EventStalled(std::vector<FEMProxy> &FEMA){
+
+  if(FEMA.empty())return false;
+  std::unique_lock<std::mutex> lock(FEMA.front().mutex_mem);
+  bool waiting = false, starved = false;
+    for (const auto &FEM : FEMA){
+      if(!FEM.pendingEvent && FEM.buffer.size() > FEM.buffer.capacity() / 2)waiting = true;
+      if(FEM.pendingEvent && FEM.buffer.empty())starved = true;
+    }
+  return waiting && starved;
+}
+
+//Wait till no data frame has been received from any FEM during the quiet time, or the timeout is reached
+bool FEMProxy::WaitForDrain(std::vector<FEMProxy> &FEMA, std::chrono::milliseconds quiet, std::chrono::milliseconds timeout){
+
+  const auto start = std::chrono::steady_clock::now();
+
+    while (std::chrono::steady_clock::now() - start < timeout) {
+      auto last = start;
+        for (const auto &FEM : FEMA){
+          std::unique_lock<std::mutex> lock(FEM.mutex_mem);
+          if(FEM.lastData > last)last = FEM.lastData;
+        }
+
+      const auto now = std::chrono::steady_clock::now();
+      if(now - last >= quiet)return true;
+
+      std::this_thread::sleep_for(std::min(quiet - std::chrono::duration_cast<std::chrono::milliseconds>(now - last), std::chrono::milliseconds(100)));
+    }
+
+  return false;
+}
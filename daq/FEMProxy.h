@@ -10,15 +10,34 @@ Based on mclient program from Denis Calvet
 #ifndef __FEM_PROXY__
 #define __FEM_PROXY__
 
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "TRestRawDAQMetadata.h"
 #include "TRESTDAQSocket.h"
+#include "FEMConfig.h"
+#include "FrameRing.h"
+#include "DAQRunControl.h"
 
 class FEMProxy : public TRESTDAQSocket {
   
   public:
-    FEMProxy(){ }
+    //Locks of the FEMs of a DAQ, shared by its receive and event builder threads
+    struct femSet {
+      std::mutex mutex_socket;
+      std::mutex mutex_mem;
+      //Notified by the receive thread when a command reply arrives, used with mutex_socket
+      std::condition_variable cmd_cv;
+      //Notified when a data frame is pushed to a buffer, used with mutex_mem
+      std::condition_variable data_cv;
+    };
+
+    //Every FEM of a DAQ is created with the same set
+    FEMProxy(const std::shared_ptr<femSet> &s) : set(s), mutex_socket(s->mutex_socket), mutex_mem(s->mutex_mem), cmd_cv(s->cmd_cv), data_cv(s->data_cv) { }
     bool pendingEvent=true;
     TRestRawDAQMetadata::FECMetadata fecMetadata;
     //std::atomic_int
@@ -26,10 +45,45 @@ class FEMProxy : public TRESTDAQSocket {
     //std::atomic_int
     int cmd_rcv=0;
 
-    std::deque <uint16_t> buffer;
+    //Data frames waiting for the event builder, allocated with AllocateBuffer
+    FrameRing buffer;
+
+    //Last reply frame (non data) received from the FEM
+    std::vector<uint16_t> reply;
+    //Arrival time of the last data frame, used to check when the FEM has been drained
+    std::chrono::steady_clock::time_point lastData = std::chrono::steady_clock::now();
+
+    //Last known register values written to the FEM
+    FEMConfig::registerMap registers;
+
+  private:
+    std::shared_ptr<femSet> set;
+
+  public:
+    std::mutex &mutex_socket;
+    std::mutex &mutex_mem;
+    std::condition_variable &cmd_cv;
+    std::condition_variable &data_cv;
+
+    //Data frames dropped because they didn't fit in the buffer, under mutex_mem
+    uint64_t bufferDrops = 0;
+
+    //Data frame appended to the buffer. It never waits, the frame is dropped and counted if the buffer is full. Words buffered, 0 if dropped
+    size_t PushFrame(const uint16_t* first, const uint16_t* last);
+    //size in MB, see FrameRing
+    void AllocateBuffer(int size, bool hugePages);
+
+    //Socket counters of every FEM, taken under mutex_socket, with the frames dropped by PushFrame
+    static std::vector<TRESTDAQSocket::counters> GetCounters(std::vector<FEMProxy> &FEMA);
+
+    //Wait till a frame is pushed to the buffer of any FEM or the timeout, used by the event builders. The FEMs share their femSet
+    static void WaitForData(std::vector<FEMProxy> &FEMA, std::chrono::milliseconds timeout);
+
+    //A FEM that already has its part of the event holds the next events in more than half of its buffer, while the FEMs
+    //with the event pending have nothing buffered. The event builders close the event then, so the FEMs keep being drained
+    static bool EventStalled(std::vector<FEMProxy> &FEMA);
 
-    inline static std::mutex mutex_socket;
-    inline static std::mutex mutex_mem;
+    static bool WaitForDrain(std::vector<FEMProxy> &FEMA, std::chrono::milliseconds quiet, std::chrono::milliseconds timeout);
 };
 
 #endif
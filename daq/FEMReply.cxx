@@ -0,0 +1,128 @@
+/*********************************************************************************
+FEMReply.cxx
+
+Decoding of the command replies of the FEMINOS and ARC cards, see FEMReply.h
+
+*********************************************************************************/
+
+#include "FEMReply.h"
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+namespace {
+
+  //Prefixes of FEMINOSPacket.h and ARCPacket.h, the headers cannot be included together
+  constexpr uint16_t pfx9BitMask = 0xFE00;
+  constexpr uint16_t pfx8BitMask = 0xFF00;
+  constexpr uint16_t pfx14BitMask = 0xC000;
+  constexpr uint16_t startOfCFrame = 0x0400;
+  constexpr uint16_t startOfMFrame = 0x0600;
+  constexpr uint16_t asciiMsgLen = 0x0100;
+  constexpr uint16_t longAsciiMsg = 0x0005;//ARC only
+  constexpr uint16_t cardChipChanHisto = 0x4000;
+  constexpr uint16_t extdCardChipChanHisto = 0x0010;//ARC only, followed by the card/chip/channel word
+  constexpr uint16_t extdCardChipChanHMD = 0x0012;//ARC only
+  constexpr uint16_t frameSeqNb = 0x1000;//ARC, last cell read in FEMINOS which are not in the replies
+  constexpr uint16_t pedestalHStat = 0x000D;
+  constexpr uint16_t pedestalHMD = 0x000C;
+
+  //Size of the start of frame header of configuration or monitoring frames
+  size_t FrameHeaderSize(const std::vector<uint16_t> &frame){
+    if(frame.size() < 2)return 0;
+    if((frame[0] & pfx9BitMask) == startOfCFrame || (frame[0] & pfx9BitMask) == startOfMFrame)return 2;
+    return 0;
+  }
+
+}
+
+std::string FEMReply::GetAsciiMsg(const std::vector<uint16_t> &frame){
+
+  std::string asciiMsg;
+  size_t i = FrameHeaderSize(frame);
+  if(i >= frame.size())return asciiMsg;
+
+  size_t len = 0;
+    if ((frame[i] & pfx8BitMask) == asciiMsgLen){
+      len = frame[i] & 0x00FF;
+      i++;
+    } else if (frame[i] == longAsciiMsg && i + 1 < frame.size()) {
+      len = frame[i+1];
+      i += 2;
+    } else {
+      return asciiMsg;
+    }
+
+    for (size_t j=0; j<len && i + j/2 < frame.size(); j++){
+      const uint16_t w = frame[i + j/2];
+      const char c = j%2 == 0 ? (w & 0xFF) : ((w & 0xFF00) >> 8);
+      if(c == '\0')break;
+      asciiMsg += c;
+    }
+
+  return asciiMsg;
+}
+
+//The last number of the reply, a malformed one is reported as not found
+int FEMReply::GetPendingRequests(const std::vector<uint16_t> &frame){
+
+  const std::string msg = GetAsciiMsg(frame);
+  const size_t last = msg.find_last_of("0123456789");
+  if(last == std::string::npos)return -1;
+  size_t first = last;
+  while(first > 0 && isdigit(msg[first-1]))first--;
+
+  const std::string number = msg.substr(first, last - first + 1);
+  char* end = nullptr;
+  errno = 0;
+  const long pending = strtol(number.c_str(), &end, 10);
+  if(errno != 0 || *end != '\0' || pending > INT_MAX)return -1;
+
+  return pending;
+}
+
+int FEMReply::GetHistoEntries(const std::vector<uint16_t> &frame){
+
+    for (size_t i = FrameHeaderSize(frame); i<frame.size(); i++){
+      if((frame[i] & pfx14BitMask) == cardChipChanHisto)continue;
+      if(frame[i] == extdCardChipChanHisto){
+        i++;
+        continue;
+      }
+      if((frame[i] & pfx9BitMask) == frameSeqNb)continue;
+      if(frame[i] != pedestalHStat)break;
+      //Min bin, max bin, bin width, bin count, min value, max value, mean and std dev precede the entries
+      if(i + 18 >= frame.size())break;
+      return (frame[i+17] << 16) | frame[i+18];
+    }
+
+  return -1;
+}
+
+//FEMINOS: channel histogram word followed by the mean and deviation, ARC: extended header with the channel
+int FEMReply::GetPedestalSummary(const std::vector<uint16_t> &frame, std::map<int, std::pair<double, double> > &summary){
+
+  int channel = -1, nCh = 0;
+    for (size_t i = FrameHeaderSize(frame); i<frame.size(); i++){
+      if((frame[i] & pfx14BitMask) == cardChipChanHisto){
+        channel = frame[i] & 0x007F;
+      } else if(frame[i] == pedestalHMD && i + 4 < frame.size()){
+        const uint32_t mean = frame[i+1] | (frame[i+2] << 16);
+        const uint32_t std_dev = frame[i+3] | (frame[i+4] << 16);
+        if(channel >= 0)summary[channel] = {mean/100., std_dev/100.};
+        nCh++;
+        i += 5;//Mean, std dev and trailing word
+      } else if(frame[i] == extdCardChipChanHMD && i + 5 < frame.size()){
+        const int chan = frame[i+1] & 0x007F;
+        const uint32_t mean = frame[i+2] | (frame[i+3] << 16);
+        const uint32_t std_dev = frame[i+4] | (frame[i+5] << 16);
+        summary[chan] = {mean/100., std_dev/100.};
+        nCh++;
+        i += 5;
+      }
+    }
+
+  return nCh;
+}
@@ -0,0 +1,31 @@
+/*********************************************************************************
+FEMReply.h
+
+Decoding of the configuration and monitoring frames replied by the FEMINOS
+and ARC cards to the commands, shared by both backends. The prefixes used
+here have the same meaning in both frame formats
+
+*********************************************************************************/
+
+#ifndef __FEM_REPLY__
+#define __FEM_REPLY__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace FEMReply {
+
+  std::string GetAsciiMsg(const std::vector<uint16_t> &frame);
+  //Number of pending requests reported by "rbf getpnd"; -1 if not found
+  int GetPendingRequests(const std::vector<uint16_t> &frame);
+  //Number of entries of the pedestal histogram statistics of a "hped getsummary" reply; -1 if not found
+  int GetHistoEntries(const std::vector<uint16_t> &frame);
+  //Channel mean and std dev from a "hped getsummary" reply, returns the number of channels found
+  int GetPedestalSummary(const std::vector<uint16_t> &frame, std::map<int, std::pair<double, double> > &summary);
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*********************************************************************************
+FrameRing.cxx
+
+Ring of the words received from a FEM, see FrameRing.h
+
+*********************************************************************************/
+
+#include "FrameRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+FrameRing::~FrameRing(){
+  PageAllocator::Free(mem);
+}
+
+FrameRing::FrameRing(FrameRing&& other) noexcept {
+  *this = std::move(other);
+}
+
+FrameRing& FrameRing::operator=(FrameRing&& other) noexcept {
+    if(this != &other){
+      PageAllocator::Free(mem);
+      mem = std::exchange(other.mem, PageAllocator::block());
+      data = std::exchange(other.data, nullptr);
+      mask = std::exchange(other.mask, 0);
+      head = std::exchange(other.head, 0);
+      tail = std::exchange(other.tail, 0);
+    }
+  return *this;
+}
+
+void FrameRing::Allocate(size_t size, bool hugePages){
+
+  size_t words = 1;
+  while(words * sizeof(uint16_t) < size)words <<= 1;
+
+  PageAllocator::Free(mem);
+  data = nullptr;
+  mem = PageAllocator::Allocate(words * sizeof(uint16_t), hugePages);
+  data = (uint16_t*)mem.data;
+  mask = words - 1;
+  clear();
+}
+
+bool FrameRing::push_back(const uint16_t* first, const uint16_t* last){
+
+  const size_t n = last - first;
+  if(n > available())return false;
+
+  //At most two copies, the end of the block and its beginning
+  const size_t pos = tail & mask;
+  const size_t chunk = std::min(n, mask + 1 - pos);
+  memcpy(data + pos, first, chunk * sizeof(uint16_t));
+  if(chunk < n)memcpy(data, first + chunk, (n - chunk) * sizeof(uint16_t));
+  tail += n;
+
+  return true;
+}
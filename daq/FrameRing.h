@@ -0,0 +1,60 @@
+/*********************************************************************************
+FrameRing.h
+
+Ring of the 16 bit words received from a FEM, written by the receive thread
+and decoded by the event builder thread (ARCPacket and FEMINOSPacket
+GetNextEvent) under the mutex_mem of the FEMProxy set. It replaces the std::deque of
+the FEM buffers: the words are stored in a single block of a fixed capacity,
+allocated with PageAllocator (2 MB huge pages when available), so the handoff
+between both threads doesn't allocate and walks contiguous memory.
+
+The capacity is a power of two words, push_back fails when the frame doesn't
+fit and the receive thread drops it (see FEMProxy::PushFrame).
+
+*********************************************************************************/
+
+#ifndef __FRAME_RING__
+#define __FRAME_RING__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PageAllocator.h"
+
+class FrameRing {
+  public:
+    FrameRing(){ }
+    ~FrameRing();
+
+    FrameRing(FrameRing&& other) noexcept;
+    FrameRing& operator=(FrameRing&& other) noexcept;
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    //At least size bytes, the words buffered are dropped
+    void Allocate(size_t size, bool hugePages = true);
+
+    inline bool empty() const { return head == tail; }
+    inline size_t size() const { return tail - head; }
+    inline size_t capacity() const { return data ? mask + 1 : 0; }
+    inline size_t available() const { return capacity() - size(); }
+
+    inline uint16_t front() const { return data[head & mask]; }
+    //Nothing is done if empty, the decoders don't check every word of a frame
+    inline void pop_front() { if (head != tail) head++; }
+
+    //The whole frame or nothing, false if it doesn't fit
+    bool push_back(const uint16_t* first, const uint16_t* last);
+    void clear() { head = tail = 0; }
+
+    inline PageAllocator::pages GetPages() const { return mem.kind; }
+
+  private:
+    PageAllocator::block mem;
+    uint16_t* data = nullptr;
+    size_t mask = 0;
+    uint64_t head = 0;//Words read since the allocation
+    uint64_t tail = 0;//Words written
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*********************************************************************************
+PageAllocator.cxx
+
+Allocator of the large buffers of the receive and builder stages, see
+PageAllocator.h
+
+*********************************************************************************/
+
+#include "PageAllocator.h"
+#include "TRESTDAQException.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+namespace {
+  size_t RoundUp(size_t size, size_t page){ return (size + page - 1) / page * page; }
+}
+
+const char* PageAllocator::GetPagesName(pages kind){
+    switch(kind){
+      case pages::HUGETLB: return "2 MB huge pages";
+      case pages::TRANSPARENT: return "transparent huge pages";
+      default: return "normal pages";
+    }
+}
+
+bool PageAllocator::TransparentHugePagesEnabled(){
+  //e.g. "always [madvise] never"
+  std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string line;
+  if(!std::getline(file, line))return false;
+  return line.find("[never]") == std::string::npos;
+}
+
+PageAllocator::block PageAllocator::Map(size_t size, bool hugePages){
+
+  block b;
+    if(hugePages){
+      b.size = RoundUp(size, hugePageSize);
+#ifdef MAP_HUGETLB
+      b.data = mmap(nullptr, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+        if(b.data != MAP_FAILED){
+          b.kind = pages::HUGETLB;
+          return b;
+        }
+#endif
+
+#ifdef MADV_HUGEPAGE
+        if(TransparentHugePagesEnabled()){
+          //Mapped with one huge page of margin, the ends are unmapped to leave it 2 MB aligned
+          const size_t mapped = b.size + hugePageSize;
+          void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(raw != MAP_FAILED){
+              const uintptr_t start = RoundUp((uintptr_t)raw, hugePageSize);
+              const size_t head = start - (uintptr_t)raw;
+              if(head > 0)munmap(raw, head);
+              if(mapped - head - b.size > 0)munmap((char*)start + b.size, mapped - head - b.size);
+              b.data = (void*)start;
+              b.kind = madvise(b.data, b.size, MADV_HUGEPAGE) == 0 ? pages::TRANSPARENT : pages::NORMAL;
+              return b;
+            }
+        }
+#endif
+    }
+
+  b.size = RoundUp(size, sysconf(_SC_PAGESIZE));
+  b.kind = pages::NORMAL;
+  b.data = mmap(nullptr, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(b.data == MAP_FAILED){
+      b.data = nullptr;
+      throw (TRESTDAQException("Cannot allocate " + std::to_string(size / (1024 * 1024)) + " MB: " + std::strerror(errno)));
+    }
+
+  return b;
+}
+
+PageAllocator::block PageAllocator::Allocate(size_t size, bool hugePages){
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+        for(auto it = slabs.begin(); it != slabs.end(); ++it){
+          //A slab of normal pages is not reused when huge pages are requested, they may be available now
+          if(it->size < size || it->size >= 2 * size || (hugePages && it->kind == pages::NORMAL) || (!hugePages && it->kind != pages::NORMAL))continue;
+          block b = *it;
+          slabs.erase(it);
+          return b;
+        }
+    }
+
+  block b = Map(size, hugePages);
+  std::cout << "Allocated " << b.size / (1024 * 1024) << " MB on " << GetPagesName(b.kind) << std::endl;
+  return b;
+}
+
+void PageAllocator::Free(block& b){
+
+  if(!b.data)return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  slabs.push_back(b);
+  b = block();
+}
+
+void PageAllocator::Release(){
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto &b : slabs)munmap(b.data, b.size);
+  slabs.clear();
+}
@@ -0,0 +1,60 @@
+/*********************************************************************************
+PageAllocator.h
+
+Allocator of the large buffers of the receive and builder stages (e.g. the
+frame rings of the FEMs, see FrameRing.h), mapped on 2 MB huge pages when
+available so the builder walking a buffer of hundreds of MB written by the
+receive thread doesn't miss the TLB every 4 kB.
+
+In order of preference:
+
+  HUGETLB      explicit huge pages (MAP_HUGETLB), reserved by the admin in
+               /proc/sys/vm/nr_hugepages
+  TRANSPARENT  2 MB aligned mapping advised for transparent huge pages, when
+               /sys/kernel/mm/transparent_hugepage/enabled is not "never"
+  NORMAL       4 kB pages
+
+The fallback is transparent for the caller, the kind of pages is reported.
+The freed blocks are kept as slabs and reused by the next allocation of the
+same size (e.g. the buffers of the next file of the run) until Release.
+
+*********************************************************************************/
+
+#ifndef __PAGE_ALLOCATOR__
+#define __PAGE_ALLOCATOR__
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+class PageAllocator {
+  public:
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+    enum class pages { NORMAL = 0, TRANSPARENT, HUGETLB };
+
+    struct block {
+      void* data = nullptr;
+      size_t size = 0;//Bytes, rounded to the page size
+      pages kind = pages::NORMAL;
+    };
+
+    //Zero filled when mapped, the content of a reused slab is undefined. Throws
+    //TRESTDAQException if the memory can't be mapped. hugePages false maps normal pages
+    static block Allocate(size_t size, bool hugePages = true);
+    //The block is kept for reuse
+    static void Free(block& b);
+    //Unmaps the blocks kept for reuse, e.g. at the end of the run
+    static void Release();
+
+    static const char* GetPagesName(pages kind);
+
+  private:
+    static block Map(size_t size, bool hugePages);
+    static bool TransparentHugePagesEnabled();
+
+    inline static std::mutex mutex;
+    inline static std::vector<block> slabs;
+};
+
+#endif
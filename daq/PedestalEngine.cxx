@@ -0,0 +1,91 @@
+/*********************************************************************************
+PedestalEngine.cxx
+
+Host side pedestal calculation from full waveform data
+
+*********************************************************************************/
+
+#include "PedestalEngine.h"
+
+#include <cmath>
+#include <cstdint>
+
+void PedestalEngine::AddEvent(TRestRawSignalEvent* sEvent){
+
+    for(int s=0; s<sEvent->GetNumberOfSignals(); s++){
+      TRestRawSignal* sgnl = sEvent->GetSignal(s);
+      const size_t size = sgnl->GetNumberOfPoints();
+      samples.resize(size);
+      for(size_t i=0; i<size; i++)samples[i] = (*sgnl)[i];
+      AddSignal(sgnl->GetID(), samples.data(), size);
+    }
+
+  nEvents++;
+}
+
+void PedestalEngine::AddSignal(int channel, const Short_t* data, size_t size){
+
+  channelStats &st = stats[channel];
+    if(st.n.size() < size){
+      st.n.resize(size, 0);
+      st.mean.resize(size, 0);
+      st.m2.resize(size, 0);
+    }
+
+  double* __restrict n = st.n.data();
+  double* __restrict mean = st.mean.data();
+  double* __restrict m2 = st.m2.data();
+
+    //Welford update, independent for each time bin
+    for(size_t i=0; i<size; i++){
+      const double x = data[i];
+      n[i] += 1;
+      const double delta = x - mean[i];
+      mean[i] += delta / n[i];
+      m2[i] += delta * (x - mean[i]);
+    }
+}
+
+bool PedestalEngine::GetPedestal(int channel, double &mean, double &rms) const {
+
+  auto it = stats.find(channel);
+  if(it == stats.end())return false;
+
+  const channelStats &st = it->second;
+  double n = 0, sum = 0;
+    for(size_t i=0; i<st.n.size(); i++){
+      n += st.n[i];
+      sum += st.n[i] * st.mean[i];
+    }
+  if(n == 0)return false;
+  mean = sum / n;
+
+  //Merge the time bins (Chan et al.)
+  double m2 = 0;
+    for(size_t i=0; i<st.n.size(); i++){
+      const double delta = st.mean[i] - mean;
+      m2 += st.m2[i] + st.n[i] * delta * delta;
+    }
+  rms = std::sqrt(m2 / n);
+
+  return true;
+}
+
+void PedestalEngine::FillPedestalEvent(TRestRawSignalEvent* pedEvent) const {
+
+    for(const auto &[channel, st] : stats){
+      double mean, rms;
+      if(!GetPedestal(channel, mean, rms))continue;
+      //Same encoding than the pedestal summary from the electronics, 16 bit in hundredths
+      const Short_t m = (Short_t)(uint16_t)std::lround(std::min(mean * 100., 65535.));
+      const Short_t s = (Short_t)(uint16_t)std::lround(std::min(rms * 100., 65535.));
+      std::vector<Short_t> sData = {m, s};
+      TRestRawSignal rawSignal(channel, sData);
+      pedEvent->AddSignal(rawSignal);
+    }
+}
+
+void PedestalEngine::Clear(){
+  stats.clear();
+  nEvents = 0;
+}
@@ -0,0 +1,49 @@
+/*********************************************************************************
+PedestalEngine.h
+
+Host side pedestal calculation from full waveform data
+
+Accumulates mean and RMS for every channel and time bin using online Welford
+updates, the loops run over contiguous time bins so they are vectorized by
+the compiler. The results are provided as a pedestal event with the same
+layout than the pedestal events from the electronics (TRESTDAQDCC::savePedestals),
+one signal per channel with {mean, stdev} in hundredths of ADC units.
+
+*********************************************************************************/
+
+#ifndef __PEDESTAL_ENGINE__
+#define __PEDESTAL_ENGINE__
+
+#include <map>
+#include <vector>
+
+#include "TRestRawSignalEvent.h"
+
+class PedestalEngine {
+  public:
+    PedestalEngine(){ }
+
+    void AddEvent(TRestRawSignalEvent* sEvent);
+    void AddSignal(int channel, const Short_t* data, size_t size);
+
+    void FillPedestalEvent(TRestRawSignalEvent* pedEvent) const;
+    bool GetPedestal(int channel, double &mean, double &rms) const;
+
+    inline size_t GetNumberOfEvents() const { return nEvents; }
+    inline size_t GetNumberOfChannels() const { return stats.size(); }
+    void Clear();
+
+  private:
+    //Running statistics per time bin, stored as separate arrays to keep the updates vectorized
+    struct channelStats {
+      std::vector<double> n;
+      std::vector<double> mean;
+      std::vector<double> m2;
+    };
+
+    std::map<int, channelStats> stats;//Indexed by physical channel
+    size_t nEvents = 0;
+    std::vector<Short_t> samples;//Scratch buffer
+};
+
+#endif
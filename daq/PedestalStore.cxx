@@ -0,0 +1,162 @@
+/*********************************************************************************
+PedestalStore.cxx
+
+Local store of the pedestals and thresholds derived in the pedestal runs of
+FEMINOS and ARC based readout
+
+*********************************************************************************/
+
+#include "PedestalStore.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Same operations than "hped centermean" and "hped setthr" in the FEM: the pedestal shifts the
+// mean of each channel to the center and the threshold is set at pedThr sigmas over the center
+PedestalStore::asicPedestals PedestalStore::Compute(const TRestRawDAQMetadata::FECMetadata& fec, int asic, const pedSummary& raw,
+                                                    const pedSummary& subtracted) {
+  asicPedestals entry;
+  entry.fecId = fec.id;
+  entry.asic = asic;
+  entry.gain = fec.asic_gain[asic];
+  entry.shapingTime = fec.asic_shappingTime[asic];
+  entry.clockDiv = fec.clockDiv;
+  entry.center = fec.asic_pedCenter[asic];
+  entry.pedThr = fec.asic_pedThr[asic];
+  entry.ped.assign(TRestRawDAQMetadata::nChannels, 0);
+  entry.thr.assign(TRestRawDAQMetadata::nChannels, 0);
+
+    for (const auto& [c, md] : raw) {
+      if (c < 0 || c >= TRestRawDAQMetadata::nChannels) continue;
+      entry.ped[c] = std::lround(md.first) - entry.center;
+    }
+
+    for (const auto& [c, md] : subtracted) {
+      if (c < 0 || c >= TRestRawDAQMetadata::nChannels) continue;
+      entry.thr[c] = entry.center + std::lround(entry.pedThr * md.second);
+    }
+
+  return entry;
+}
+
+bool PedestalStore::IsValid(const asicPedestals& entry, const TRestRawDAQMetadata::FECMetadata& fec, int asic, double timestamp,
+                            double maxAge) {
+  if (entry.fecId != fec.id || entry.asic != asic) return false;
+  if (entry.gain != fec.asic_gain[asic] || entry.shapingTime != fec.asic_shappingTime[asic] || entry.clockDiv != fec.clockDiv) return false;
+  if (entry.center != fec.asic_pedCenter[asic] || std::abs(entry.pedThr - fec.asic_pedThr[asic]) > 1E-3) return false;
+  if (entry.ped.size() != (size_t)TRestRawDAQMetadata::nChannels || entry.thr.size() != (size_t)TRestRawDAQMetadata::nChannels) return false;
+
+  return timestamp - entry.timestamp <= maxAge;
+}
+
+namespace {
+
+  // The most frequent value is set to all the channels of the ASIC at once, then the channels with other values
+  void AddRegister(std::vector<std::string>& cmds, const char* reg, int asic, const std::vector<int>& values) {
+    std::map<int, int> count;
+    for (const auto v : values) count[v]++;
+    auto common = count.begin();
+    for (auto it = count.begin(); it != count.end(); it++)
+      if (it->second > common->second) common = it;
+    const bool wildcard = common != count.end() && common->second > 1;
+
+    char cmd[200];
+      if (wildcard) {
+        sprintf(cmd, "%s %d * %d", reg, asic, common->first);
+        cmds.push_back(cmd);
+      }
+      for (size_t c = 0; c < values.size(); c++) {
+        if (wildcard && values[c] == common->first) continue;
+        sprintf(cmd, "%s %d %zu %d", reg, asic, c, values[c]);
+        cmds.push_back(cmd);
+      }
+  }
+
+}
+
+std::vector<std::string> PedestalStore::GetCommands(const asicPedestals& entry) {
+  std::vector<std::string> cmds;
+  AddRegister(cmds, "ped", entry.asic, entry.ped);
+  AddRegister(cmds, "thr", entry.asic, entry.thr);
+  return cmds;
+}
+
+std::string PedestalStore::GetFileName(const std::string& storeDir, const TRestRawDAQMetadata::FECMetadata& fec, int asic) {
+  char name[256];
+  sprintf(name, "/PED_%d_%d.%d.%d.%d_ASIC%d_G%d_T%d_C%d.txt", fec.id, fec.ip[0], fec.ip[1], fec.ip[2], fec.ip[3], asic,
+          fec.asic_gain[asic], fec.asic_shappingTime[asic], fec.clockDiv);
+  return storeDir + name;
+}
+
+bool PedestalStore::Load(const std::string& fileName, asicPedestals& entry) {
+  std::ifstream file(fileName);
+  if (!file.is_open()) return false;
+
+  entry = asicPedestals();
+  entry.ped.assign(TRestRawDAQMetadata::nChannels, 0);
+  entry.thr.assign(TRestRawDAQMetadata::nChannels, 0);
+
+  std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      std::istringstream str(line);
+      std::string key;
+      str >> key;
+        if (key == "ped" || key == "thr") {
+          int c, v;
+          if (!(str >> c >> v) || c < 0 || c >= TRestRawDAQMetadata::nChannels) continue;
+          (key == "ped" ? entry.ped : entry.thr)[c] = v;
+        } else if (key == "fecId") {
+          str >> entry.fecId;
+        } else if (key == "asic") {
+          str >> entry.asic;
+        } else if (key == "gain") {
+          str >> entry.gain;
+        } else if (key == "shapingTime") {
+          str >> entry.shapingTime;
+        } else if (key == "clockDiv") {
+          str >> entry.clockDiv;
+        } else if (key == "center") {
+          str >> entry.center;
+        } else if (key == "pedThr") {
+          str >> entry.pedThr;
+        } else if (key == "timestamp") {
+          str >> entry.timestamp;
+        } else if (key == "runNumber") {
+          str >> entry.runNumber;
+        }
+    }
+
+  return true;
+}
+
+bool PedestalStore::Save(const std::string& fileName, const asicPedestals& entry) {
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(fileName).parent_path(), ec);
+
+  std::ofstream file(fileName, std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write pedestal store " << fileName << std::endl;
+    return false;
+  }
+
+  file << "# restDAQ pedestal store, written after the pedestal run " << entry.runNumber << std::endl;
+  file << "fecId " << entry.fecId << std::endl;
+  file << "asic " << entry.asic << std::endl;
+  file << "gain " << entry.gain << std::endl;
+  file << "shapingTime " << entry.shapingTime << std::endl;
+  file << "clockDiv " << entry.clockDiv << std::endl;
+  file << "center " << entry.center << std::endl;
+  file << "pedThr " << entry.pedThr << std::endl;
+  file.precision(15);
+  file << "timestamp " << entry.timestamp << std::endl;
+  file << "runNumber " << entry.runNumber << std::endl;
+  for (size_t c = 0; c < entry.ped.size(); c++) file << "ped " << c << " " << entry.ped[c] << std::endl;
+  for (size_t c = 0; c < entry.thr.size(); c++) file << "thr " << c << " " << entry.thr[c] << std::endl;
+
+  return true;
+}
@@ -0,0 +1,54 @@
+/*********************************************************************************
+PedestalStore.h
+
+Local store of the pedestals and thresholds derived in the pedestal runs of
+FEMINOS and ARC based readout
+
+One file per FEC and ASIC, indexed by the settings which change the pedestals
+(gain, shaping time and clock divider). The entries record the run number and
+timestamp of the pedestal run, so data taking runs can reload them in the
+FEMs instead of running a new pedestal cycle.
+
+*********************************************************************************/
+
+#ifndef __PEDESTAL_STORE__
+#define __PEDESTAL_STORE__
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TRestRawDAQMetadata.h"
+
+namespace PedestalStore {
+
+  // Channel and {mean, stdev} from a pedestal histogram summary
+  typedef std::map<int, std::pair<double, double> > pedSummary;
+
+  struct asicPedestals {
+    int fecId = -1;
+    int asic = -1;
+    int gain = -1;
+    int shapingTime = -1;
+    int clockDiv = -1;
+    int center = 0;
+    float pedThr = 0;
+    double timestamp = 0;
+    int runNumber = 0;
+    std::vector<int> ped;
+    std::vector<int> thr;
+  };
+
+  asicPedestals Compute(const TRestRawDAQMetadata::FECMetadata& fec, int asic, const pedSummary& raw, const pedSummary& subtracted);
+  bool IsValid(const asicPedestals& entry, const TRestRawDAQMetadata::FECMetadata& fec, int asic, double timestamp, double maxAge);
+  // ped/thr commands to load the entry in the FEM, the most frequent value of every register is set with a wildcard
+  std::vector<std::string> GetCommands(const asicPedestals& entry);
+
+  std::string GetFileName(const std::string& storeDir, const TRestRawDAQMetadata::FECMetadata& fec, int asic);
+  bool Load(const std::string& fileName, asicPedestals& entry);
+  bool Save(const std::string& fileName, const asicPedestals& entry);
+
+}
+
+#endif
@@ -0,0 +1,345 @@
+/*********************************************************************************
+RawArchive.cxx
+
+Raw frame archive, the data frames are written as received from the
+electronics into an append only binary file, without event building
+
+*********************************************************************************/
+
+#include "RawArchive.h"
+#include "ThreadPolicy.h"
+#include "TRESTDAQException.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+  constexpr size_t dataStart = (sizeof(RawArchive::chunkHeader) + 7) & ~size_t(7);
+
+  inline size_t Pad(size_t size, size_t align){ return (size + align - 1) / align * align; }
+
+  inline size_t IndexBytes(size_t nFrames, size_t nFems){
+    return nFems * sizeof(RawArchive::femIndex) + nFrames * sizeof(RawArchive::indexEntry);
+  }
+}
+
+RawArchive::RawArchive(const std::string& fName, const std::string& electronics, int runNumber, int subRunNumber, size_t cSize) :
+  fileName(fName), chunkSize(Pad(std::max(cSize, 16*blockSize), blockSize)) {
+
+  fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  directIO = fd >= 0;
+    if(fd < 0 && errno == EINVAL){//O_DIRECT not supported by the filesystem
+      fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if(fd < 0){
+      std::string error ="Cannot open raw archive " + fileName + ": " + std::string(strerror(errno));
+      throw (TRESTDAQException(error));
+    }
+
+  //The destructor is not called if the constructor throws, the buffers are freed as members
+  try {
+      for(auto &buf : buffers){
+        void *ptr = nullptr;
+          if(posix_memalign(&ptr, blockSize, chunkSize) != 0){
+            throw (TRESTDAQException("Cannot allocate raw archive buffers"));
+          }
+        buf.data.reset((uint8_t*)ptr);
+        buf.used = dataStart;
+      }
+
+    //The header uses the second buffer, not used until the first chunk is full
+    uint8_t* block = buffers[1].data.get();
+    memset(block, 0, blockSize);
+    fileHeader* hdr = (fileHeader*)block;
+    strncpy(hdr->magic, "RESTDAQ", sizeof(hdr->magic));
+    hdr->version = version;
+    hdr->headerSize = blockSize;
+    hdr->chunkSize = chunkSize;
+    hdr->runNumber = runNumber;
+    hdr->subRunNumber = subRunNumber;
+    hdr->startTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
+    strncpy(hdr->electronics, electronics.c_str(), sizeof(hdr->electronics) - 1);
+      if(!WriteBlock(block, blockSize)){
+        throw (TRESTDAQException("Cannot write raw archive header " + fileName));
+      }
+
+    writeThread = std::thread(&RawArchive::WriteThread, this);
+  } catch (...) {
+    close(fd);
+    fd = -1;
+    throw;
+  }
+
+  std::cout << "Raw archive " << fileName << (directIO ? " (direct I/O)" : "") << " chunk size " << chunkSize / 1024 << " kB" << std::endl;
+}
+
+RawArchive::~RawArchive(){
+  Close();
+}
+
+std::string RawArchive::GetArchiveName(const std::string& rootFileName){
+  const size_t pos = rootFileName.rfind(".root");
+  if(pos == std::string::npos)return rootFileName + ".daq";
+  return rootFileName.substr(0, pos) + ".daq";
+}
+
+//Called from a single thread (the receive thread of the backend)
+void RawArchive::AddFrame(uint16_t fem, const void* data, uint32_t size, double timestamp){
+
+  if(fd < 0)throw (TRESTDAQException("Raw archive " + fileName + " is closed"));
+  if(bad.load(std::memory_order_relaxed))return;//Nothing is written after a failure
+
+  const size_t padded = Pad(size, 8);
+  chunkBuffer *buf = &buffers[current];
+  const bool newFem = std::find(buf->fems.begin(), buf->fems.end(), fem) == buf->fems.end();
+
+    if(buf->used + padded + IndexBytes(buf->index.size() + 1, buf->fems.size() + newFem) > chunkSize){
+      if(buf->index.empty())throw (TRESTDAQException("Frame of " + std::to_string(size) + " bytes does not fit in a raw archive chunk"));
+      FlushChunk();
+      buf = &buffers[current];
+      if(buf->used + padded + IndexBytes(1, 1) > chunkSize)
+        throw (TRESTDAQException("Frame of " + std::to_string(size) + " bytes does not fit in a raw archive chunk"));
+    }
+
+    if(std::find(buf->fems.begin(), buf->fems.end(), fem) == buf->fems.end())buf->fems.push_back(fem);
+    if(fem >= femSeq.size())femSeq.resize(fem + 1, 0);
+
+  indexEntry entry;
+  entry.offset = buf->used;
+  entry.size = size;
+  entry.seq = femSeq[fem]++;
+  entry.fem = fem;
+  entry.reserved = 0;
+  entry.timestamp = timestamp;
+  buf->index.push_back(entry);
+
+  memcpy(buf->data.get() + buf->used, data, size);
+  if(padded > size)memset(buf->data.get() + buf->used + size, 0, padded - size);
+  buf->used += padded;
+  nFrames++;
+}
+
+//Append the index to the current chunk and hand it to the write thread
+void RawArchive::FlushChunk(){
+
+  chunkBuffer &buf = buffers[current];
+  if(buf.index.empty())return;
+
+  std::sort(buf.fems.begin(), buf.fems.end());
+  std::stable_sort(buf.index.begin(), buf.index.end(), [](const indexEntry &a, const indexEntry &b){ return a.fem < b.fem; });
+
+  chunkHeader* hdr = (chunkHeader*)buf.data.get();
+  memset(hdr, 0, dataStart);
+  hdr->magic = chunkMagic;
+  hdr->nFrames = buf.index.size();
+  hdr->nFems = buf.fems.size();
+  hdr->dataBytes = buf.used - dataStart;
+  hdr->indexOffset = buf.used;
+  hdr->firstTimestamp = buf.index.front().timestamp;
+  hdr->lastTimestamp = buf.index.front().timestamp;
+
+  femIndex* fIdx = (femIndex*)(buf.data.get() + buf.used);
+  indexEntry* eIdx = (indexEntry*)(fIdx + buf.fems.size());
+  uint32_t first = 0;
+    for(size_t f=0; f<buf.fems.size(); f++){
+      fIdx[f].fem = buf.fems[f];
+      fIdx[f].reserved = 0;
+      fIdx[f].reserved2 = 0;
+      fIdx[f].first = first;
+      while(first < buf.index.size() && buf.index[first].fem == buf.fems[f])first++;
+      fIdx[f].nFrames = first - fIdx[f].first;
+    }
+
+    for(const auto &e : buf.index){
+      hdr->firstTimestamp = std::min(hdr->firstTimestamp, e.timestamp);
+      hdr->lastTimestamp = std::max(hdr->lastTimestamp, e.timestamp);
+    }
+  memcpy(eIdx, buf.index.data(), buf.index.size() * sizeof(indexEntry));
+
+  const size_t end = buf.used + IndexBytes(buf.index.size(), buf.fems.size());
+  hdr->chunkBytes = Pad(end, blockSize);
+  memset(buf.data.get() + end, 0, hdr->chunkBytes - end);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [this]{ return pending == nullptr; });
+  pending = &buf;
+  current ^= 1;
+  lock.unlock();
+  cv.notify_all();
+
+  chunkBuffer &next = buffers[current];
+  next.used = dataStart;
+  next.index.clear();
+  next.fems.clear();
+}
+
+//Short writes are retried, false if the block couldn't be written completely
+bool RawArchive::WriteBlock(const uint8_t* data, size_t size){
+
+  size_t done = 0;
+    while(done < size){
+      const ssize_t n = write(fd, data + done, size - done);
+        if(n < 0){
+          if(errno == EINTR)continue;
+          std::cerr << "Raw archive " << fileName << " write failed after " << bytesWritten + done << " bytes: " << strerror(errno) << std::endl;
+          bad = true;
+          return false;
+        }
+        if(n == 0){
+          std::cerr << "Raw archive " << fileName << " write failed after " << bytesWritten + done << " bytes: no progress" << std::endl;
+          bad = true;
+          return false;
+        }
+      done += n;
+        if(directIO && done < size && done % blockSize != 0){
+          //The rest of the block is not aligned, continue without O_DIRECT
+          const int flags = fcntl(fd, F_GETFL);
+          if(flags >= 0 && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0)directIO = false;
+        }
+    }
+  bytesWritten += size;
+  return true;
+}
+
+void RawArchive::WriteThread(){
+  ThreadPolicy::Apply(ThreadPolicy::stage::WRITER, "rawArchive");
+
+  std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+      cv.wait(lock, [this]{ return pending != nullptr || closing; });
+      if(!pending)break;
+      chunkBuffer *buf = pending;
+      lock.unlock();
+      if(!bad)WriteBlock(buf->data.get(), ((chunkHeader*)buf->data.get())->chunkBytes);
+      lock.lock();
+      pending = nullptr;
+      cv.notify_all();
+    }
+}
+
+void RawArchive::Close(){
+
+  if(fd < 0)return;
+
+  FlushChunk();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  closing = true;
+  lock.unlock();
+  cv.notify_all();
+  if(writeThread.joinable())writeThread.join();
+
+  if(bad && ftruncate(fd, bytesWritten) != 0)//Drop the partial chunk
+    std::cerr << "Cannot truncate raw archive " << fileName << ": " << strerror(errno) << std::endl;
+  close(fd);
+  fd = -1;
+  std::cout << "Raw archive " << fileName << " closed: " << nFrames << " frames, " << bytesWritten / 1024 << " kB" << std::endl;
+  if(bad)std::cerr << "Raw archive " << fileName << " is incomplete, only the first " << bytesWritten / 1024 << " kB are valid" << std::endl;
+}
+
+RawArchive::Reader::Reader(const std::string& fileName){
+
+  int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0){
+      std::cerr << "Cannot open raw archive " << fileName << ": " << strerror(errno) << std::endl;
+      return;
+    }
+
+  struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(fileHeader)){
+      std::cerr << "Invalid raw archive " << fileName << std::endl;
+      close(fd);
+      return;
+    }
+
+  size = st.st_size;
+  void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+    if(ptr == MAP_FAILED){
+      std::cerr << "Cannot map raw archive " << fileName << ": " << strerror(errno) << std::endl;
+      size = 0;
+      return;
+    }
+  base = (const uint8_t*)ptr;
+  madvise(ptr, size, MADV_SEQUENTIAL);
+
+  const fileHeader* hdr = (const fileHeader*)base;
+    if(strncmp(hdr->magic, "RESTDAQ", sizeof(hdr->magic)) != 0 || hdr->version != version){
+      std::cerr << "Invalid raw archive header " << fileName << std::endl;
+      return;
+    }
+  header = hdr;
+
+  //A chunk truncated at the end of the file (e.g. crash) is ignored, as the chunks with a corrupted index
+  size_t offset = header->headerSize;
+    while(offset <= size && size - offset >= sizeof(chunkHeader)){
+      const chunkHeader* chk = (const chunkHeader*)(base + offset);
+      if(chk->magic != chunkMagic || chk->chunkBytes < dataStart || chk->chunkBytes % blockSize != 0 || chk->chunkBytes > size - offset)break;
+        if(IsValidChunk(offset)){
+          chunks.push_back(offset);
+        } else {
+          std::cerr << "Raw archive " << fileName << ": invalid index in the chunk at offset " << offset << ", skipped" << std::endl;
+        }
+      offset += chk->chunkBytes;
+    }
+}
+
+//The chunk header is within the file and chunkBytes is already checked
+bool RawArchive::Reader::IsValidChunk(size_t offset) const {
+
+  const uint8_t* chk = base + offset;
+  const chunkHeader* hdr = (const chunkHeader*)chk;
+
+  if(hdr->indexOffset < dataStart || hdr->indexOffset % 8 != 0 || hdr->indexOffset > hdr->chunkBytes)return false;
+  //64 bits, no overflow with 32 bit counters
+  if(hdr->indexOffset + IndexBytes(hdr->nFrames, hdr->nFems) > hdr->chunkBytes)return false;
+
+  const femIndex* fIdx = (const femIndex*)(chk + hdr->indexOffset);
+  const indexEntry* eIdx = (const indexEntry*)(fIdx + hdr->nFems);
+  uint64_t nFrames = 0;
+    for(uint32_t f=0; f<hdr->nFems; f++){
+      if((uint64_t)fIdx[f].first + fIdx[f].nFrames > hdr->nFrames)return false;
+      nFrames += fIdx[f].nFrames;
+      for(uint32_t i=fIdx[f].first; i<fIdx[f].first + fIdx[f].nFrames; i++){
+        const indexEntry &e = eIdx[i];
+        if(e.fem != fIdx[f].fem || e.offset < dataStart || (uint64_t)e.offset + e.size > hdr->indexOffset)return false;
+      }
+    }
+
+  return nFrames == hdr->nFrames;
+}
+
+RawArchive::Reader::~Reader(){
+  if(base)munmap((void*)base, size);
+}
+
+void RawArchive::Reader::GetFrames(size_t chunk, std::vector<frame>& frames, int fem) const {
+
+  frames.clear();
+  if(chunk >= chunks.size())return;//Only the chunks validated when the archive is opened
+
+  const uint8_t* chk = base + chunks[chunk];
+  const chunkHeader* hdr = (const chunkHeader*)chk;
+  const femIndex* fIdx = (const femIndex*)(chk + hdr->indexOffset);
+  const indexEntry* eIdx = (const indexEntry*)(fIdx + hdr->nFems);
+
+    for(uint32_t f=0; f<hdr->nFems; f++){
+      if(fem >= 0 && fIdx[f].fem != fem)continue;
+      for(uint32_t i=fIdx[f].first; i<fIdx[f].first + fIdx[f].nFrames; i++){
+        const indexEntry &e = eIdx[i];
+        frames.push_back({e.fem, e.seq, e.timestamp, chk + e.offset, e.size});
+      }
+    }
+
+  //Offsets grow with the arrival time
+  if(fem < 0)std::sort(frames.begin(), frames.end(), [](const frame &a, const frame &b){ return a.data < b.data; });
+}
@@ -0,0 +1,163 @@
+/*********************************************************************************
+RawArchive.h
+
+Raw frame archive, the data frames are written as received from the
+electronics into an append only binary file, without event building
+
+File layout:
+  fileHeader, padded to blockSize
+  chunks, each one padded to a multiple of blockSize:
+    chunkHeader
+    frames, each one padded to 8 bytes
+    femIndex table, one entry per FEM present in the chunk
+    indexEntry table, grouped by FEM and in arrival order within a FEM
+
+The chunks are filled in memory and written by a separate thread using
+aligned buffers, so the file can be opened with O_DIRECT. Every chunk is
+self contained, so they can be decoded independently. If a write fails the
+archive is marked as bad and the frames are dropped till it is closed, the
+chunks written before are still valid.
+
+*********************************************************************************/
+
+#ifndef __RAW_ARCHIVE__
+#define __RAW_ARCHIVE__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class RawArchive {
+  public:
+    static constexpr size_t blockSize = 4096;
+    static constexpr uint32_t version = 1;
+    static constexpr uint32_t chunkMagic = 0x4B4E4843;//"CHNK"
+
+    struct fileHeader {
+      char magic[8];//"RESTDAQ"
+      uint32_t version;
+      uint32_t headerSize;
+      uint64_t chunkSize;
+      int32_t runNumber;
+      int32_t subRunNumber;
+      double startTime;
+      char electronics[32];
+    };
+
+    struct chunkHeader {
+      uint32_t magic;
+      uint32_t nFrames;
+      uint32_t nFems;
+      uint32_t reserved;
+      uint64_t chunkBytes;//Including padding
+      uint64_t dataBytes;
+      uint64_t indexOffset;//From the start of the chunk
+      double firstTimestamp;
+      double lastTimestamp;
+    };
+
+    struct femIndex {
+      uint16_t fem;
+      uint16_t reserved;
+      uint32_t first;//First indexEntry of this FEM
+      uint32_t nFrames;
+      uint32_t reserved2;
+    };
+
+    struct indexEntry {
+      uint32_t offset;//From the start of the chunk
+      uint32_t size;//In bytes
+      uint32_t seq;//Frame counter of the FEM since the start of the file
+      uint16_t fem;
+      uint16_t reserved;
+      double timestamp;//Host arrival time
+    };
+
+    RawArchive(const std::string& fileName, const std::string& electronics, int runNumber, int subRunNumber, size_t chunkSize);
+    ~RawArchive();
+
+    void AddFrame(uint16_t fem, const void* data, uint32_t size, double timestamp);
+    void Close();
+
+    inline uint64_t GetSize() const { return bytesWritten; }
+    //A write failed, the next chunks are dropped and the run has to be stopped
+    inline bool IsBad() const { return bad.load(std::memory_order_acquire); }
+    inline uint64_t GetNumberOfFrames() const { return nFrames; }
+    inline const std::string& GetFileName() const { return fileName; }
+
+    static std::string GetArchiveName(const std::string& rootFileName);
+
+    //Memory mapped access to an archive
+    class Reader {
+      public:
+        struct frame {
+          uint16_t fem;
+          uint32_t seq;
+          double timestamp;
+          const uint8_t* data;
+          uint32_t size;
+        };
+
+        Reader(const std::string& fileName);
+        ~Reader();
+
+        inline bool IsOpen() const { return header != nullptr; }
+        inline const fileHeader& GetHeader() const { return *header; }
+        inline size_t GetNumberOfChunks() const { return chunks.size(); }
+        inline const chunkHeader& GetChunkHeader(size_t chunk) const { return *(const chunkHeader*)(base + chunks[chunk]); }
+
+        //Frames of a chunk in arrival order, or only the ones of a FEM if fem >= 0
+        void GetFrames(size_t chunk, std::vector<frame>& frames, int fem = -1) const;
+
+      private:
+        const uint8_t* base = nullptr;
+        size_t size = 0;
+        const fileHeader* header = nullptr;
+        std::vector<size_t> chunks;//Offsets of the chunks in the file
+
+        //The index of the chunk is within the chunk and every frame within the data
+        bool IsValidChunk(size_t offset) const;
+    };
+
+  private:
+    struct alignedFree {
+      void operator()(uint8_t* ptr) const { free(ptr); }
+    };
+
+    struct chunkBuffer {
+      std::unique_ptr<uint8_t, alignedFree> data;//posix_memalign, freed also if the constructor throws
+      size_t used = 0;
+      std::vector<indexEntry> index;
+      std::vector<uint16_t> fems;
+    };
+
+    void FlushChunk();
+    bool WriteBlock(const uint8_t* data, size_t size);
+    void WriteThread();
+
+    std::string fileName;
+    int fd = -1;
+    bool directIO = false;
+    size_t chunkSize;
+
+    chunkBuffer buffers[2];
+    int current = 0;
+    chunkBuffer* pending = nullptr;
+    bool closing = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread writeThread;
+
+    std::vector<uint32_t> femSeq;
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> nFrames{0};
+    std::atomic<bool> bad{false};
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*********************************************************************************
+SharedEventRing.cxx
+
+Ring of the last built events in shared memory, see SharedEventRing.h
+
+*********************************************************************************/
+
+#include "SharedEventRing.h"
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+SharedEventRing::SharedEventRing(int shmid, header* hdr) : shmid(shmid), hdr(hdr) { }
+
+SharedEventRing::~SharedEventRing(){
+  shmdt(hdr);
+}
+
+std::unique_ptr<SharedEventRing> SharedEventRing::Create(uint32_t nSlots, uint32_t slotSize){
+
+  slotSize = (std::max<uint32_t>(slotSize, sizeof(slotHeader) + 64) + 7) & ~7U;
+  const size_t size = sizeof(header) + (size_t)nSlots * slotSize;
+
+  //Reuse the segment of the previous file or run if the layout is the same
+  int sid = shmget(GetKey(), 0, 0);
+    if(sid != -1){
+      header* hdr = (header*)shmat(sid, NULL, 0);
+        if(hdr != (header*)-1){
+          if(hdr->magic == magic && hdr->version == version && hdr->nSlots == nSlots && hdr->slotSize == slotSize){
+            ThreadPolicy::Prefault(hdr, size);
+            return std::unique_ptr<SharedEventRing>(new SharedEventRing(sid, hdr));
+          }
+          shmdt(hdr);
+        }
+      //The readers attached keep the old segment until they detach
+      shmctl(sid, IPC_RMID, NULL);
+    }
+
+    if((sid = shmget(GetKey(), size, IPC_CREAT | 0666)) == -1){
+      std::cerr << "Error while creating the event ring shared memory (shmget) of " << size << " bytes " << std::strerror(errno) << std::endl;
+      return nullptr;
+    }
+
+  header* hdr = (header*)shmat(sid, NULL, 0);
+    if(hdr == (header*)-1){
+      std::cerr << "Error while creating the event ring shared memory (shmat) " << std::strerror(errno) << std::endl;
+      return nullptr;
+    }
+
+  //New segments are zero filled
+  hdr->nSlots = nSlots;
+  hdr->slotSize = slotSize;
+  hdr->version = version;
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr->magic = magic;
+
+  //The events are published without page faults when the memory is locked
+  ThreadPolicy::Prefault(hdr, size);
+  return std::unique_ptr<SharedEventRing>(new SharedEventRing(sid, hdr));
+}
+
+std::unique_ptr<SharedEventRing> SharedEventRing::Attach(bool verbose){
+
+  const int sid = shmget(GetKey(), 0, 0);
+    if(sid == -1){
+      if(verbose)std::cerr << "Event ring shared memory not found (shmget) " << std::strerror(errno) << std::endl;
+      return nullptr;
+    }
+
+  header* hdr = (header*)shmat(sid, NULL, SHM_RDONLY);
+    if(hdr == (header*)-1){
+      if(verbose)std::cerr << "Error while attaching the event ring shared memory (shmat) " << std::strerror(errno) << std::endl;
+      return nullptr;
+    }
+
+    if(hdr->magic != magic || hdr->version != version || hdr->nSlots == 0){
+      if(verbose)std::cerr << "Event ring shared memory not initialized or with different version" << std::endl;
+      shmdt(hdr);
+      return nullptr;
+    }
+
+  std::unique_ptr<SharedEventRing> ring(new SharedEventRing(sid, hdr));
+  ring->SkipToLatest();
+  return ring;
+}
+
+void SharedEventRing::Remove(){
+  const int sid = shmget(GetKey(), 0, 0);
+  if(sid != -1)shmctl(sid, IPC_RMID, NULL);
+}
+
+void SharedEventRing::SetRun(int runNumber, int subRunNumber){
+  hdr->subRunNumber.store(subRunNumber, std::memory_order_release);
+  hdr->runNumber.store(runNumber, std::memory_order_release);
+}
+
+void SharedEventRing::Publish(TRestRawSignalEvent* sEvent, int eventCount){
+
+  const uint64_t entry = hdr->published.load(std::memory_order_relaxed) + 1;
+  slotHeader* slot = GetSlot(entry);
+
+  const uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+  slot->seq.store(seq + 1, std::memory_order_relaxed);//Odd, the readers discard the slot
+  std::atomic_thread_fence(std::memory_order_release);
+
+  char* data = (char*)slot + sizeof(slotHeader);
+  const size_t capacity = hdr->slotSize - sizeof(slotHeader);
+  size_t offset = 0;
+  uint32_t nSignals = 0, truncated = 0;
+
+    for(int s=0; s<sEvent->GetNumberOfSignals(); s++){
+      TRestRawSignal* sgnl = sEvent->GetSignal(s);
+      const uint32_t nPoints = sgnl->GetNumberOfPoints();
+      const size_t size = (2*sizeof(int32_t) + nPoints*sizeof(Short_t) + 7) & ~(size_t)7;
+        if(offset + size > capacity){
+          truncated++;
+          continue;
+        }
+      const int32_t id = sgnl->GetID();
+      memcpy(data + offset, &id, sizeof(id));
+      memcpy(data + offset + sizeof(id), &nPoints, sizeof(nPoints));
+      Short_t* points = (Short_t*)(data + offset + 2*sizeof(int32_t));
+      for(uint32_t i=0; i<nPoints; i++)points[i] = (*sgnl)[i];
+      offset += size;
+      nSignals++;
+    }
+
+  slot->entry = entry;
+  slot->eventID = sEvent->GetID();
+  slot->eventCount = eventCount;
+  slot->time = sEvent->GetTime();
+  slot->nSignals = nSignals;
+  slot->truncated = truncated;
+  slot->payload = offset;
+
+  slot->seq.store(seq + 2, std::memory_order_release);
+  hdr->published.store(entry, std::memory_order_release);
+}
+
+void SharedEventRing::SkipToLatest(){
+  nextEntry = hdr->published.load(std::memory_order_acquire) + 1;
+}
+
+bool SharedEventRing::Latest(TRestRawSignalEvent& sEvent, int& eventCount){
+  const uint64_t published = hdr->published.load(std::memory_order_acquire);
+  if(published > nextEntry)nextEntry = published;
+  return Next(sEvent, eventCount);
+}
+
+bool SharedEventRing::Next(TRestRawSignalEvent& sEvent, int& eventCount){
+
+  const uint64_t published = hdr->published.load(std::memory_order_acquire);
+  if(published + 1 < nextEntry)nextEntry = published + 1;//Segment recreated by the writer
+
+    if(published >= nextEntry + hdr->nSlots){//Overwritten
+      lost += published - hdr->nSlots + 1 - nextEntry;
+      nextEntry = published - hdr->nSlots + 1;
+    }
+
+  const size_t capacity = hdr->slotSize - sizeof(slotHeader);
+
+    for(; nextEntry <= published; nextEntry++){
+      const slotHeader* slot = GetSlot(nextEntry);
+      const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        if(seq & 1){//Being overwritten
+          lost++;
+          continue;
+        }
+
+      const uint64_t entry = slot->entry;
+      const int32_t eventID = slot->eventID;
+      const int32_t count = slot->eventCount;
+      const double time = slot->time;
+      const uint32_t nSignals = slot->nSignals;
+      const size_t payload = std::min<size_t>(slot->payload, capacity);
+      copy.resize(payload);
+      memcpy(copy.data(), (const char*)slot + sizeof(slotHeader), payload);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot->seq.load(std::memory_order_relaxed) != seq || entry != nextEntry){
+          lost++;
+          continue;
+        }
+
+      sEvent.Initialize();
+      sEvent.SetID(eventID);
+      sEvent.SetTime(time);
+      size_t offset = 0;
+        for(uint32_t s=0; s<nSignals && offset + 2*sizeof(int32_t) <= payload; s++){
+          int32_t id;
+          uint32_t nPoints;
+          memcpy(&id, copy.data() + offset, sizeof(id));
+          memcpy(&nPoints, copy.data() + offset + sizeof(id), sizeof(nPoints));
+          const size_t size = (2*sizeof(int32_t) + nPoints*sizeof(Short_t) + 7) & ~(size_t)7;
+          if(offset + size > payload)break;
+          const Short_t* points = (const Short_t*)(copy.data() + offset + 2*sizeof(int32_t));
+          std::vector<Short_t> sData(points, points + nPoints);
+          TRestRawSignal rawSignal(id, sData);
+          sEvent.AddSignal(rawSignal);
+          offset += size;
+        }
+
+      eventCount = count;
+      nextEntry++;
+      return true;
+    }
+
+  return false;
+}
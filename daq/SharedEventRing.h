@@ -0,0 +1,103 @@
+/*********************************************************************************
+SharedEventRing.h
+
+Ring of the last built events in a System V shared memory segment, published
+by restDAQManager in FillTree and consumed by the GUI, which no longer has to
+reopen the output file
+
+Segment layout:
+  header
+  nSlots slots of slotSize bytes, each one:
+    slotHeader
+    signals: int32 id, uint32 number of points, Short_t points, padded to 8 bytes
+
+Single writer, any number of readers. Every slot is protected by a sequence
+counter (odd while it is being written), the readers copy the slot and discard
+it if the counter changed meanwhile, so the writer never waits for the readers.
+Readers falling behind more than nSlots events skip the overwritten ones.
+
+*********************************************************************************/
+
+#ifndef __SHARED_EVENT_RING__
+#define __SHARED_EVENT_RING__
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DAQInstance.h"
+#include "TRestRawSignalEvent.h"
+
+class SharedEventRing {
+  public:
+    static constexpr uint32_t magic = 0x52564544;//"DEVR"
+    static constexpr uint32_t version = 1;
+
+    struct header {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t nSlots;
+      uint32_t slotSize;
+      std::atomic<uint64_t> published;//Number of events published since the creation of the segment
+      std::atomic<int32_t> runNumber;
+      std::atomic<int32_t> subRunNumber;
+    };
+
+    struct slotHeader {
+      std::atomic<uint64_t> seq;
+      uint64_t entry;//Publication number, 1 for the first event
+      int32_t eventID;
+      int32_t eventCount;//Events written by the DAQ (DAQRunControl) when the event was written
+      double time;
+      uint32_t nSignals;
+      uint32_t truncated;//Signals not stored because the slot was full
+      uint64_t payload;//Bytes after the slotHeader
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Lock free atomics are required in shared memory");
+
+    ~SharedEventRing();
+
+    //Writer, the segment is created or recreated if the layout differs, nullptr on error
+    static std::unique_ptr<SharedEventRing> Create(uint32_t nSlots, uint32_t slotSize);
+    //Reader, nullptr if the segment doesn't exist
+    static std::unique_ptr<SharedEventRing> Attach(bool verbose = false);
+    static void Remove();
+
+    void SetRun(int runNumber, int subRunNumber);
+    inline int GetRunNumber() const { return hdr->runNumber.load(std::memory_order_acquire); }
+    inline int GetSubRunNumber() const { return hdr->subRunNumber.load(std::memory_order_acquire); }
+
+    void Publish(TRestRawSignalEvent* sEvent, int eventCount);
+
+    //Copies the next event not read yet, false if there is none
+    bool Next(TRestRawSignalEvent& sEvent, int& eventCount);
+    //Copies the last published event if it was not read yet, the previous ones are skipped
+    bool Latest(TRestRawSignalEvent& sEvent, int& eventCount);
+    //Start reading from the next published event
+    void SkipToLatest();
+    inline uint64_t GetLost() const { return lost; }
+
+  private:
+    SharedEventRing(int shmid, header* hdr);
+
+    inline slotHeader* GetSlot(uint64_t entry) const {
+      return (slotHeader*)((char*)hdr + sizeof(header) + ((entry - 1) % hdr->nSlots) * (size_t)hdr->slotSize);
+    }
+
+    //Next to the key of the manager shared memory of the instance
+    static inline key_t GetKey() { return DAQInstance::GetKey(DAQInstance::segment::EVENT_RING); }
+
+    int shmid;
+    header* hdr;
+
+    uint64_t nextEntry = 1;//Reader position
+    uint64_t lost = 0;
+    std::vector<char> copy;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*********************************************************************************
+SignalBatch.cxx
+
+Batch analysis of the raw signals of an event, see SignalBatch.h
+
+*********************************************************************************/
+
+#include "SignalBatch.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+  //Restrict parameters, so the copy becomes a memmove
+  void CopySignal(Short_t* __restrict data, const TRestRawSignal* __restrict sgnl, int n){
+    for(int i=0; i<n; i++)data[i] = (*sgnl)[i];
+  }
+}
+
+void SignalBatch::Resize(size_t nSignals, size_t maxPoints){
+
+  stride = (maxPoints + lanes - 1) / lanes * lanes;
+  samples.resize(nSignals * stride);
+  nPoints.resize(nSignals);
+  id.resize(nSignals);
+  baseline.resize(nSignals);
+  sigma.resize(nSignals);
+  amplitude.resize(nSignals);
+  peakBin.resize(nSignals);
+  integral.resize(nSignals);
+}
+
+void SignalBatch::Load(TRestRawSignalEvent* sEvent){
+
+  const size_t nSignals = sEvent->GetNumberOfSignals();
+  size_t maxPoints = 0;
+  for(size_t s=0; s<nSignals; s++)maxPoints = std::max<size_t>(maxPoints, sEvent->GetSignal(s)->GetNumberOfPoints());
+  Resize(nSignals, maxPoints);
+
+    for(size_t s=0; s<nSignals; s++){
+      TRestRawSignal* sgnl = sEvent->GetSignal(s);
+      id[s] = sgnl->GetID();
+      nPoints[s] = sgnl->GetNumberOfPoints();
+      CopySignal(&samples[s * stride], sgnl, nPoints[s]);
+      std::fill(samples.data() + s * stride + nPoints[s], samples.data() + (s + 1) * stride, SHRT_MIN);//The padding doesn't change the maximum
+    }
+}
+
+void SignalBatch::Load(const std::vector<int>& ids, const Short_t* data, size_t size){
+
+  Resize(ids.size(), size);
+    for(size_t s=0; s<ids.size(); s++){
+      id[s] = ids[s];
+      nPoints[s] = size;
+      memcpy(&samples[s * stride], data + s * size, size * sizeof(Short_t));
+      std::fill(samples.data() + s * stride + size, samples.data() + (s + 1) * stride, SHRT_MIN);
+    }
+}
+
+void SignalBatch::Process(int baselineStart, int baselineEnd, double threshold){
+
+    for(size_t s=0; s<id.size(); s++){
+      const Short_t* __restrict data = &samples[s * stride];
+      const int n = nPoints[s];
+      const int b0 = std::max(baselineStart, 0);
+      const int b1 = std::min(baselineEnd, n);
+      const uint32_t nBaseline = b1 > b0 ? b1 - b0 : 0;
+
+      //Single pass over the whole stride: maximum and sum per lane, plus the baseline sums in the
+      //blocks of the baseline window. The padding is removed from the sum afterwards
+      Short_t laneMax[lanes];
+      int32_t laneSum[lanes];
+      int64_t bSum = 0, bSum2 = 0;
+      for(size_t l=0; l<lanes; l++){ laneMax[l] = SHRT_MIN; laneSum[l] = 0; }
+        for(size_t i=0; i<stride; i+=lanes){
+          #pragma omp simd
+          for(size_t l=0; l<lanes; l++){
+            const Short_t x = data[i + l];
+            laneMax[l] = x > laneMax[l] ? x : laneMax[l];
+            laneSum[l] += x;
+          }
+            if((int)i < b1 && (int)(i + lanes) > b0){
+              const int end = std::min<int>(i + lanes, b1);
+              #pragma omp simd reduction(+:bSum, bSum2)
+              for(int j=std::max<int>(i, b0); j<end; j++){
+                const int32_t x = data[j];
+                bSum += x;
+                bSum2 += x * x;
+              }
+            }
+        }
+      Short_t max = SHRT_MIN;
+      int64_t sum = 0;
+        for(size_t l=0; l<lanes; l++){
+          max = laneMax[l] > max ? laneMax[l] : max;
+          sum += laneSum[l];
+        }
+      sum -= (int64_t)(stride - n) * SHRT_MIN;
+
+      //The first bin holding the maximum is searched from the start, it stops at the peak
+      size_t block = 0;
+        for(; block<stride; block+=lanes){
+          int found = 0;
+          #pragma omp simd reduction(|:found)
+          for(size_t l=0; l<lanes; l++)found |= data[block + l] == max;
+          if(found)break;
+        }
+      int peak = block;
+      while(peak < n && data[peak] != max)peak++;
+
+      const double nb = nBaseline;
+      const double mean = nb > 0 ? bSum / nb : 0;
+      const double rms = nb > 0 ? std::sqrt(std::max(0., bSum2 / nb - mean * mean)) : 0;
+      const double amp = max - mean;
+
+      baseline[s] = mean;
+      sigma[s] = rms;
+      amplitude[s] = nb > 0 && n > 0 && amp > threshold * rms ? amp : 0;
+      peakBin[s] = n > 0 ? peak : -1;
+      integral[s] = sum - mean * n;
+    }
+}
@@ -0,0 +1,55 @@
+/*********************************************************************************
+SignalBatch.h
+
+Batch analysis of the raw signals of an event: the samples of all the signals
+are copied to a single buffer with a common stride (structure of arrays), then
+baseline, sigma, amplitude and integral of every signal are computed in one
+pass over the samples, the peak bin is searched afterwards till the maximum.
+The loops run over fixed width lanes marked with #pragma omp simd, SignalBatch.cxx
+is built with -O2 -fopenmp-simd (daq/CMakeLists.txt) so they are vectorized
+without target specific code or the OpenMP runtime.
+
+The amplitude follows TRestRawSignal::GetAmplitudeFast: maximum above the
+baseline if larger than threshold times the baseline sigma, 0 otherwise.
+
+*********************************************************************************/
+
+#ifndef __SIGNAL_BATCH__
+#define __SIGNAL_BATCH__
+
+#include <vector>
+
+#include "TRestRawSignalEvent.h"
+
+class SignalBatch {
+  public:
+    static constexpr size_t lanes = 16;//Stride multiple of the lane width
+
+    SignalBatch(){ }
+
+    void Load(TRestRawSignalEvent* sEvent);
+    //Signals of nPoints samples stored contiguously
+    void Load(const std::vector<int>& ids, const Short_t* data, size_t nPoints);
+
+    //baselineEnd is not included, as in TRestRawSignal
+    void Process(int baselineStart, int baselineEnd, double threshold);
+
+    inline size_t GetNumberOfSignals() const { return id.size(); }
+
+    //Results, one entry per signal in the order of the event
+    std::vector<int> id;
+    std::vector<float> baseline;
+    std::vector<float> sigma;
+    std::vector<float> amplitude;
+    std::vector<int> peakBin;
+    std::vector<float> integral;//Baseline subtracted
+
+  private:
+    void Resize(size_t nSignals, size_t maxPoints);
+
+    size_t stride = 0;
+    std::vector<Short_t> samples;//nSignals x stride, padded with the minimum value
+    std::vector<int> nPoints;
+};
+
+#endif
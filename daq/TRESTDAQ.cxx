@@ -8,21 +8,32 @@ Author: JuanAn Garcia 18/05/2021
 *********************************************************************************/
 
 #include "TRESTDAQ.h"
+#include "DAQTrace.h"
 
+#include <algorithm>
 #include <chrono>
+#include <climits>
+#include <cstdio>
+#include <sstream>
 
-std::atomic<bool> TRESTDAQ::abrt(false);
-std::atomic<bool> TRESTDAQ::nextFile(false);
-std::atomic<int> TRESTDAQ::event_cnt(0);
-
-TRESTDAQ::TRESTDAQ(TRestRun* rR, TRestRawDAQMetadata* dM) {
+TRESTDAQ::TRESTDAQ(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc) {
     restRun = rR;
     daqMetadata = dM;
+    managerMetadata = mM;
+      if(!managerMetadata){
+        defaultManagerMetadata = std::make_unique<TRestDAQManagerMetadata>();
+        managerMetadata = defaultManagerMetadata.get();
+      }
+    runControl = rc;
+      if(!runControl){
+        defaultRunControl = std::make_unique<DAQRunControl>();
+        runControl = defaultRunControl.get();
+      }
+    mergerInput = runControl->GetMerger() != nullptr;
     verboseLevel = daqMetadata->GetVerboseLevel();
     fSignalEvent.Initialize();
 
-     if(restRun)
-      restRun->AddEventBranch(&fSignalEvent);
+    if(managerMetadata->UsePackedEvents() && !mergerInput)packedEvent = std::make_unique<TRestRawPackedEvent>();
 
     auto tT = daq_metadata_types::triggerTypes_map.find(daqMetadata->GetTriggerType().Data());
     if(tT == daq_metadata_types::triggerTypes_map.end() ){
@@ -61,30 +72,229 @@ TRESTDAQ::TRESTDAQ(TRestRun* rR, TRestRawDAQMetadata* dM) {
       acqType = rT->second;
     }
 
+    //Applied by the decoders of every backend
+    if(managerMetadata->UseSoftwareZeroSuppression() && !managerMetadata->UseSoftwarePedestals() && acqType != daq_metadata_types::acqTypes::PEDESTAL){
+      if(compressMode != daq_metadata_types::compressModeTypes::ALLCHANNELS)
+        std::cout << "Warning: software zero suppression without allchannels compress mode" << std::endl;
+      const TVector2 range = managerMetadata->GetZSBaseLineRange();
+      const TVector2 prePost = managerMetadata->GetZSPrePost();
+      zeroSuppression = std::make_unique<ZeroSuppression>(managerMetadata->GetZSThreshold(), range.X(), range.Y(), prePost.X(), prePost.Y());
+    }
+
+    if(mergerInput)return;//The writing stages are set up by the DAQ writing the merged events
+
+    if(managerMetadata->UseSoftwarePedestals() && acqType != daq_metadata_types::acqTypes::PEDESTAL){
+      if(compressMode != daq_metadata_types::compressModeTypes::ALLCHANNELS)
+        std::cout << "Warning: software pedestals without allchannels compress mode" << std::endl;
+      pedestalEngine = std::make_unique<PedestalEngine>();
+    }
+
+    if(managerMetadata->UseRawArchive() && restRun && acqType != daq_metadata_types::acqTypes::PEDESTAL && daqMetadata->GetElectronicsType() != "REPLAY"){
+      const std::string archiveName = RawArchive::GetArchiveName(restRun->GetOutputFileName().Data());
+      rawArchive = std::make_unique<RawArchive>(archiveName, daqMetadata->GetElectronicsType().Data(), restRun->GetRunNumber(),
+                                                restRun->GetParentRunNumber(), (size_t)managerMetadata->GetArchiveChunkSize()*1024*1024);
+    }
+
+    if(managerMetadata->GetEventRingSlots() > 0 && restRun && !pedestalEngine && !rawArchive && acqType != daq_metadata_types::acqTypes::PEDESTAL){
+      auto &eventRing = runControl->eventRing;
+      eventRing = SharedEventRing::Create(managerMetadata->GetEventRingSlots(), managerMetadata->GetEventRingSlotSize()*1024);
+      if(eventRing)eventRing->SetRun(restRun->GetRunNumber(), restRun->GetParentRunNumber());
+      eventRingPrescale = std::max(1, managerMetadata->GetEventRingPrescale());
+    } else if(restRun) {//The GUI reads the output file
+      runControl->eventRing.reset();
+      SharedEventRing::Remove();
+    }
+
+    if(managerMetadata->GetMonitorInterval() > 0 && restRun && !pedestalEngine && !rawArchive && acqType != daq_metadata_types::acqTypes::PEDESTAL){
+      DAQMonitor::settings st;
+      st.interval = managerMetadata->GetMonitorInterval();
+      st.baselineStart = managerMetadata->GetMonitorBaseLineRange().X();
+      st.baselineEnd = managerMetadata->GetMonitorBaseLineRange().Y();
+      st.threshold = managerMetadata->GetMonitorSignalThreshold();
+      st.nBins = std::max(1, managerMetadata->GetMonitorBins());
+      st.spectrumMax = managerMetadata->GetMonitorSpectrumMax();
+      st.nChannels = std::max(1, managerMetadata->GetMonitorChannels());
+      auto &monitor = runControl->monitor;
+        if(!monitor || !monitor->SameSettings(st)){
+          monitor.reset();
+          monitor = DAQMonitor::Create(st);
+        }
+      //The histograms are accumulated over all the files of the run
+      if(monitor && restRun->GetParentRunNumber() == 0)monitor->Reset(restRun->GetRunNumber(), restRun->GetStartTimestamp());
+    } else if(restRun) {
+      runControl->monitor.reset();
+      DAQMonitor::Remove();
+    }
+
+    if(managerMetadata->GetBuilderAddress() != "" && restRun && !pedestalEngine && !rawArchive && acqType != daq_metadata_types::acqTypes::PEDESTAL &&
+       daqMetadata->GetElectronicsType() != "BUILDER"){
+      EventSender::settings st;
+        if(!EventLink::ParseAddress(managerMetadata->GetBuilderAddress(), st.host, st.port)){
+          std::cerr << "Cannot parse builder address "<< managerMetadata->GetBuilderAddress() << std::endl;
+          throw (TRESTDAQException("Wrong builderAddress, please check RML"));
+        }
+      st.name = EventSender::GetNodeName();
+      st.queueSize = std::max(1, managerMetadata->GetBuilderCredits());
+      eventSender = std::make_unique<EventSender>(st, runControl);
+    }
+
+    if(managerMetadata->UseEventFilter() && restRun && !pedestalEngine && !rawArchive && acqType != daq_metadata_types::acqTypes::PEDESTAL){
+      EventFilter::settings st;
+      st.baselineStart = managerMetadata->GetFilterBaseLineRange().X();
+      st.baselineEnd = managerMetadata->GetFilterBaseLineRange().Y();
+      st.threshold = managerMetadata->GetFilterSignalThreshold();
+      st.minMultiplicity = managerMetadata->GetFilterMultiplicity().X();
+      st.maxMultiplicity = managerMetadata->GetFilterMultiplicity().Y();
+      st.minAmplitude = managerMetadata->GetFilterAmplitude().X();
+      st.maxAmplitude = managerMetadata->GetFilterAmplitude().Y();
+      st.minTimeDiff = managerMetadata->GetFilterMinTimeDiff();
+      st.prescale = std::max(1, managerMetadata->GetFilterPrescale());
+      st.nThreads = std::max(0, managerMetadata->GetFilterThreads());
+        if(!EventFilter::ParseChannels(managerMetadata->GetFilterChannels(), st.channels)){
+          std::cerr << "Cannot parse filter channels "<< managerMetadata->GetFilterChannels() << std::endl;
+          throw (TRESTDAQException("Wrong filterChannels, please check RML"));
+        }
+      eventFilter = std::make_unique<EventFilter>(st, [this](TRestRawSignalEvent* ev){ WriteEvent(ev); });
+      //The writer thread of the filter doesn't fill the event that is being built
+      if(st.nThreads > 0)treeEvent = &fTreeEvent;
+    }
+
+     if(restRun){
+      if(packedEvent)restRun->AddEventBranch(packedEvent.get());
+      else restRun->AddEventBranch(treeEvent);
+     }
+
 }
 
 TRESTDAQ::~TRESTDAQ() {
-    // Cleanup if any
+    if(zeroSuppression)zeroSuppression->PrintSummary(daqMetadata->GetName());
+    if(mergerInput)return;
+    // The pending events are written before the file is closed
+    if(eventFilter){
+      eventFilter->Flush();
+      eventFilter->PrintSummary();
+      const EventFilter::counters c = eventFilter->GetCounters();
+      managerMetadata->SetFilterCounters(c.events, c.accepted);
+      eventFilter.reset();
+    }
+    if(eventSender){
+      eventSender->Close();
+      eventSender->PrintSummary();
+      eventSender.reset();
+    }
+    // Flush and close the archive, the backend threads are stopped at this point
+    rawArchive.reset();
 }
 
 Double_t TRESTDAQ::getCurrentTime() {
     return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
 }
 
-void TRESTDAQ::FillTree(TRestRun *rR, TRestRawSignalEvent* sEvent) {
+void TRESTDAQ::FillTree(TRestRawSignalEvent* sEvent) {
+
+  DAQ_TRACE_SPAN(FILL_TREE);
+
+  if(eventBuilt)eventBuilt(sEvent);
+
+    if(mergerInput){//Written by the merger with the events of the other backends
+      runControl->GetMerger()->Push(runControl, sEvent);
+      runControl->AddEvent();
+      return;
+    }
 
+    if(pedestalEngine){//Only accumulated, the pedestal event is written at the end of the run
+      pedestalEngine->AddEvent(sEvent);
+      runControl->AddEvent();
+      return;
+    }
+
+  //Every event built is counted, also the ones rejected by the filter
+  if(eventFilter)eventFilter->Process(sEvent);//Written by the filter if it is accepted
+  else WriteEvent(sEvent);
+  runControl->AddEvent();
+}
+
+void TRESTDAQ::WriteEvent(TRestRawSignalEvent* sEvent) {
+
+  TRestRun* rR = restRun;
+  DAQRunControl& rc = *runControl;
   const double evTime = sEvent->GetTime();
 
   if(rR){
     const int eventsTree = rR->GetAnalysisTree()->GetEntries();
-    rR->GetAnalysisTree()->SetEventInfo(sEvent);
-    rR->GetEventTree()->Fill();
-    rR->GetAnalysisTree()->Fill();
-    // AutoSave is needed to read and write at the same time
-    if (eventsTree % 1000 == 0 || (evTime - lastEvTime) > 10 ) {
+    if (eventSender) {//Written by the event builder
+      eventSender->Send(sEvent, rR->GetStartTimestamp());
+    } else {
+      rR->GetAnalysisTree()->SetEventInfo(sEvent);
+      if (packedEvent) packedEvent->Encode(sEvent);
+      else if (sEvent != treeEvent) *treeEvent = *sEvent;//e.g. the merged events, only the registered event is filled
+      DAQ_TRACE_SPAN(TREE_FILL);
+      rR->GetEventTree()->Fill();
+      rR->GetAnalysisTree()->Fill();
+    }
+    if (rc.monitor) rc.monitor->AddEvent(sEvent);
+    if (rc.eventRing) {//The GUI reads the events from the ring, not from the file
+      const int evCnt = rc.GetEvents();
+      if (evCnt % eventRingPrescale == 0) rc.eventRing->Publish(sEvent, evCnt + 1);
+    } else if (!eventSender && (eventsTree % 1000 == 0 || (evTime - lastEvTime) > 10) ) {// AutoSave is needed to read and write at the same time
+        DAQ_TRACE_SPAN(AUTOSAVE);
         rR->GetEventTree()->AutoSave("SaveSelf");
         lastEvTime = evTime;
     }
   }
-  event_cnt++;
+}
+
+void TRESTDAQ::SaveSoftwarePedestals() {
+
+  if(!pedestalEngine)return;
+
+  //Release the engine first so the pedestal event goes to the tree
+  auto engine = std::move(pedestalEngine);
+  const int nEvents = runControl->GetEvents();
+
+  fSignalEvent.Initialize();
+  engine->FillPedestalEvent(&fSignalEvent);
+  fSignalEvent.SetID(0);
+  fSignalEvent.SetTime(getCurrentTime());
+  std::cout << "Software pedestals: " << fSignalEvent.GetNumberOfSignals() << " channels from " << engine->GetNumberOfEvents() << " events" << std::endl;
+
+  FillTree(&fSignalEvent);
+  runControl->SetEvents(nEvents);
+}
+
+TRESTDAQSocket::settings TRESTDAQ::GetSocketSettings(int fecId) const {
+
+  TRESTDAQSocket::settings st;
+  st.receiveBuffer = std::clamp(managerMetadata->GetSocketBufferSize(), 1, INT_MAX / 1024) * 1024;
+  st.force = managerMetadata->UseSocketBufferForce();
+  st.dropCount = managerMetadata->UseSocketDropCount();
+
+  //e.g. "2:32768,5:16384"
+  std::stringstream ss(managerMetadata->GetFEMSocketBuffers());
+  std::string item;
+    while(std::getline(ss, item, ',')){
+      if(item.find_first_not_of(" \t") == std::string::npos)continue;
+      int id, size;
+      char extra;
+        if(sscanf(item.c_str(), " %d : %d %c", &id, &size, &extra) != 2 || size <= 0 || size > INT_MAX / 1024){
+          std::cerr << "Cannot parse FEM socket buffers "<< managerMetadata->GetFEMSocketBuffers() << std::endl;
+          throw (TRESTDAQException("Wrong femSocketBuffers, please check RML"));
+        }
+      if(id == fecId)st.receiveBuffer = size * 1024;
+    }
+
+  return st;
+}
+
+void TRESTDAQ::SaveSocketCounters(const std::vector<TRESTDAQSocket::counters>& counters) {
+
+  if(publishSocketCounters)publishSocketCounters(counters);
+
+    for(const auto &c : counters){
+      managerMetadata->SetSocketCounters(c.id, c.datagrams, c.kernelDrops, c.bufferDrops);
+      std::cout << "FEM " << c.id << ": " << c.datagrams << " datagrams received";
+      if(managerMetadata->UseSocketDropCount())std::cout << ", " << c.kernelDrops << " dropped by the kernel";
+      if(c.bufferDrops > 0)std::cout << ", " << c.bufferDrops << " data frames dropped with the FEM buffer full";
+      std::cout << std::endl;
+    }
 }
@@ -12,18 +12,33 @@ To implement generic methods here
 #ifndef __TREST_DAQ__
 #define __TREST_DAQ__
 
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "TRestRawDAQMetadata.h"
 #include "TRestRawSignalEvent.h"
 #include "TRestRun.h"
+#include "TRestDAQManagerMetadata.h"
 #include "TRESTDAQException.h"
+#include "PedestalEngine.h"
+#include "RawArchive.h"
+#include "SharedEventRing.h"
+#include "DAQMonitor.h"
+#include "ZeroSuppression.h"
+#include "TRestRawPackedEvent.h"
+#include "EventFilter.h"
+#include "DAQRunControl.h"
+#include "EventMerger.h"
+#include "EventSender.h"
+#include "TRESTDAQSocket.h"
 
 class TRESTDAQ {
    public:
-    TRESTDAQ(TRestRun* rR, TRestRawDAQMetadata* dM);
-    ~TRESTDAQ();
+    TRESTDAQ(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM = nullptr, DAQRunControl* rc = nullptr);
+    virtual ~TRESTDAQ();
 
     // Pure virtual methods to start, stop and configure the DAQ
     virtual void configure() = 0;
@@ -32,16 +47,26 @@ class TRESTDAQ {
     virtual void initialize() = 0;
     virtual void startUp(){};
 
-    static std::atomic<bool> abrt;
-    static std::atomic<bool> nextFile;
-    static std::atomic<int> event_cnt;
-    static inline double lastEvTime = 0;
-
-    static inline TRestStringOutput::REST_Verbose_Level verboseLevel = TRestStringOutput::REST_Verbose_Level::REST_Info;
+    //From the metadata of this DAQ
+    TRestStringOutput::REST_Verbose_Level verboseLevel = TRestStringOutput::REST_Verbose_Level::REST_Info;
 
     static Double_t getCurrentTime();
 
-    static void FillTree(TRestRun *rR, TRestRawSignalEvent* sEvent);
+    void FillTree(TRestRawSignalEvent* sEvent);
+    //Writes the event to the output file, after the event filter, the events are counted by FillTree
+    void WriteEvent(TRestRawSignalEvent* sEvent);
+
+    inline DAQRunControl& GetRunControl() { return *runControl; }
+    inline TRestRun* GetRestRun() { return restRun; }
+    //Used by the decoders, nullptr if the software zero suppression is disabled
+    inline ZeroSuppression* GetZeroSuppression() { return zeroSuppression.get(); }
+
+    void SaveSoftwarePedestals();
+
+    //Datagrams received and dropped by the kernel per FEM, published by the receive threads when restDAQManager sets it
+    static inline std::function<void(const std::vector<TRESTDAQSocket::counters>&)> publishSocketCounters;
+    //Called by FillTree for every built event from the event builder thread, restDAQBench measures the build latency with it
+    static inline std::function<void(const TRestRawSignalEvent*)> eventBuilt;
 
     enum daq_metadata_types::triggerTypes triggerType;
     enum daq_metadata_types::compressModeTypes compressMode;
@@ -50,7 +75,41 @@ class TRESTDAQ {
    protected:
     TRestRun* restRun;
     TRestRawDAQMetadata* daqMetadata;
+    TRestDAQManagerMetadata* managerMetadata;
+    DAQRunControl* runControl;
+    //Backend of a TRESTDAQMulti, its events are pushed to the merger and the writing stages are not set up
+    bool mergerInput = false;
     TRestRawSignalEvent fSignalEvent;
+    //Registered in the event tree when packed events are disabled, the written events are copied to it
+    TRestRawSignalEvent* treeEvent = &fSignalEvent;
+    //Registered instead of fSignalEvent when the events are written by the writer thread of the event filter
+    TRestRawSignalEvent fTreeEvent;
+
+    //Accumulates the events instead of writing them when software pedestals are enabled
+    std::unique_ptr<PedestalEngine> pedestalEngine;
+    //The decoders zero suppress the signals when software zero suppression is enabled
+    std::unique_ptr<ZeroSuppression> zeroSuppression;
+    //Written to the output file instead of the built events when packed events are enabled
+    std::unique_ptr<TRestRawPackedEvent> packedEvent;
+    //Data frames are written to the archive instead of building the events when raw archive is enabled
+    std::unique_ptr<RawArchive> rawArchive;
+    //Only the accepted events are written when the event filter is enabled
+    std::unique_ptr<EventFilter> eventFilter;
+    //The events are sent to the event builder instead of being written on the nodes of a distributed DAQ
+    std::unique_ptr<EventSender> eventSender;
+    //One of every eventRingPrescale events is published in the event ring of the run control
+    int eventRingPrescale = 1;
+    //Time of the last AutoSave
+    double lastEvTime = 0;
+
+    //Socket settings of the FEM with this id, from the manager metadata
+    TRESTDAQSocket::settings GetSocketSettings(int fecId) const;
+    //Published and stored in the manager metadata at the end of the file
+    void SaveSocketCounters(const std::vector<TRESTDAQSocket::counters>& counters);
+
+   private:
+    std::unique_ptr<TRestDAQManagerMetadata> defaultManagerMetadata;
+    std::unique_ptr<DAQRunControl> defaultRunControl;
 
 };
 
@@ -9,42 +9,25 @@ Author: JuanAn Garcia 15/04/2024
 
 #include "TRESTDAQARC.h"
 #include "ARCPacket.h"
+#include "FEMReply.h"
+#include "DAQTrace.h"
+#include "ThreadPolicy.h"
 
 
-std::atomic<bool> TRESTDAQARC::stopReceiver(false);
-std::atomic<bool> TRESTDAQARC::isPed(false);
+TRESTDAQARC::TRESTDAQARC(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc) : TRESTDAQFEM(rR, dM, mM, rc, FEMConfig::dialect::ARC) { initialize(); }
 
-TRESTDAQARC::TRESTDAQARC(TRestRun* rR, TRestRawDAQMetadata* dM) : TRESTDAQ(rR, dM) { initialize(); }
+//The FEM buffers are freed with FEMArray
+TRESTDAQARC::~TRESTDAQARC() {
+  StopThreads();
+}
 
 void TRESTDAQARC::initialize() {
 
-    for(auto fec : daqMetadata->GetFECs()){
-        FEMProxy FEM;
-        FEM.Open(fec.ip, REMOTE_DST_PORT);
-        FEM.fecMetadata = fec;
-        FEMArray.emplace_back(std::move(FEM));
-    }
-
-    for (auto &FEM : FEMArray){
-      auto cT = daq_metadata_types::chipTypes_map.find(FEM.fecMetadata.chipType.Data());
-        if(cT == daq_metadata_types::chipTypes_map.end() ){
-          std::cerr << "Unknown chip type for FEC id "<< FEM.fecMetadata.id <<" " << FEM.fecMetadata.chipType.Data() << std::endl;
-          std::cerr << "Valid chip types "<< std::endl;
-            for(const auto &[type, chip] : daq_metadata_types::chipTypes_map){
-              std::cerr << type <<" ["<< (int)chip <<"], \t";
-            }
-          std::cerr << std::endl;
-          throw (TRESTDAQException("Unknown chip type, please check RML"));
-       } else if (cT->second != daq_metadata_types::chipTypes::AGET){
-         std::cerr << "Unsupported chip type for FEC id "<< FEM.fecMetadata.id <<" " << FEM.fecMetadata.chipType.Data() << std::endl;
-         throw (TRESTDAQException("Unsupported chip type, please check RML"));
-       }
-    }
+  OpenFEMs();
 
   //Start receive and event builder threads
-  stopReceiver=false;
-  receiveThread = std::thread( TRESTDAQARC::ReceiveThread, &FEMArray);
-  eventBuilderThread = std::thread( TRESTDAQARC::EventBuilderThread, &FEMArray, restRun, &fSignalEvent);
+  receiveThread = std::thread( &TRESTDAQARC::ReceiveThread, this);
+  eventBuilderThread = std::thread( TRESTDAQARC::EventBuilderThread, &FEMArray, this, &fSignalEvent, &stopReceiver, &isPed);
 }
 
 void TRESTDAQARC::startUp(){
@@ -56,11 +39,9 @@ void TRESTDAQARC::startUp(){
   BroadcastCommand("DAQ 0",FEMArray,false);
   BroadcastCommand("daq 0xFFFFFF B",FEMArray);
   BroadcastCommand("sca enable 0",FEMArray);
-  std::this_thread::sleep_for(std::chrono::seconds(1));
+  FEMProxy::WaitForDrain(FEMArray, std::chrono::milliseconds(250), std::chrono::seconds(1));//Wait till data stops flowing
   BroadcastCommand("serve_target 0",FEMArray);
-  std::this_thread::sleep_for(std::chrono::seconds(4));
-  BroadcastCommand("rbf getpnd",FEMArray);
-  std::this_thread::sleep_for(std::chrono::seconds(1));
+  WaitForRingBuffer(std::chrono::seconds(5));//Wait till the pending requests are flushed
   //Ring Buffer startup
   BroadcastCommand("rbf timed 1",FEMArray);
   BroadcastCommand("rbf timeval 2",FEMArray);
@@ -87,81 +68,6 @@ void TRESTDAQARC::startUp(){
 
 }
 
-void TRESTDAQARC::configure() {
-  std::cout << "Configuring readout" << std::endl;
-  char cmd[200];
-  //ARC settings
-  //Selection of operating mode
-    for (auto &FEM : FEMArray){
-      sprintf(cmd, "sca wckdiv 0x%X", FEM.fecMetadata.clockDiv);  // Clock div
-      SendCommand(cmd,FEM);
-    }
-
-  BroadcastCommand("sca cnt 0x200",FEMArray);
-  BroadcastCommand("sca autostart 1",FEMArray);
-  BroadcastCommand("rst_len 1",FEMArray);
-  BroadcastCommand("mmpol 0x3",FEMArray); //Needed?
-
-  //Test mode settings
-  BroadcastCommand("keep_fco 0",FEMArray);
-  BroadcastCommand("test_zbt 0",FEMArray);
-  BroadcastCommand("test_enable 0",FEMArray);
-  BroadcastCommand("test_mode 0",FEMArray);
-  BroadcastCommand("tdata A 0x40",FEMArray);
-
-   //AGET settings
-   for (auto &FEM : FEMArray){
-      SendCommand("aget 3:0 autoreset_bank 0x1",FEM);
-      SendCommand("aget 3:0 dis_multiplicity_out 0x0",FEM);
-        for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
-          if(!FEM.fecMetadata.asic_isActive[a])continue;
-            if(FEM.fecMetadata.asic_polarity[a] == 0){
-              sprintf(cmd, "aget %d vicm 0x1", a);
-              SendCommand(cmd,FEM);
-              sprintf(cmd, "aget %d polarity 0x0", a);
-              SendCommand(cmd,FEM);
-            } else {
-              sprintf(cmd, "aget %d vicm 0x2", a);
-              SendCommand(cmd,FEM);
-              sprintf(cmd, "aget %d polarity 0x1", a);
-              SendCommand(cmd,FEM);
-            }
-         }
-
-      SendCommand("aget 3:0 en_mkr_rst 0x0",FEM);
-      SendCommand("aget 3:0 rst_level 0x1",FEM);
-      SendCommand("aget 3:0 short_read 0x0",FEM);
-      SendCommand("aget 3:0 tst_digout 0x0",FEM);
-      SendCommand("aget 3:0 mode 0x1",FEM);
-
-        for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
-          if(!FEM.fecMetadata.asic_isActive[a])continue;
-          sprintf(cmd, "aget %d gain * 0x%X",a, (FEM.fecMetadata.asic_gain[a] & 0x3) ); //Gain
-          SendCommand(cmd,FEM);
-          sprintf(cmd, "aget %d time 0x%X",a, (FEM.fecMetadata.asic_shappingTime[a] & 0xF) );  //Shapping time
-          SendCommand(cmd,FEM);
-        }
-      SendCommand("aget 3:0 dac 0x0",FEM);
-    }
-}
-
-void TRESTDAQARC::startDAQ(bool configure) {
-    auto rT = daq_metadata_types::acqTypes_map.find(std::string(daqMetadata->GetAcquisitionType()));
-    if (rT == daq_metadata_types::acqTypes_map.end()) {
-        std::cout << "Unknown acquisition type " << daqMetadata->GetAcquisitionType() << " skipping" << std::endl;
-        std::cout << "Valid acq types:" << std::endl;
-        for (auto& [name, t] : daq_metadata_types::acqTypes_map) std::cout << (int)t << " " << name << std::endl;
-        return;
-    }
-
-    if (rT->second == daq_metadata_types::acqTypes::PEDESTAL) {
-        pedestal();
-    } else {
-        dataTaking(configure);
-        isPed=false;
-    }
-}
-
 void TRESTDAQARC::pedestal() {
   std::cout << "Starting pedestal run" << std::endl;
   //Readout settings
@@ -191,14 +97,17 @@ void TRESTDAQARC::pedestal() {
   //Data server target: 0:drop data; 1:send to DAQ; 2:feed to pedestal histos; 3:feed to hit channel histos 
   BroadcastCommand("serve_target 2",FEMArray);
   BroadcastCommand("sca enable 1",FEMArray);
-  std::this_thread::sleep_for(std::chrono::seconds(15));// Wait pedestal accumulation completion
+  WaitForPedestals(std::chrono::seconds(15));// Wait pedestal accumulation completion
   BroadcastCommand("sca enable 0",FEMArray);
   char cmd[200];
+  std::map<std::pair<int, int>, PedestalStore::pedSummary> rawSummary, subSummary;
     for (auto &FEM : FEMArray){
       for(int a=0;a<4;a++){
         if(!FEM.fecMetadata.asic_isActive[a])continue;
-        sprintf(cmd, "hped %d * getsummary", a );
-        SendCommand(cmd,FEM);
+          if(SendCommand(SummaryCommand(a, "*").c_str(),FEM)){//Left empty without reply, the pedestals of the ASIC are not stored
+            std::lock_guard<std::mutex> lock(FEM.mutex_socket);
+            FEMReply::GetPedestalSummary(FEM.reply, rawSummary[{FEM.fecMetadata.id, a}]);
+          }
       }
     }
 
@@ -211,25 +120,29 @@ void TRESTDAQARC::pedestal() {
       }
     }
 
-  isPed=true;
-
   BroadcastCommand("subtract_ped 1",FEMArray);
   BroadcastCommand("hped 3:0 * clr",FEMArray);
   BroadcastCommand("sca enable 1",FEMArray);
-  std::this_thread::sleep_for(std::chrono::seconds(15));// Wait pedestal accumulation completion
+  WaitForPedestals(std::chrono::seconds(15));// Wait pedestal accumulation completion
   BroadcastCommand("sca enable 0",FEMArray);
   BroadcastCommand("trig_ena 0x0",FEMArray);
+  //Monitoring frames from now on are the pedestal summary, set after WaitForPedestals which also polls them
+  isPed=true;
     for (auto &FEM : FEMArray){
       for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
         if(!FEM.fecMetadata.asic_isActive[a])continue;
-        sprintf(cmd, "hped %d * getsummary", a );
-        SendCommand(cmd,FEM);
+          if(SendCommand(SummaryCommand(a, "*").c_str(),FEM)){//Left empty without reply, the pedestals of the ASIC are not stored
+            std::lock_guard<std::mutex> lock(FEM.mutex_socket);
+            FEMReply::GetPedestalSummary(FEM.reply, subSummary[{FEM.fecMetadata.id, a}]);
+          }
         //Set threshold
         sprintf(cmd, "hped %d * setthr %d %.1f", a , FEM.fecMetadata.asic_pedCenter[a], FEM.fecMetadata.asic_pedThr[a] );
         SendCommand(cmd,FEM);
       }
     }
 
+  SavePedestals(rawSummary, subSummary);
+
   //Set Data server target to DAQ
   BroadcastCommand("serve_target 1",FEMArray);
 }
@@ -241,9 +154,9 @@ void TRESTDAQARC::dataTaking(bool configure) {
     BroadcastCommand("DAQ 0",FEMArray);
     BroadcastCommand("daq 0xFFFFFF F",FEMArray);
     BroadcastCommand("sca enable 0",FEMArray);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    FEMProxy::WaitForDrain(FEMArray, std::chrono::milliseconds(250), std::chrono::seconds(1));
     BroadcastCommand("serve_target 0",FEMArray);
-    std::this_thread::sleep_for(std::chrono::seconds(4));
+    WaitForRingBuffer(std::chrono::seconds(4));
     //Readout settings
     BroadcastCommand("modify_hit_reg 0",FEMArray);
     BroadcastCommand("emit_hit_cnt 1",FEMArray);
@@ -251,6 +164,7 @@ void TRESTDAQARC::dataTaking(bool configure) {
     BroadcastCommand("emit_lst_cell_rd 1",FEMArray);
     BroadcastCommand("keep_rst 1",FEMArray);
     BroadcastCommand("skip_rst 0",FEMArray);
+    ReloadPedestals();
     //AGET settings
       if(compressMode == daq_metadata_types::compressModeTypes::ALLCHANNELS || compressMode == daq_metadata_types::compressModeTypes::ZEROSUPPRESSION){
         BroadcastCommand("aget 3:0 mode 0x1",FEMArray);//Mode: 0x0: hit/selected channels 0x1:all channels
@@ -296,13 +210,20 @@ void TRESTDAQARC::dataTaking(bool configure) {
         }
     }
 
+    LoadZSThresholds();//Also for the next files of the run, the pedestals are kept in the FEM registers
     BroadcastCommand("serve_target 1",FEMArray);//1: send to DAQ
     BroadcastCommand("sca enable 1",FEMArray);//Enable data taking
     BroadcastCommand("daq 0xFFFFFE F",FEMArray, false);//DAQ request
       //Wait till DAQ completion
-      while ( !abrt && !nextFile && (daqMetadata->GetNEvents() == 0 || event_cnt < daqMetadata->GetNEvents())) {
+      while (runControl->Running(daqMetadata->GetNEvents())) {
         //Do something here? E.g. send packet request
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        runControl->WaitForStop(std::chrono::milliseconds(200));
+        //The ROOT file doesn't grow in archive mode, check the archive size instead
+        if(rawArchive && rawArchive->GetSize() >= (uint64_t)daqMetadata->GetMaxFileSize())runControl->RequestNextFile();
+          if(rawArchive && rawArchive->IsBad()){
+            std::cerr << "Raw archive write failed, stopping the run" << std::endl;
+            runControl->Abort();
+          }
       }
     BroadcastCommand("sca enable 0",FEMArray);
     BroadcastCommand("serve_target 0",FEMArray);
@@ -312,70 +233,11 @@ void TRESTDAQARC::dataTaking(bool configure) {
     std::this_thread::sleep_for(std::chrono::milliseconds(500));//Wait some time till DAQ command is propagated
 }
 
-void TRESTDAQARC::stopDAQ() {
-  
-  stopReceiver = true;
-  receiveThread.join();
-  eventBuilderThread.join();
-
-    for (auto &FEM : FEMArray)
-      FEM.Close();
-}
-
-void TRESTDAQARC::BroadcastCommand(const char* cmd, std::vector<FEMProxy> &FEMA, bool wait){
-
-    for (auto &FEM : FEMA){
-      SendCommand(cmd,FEM,wait);
-    }
-
-  //if (verboseLevel >= REST_Debug)std::cout<<"Command sent "<<cmd<<std::endl;
-
-}
-
-void TRESTDAQARC::SendCommand(const char* cmd, FEMProxy &FEM, bool wait ){
-   //if(abrt)return;
-   std::unique_lock<std::mutex> lock(FEM.mutex_socket);
-   if (sendto (FEM.client, cmd, strlen(cmd), 0, (struct sockaddr*)&(FEM.target), sizeof(struct sockaddr)) == -1) {
-     std::string error ="sendto failed: " + std::string(strerror(errno));
-     throw (TRESTDAQException(error));
-   }
-
-  lock.unlock();
-  if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)std::cout<<"FEM "<<FEM.fecMetadata.id<<" Command sent "<<cmd<<std::endl;
-
-    if(wait){
-      //lock.lock();
-      FEM.cmd_sent++;
-      //lock.unlock();
-      waitForCmd(FEM, cmd);
-    }
-
-}
-
-void TRESTDAQARC::waitForCmd(FEMProxy &FEM, const char* cmd){
-
-  int timeout = 0;
-  bool condition;
-
-    do {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
-      std::unique_lock<std::mutex> lock(FEM.mutex_socket);
-      condition = (FEM.cmd_sent > FEM.cmd_rcv);
-      lock.unlock();
-      timeout++;
-    } while ( condition && timeout <20);
-
-  if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)std::cout<<"Cmd sent "<<FEM.cmd_sent<<" Cmd Received: "<<FEM.cmd_rcv<<std::endl;
-
-  if(timeout>=20)std::cout<<"Cmd timeout "<<cmd<<std::endl;
-}
-
-void TRESTDAQARC::ReceiveThread( std::vector<FEMProxy> *FEMA ) {
+void TRESTDAQARC::ReceiveThread() {
+  ThreadPolicy::Apply(ThreadPolicy::stage::RECEIVE, "arcReceive");
 
   fd_set readfds, writefds, exceptfds, readfds_work;
   struct timeval t_timeout;
-  t_timeout.tv_sec  = 5;
-  t_timeout.tv_usec = 0;
 
   // Build the socket descriptor set from which we want to read
   FD_ZERO(&readfds);
@@ -384,17 +246,32 @@ void TRESTDAQARC::ReceiveThread( std::vector<FEMProxy> *FEMA ) {
 
   
   int smax  = 0;
-    for (auto &FEM : *FEMA){
+    for (auto &FEM : FEMArray){
       FD_SET(FEM.client, &readfds);
         if (FEM.client > smax)
           smax = FEM.client;
     }
+  //Woken up by stopDAQ, and once by the abort of the run to cancel the commands waiting for a reply
+  const int stopFd = stopReceiver.GetFd();
+  const int abortFd = runControl->GetAbortFd();
+  FD_SET(stopFd, &readfds);
+  FD_SET(abortFd, &readfds);
+  smax = std::max({smax, stopFd, abortFd});
   smax++;
   int err=0;
-    while (!stopReceiver){
+  auto lastPublish = std::chrono::steady_clock::now();
+
+    while (!stopReceiver.Requested()){
+
+        if(publishSocketCounters && std::chrono::steady_clock::now() - lastPublish >= std::chrono::seconds(1)){
+          publishSocketCounters(FEMProxy::GetCounters(FEMArray));
+          lastPublish = std::chrono::steady_clock::now();
+        }
 
       // Copy the read fds from what we computed outside of the loop
       readfds_work = readfds;
+      t_timeout.tv_sec  = 5;
+      t_timeout.tv_usec = 0;
 
         // Wait for any of these sockets to be ready
         if ((err = select(smax, &readfds_work, &writefds, &exceptfds, &t_timeout)) < 0){
@@ -404,15 +281,25 @@ void TRESTDAQARC::ReceiveThread( std::vector<FEMProxy> *FEMA ) {
 
         if(err == 0 )continue;//Nothing received
 
-        for (auto &FEM : *FEMA){
+        if (FD_ISSET(abortFd, &readfds_work)){//Readable till the next run
+          FD_CLR(abortFd, &readfds);
+          std::unique_lock<std::mutex> lock(femLocks->mutex_socket);
+          femLocks->cmd_cv.notify_all();
+        }
+
+        for (auto &FEM : FEMArray){
 
           if (FD_ISSET(FEM.client, &readfds_work)){
             std::unique_lock<std::mutex> lock(FEM.mutex_socket);
             uint16_t buf_rcv[8192/(sizeof(uint16_t))];
-            int length = recvfrom(FEM.client, buf_rcv, 8192, 0, (struct sockaddr*)&FEM.remote, &FEM.remote_size);
+            int length;
+            {
+              DAQ_TRACE_SPAN(RECEIVE);
+              length = FEM.Receive(buf_rcv, 8192);
+            }
             lock.unlock();
               if (length < 0) {
-                std::string error ="recvfrom failed: " + std::string(strerror(errno));
+                std::string error ="recvmsg failed: " + std::string(strerror(errno));
                 throw (TRESTDAQException(error));
               }
 
@@ -424,30 +311,31 @@ void TRESTDAQARC::ReceiveThread( std::vector<FEMProxy> *FEMA ) {
               if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)ARCPacket::DataPacket_Print(&buf_rcv[1], size-1);
 
                 if(ARCPacket::isDataFrame(&buf_rcv[1])) {
-                  std::unique_lock<std::mutex> lock_mem(FEM.mutex_mem);
-                  //const std::deque<uint16_t> frame (&buf_rcv[1], &buf_rcv[size -1]);
-                  FEM.buffer.insert(FEM.buffer.end(), &buf_rcv[1], &buf_rcv[size]);
-                  const size_t bufferSize = FEM.buffer.size();
-                  lock_mem.unlock();
+                  if(rawArchive){//Frame archived as received, no event building
+                    rawArchive->AddFrame(FEM.fecMetadata.id, &buf_rcv[1], (size-1)*sizeof(uint16_t), getCurrentTime());
+                    std::unique_lock<std::mutex> lock_mem(FEM.mutex_mem);
+                    FEM.lastData = std::chrono::steady_clock::now();
+                    continue;
+                  }
+                  DAQ_TRACE_SPAN(BUFFER_INSERT);
+                  const size_t bufferSize = FEM.PushFrame(&buf_rcv[1], &buf_rcv[size]);
                     if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)
                       std::cout<<"Packet buffered with size "<<(int)size-1<<" queue size: "<<bufferSize<<std::endl;
-                    if( bufferSize > 1024*1024*1024){
-                      std::string error ="Buffer FULL with size "+std::to_string(bufferSize/sizeof(uint16_t))+" bytes";
-                      throw (TRESTDAQException(error));
-                    }
 
                } else if (ARCPacket::isMFrame(&buf_rcv[1]) && isPed){
+                  FEM.PushFrame(&buf_rcv[1], &buf_rcv[size]);
+                  lock.lock();
+                  FEM.reply.assign(&buf_rcv[1], &buf_rcv[size]);
                   FEM.cmd_rcv++;
-                  std::unique_lock<std::mutex> lock_mem(FEM.mutex_mem);
-                  //const std::deque<uint16_t> frame (&buf_rcv[1], &buf_rcv[size -1]);
-                  FEM.buffer.insert(FEM.buffer.end(), &buf_rcv[1], &buf_rcv[size]);
-                  const size_t bufferSize = FEM.buffer.size();
-                  lock_mem.unlock();
+                  lock.unlock();
+                  FEM.cmd_cv.notify_all();
                   if (verboseLevel == TRestStringOutput::REST_Verbose_Level::REST_Info)ARCPacket::DataPacket_Print(&buf_rcv[1], size-1);
                 } else {
-                  //lock.lock();
+                  lock.lock();
+                  FEM.reply.assign(&buf_rcv[1], &buf_rcv[size]);
                   FEM.cmd_rcv++;
-                  //lock.unlock();
+                  lock.unlock();
+                  FEM.cmd_cv.notify_all();
                 }
             }
           }
@@ -459,10 +347,14 @@ void TRESTDAQARC::ReceiveThread( std::vector<FEMProxy> *FEMA ) {
 
 }
 
-void TRESTDAQARC::EventBuilderThread(std::vector<FEMProxy> *FEMA, TRestRun *rR, TRestRawSignalEvent* sEvent){
+void TRESTDAQARC::EventBuilderThread(std::vector<FEMProxy> *FEMA, TRESTDAQ* daq, TRestRawSignalEvent* sEvent, const StopToken* stop, const std::atomic<bool>* isPed){
+  ThreadPolicy::Apply(ThreadPolicy::stage::BUILDER, "arcBuilder");
 
   sEvent->Initialize();
 
+  TRestRun* rR = daq->GetRestRun();
+  DAQRunControl* rc = &daq->GetRunControl();
+  ZeroSuppression* zs = daq->GetZeroSuppression();
   uint32_t ev_count=0;
   uint64_t ts=0;
 
@@ -475,8 +367,9 @@ void TRESTDAQARC::EventBuilderThread(std::vector<FEMProxy> *FEMA, TRestRun *rR,
         std::unique_lock<std::mutex> lock(FEM.mutex_mem);
         emptyBuffer &= FEM.buffer.empty();
         if(!FEM.buffer.empty()){
+          DAQ_TRACE_SPAN(EVENT_BUILDER);
           if(FEM.pendingEvent){//Wait till we reach end of event for all the ARC
-            FEM.pendingEvent = !ARCPacket::GetNextEvent( FEM.buffer, sEvent, ts, ev_count);
+            FEM.pendingEvent = !ARCPacket::GetNextEvent( FEM.buffer, sEvent, ts, ev_count, zs);
           }
         }
         lock.unlock();
@@ -487,30 +380,43 @@ void TRESTDAQARC::EventBuilderThread(std::vector<FEMProxy> *FEMA, TRestRun *rR,
             newEvent &= !FEM.pendingEvent;//Check if the event is pending
         }
 
+        //The FEMs with the event completed would fill their buffers and drop frames waiting for the others. Once
+        //stopped nothing else arrives and only their frames are left
+        if(!newEvent && (FEMProxy::EventStalled(*FEMA) || (stop->Requested() && !emptyBuffer))){
+          std::cerr<<"Event "<<ev_count<<" closed without the data of every FEM"<<std::endl;
+          newEvent = true;
+        }
+
       if(newEvent){//Save Event if closed
         if(rR){
           sEvent->SetID(ev_count);
           sEvent->SetTime( rR->GetStartTimestamp() + (double) ts * 2E-8 );
-          FillTree(rR, sEvent);
+          daq->FillTree(sEvent);
           sEvent->Initialize();
-          if(event_cnt%100 == 0)std::cout<<"Events "<<event_cnt<<std::endl;
+          if(rc->GetEvents()%100 == 0)std::cout<<"Events "<<rc->GetEvents()<<std::endl;
             for (auto &FEM : *FEMA)FEM.pendingEvent = true;
         }
       }
 
-    if(emptyBuffer)std::this_thread::sleep_for(std::chrono::milliseconds(100));
-  } while(!(emptyBuffer && stopReceiver));
+    if(emptyBuffer && !stop->Requested())FEMProxy::WaitForData(*FEMA, std::chrono::milliseconds(100));
+  } while(!(emptyBuffer && stop->Requested()));
 
   //Save pedestal event
-  if(isPed && emptyBuffer){
+  if(*isPed && emptyBuffer){
         if(rR){
           sEvent->SetID(ev_count);
           sEvent->SetTime( rR->GetStartTimestamp() + (double) ts * 2E-8 );
-          FillTree(rR, sEvent);
+          daq->FillTree(sEvent);
           sEvent->Initialize();
         }
       }
 
 }
 
+bool TRESTDAQARC::IsEventStart(const uint16_t* fr, size_t size){
+  return ARCPacket::isEventStart(fr, size);
+}
 
+bool TRESTDAQARC::IsEventEnd(const uint16_t* fr, size_t size){
+  return ARCPacket::isEventEnd(fr, size);
+}
@@ -0,0 +1,225 @@
+/*********************************************************************************
+TRESTDAQBuilder.cxx
+
+Event builder of a distributed DAQ, see TRESTDAQBuilder.h
+
+*********************************************************************************/
+
+#include "TRESTDAQBuilder.h"
+#include "EventLink.h"
+#include "ThreadPolicy.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+TRESTDAQBuilder::TRESTDAQBuilder(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc, statsCallback stats) :
+  TRESTDAQ(rR, dM, mM, rc), stats(stats) {
+
+    if(rawArchive){
+      rawArchive.reset();
+      throw (TRESTDAQException("rawArchive is not supported by the event builder, please check RML"));
+    }
+
+  initialize();
+}
+
+TRESTDAQBuilder::~TRESTDAQBuilder() {
+  //The pending events are written before the filter and the file are closed
+  eventMerger.reset();
+}
+
+void TRESTDAQBuilder::initialize() {
+
+  credits = std::max(1, managerMetadata->GetBuilderCredits());
+
+  EventMerger::settings st;
+  st.window = managerMetadata->GetMergeWindow();
+  st.timeout = managerMetadata->GetMergeTimeout();
+  st.queueSize = std::max(1, managerMetadata->GetMergeQueueSize());
+  st.matchIds = true;//Same trigger, same event counter in all the nodes
+  eventMerger = std::make_unique<EventMerger>(st, [this](TRestRawSignalEvent* ev){ FillTree(ev); });
+}
+
+void TRESTDAQBuilder::configure() {
+  CloseLinks();//Of a previous run
+  AcceptNodes();
+}
+
+void TRESTDAQBuilder::AcceptNodes() {
+
+  const int port = managerMetadata->GetBuilderPort();
+  const int nNodes = std::max(1, managerMetadata->GetBuilderNodes());
+  const int listenFd = EventLink::Listen(port);
+  if(listenFd < 0)throw (TRESTDAQException("Cannot listen on port " + std::to_string(port) + " for the nodes, please check builderPort"));
+
+  std::cout << "Event builder waiting for " << nNodes << " nodes on port " << port << std::endl;
+  std::vector<char> payload;
+    while((int)links.size() < nNodes && !runControl->Aborted()){
+      if(!EventLink::Readable(listenFd, 200))continue;
+      const int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+      if(fd < 0)continue;
+      EventLink::SetOptions(fd);
+
+      EventLink::messageHeader hdr;
+        if(!EventLink::ReceiveMessage(fd, hdr, payload) || hdr.type != (uint16_t)EventLink::messageType::HELLO){
+          std::cerr << "Connection without node name, closing it" << std::endl;
+          close(fd);
+          continue;
+        }
+
+      const std::string name(payload.begin(), payload.end());
+        if(std::any_of(links.begin(), links.end(), [&](const std::unique_ptr<link>& l){ return l->name == name; })){
+          std::cerr << "Node " << name << " already connected, closing the new connection" << std::endl;
+          close(fd);
+          continue;
+        }
+
+      auto l = std::make_unique<link>();
+      l->name = name;
+      l->fd = fd;
+      l->start = std::chrono::steady_clock::now();
+        if(!EventLink::SendMessage(fd, EventLink::messageType::CREDIT, &credits, sizeof(credits))){
+          std::cerr << "Cannot send the credits to node " << name << std::endl;
+          close(fd);
+          continue;
+        }
+      links.push_back(std::move(l));
+      std::cout << "Node " << name << " connected (" << links.size() << "/" << nNodes << ")" << std::endl;
+    }
+  close(listenFd);//No more nodes in this run
+}
+
+void TRESTDAQBuilder::startDAQ(bool configure) {
+
+  if(links.empty())throw (TRESTDAQException("No nodes connected to the event builder"));
+  if(!eventMerger)initialize();//Stopped by a previous stopDAQ
+
+  std::vector<link*> active;
+  linkControls.clear();
+    for(auto &l : links){
+      if(l->ended)continue;
+      linkControls.push_back(std::make_unique<DAQRunControl>());
+      eventMerger->AddInput(linkControls.back().get(), l->name);
+      active.push_back(l.get());
+    }
+
+  std::atomic<int> running(active.size());
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> threads;
+    for(size_t i=0; i<active.size(); i++){
+      threads.emplace_back([&, i]{
+        if(!ReaderThread(active[i], linkControls[i].get()))failed = true;
+        running--;
+      });
+    }
+
+  auto lastPrint = std::chrono::steady_clock::now();
+    while(running > 0 && !runControl->Stopped()){
+      PublishStats();
+        if(std::chrono::steady_clock::now() - lastPrint > std::chrono::seconds(10)){
+          PrintLinks();
+          lastPrint = std::chrono::steady_clock::now();
+        }
+      runControl->WaitForStop(std::chrono::milliseconds(200));
+    }
+
+  //The readers stop at a message boundary
+  for(auto &t : threads)t.join();
+  PublishStats();
+
+  if(failed)throw (TRESTDAQException("Fragments rejected by the event merger, run aborted"));
+}
+
+bool TRESTDAQBuilder::ReaderThread(link* l, DAQRunControl* rc) {
+  ThreadPolicy::Apply(ThreadPolicy::stage::RECEIVE, "builderLink");
+
+  TRestRawPackedEvent packed;
+  TRestRawSignalEvent sEvent;
+  std::vector<char> payload;
+  EventLink::fragmentHeader fh;
+  const double startTime = restRun ? restRun->GetStartTimestamp() : 0;
+
+    while(runControl->Running(daqMetadata->GetNEvents())){
+      if(!EventLink::Readable(l->fd, 100))continue;
+
+      EventLink::messageHeader hdr;
+        if(!EventLink::ReceiveMessage(l->fd, hdr, payload)){
+          std::cerr << "Link of node " << l->name << " broken " << std::strerror(errno) << std::endl;
+          l->ended = true;
+          break;
+        }
+      l->bytes += sizeof(hdr) + hdr.size;
+
+        if(hdr.type == (uint16_t)EventLink::messageType::END){
+          uint64_t sent = 0;
+          if(payload.size() == sizeof(sent))memcpy(&sent, payload.data(), sizeof(sent));
+          std::cout << "Node " << l->name << " ended, " << sent << " events sent, " << l->fragments << " received" << std::endl;
+          l->ended = true;
+          break;
+        }
+      if(hdr.type != (uint16_t)EventLink::messageType::FRAGMENT)continue;
+
+        if(payload.size() < sizeof(fh) || !packed.Deserialize(payload.data() + sizeof(fh), payload.size() - sizeof(fh))){
+          std::cerr << "Wrong fragment from node " << l->name << ", skipping it" << std::endl;
+        } else {
+          memcpy(&fh, payload.data(), sizeof(fh));
+          packed.Decode(&sEvent);
+          sEvent.SetID(fh.id);
+          sEvent.SetTime(startTime + fh.time);
+            if(!eventMerger->Push(rc, &sEvent)){//Waits while the queue of the node is full
+              std::cerr << "Link of node " << l->name << " is not an input of the event merger, aborting the run" << std::endl;
+              runControl->Abort();
+              return false;
+            }
+        }
+      l->fragments++;
+
+        //A node closes the link after its last fragments, they are still read if the credits can't be sent
+        if(++l->consumed >= std::max(1u, credits / 4)){
+          EventLink::SendMessage(l->fd, EventLink::messageType::CREDIT, &l->consumed, sizeof(l->consumed));
+          l->consumed = 0;
+        }
+    }
+
+  if(l->ended)eventMerger->EndInput(rc);
+  return true;
+}
+
+void TRESTDAQBuilder::stopDAQ() {
+
+  //Events received once the readers are stopped
+    if(eventMerger){
+      eventMerger->Flush();
+      eventMerger->PrintSummary();
+      PublishStats();
+    }
+  //Nothing is written after the file is closed
+  eventMerger.reset();
+  PrintLinks();
+
+  //End of the run, the nodes still acquiring are aborted
+  if(!runControl->NextFile())CloseLinks();
+}
+
+void TRESTDAQBuilder::PublishStats() {
+  if(stats && eventMerger)stats(eventMerger->GetStats());
+}
+
+void TRESTDAQBuilder::PrintLinks() {
+  const auto now = std::chrono::steady_clock::now();
+    for(const auto &l : links){
+      const double mb = l->bytes / (1024. * 1024.);
+      const double elapsed = std::chrono::duration<double>(now - l->start).count();
+      std::cout << "  Node " << l->name << ": " << l->fragments << " events, " << mb << " MB, " << (elapsed > 0 ? mb / elapsed : 0) << " MB/s"
+                << (l->ended ? ", ended" : "") << std::endl;
+    }
+}
+
+void TRESTDAQBuilder::CloseLinks() {
+  for(auto &l : links)close(l->fd);
+  links.clear();
+}
@@ -0,0 +1,71 @@
+/*********************************************************************************
+TRESTDAQBuilder.h
+
+Event builder of a distributed DAQ: every node (restDAQManager with the
+builderAddress of TRestDAQManagerMetadata) receives the data of its FEMs and
+builds the events of them, the built events are sent to the builder (see
+EventSender and EventLink.h), which merges the events of the nodes with the
+same event counter within the merge window (EventMerger) and writes them.
+Selected with electronicsType BUILDER, the builder waits for builderNodes
+nodes when it is configured.
+
+The links are kept for all the files of a run, the fragments received while
+a new file is opened wait in the sockets. The run stops once all the nodes
+have ended, the links are closed at the end of the run so the nodes still
+acquiring are aborted. The times of the events are relative to the start of
+the run of every node, so the FEMs of the nodes have to share the clock.
+
+*********************************************************************************/
+
+#ifndef __TREST_DAQ_BUILDER__
+#define __TREST_DAQ_BUILDER__
+
+#include "TRESTDAQ.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TRESTDAQBuilder : public TRESTDAQ {
+  public:
+    typedef std::function<void(const std::vector<EventMerger::inputStats>&)> statsCallback;
+
+    TRESTDAQBuilder(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc, statsCallback stats = nullptr);
+    ~TRESTDAQBuilder();
+
+    void configure() override;
+    void startDAQ(bool configure=true) override;
+    void stopDAQ() override;
+    void initialize() override;
+
+  private:
+    struct link {
+      std::string name;
+      int fd = -1;
+      std::atomic<bool> ended{false};
+      std::atomic<uint64_t> fragments{0};
+      std::atomic<uint64_t> bytes{0};
+      uint32_t consumed = 0;//Fragments queued in the merger, the credits are not returned yet
+      std::chrono::steady_clock::time_point start;
+    };
+
+    void AcceptNodes();
+    //false if the merger rejects a fragment, the run is aborted then
+    bool ReaderThread(link* l, DAQRunControl* rc);
+    void PublishStats();
+    static void PrintLinks();
+    static void CloseLinks();
+
+    //Kept for all the files of the run
+    static inline std::vector<std::unique_ptr<link> > links;
+
+    std::unique_ptr<EventMerger> eventMerger;
+    std::vector<std::unique_ptr<DAQRunControl> > linkControls;//Merger input of every link, in this file
+    statsCallback stats;
+    uint32_t credits;
+};
+
+#endif
@@ -8,8 +8,10 @@ Author: JuanAn Garcia 18/05/2021
 *********************************************************************************/
 
 #include "TRESTDAQDCC.h"
+#include "DAQTrace.h"
+#include "ThreadPolicy.h"
 
-TRESTDAQDCC::TRESTDAQDCC(TRestRun* rR, TRestRawDAQMetadata* dM) : TRESTDAQ(rR, dM) { initialize(); }
+TRESTDAQDCC::TRESTDAQDCC(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc) : TRESTDAQ(rR, dM, mM, rc) { initialize(); }
 
 void TRESTDAQDCC::initialize() {
 
@@ -36,7 +38,10 @@ void TRESTDAQDCC::initialize() {
       throw (TRESTDAQException("Unsupported compress mode, please check RML"));
     }
 
-    dcc_socket.Open(daqMetadata->GetFECs().front().ip, REMOTE_DST_PORT);
+    TRESTDAQSocket::settings st = GetSocketSettings(daqMetadata->GetFECs().front().id);
+    //The replies are waited for in the acquisition loop, which may run with real time priority, blocking so it doesn't spin
+    st.receiveTimeout = 100;
+    dcc_socket.Open(daqMetadata->GetFECs().front().ip, REMOTE_DST_PORT, st);
 
 }
 
@@ -91,6 +96,8 @@ void TRESTDAQDCC::configure() {
 }
 
 void TRESTDAQDCC::startDAQ(bool configure) {
+    //The DCC is read by the acquisition loop, in the thread of the manager
+    ThreadPolicy::Scope policy(ThreadPolicy::stage::RECEIVE, "dccReceive");
 
     if ( acqType == daq_metadata_types::acqTypes::PEDESTAL) {
         pedestal();
@@ -115,7 +122,7 @@ void TRESTDAQDCC::pedestal() {
     SendCommand("isobus 0x4F");  // Reset event counter, timestamp for type 10
 
     int loopN = 0;
-      while (!abrt && (loopN++ < daqMetadata->GetNPedestalEvents())) {
+      while (!runControl->Aborted() && (loopN++ < daqMetadata->GetNPedestalEvents())) {
         SendCommand("isobus 0x6C");     // SCA start
         SendCommand("isobus 0x1C");     // SCA stop
         waitForTrigger();
@@ -146,7 +153,7 @@ void TRESTDAQDCC::pedestal() {
             }
           }
 
-    FillTree(restRun, &fSignalEvent);
+    FillTree(&fSignalEvent);
 }
 
 void TRESTDAQDCC::dataTaking(bool configure) {
@@ -158,13 +165,13 @@ void TRESTDAQDCC::dataTaking(bool configure) {
     // else SendCommand("skipempty 0", -1);//Save empty frames if not
     if(configure)SendCommand("isobus 0x4F");  // Reset event counter, timestamp for type 11
 
-    while ( !abrt && !nextFile && (daqMetadata->GetNEvents() == 0 || event_cnt < daqMetadata->GetNEvents())) {
+    while (runControl->Running(daqMetadata->GetNEvents())) {
         SendCommand("fem 0");
 
         SendCommand("isobus 0x6C");// SCA start
         if (triggerType ==  daq_metadata_types::triggerTypes::INTERNAL) SendCommand("isobus 0x1C");  // SCA stop case of internal trigger
         fSignalEvent.Initialize();
-        fSignalEvent.SetID(event_cnt);
+        fSignalEvent.SetID(runControl->GetEvents());
         waitForTrigger();
         // Perform data acquisition phase, compress, accept size
         fSignalEvent.SetTime(getCurrentTime());
@@ -176,16 +183,24 @@ void TRESTDAQDCC::dataTaking(bool configure) {
               SendCommand(cmd, DCCPacket::packetType::BINARY, 0, DCCPacket::packetDataType::EVENT);
             }
           }
-        if(fSignalEvent.GetNumberOfSignals() >0 )FillTree(restRun, &fSignalEvent);
+          if(rawArchive){//Frames already archived, the ROOT file doesn't grow in archive mode
+            runControl->AddEvent();
+            if(rawArchive->GetSize() >= (uint64_t)daqMetadata->GetMaxFileSize())runControl->RequestNextFile();
+              if(rawArchive->IsBad()){
+                std::cerr << "Raw archive write failed, stopping the run" << std::endl;
+                runControl->Abort();
+              }
+          } else if(fSignalEvent.GetNumberOfSignals() >0 )FillTree(&fSignalEvent);
     }
 }
 
 void TRESTDAQDCC::stopDAQ() {
+    SaveSocketCounters({dcc_socket.GetCounters(daqMetadata->GetFECs().front().id)});
     dcc_socket.Close();
     std::cout << "Run stopped" << std::endl;
 }
 
-void TRESTDAQDCC::saveEvent(unsigned char* buf, int size) {
+void TRESTDAQDCC::saveEvent(unsigned char* buf, int size, TRestRawSignalEvent* sEvent, ZeroSuppression* zs, TRestStringOutput::REST_Verbose_Level verbose) {
     // If data supplied, copy to temporary buffer
     if (size <= 0) return;
     DCCPacket::DataPacket* dp = (DCCPacket::DataPacket*)buf;
@@ -205,7 +220,7 @@ void TRESTDAQDCC::saveEvent(unsigned char* buf, int size) {
 
     if (physChannel < 0) return;
 
-    if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)
+    if (verbose >= TRestStringOutput::REST_Verbose_Level::REST_Debug)
         std::cout << "FEC " << fec << " asic " << asic << " channel " << channel << " physChann " << physChannel << "\n";
 
    //bool compress = GET_RB_COMPRESS(ntohs(dp->args) );
@@ -227,8 +242,11 @@ void TRESTDAQDCC::saveEvent(unsigned char* buf, int size) {
           }
       }
 
+    if (zs && !zs->Apply(physChannel, sData)) return;
+
     TRestRawSignal rawSignal(physChannel, sData);
-    fSignalEvent.AddSignal(rawSignal);
+    DAQ_TRACE_COUNT(ADD_SIGNAL);
+    sEvent->AddSignal(rawSignal);
 }
 
 void TRESTDAQDCC::savePedestals(unsigned char* buf, int size) {
@@ -268,6 +286,7 @@ void TRESTDAQDCC::savePedestals(unsigned char* buf, int size) {
 }
 
 DCCPacket::packetReply TRESTDAQDCC::SendCommand(const char* cmd, DCCPacket::packetType pckType, size_t nPackets, DCCPacket::packetDataType dataType) {
+    DAQ_TRACE_SPAN(SEND_COMMAND);
     if (sendto(dcc_socket.client, cmd, strlen(cmd), 0, (struct sockaddr*)&(dcc_socket.target), sizeof(struct sockaddr)) == -1) {
         std::string error ="sendto failed: " + std::string(strerror(errno));
         throw (TRESTDAQException(error));
@@ -283,28 +302,24 @@ DCCPacket::packetReply TRESTDAQDCC::SendCommand(const char* cmd, DCCPacket::pack
 
     while (!done) {
         int length;
-        int cnt = 0;
         auto startTime = std::chrono::steady_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::duration<int>>(std::chrono::steady_clock::now() - startTime);
 
         do {
-            length = recvfrom(dcc_socket.client, buf_rcv, 8192, 0, (struct sockaddr*)&dcc_socket.remote, &dcc_socket.remote_size);
+            length = dcc_socket.Receive(buf_rcv, 8192);
 
             if (length < 0) {
-                if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                    if (cnt % 1000 == 0) {
-                        duration = std::chrono::duration_cast<std::chrono::duration<int>>(std::chrono::steady_clock::now() - startTime);
-                        if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Extreme) fprintf(stderr, "socket() failed: %s\n", strerror(errno));
-                    }
+                if (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR) {//Receive timeout, the abort is checked
+                    duration = std::chrono::duration_cast<std::chrono::duration<int>>(std::chrono::steady_clock::now() - startTime);
+                    if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Extreme) fprintf(stderr, "socket() failed: %s\n", strerror(errno));
                 } else {
-                  std::string error ="recvfrom failed: " + std::string(strerror(errno));
+                  std::string error ="recvmsg failed: " + std::string(strerror(errno));
                   throw (TRESTDAQException(error));
                 }
             }
-            cnt++;
-        } while (length < 0 && duration.count() < 10 && !abrt);
+        } while (length < 0 && duration.count() < 10 && !runControl->Aborted());
 
-        if(abrt){
+        if(runControl->Aborted()){
           std::cerr << "Run aborted" << std::endl;
             return DCCPacket::packetReply::ERROR;
         }
@@ -344,8 +359,10 @@ DCCPacket::packetReply TRESTDAQDCC::SendCommand(const char* cmd, DCCPacket::pack
 
             DCCPacket::DataPacket* data_pkt = (DCCPacket::DataPacket*)buf_ual;
 
-            if(dataType == DCCPacket::packetDataType::EVENT){
-              saveEvent(buf_ual, length);
+            if(dataType == DCCPacket::packetDataType::EVENT && rawArchive){
+              rawArchive->AddFrame(0, buf_ual, length, getCurrentTime());
+            } else if(dataType == DCCPacket::packetDataType::EVENT){
+              saveEvent(buf_ual, length, &fSignalEvent, zeroSuppression.get(), verboseLevel);
             } else if(dataType == DCCPacket::packetDataType::PEDESTAL) {
               savePedestals(buf_ual, length);
             }
@@ -369,6 +386,6 @@ void TRESTDAQDCC::waitForTrigger() {  // Wait till trigger is acquired
     DCCPacket::packetReply reply;
     do {
         reply = SendCommand("wait 1000000");                   // Wait for the event to be acquired
-    } while (reply == DCCPacket::packetReply::RETRY && !abrt);  // Infinite loop till aborted or wait succeed
+    } while (reply == DCCPacket::packetReply::RETRY && !runControl->Aborted());  // Infinite loop till aborted or wait succeed
 }
 
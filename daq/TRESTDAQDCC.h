@@ -18,20 +18,23 @@ Based on mclient program from Denis Calvet
 
 class TRESTDAQDCC : public TRESTDAQ {
    public:
-    TRESTDAQDCC(TRestRun* rR, TRestRawDAQMetadata* dM);
+    TRESTDAQDCC(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM = nullptr, DAQRunControl* rc = nullptr);
 
     void configure() override;
     void startDAQ(bool configure=true) override;
     void stopDAQ() override;
     void initialize() override;
 
+    //The signals are zero suppressed by zs if it is given
+    static void saveEvent(unsigned char* buf, int size, TRestRawSignalEvent* sEvent, ZeroSuppression* zs = nullptr,
+                          TRestStringOutput::REST_Verbose_Level verbose = TRestStringOutput::REST_Verbose_Level::REST_Info);
+
    private:
     void pedestal();
     void dataTaking(bool configure=true);
     DCCPacket::packetReply SendCommand(const char* cmd, DCCPacket::packetType type = DCCPacket::packetType::ASCII, size_t nPackets = 0, DCCPacket::packetDataType dataType = DCCPacket::packetDataType::NONE);
 
     void waitForTrigger();
-    void saveEvent(unsigned char* buf, int size);
     void savePedestals(unsigned char* buf, int size);
 
     uint16_t FECMask = 0;
@@ -1,13 +1,21 @@
 /*********************************************************************************
-TRESTDAQT2K.cxx
+TRESTDAQDummy.cxx
 
-Implement data acquisition for DCC + FEM + FEC based readout
+Dummy electronics, see TRESTDAQDummy.h
 
 Author: JuanAn Garcia 18/05/2021
 
 *********************************************************************************/
 
 #include "TRESTDAQDummy.h"
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <random>
+#include <thread>
 
 const std::vector<double> pulseSample = {0,       0,       83,      115.333, 136,     154.4,   171.167, 188,     206.125, 223.333, 242.4,   262.727,
                                          283.833, 317,     352.833, 391.417, 431.167, 472.167, 513.667, 553.5,   594,     631.917, 667.583, 700.333,
@@ -15,37 +23,131 @@ const std::vector<double> pulseSample = {0,       0,       83,      115.333, 136
                                          745.5,   724,     701.583, 677.667, 653.917, 629.417, 604.667, 579.75,  555.333, 531.583, 507.167, 491.091,
                                          474.7,   457,     438.875, 418,     394.833, 368.2,   335,     288.333, 209.5,   0,       0,       0};
 
-TRESTDAQDummy::TRESTDAQDummy(TRestRun* rR, TRestRawDAQMetadata* dM) : TRESTDAQ(rR, dM) { initialize(); }
+TRESTDAQDummy::TRESTDAQDummy(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc) : TRESTDAQ(rR, dM, mM, rc) { initialize(); }
+
+//Bank of pulse shapes with different amplitudes and peaking times, plus gaussian noise read at random offsets
+void TRESTDAQDummy::initialize() {
 
-void TRESTDAQDummy::initialize() {}
+  nSamples = std::max(1, managerMetadata->GetDummySamples());
+  nChannels = std::max(1, managerMetadata->GetDummyChannels());
+  const int bankSize = std::max(1, managerMetadata->GetDummyBankSize());
+  const double noise = managerMetadata->GetDummyNoise();
+
+  std::mt19937 gen(static_cast<unsigned int>(std::time(nullptr)));
+  std::uniform_real_distribution<double> amplitude(0, 3);
+  std::uniform_int_distribution<int> jitter(-20, 20);
+
+  const int pulseSize = pulseSample.size();
+  const int maxStart = std::max(0, nSamples - pulseSize);
+  pulseBank.assign(bankSize, std::vector<Short_t>(nSamples, 0));
+    for(auto &pulse : pulseBank){
+      const double factor = amplitude(gen);
+      const int t0 = std::min(maxStart, std::max(0, nSamples * 200 / 512 + jitter(gen)));
+      for (int i = 0; i < pulseSize && t0 + i < nSamples; i++)
+        pulse[t0 + i] = std::round(pulseSample[i] * factor);
+    }
+
+  noiseBank.clear();
+    if(noise > 0){
+      std::normal_distribution<double> gaus(0, noise);
+      noiseBank.resize(65536 + nSamples);
+      for(auto &n : noiseBank)n = std::round(gaus(gen));
+    }
+}
 
 void TRESTDAQDummy::configure() { std::cout << "Configuring readout" << std::endl; }
 
+//Signals in two clusters, in the first and second half of the readout channels
+void TRESTDAQDummy::GeneratorThread(int id) {
+  ThreadPolicy::Apply(ThreadPolicy::stage::BUILDER, "dummyGenerator");
+
+  std::mt19937 gen(static_cast<unsigned int>(std::time(nullptr)) + 7919 * id);
+  const int halfRange = std::max(144, (nChannels + 1) / 2);
+  std::uniform_int_distribution<int> clusterStart(0, halfRange - 1);
+  std::uniform_int_distribution<size_t> pulseIndex(0, pulseBank.size() - 1);
+  std::uniform_int_distribution<size_t> noiseOffset(0, noiseBank.empty() ? 0 : noiseBank.size() - nSamples);
+
+    while (true) {
+      dummyEvent event(nChannels);
+      const int start[2] = {clusterStart(gen), clusterStart(gen)};
+        for (int s = 0; s < nChannels; s++) {
+          const int half = s < (nChannels + 1) / 2 ? 0 : 1;
+          const int k = half == 0 ? s : s - (nChannels + 1) / 2;
+          event[s].first = half * halfRange + (start[half] + k) % halfRange;
+
+          auto &sData = event[s].second;
+          sData.assign(nSamples, 250);
+          const auto &pulse = pulseBank[pulseIndex(gen)];
+          for (int i = 0; i < nSamples; i++) sData[i] += pulse[i];
+            if (!noiseBank.empty()) {
+              const Short_t* n = &noiseBank[noiseOffset(gen)];
+              for (int i = 0; i < nSamples; i++) sData[i] += n[i];
+            }
+        }
+
+      std::unique_lock<std::mutex> lock(queueMutex);
+      queueCond.wait(lock, [this] { return stopGenerators || eventQueue.size() < maxQueueSize; });
+      if (stopGenerators) return;
+      eventQueue.emplace_back(std::move(event));
+      lock.unlock();
+      queueCond.notify_all();
+    }
+}
+
 void TRESTDAQDummy::startDAQ(bool configure) {
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
 
-    while ( !abrt && !nextFile && (daqMetadata->GetNEvents() == 0 || event_cnt < daqMetadata->GetNEvents() ) ) {
+  const double rate = managerMetadata->GetDummyRate();
+  const int nThreads = std::max(1, managerMetadata->GetDummyThreads());
+
+  stopGenerators = false;
+  std::vector<std::thread> generators;
+  for (int i = 0; i < nThreads; i++) generators.emplace_back(&TRESTDAQDummy::GeneratorThread, this, i);
+
+  const auto period = std::chrono::nanoseconds(rate > 0 ? (int64_t)(1E9 / rate) : 0);
+  const auto startTime = std::chrono::steady_clock::now();
+  auto nextEvent = startTime;
+  const int startCnt = runControl->GetEvents();
+
+    while (runControl->Running(daqMetadata->GetNEvents())) {
+        dummyEvent event;
+        {
+          std::unique_lock<std::mutex> lock(queueMutex);
+          if (!queueCond.wait_for(lock, std::chrono::milliseconds(100), [this] { return !eventQueue.empty(); })) continue;
+          event = std::move(eventQueue.front());
+          eventQueue.pop_front();
+        }
+        queueCond.notify_all();
+
         fSignalEvent.Initialize();
-        fSignalEvent.SetID(event_cnt);
+        fSignalEvent.SetID(runControl->GetEvents());
         fSignalEvent.SetTime(getCurrentTime());
-        int physChannel = rand() * 140. / RAND_MAX;
-        for (int s = 0; s < 10; s++) {
-            std::vector<Short_t> sData(512, 250);
-            double factor = rand() * 3. / RAND_MAX;
-            for (size_t i = 0; i < pulseSample.size(); i++) {
-                int timeBin = i + 200;
-                sData[timeBin] += pulseSample[i] * factor;
-            }
-            // std::cout<<physChannel<<std::endl;
-            if (s == 5) physChannel = rand() * 140. / RAND_MAX + 144;
-            TRestRawSignal rawSignal(physChannel % 288, sData);
+        for (auto& [physChannel, sData] : event) {
+            TRestRawSignal rawSignal(physChannel, sData);
             fSignalEvent.AddSignal(rawSignal);
-            physChannel++;
         }
 
-        FillTree(restRun, &fSignalEvent);
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        FillTree(&fSignalEvent);
+
+          if (rate > 0) {
+            nextEvent += period;
+            const auto now = std::chrono::steady_clock::now();
+            if (nextEvent < now - std::chrono::seconds(1)) nextEvent = now;  // Don't catch up after a long stall
+            if (nextEvent > now) runControl->WaitForStop(nextEvent - now);
+          }
     }
+
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    stopGenerators = true;
+    eventQueue.clear();
+  }
+  queueCond.notify_all();
+  for (auto& t : generators) t.join();
+
+  const double elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - startTime).count();
+  const int nEvents = runControl->GetEvents() - startCnt;
+  std::cout << "Dummy DAQ: " << nEvents << " events in " << elapsed << " s (" << (elapsed > 0 ? nEvents / elapsed : 0) << " Hz), "
+            << nChannels << " signals x " << nSamples << " samples, " << nThreads << " generator threads" << std::endl;
 }
 
 void TRESTDAQDummy::stopDAQ() { std::cout << "Run stopped" << std::endl; }
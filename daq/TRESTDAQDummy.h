@@ -1,10 +1,15 @@
 /*********************************************************************************
-TRESTDAQT2K.h
+TRESTDAQDummy.h
 
-Implement data acquisition for DCC + FEM + FEC based readout
+Dummy electronics, no hardware is needed
 
 Author: JuanAn Garcia 18/05/2021
 
+The dummy electronics is a synthetic load generator: the signals are drawn
+from a bank of precomputed pulse shapes plus a bank of gaussian noise by
+several generator threads, the events are written by the acquisition thread
+at the rate set in TRestDAQManagerMetadata
+
 *********************************************************************************/
 
 #ifndef __TREST_DAQ_DUMMY__
@@ -12,14 +17,38 @@ Author: JuanAn Garcia 18/05/2021
 
 #include "TRESTDAQ.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 class TRESTDAQDummy : public TRESTDAQ {
    public:
-    TRESTDAQDummy(TRestRun* rR, TRestRawDAQMetadata* dM);
+    TRESTDAQDummy(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM = nullptr, DAQRunControl* rc = nullptr);
 
     void configure() override;
     void startDAQ(bool configure=true) override;
     void stopDAQ() override;
     void initialize() override;
+
+   private:
+    //Physical channel and samples of every signal
+    typedef std::vector<std::pair<int, std::vector<Short_t> > > dummyEvent;
+
+    void GeneratorThread(int id);
+
+    std::vector<std::vector<Short_t> > pulseBank;
+    std::vector<Short_t> noiseBank;
+    int nSamples = 512;
+    int nChannels = 10;
+
+    //Events ready to be written, filled by the generator threads
+    static constexpr size_t maxQueueSize = 256;
+    std::deque<dummyEvent> eventQueue;
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    bool stopGenerators = false;
 };
 
 #endif
@@ -0,0 +1,335 @@
+/*********************************************************************************
+TRESTDAQFEM.cxx
+
+Common part of the FEMINOS and ARC based readout, see TRESTDAQFEM.h
+
+*********************************************************************************/
+
+#include "TRESTDAQFEM.h"
+#include "FEMReply.h"
+#include "DAQTrace.h"
+
+TRESTDAQFEM::TRESTDAQFEM(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc, FEMConfig::dialect d) :
+  TRESTDAQ(rR, dM, mM, rc), dialect(d) { }
+
+void TRESTDAQFEM::OpenFEMs() {
+
+    for(auto fec : daqMetadata->GetFECs()){
+        FEMProxy FEM(femLocks);
+        FEM.Open(fec.ip, REMOTE_DST_PORT, GetSocketSettings(fec.id));
+        FEM.fecMetadata = fec;
+        FEM.AllocateBuffer(managerMetadata->GetFEMBufferSize(), managerMetadata->UseHugePages());
+        FEMArray.emplace_back(std::move(FEM));
+    }
+
+    for (auto &FEM : FEMArray){
+      auto cT = daq_metadata_types::chipTypes_map.find(FEM.fecMetadata.chipType.Data());
+        if(cT == daq_metadata_types::chipTypes_map.end() ){
+          std::cerr << "Unknown chip type for FEC id "<< FEM.fecMetadata.id <<" " << FEM.fecMetadata.chipType.Data() << std::endl;
+          std::cerr << "Valid chip types "<< std::endl;
+            for(const auto &[type, chip] : daq_metadata_types::chipTypes_map){
+              std::cerr << type <<" ["<< (int)chip <<"], \t";
+            }
+          std::cerr << std::endl;
+          throw (TRESTDAQException("Unknown chip type, please check RML"));
+       } else if (cT->second != daq_metadata_types::chipTypes::AGET){
+         std::cerr << "Unsupported chip type for FEC id "<< FEM.fecMetadata.id <<" " << FEM.fecMetadata.chipType.Data() << std::endl;
+         throw (TRESTDAQException("Unsupported chip type, please check RML"));
+       }
+    }
+
+  LoadConfigCache();
+}
+
+void TRESTDAQFEM::StopThreads() {
+  stopReceiver.Request();
+  femLocks->data_cv.notify_all();
+  if(receiveThread.joinable())receiveThread.join();
+  if(eventBuilderThread.joinable())eventBuilderThread.join();
+}
+
+void TRESTDAQFEM::configure() {
+  std::cout << "Configuring readout" << std::endl;
+    //FEM and AGET settings, blocks already applied in a previous configuration are skipped
+    for (auto &FEM : FEMArray){
+      int sent = 0, skipped = 0;
+        for(const auto &block : FEMConfig::Compile(FEM.fecMetadata, dialect)){
+            if(managerMetadata->UseConfigCache() && FEMConfig::IsApplied(block, FEM.registers)){
+              skipped += block.size();
+              continue;
+            }
+          for(const auto &cmd : block)SendCommand(cmd.c_str(),FEM);
+          sent += block.size();
+        }
+      std::cout<<"FEM "<<FEM.fecMetadata.id<<" configured: "<<sent<<" commands sent, "<<skipped<<" already applied"<<std::endl;
+    }
+
+  SaveConfigCache();
+}
+
+void TRESTDAQFEM::startDAQ(bool configure) {
+    auto rT = daq_metadata_types::acqTypes_map.find(std::string(daqMetadata->GetAcquisitionType()));
+    if (rT == daq_metadata_types::acqTypes_map.end()) {
+        std::cout << "Unknown acquisition type " << daqMetadata->GetAcquisitionType() << " skipping" << std::endl;
+        std::cout << "Valid acq types:" << std::endl;
+        for (auto& [name, t] : daq_metadata_types::acqTypes_map) std::cout << (int)t << " " << name << std::endl;
+        return;
+    }
+
+    if (rT->second == daq_metadata_types::acqTypes::PEDESTAL) {
+        pedestal();
+    } else {
+        dataTaking(configure);
+        isPed=false;
+    }
+}
+
+void TRESTDAQFEM::stopDAQ() {
+  stopReceiver.Request();
+  femLocks->data_cv.notify_all();
+  receiveThread.join();
+  eventBuilderThread.join();
+
+  SaveConfigCache();
+  SaveSocketCounters(FEMProxy::GetCounters(FEMArray));
+
+    for (auto &FEM : FEMArray)
+      FEM.Close();
+}
+
+void TRESTDAQFEM::LoadConfigCache(){
+  if(!managerMetadata->UseConfigCache())return;
+
+    for (auto &FEM : FEMArray){
+      const std::string cacheFile = FEMConfig::GetCacheFile(managerMetadata->GetCacheDirectory(), FEM.fecMetadata);
+      if(FEMConfig::LoadCache(cacheFile, FEM.registers))
+        std::cout<<"FEM "<<FEM.fecMetadata.id<<" "<<FEM.registers.size()<<" registers loaded from "<<cacheFile<<std::endl;
+    }
+}
+
+void TRESTDAQFEM::SaveConfigCache(){
+  if(!managerMetadata->UseConfigCache())return;
+
+    for (auto &FEM : FEMArray){
+      FEMConfig::SaveCache(FEMConfig::GetCacheFile(managerMetadata->GetCacheDirectory(), FEM.fecMetadata), FEM.registers);
+    }
+}
+
+void TRESTDAQFEM::BroadcastCommand(const char* cmd, std::vector<FEMProxy> &FEMA, bool wait){
+
+    for (auto &FEM : FEMA){
+      SendCommand(cmd,FEM,wait);
+    }
+
+}
+
+bool TRESTDAQFEM::SendCommand(const char* cmd, FEMProxy &FEM, bool wait ){
+   DAQ_TRACE_SPAN(SEND_COMMAND);
+   std::unique_lock<std::mutex> lock(FEM.mutex_socket);
+   if (sendto (FEM.client, cmd, strlen(cmd), 0, (struct sockaddr*)&(FEM.target), sizeof(struct sockaddr)) == -1) {
+     std::string error ="sendto failed: " + std::string(strerror(errno));
+     throw (TRESTDAQException(error));
+   }
+
+  if(wait)FEM.cmd_sent++;
+  lock.unlock();
+  if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)std::cout<<"FEM "<<FEM.fecMetadata.id<<" Command sent "<<cmd<<std::endl;
+
+    if(wait){
+        //Keep track of the registers only if the FEM has acknowledged the command
+        if(waitForCmd(FEM, cmd)){
+          FEMConfig::Apply(cmd, FEM.registers);
+          return true;
+        } else {
+          FEMConfig::Invalidate(cmd, FEM.registers);
+          return false;
+        }
+    } else {
+      FEMConfig::Invalidate(cmd, FEM.registers);
+      return true;
+    }
+
+}
+
+//Send a list of commands keeping several of them in flight instead of waiting for every reply
+void TRESTDAQFEM::SendCommands(const std::vector<std::string> &cmds, FEMProxy &FEM){
+
+  const int maxPending = 8;
+  bool received = true;
+  std::unique_lock<std::mutex> lock(FEM.mutex_socket);
+    for (const auto &cmd : cmds){
+      received &= FEM.cmd_cv.wait_for(lock, std::chrono::seconds(1), [&]{ return FEM.cmd_sent - FEM.cmd_rcv < maxPending || runControl->Aborted(); });
+        if (sendto (FEM.client, cmd.c_str(), cmd.size(), 0, (struct sockaddr*)&(FEM.target), sizeof(struct sockaddr)) == -1) {
+          std::string error ="sendto failed: " + std::string(strerror(errno));
+          throw (TRESTDAQException(error));
+        }
+      FEM.cmd_sent++;
+      if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)std::cout<<"FEM "<<FEM.fecMetadata.id<<" Command sent "<<cmd<<std::endl;
+    }
+  received &= FEM.cmd_cv.wait_for(lock, std::chrono::seconds(1), [&]{ return FEM.cmd_rcv >= FEM.cmd_sent || runControl->Aborted(); });
+  received &= FEM.cmd_rcv >= FEM.cmd_sent;
+  lock.unlock();
+
+  if(!received && !runControl->Aborted())std::cout<<"FEM "<<FEM.fecMetadata.id<<" timeout waiting for "<<cmds.size()<<" commands"<<std::endl;
+
+    for (const auto &cmd : cmds){
+      if(received)FEMConfig::Apply(cmd, FEM.registers);
+      else FEMConfig::Invalidate(cmd, FEM.registers);
+    }
+}
+
+bool TRESTDAQFEM::waitForCmd(FEMProxy &FEM, const char* cmd){
+
+  //The ARC replies are slower
+  const std::chrono::milliseconds timeout(dialect == FEMConfig::dialect::ARC ? 2000 : 1000);
+
+  //Wake up as soon as the reply is received by the receive thread
+  std::unique_lock<std::mutex> lock(FEM.mutex_socket);
+  //or as soon as the run is aborted, the receive thread wakes up the waiting commands
+  FEM.cmd_cv.wait_for(lock, timeout, [&]{ return FEM.cmd_rcv >= FEM.cmd_sent || runControl->Aborted(); });
+  const bool received = FEM.cmd_rcv >= FEM.cmd_sent;
+
+  if (verboseLevel >= TRestStringOutput::REST_Verbose_Level::REST_Debug)std::cout<<"Cmd sent "<<FEM.cmd_sent<<" Cmd Received: "<<FEM.cmd_rcv<<std::endl;
+  lock.unlock();
+
+  if(!received){
+    if(!runControl->Aborted())std::cout<<"Cmd timeout "<<cmd<<std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+std::string TRESTDAQFEM::SummaryCommand(int asic, const std::string &channel) const {
+  if(dialect == FEMConfig::dialect::ARC)return "hped " + std::to_string(asic) + " " + channel + " getsummary";
+  return "hped getsummary " + std::to_string(asic) + " " + channel;
+}
+
+//Store the pedestals and thresholds set by the FEM from the histogram summaries of the pedestal run
+void TRESTDAQFEM::SavePedestals(std::map<std::pair<int, int>, PedestalStore::pedSummary> &raw, std::map<std::pair<int, int>, PedestalStore::pedSummary> &subtracted){
+
+  const double now = getCurrentTime();
+
+    for (auto &FEM : FEMArray){
+      for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
+        if(!FEM.fecMetadata.asic_isActive[a])continue;
+        char cmd[200];
+        //Pedestals and thresholds were set by the FEM, the values computed here are not known to be the same
+        sprintf(cmd, "ped %d * 0", a);
+        FEMConfig::Invalidate(cmd, FEM.registers);
+        sprintf(cmd, "thr %d * 0", a);
+        FEMConfig::Invalidate(cmd, FEM.registers);
+
+        const auto &rawS = raw[{FEM.fecMetadata.id, a}];
+        const auto &subS = subtracted[{FEM.fecMetadata.id, a}];
+          if(rawS.empty() || subS.empty()){
+            std::cout<<"FEM "<<FEM.fecMetadata.id<<" ASIC "<<a<<" pedestal summary not decoded, not stored"<<std::endl;
+            continue;
+          }
+
+        auto entry = PedestalStore::Compute(FEM.fecMetadata, a, rawS, subS);
+        entry.timestamp = now;
+        entry.runNumber = restRun ? restRun->GetRunNumber() : 0;
+        PedestalStore::Save(PedestalStore::GetFileName(managerMetadata->GetPedestalDirectory(), FEM.fecMetadata, a), entry);
+      }
+    }
+}
+
+//Load the stored pedestals and thresholds in the FEMs if they are still valid
+void TRESTDAQFEM::ReloadPedestals(){
+
+  if(managerMetadata->GetPedestalValidity() <= 0)return;
+
+  const double now = getCurrentTime();
+
+    for (auto &FEM : FEMArray){
+      for(int a=0;a<TRestRawDAQMetadata::nAsics;a++){
+        if(!FEM.fecMetadata.asic_isActive[a])continue;
+        PedestalStore::asicPedestals entry;
+        const std::string fileName = PedestalStore::GetFileName(managerMetadata->GetPedestalDirectory(), FEM.fecMetadata, a);
+          if(!PedestalStore::Load(fileName, entry) || !PedestalStore::IsValid(entry, FEM.fecMetadata, a, now, managerMetadata->GetPedestalValidity()*3600.)){
+            std::cout<<"FEM "<<FEM.fecMetadata.id<<" ASIC "<<a<<" no valid pedestals stored, keeping the ones in the FEM"<<std::endl;
+            continue;
+          }
+
+        const auto cmds = PedestalStore::GetCommands(entry);
+          if(FEMConfig::IsApplied(cmds, FEM.registers)){
+            std::cout<<"FEM "<<FEM.fecMetadata.id<<" ASIC "<<a<<" pedestals from run "<<entry.runNumber<<" already loaded"<<std::endl;
+            continue;
+          }
+
+        SendCommands(cmds, FEM);
+        std::cout<<"FEM "<<FEM.fecMetadata.id<<" ASIC "<<a<<" pedestals reloaded from run "<<entry.runNumber<<" ("<<(now - entry.timestamp)/3600.<<" h old)"<<std::endl;
+      }
+    }
+}
+
+//Thresholds of the pedestals in the FEMs, set before the data is served and not modified once the event builder decodes the frames
+void TRESTDAQFEM::LoadZSThresholds(){
+  if(!zeroSuppression || !managerMetadata->UseZSStore())return;
+
+    for (auto &FEM : FEMArray)
+      zeroSuppression->LoadThresholds(managerMetadata->GetPedestalDirectory(), FEM.fecMetadata, FEM.registers);
+}
+
+//Poll the ring buffer of the FEMs till no pending requests are reported, the timeout is used if the reply cannot be decoded
+void TRESTDAQFEM::WaitForRingBuffer(std::chrono::milliseconds timeout){
+
+  const auto start = std::chrono::steady_clock::now();
+  bool ready = false;
+
+    while(!ready && !runControl->Aborted() && std::chrono::steady_clock::now() - start < timeout){
+      ready = true;
+        for (auto &FEM : FEMArray){
+            if(!SendCommand("rbf getpnd",FEM)){//The reply is the one of a previous command
+              ready = false;
+              continue;
+            }
+          std::unique_lock<std::mutex> lock(FEM.mutex_socket);
+          ready &= FEMReply::GetPendingRequests(FEM.reply) == 0;
+        }
+      if(!ready && runControl->WaitForAbort(std::chrono::milliseconds(250)))break;
+    }
+
+  ready &= FEMProxy::WaitForDrain(FEMArray, std::chrono::milliseconds(250), std::chrono::milliseconds(1000));
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  std::cout<<"Ring buffer "<<(ready ? "flushed" : "flush timeout")<<" after "<<elapsed.count()<<" ms"<<std::endl;
+}
+
+//Poll the pedestal histogram of one active channel per FEM till the number of entries stops increasing,
+//which happens once the event limit is reached. The timeout is used if the reply cannot be decoded
+void TRESTDAQFEM::WaitForPedestals(std::chrono::milliseconds timeout){
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<int> entries(FEMArray.size(), -1);
+  std::vector<int> stable(FEMArray.size(), 0);
+  bool ready = false;
+
+    while(!ready && !runControl->Aborted() && std::chrono::steady_clock::now() - start < timeout){
+      if(runControl->WaitForAbort(std::chrono::milliseconds(250)))break;
+      ready = true;
+        for (size_t i=0; i<FEMArray.size(); i++){
+          auto &FEM = FEMArray[i];
+          if(stable[i] >= 2)continue;
+          int a = 0, c = 0;
+          while(a < TRestRawDAQMetadata::nAsics-1 && !FEM.fecMetadata.asic_isActive[a])a++;
+          while(c < TRestRawDAQMetadata::nChannels-1 && !FEM.fecMetadata.asic_channelActive[a][c])c++;
+          int ent = -1;//No reply, not counted as stable
+            if(SendCommand(SummaryCommand(a, std::to_string(c)).c_str(),FEM)){
+              std::lock_guard<std::mutex> lock(FEM.mutex_socket);
+              ent = FEMReply::GetHistoEntries(FEM.reply);
+            }
+            if(ent > 0 && ent == entries[i]){
+              stable[i]++;
+            } else {
+              stable[i] = 0;
+            }
+          entries[i] = ent;
+          ready &= stable[i] >= 2;
+        }
+    }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  std::cout<<"Pedestal accumulation "<<(ready ? "completed" : "timeout")<<" after "<<elapsed.count()<<" ms"<<std::endl;
+}
@@ -0,0 +1,71 @@
+/*********************************************************************************
+TRESTDAQFEM.h
+
+Common part of the FEMINOS and ARC based readout: command exchange with the
+FEMs, configuration cache, pedestal store and ring buffer/pedestal polling.
+The backends implement the run sequences and the receive and event builder
+threads for their frame format
+
+*********************************************************************************/
+
+#ifndef __TREST_DAQ_FEM__
+#define __TREST_DAQ_FEM__
+
+#include "TRESTDAQ.h"
+#include "FEMProxy.h"
+#include "PedestalStore.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TRESTDAQFEM : public TRESTDAQ {
+  public:
+    TRESTDAQFEM(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc, FEMConfig::dialect d);
+
+    void configure() override;
+    void startDAQ(bool configure=true) override;
+    void stopDAQ() override;
+
+  protected:
+    virtual void pedestal() = 0;
+    virtual void dataTaking(bool configure=true) = 0;
+
+    //One FEMProxy per FEC of the metadata, loads the configuration cache
+    void OpenFEMs();
+    //Called by the destructor of the backends, the threads are still running when the run ends with an exception
+    void StopThreads();
+
+    void BroadcastCommand(const char* cmd, std::vector<FEMProxy> &FEMA, bool wait=true);
+    //false if the FEM doesn't acknowledge the command in time, FEM.reply is not valid then
+    bool SendCommand(const char* cmd, FEMProxy &FEM, bool wait=true);
+    void SendCommands(const std::vector<std::string> &cmds, FEMProxy &FEM);
+    bool waitForCmd(FEMProxy &FEM, const char* cmd);
+    //"hped getsummary" command for the channel (number or "*") of an ASIC
+    std::string SummaryCommand(int asic, const std::string &channel) const;
+
+    void SavePedestals(std::map<std::pair<int, int>, PedestalStore::pedSummary> &raw, std::map<std::pair<int, int>, PedestalStore::pedSummary> &subtracted);
+    void ReloadPedestals();
+    void LoadZSThresholds();
+    void WaitForRingBuffer(std::chrono::milliseconds timeout);
+    void WaitForPedestals(std::chrono::milliseconds timeout);
+    void LoadConfigCache();
+    void SaveConfigCache();
+
+    const FEMConfig::dialect dialect;
+
+    //Locks and condition variables of the FEMs of this DAQ
+    std::shared_ptr<FEMProxy::femSet> femLocks = std::make_shared<FEMProxy::femSet>();
+    std::vector<FEMProxy> FEMArray;
+
+    std::thread receiveThread, eventBuilderThread;
+    StopToken stopReceiver;
+    //The monitoring frames are the pedestal summaries of a pedestal run
+    std::atomic<bool> isPed{false};
+};
+
+#endif
@@ -12,39 +12,30 @@ Based on mclient program from Denis Calvet
 #ifndef __TREST_DAQ_FEMINOS__
 #define __TREST_DAQ_FEMINOS__
 
-#include "TRESTDAQ.h"
-#include "FEMProxy.h"
+#include "TRESTDAQFEM.h"
 
 #include <iostream>
 #include <thread>
 #include <memory>
 
-class TRESTDAQFEMINOS : public TRESTDAQ {
+class TRESTDAQFEMINOS : public TRESTDAQFEM {
   public:
-    TRESTDAQFEMINOS(TRestRun* rR, TRestRawDAQMetadata* dM);
+    TRESTDAQFEMINOS(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM = nullptr, DAQRunControl* rc = nullptr);
+    ~TRESTDAQFEMINOS();
 
-    void configure() override;
-    void startDAQ(bool configure=true) override;
-    void stopDAQ() override;
     void initialize() override;
     void startUp() override;
 
-    static void ReceiveThread(std::vector<FEMProxy> *FEMA);
-    static void ReceiveBuffer(FEMProxy &FEM);
-    static void EventBuilderThread(std::vector<FEMProxy> *FEMA, TRestRun *rR, TRestRawSignalEvent* sEvent);
-    static void waitForCmd(FEMProxy &FEM);
-    static std::atomic<bool> stopReceiver;
-    static std::atomic<bool> isPed;
+    //Also run by TRESTDAQReplay, the events are written by daq. Ends once stop is requested and the buffers are drained
+    static void EventBuilderThread(std::vector<FEMProxy> *FEMA, TRESTDAQ* daq, TRestRawSignalEvent* sEvent, const StopToken* stop, const std::atomic<bool>* isPed);
+    //Data frames starting and ending an event, TRESTDAQReplay only splits the run between events
+    static bool IsEventStart(const uint16_t* fr, size_t size);
+    static bool IsEventEnd(const uint16_t* fr, size_t size);
 
   private:
-    void pedestal();
-    void dataTaking(bool configure=true);
-    void BroadcastCommand(const char* cmd, std::vector<FEMProxy> &FEMA, bool wait=true);
-    void SendCommand(const char* cmd, FEMProxy &FEM, bool wait=true);
-
-    std::vector<FEMProxy> FEMArray;//Vector of FEMINOS
-
-    std::thread receiveThread, eventBuilderThread;
+    void ReceiveThread();
+    void pedestal() override;
+    void dataTaking(bool configure=true) override;
 
 };
 
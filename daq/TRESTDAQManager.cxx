@@ -9,6 +9,7 @@ Control data acquisition via shared memory, should be always running
 
 #include "TRESTDAQManager.h"
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -16,18 +17,32 @@ Control data acquisition via shared memory, should be always running
 #include "TRESTDAQDummy.h"
 #include "TRESTDAQFEMINOS.h"
 #include "TRESTDAQARC.h"
+#include "TRESTDAQReplay.h"
+#include "TRESTDAQMulti.h"
+#include "TRESTDAQBuilder.h"
+#include "FEMConfig.h"
+#include "PageAllocator.h"
+#include "ThreadPolicy.h"
 
 TRESTDAQManager::TRESTDAQManager() {
     int shmid;
     sharedMemoryStruct* sharedMemory;
+    std::cout << "Instance " << DAQInstance::Get() << ", shared memory key 0x" << std::hex
+              << DAQInstance::GetKey(DAQInstance::segment::CONTROL) << std::dec << std::endl;
     if (!GetSharedMemory(shmid, &sharedMemory, IPC_CREAT | 0666)) exit(1);
 
     InitializeSharedMemory(sharedMemory);
     PrintSharedMemory(sharedMemory);
     DetachSharedMemory(&sharedMemory);
+    TRESTDAQ::publishSocketCounters = PublishSocketCounters;
 }
 
 TRESTDAQManager::~TRESTDAQManager() {
+    runControl.eventRing.reset();
+    SharedEventRing::Remove();
+    runControl.monitor.reset();
+    DAQMonitor::Remove();
+
     int shmid;
     sharedMemoryStruct* sharedMemory;
     if (GetSharedMemory(shmid, &sharedMemory)) {
@@ -52,12 +67,19 @@ void TRESTDAQManager::startUp() {
     }
 
   TRestRawDAQMetadata daqMetadata(sM->cfgFile);
+  TRestDAQManagerMetadata managerMetadata(sM->cfgFile);
 
   sM->status = 2;
+  const std::string cfgFile = std::string(sM->cfgFile);
   DetachSharedMemory(&sM);
+  //The commands of the start up are not cancelled by the abort of the previous run
+  runControl.Reset();
 
     try{
-      auto daq = GetTRESTDAQ(nullptr,&daqMetadata);
+      auto backendMetadata = LoadBackends(cfgFile, managerMetadata, daqMetadata);
+      std::vector<TRestRawDAQMetadata*> backends;
+      for (auto& b : backendMetadata) backends.push_back(b.get());
+      auto daq = GetTRESTDAQ(nullptr,&daqMetadata,&managerMetadata,backends);
       if(daq){ 
         daq->startUp();
         daq->stopDAQ();
@@ -67,14 +89,38 @@ void TRESTDAQManager::startUp() {
     } catch (const std::exception& e) {
         std::cerr<<"std::exception was thrown: "<<e.what()<<std::endl;
     }
+  PageAllocator::Release();
+
+}
+
+std::unique_ptr<TRESTDAQ> TRESTDAQManager::GetTRESTDAQ (TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, const std::vector<TRestRawDAQMetadata*>& backends){
+
+    if (!backends.empty()) {
+      std::cout << backends.size() << " electronics backends, the events are merged" << std::endl;
+      return std::make_unique<TRESTDAQMulti>(rR, dM, mM, &runControl, backends, CreateDAQ, PublishBackendStats);
+    }
 
+  return CreateDAQ(rR, dM, mM, &runControl);
 }
 
-std::unique_ptr<TRESTDAQ> TRESTDAQManager::GetTRESTDAQ (TRestRun* rR, TRestRawDAQMetadata* dM){
+std::unique_ptr<TRESTDAQ> TRESTDAQManager::CreateDAQ (TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc){
 
   std::unique_ptr<TRESTDAQ> daq(nullptr);
 
   std::string electronicsType (dM->GetElectronicsType());
+
+    //Not an electronics type of TRestRawDAQMetadata, the electronics is taken from the archive
+    if (electronicsType == "REPLAY") {
+      daq = std::make_unique<TRESTDAQReplay>(rR, dM, mM, rc);
+      return daq;
+    }
+
+    //The events are received from the nodes of a distributed DAQ
+    if (electronicsType == "BUILDER") {
+      daq = std::make_unique<TRESTDAQBuilder>(rR, dM, mM, rc, PublishBackendStats);
+      return daq;
+    }
+
   auto eT = daq_metadata_types::electronicsTypes_map.find(electronicsType);
     if (eT == daq_metadata_types::electronicsTypes_map.end()) {
         std::cout << "Electronics type " << electronicsType << " not found, skipping " << std::endl;
@@ -84,13 +130,13 @@ std::unique_ptr<TRESTDAQ> TRESTDAQManager::GetTRESTDAQ (TRestRun* rR, TRestRawDA
     }
 
     if (eT->second == daq_metadata_types::electronicsTypes::DUMMY) {
-        daq = std::make_unique<TRESTDAQDummy>(rR, dM);
+        daq = std::make_unique<TRESTDAQDummy>(rR, dM, mM, rc);
     } else if (eT->second == daq_metadata_types::electronicsTypes::DCC) {
-        daq = std::make_unique<TRESTDAQDCC>(rR, dM);
+        daq = std::make_unique<TRESTDAQDCC>(rR, dM, mM, rc);
     } else if (eT->second == daq_metadata_types::electronicsTypes::FEMINOS) {
-        daq = std::make_unique<TRESTDAQFEMINOS>(rR, dM);
+        daq = std::make_unique<TRESTDAQFEMINOS>(rR, dM, mM, rc);
     } else if (eT->second == daq_metadata_types::electronicsTypes::ARC) {
-        daq = std::make_unique<TRESTDAQARC>(rR, dM);
+        daq = std::make_unique<TRESTDAQARC>(rR, dM, mM, rc);
     } else {
         std::cout << electronicsType << " not implemented, skipping..." << std::endl;
     }
@@ -111,6 +157,11 @@ void TRESTDAQManager::dataTaking() {
     }
 
     TRestRawDAQMetadata daqMetadata(sM->cfgFile);
+    TRestDAQManagerMetadata managerMetadata(sM->cfgFile);
+    if (managerMetadata.GetInstance() >= 0 && managerMetadata.GetInstance() != DAQInstance::Get())
+        std::cout << "Warning: " << sM->cfgFile << " is meant for instance " << managerMetadata.GetInstance() << ", acquiring with instance "
+                  << DAQInstance::Get() << std::endl;
+    ConfigureThreadPolicy(managerMetadata);
 
     auto rT = daq_metadata_types::acqTypes_map.find(sM->runType);
     if (rT != daq_metadata_types::acqTypes_map.end()) {
@@ -140,11 +191,18 @@ void TRESTDAQManager::dataTaking() {
     daqMetadata.PrintMetadata();
     maxFileSize = daqMetadata.GetMaxFileSize();
     const std::string cfgFile = std::string(sM->cfgFile);
+    auto backendMetadata = LoadBackends(cfgFile, managerMetadata, daqMetadata);
+    std::vector<TRestRawDAQMetadata*> backends;
+    for (auto& b : backendMetadata) backends.push_back(b.get());
+    sM->nBackends = 0;
+    sM->nFEMs = 0;
+    //Events of a previous run are not shown, the ring is created again when the DAQ is built
+    runControl.eventRing.reset();
+    SharedEventRing::Remove();
     sM->status = 1;
     DetachSharedMemory(&sM);
-    TRESTDAQ::abrt = false;
-    TRESTDAQ::event_cnt = 0;
-    std::thread abrtT(AbortThread);
+    runControl.Reset();
+    std::thread abrtT(AbortThread, &runControl);
     int parentRunNumber = 0;
     TRestDataBase *db = gDataBase;
     int runNumber = db->get_lastrun() + 1;
@@ -167,6 +225,8 @@ void TRESTDAQManager::dataTaking() {
 
       restRun.SetRunType(daqMetadata.GetAcquisitionType());
       restRun.AddMetadata(&daqMetadata);
+      restRun.AddMetadata(&managerMetadata);
+      for (auto b : backends) restRun.AddMetadata(b);
       restRun.SetParentRunNumber(parentRunNumber);
       restRun.FormOutputFile();
 
@@ -175,14 +235,14 @@ void TRESTDAQManager::dataTaking() {
       DetachSharedMemory(&sM);
       std::cout << "Run " << " " << restRun.GetOutputFileName() << std::endl;
 
-      TRESTDAQ::nextFile = false;
-      std::thread fileSizeT(FileSizeThread);
+      runControl.ClearNextFile();
+      std::thread fileSizeT(FileSizeThread, &runControl);
 
       restRun.SetStartTimeStamp(TRESTDAQ::getCurrentTime());
       restRun.PrintMetadata();
 
       try{
-        auto daq = GetTRESTDAQ(&restRun, &daqMetadata);
+        auto daq = GetTRESTDAQ(&restRun, &daqMetadata, &managerMetadata, backends);
           if(daq){
             if(parentRunNumber == 0){
               daq->configure();
@@ -190,6 +250,7 @@ void TRESTDAQManager::dataTaking() {
             }
             daq->startDAQ(parentRunNumber == 0);  // Should wait till completion or stopped
             daq->stopDAQ();
+            daq->SaveSoftwarePedestals();
           }
       } catch(const TRESTDAQException& e) {
         std::cerr<<"TRESTDAQException was thrown: "<<e.what()<<std::endl;
@@ -202,19 +263,36 @@ void TRESTDAQManager::dataTaking() {
       restRun.CloseFile();
       restRun.PrintMetadata();
 
-        if( (daqMetadata.GetNEvents() != 0 && TRESTDAQ::event_cnt >= daqMetadata.GetNEvents()) || daqMetadata.GetAcquisitionType() =="pedestal" ){
+        if( (daqMetadata.GetNEvents() != 0 && runControl.GetEvents() >= daqMetadata.GetNEvents()) || daqMetadata.GetAcquisitionType() =="pedestal" ||
+            ((daqMetadata.GetElectronicsType() == "REPLAY" || daqMetadata.GetElectronicsType() == "BUILDER") && !runControl.NextFile()) ||
+            runControl.Aborted() ){//e.g. the link to the event builder is broken
           StopRun();
         }
 
       fileSizeT.join();
       parentRunNumber++;
-    } while (!TRESTDAQ::abrt && TRESTDAQ::nextFile );
+    } while (!runControl.Aborted() && runControl.NextFile() );
 
     abrtT.join();
+    //The FEM buffers are kept for the files of the run
+    PageAllocator::Release();
+    //Last snapshot of the monitoring, kept in shared memory until the next run
+    runControl.monitor.reset();
     std::cout << "Data taking stopped " << std::endl;
 
 }
 
+void TRESTDAQManager::ConfigureThreadPolicy(const TRestDAQManagerMetadata& mM) {
+    ThreadPolicy::settings st;
+    st.cpus[(int)ThreadPolicy::stage::RECEIVE] = mM.GetReceiveCPUs();
+    st.cpus[(int)ThreadPolicy::stage::BUILDER] = mM.GetBuilderCPUs();
+    st.cpus[(int)ThreadPolicy::stage::WRITER] = mM.GetWriterCPUs();
+    st.cpus[(int)ThreadPolicy::stage::CONTROL] = mM.GetControlCPUs();
+    st.receivePriority = mM.GetReceivePriority();
+    st.lockMemory = mM.LockMemory();
+    ThreadPolicy::Configure(st);
+}
+
 void TRESTDAQManager::StopRun() {
     int shmid;
     sharedMemoryStruct* sharedMemory;
@@ -233,6 +311,46 @@ void TRESTDAQManager::ExitManager() {
     shmdt((sharedMemoryStruct*)sharedMemory);
 }
 
+void TRESTDAQManager::PrintConfigPlan(const std::string& cfgFile) {
+
+  TRestRawDAQMetadata daqMetadata(cfgFile.c_str());
+  TRestDAQManagerMetadata managerMetadata(cfgFile.c_str());
+
+  std::string electronicsType (daqMetadata.GetElectronicsType());
+  auto eT = daq_metadata_types::electronicsTypes_map.find(electronicsType);
+    if (eT == daq_metadata_types::electronicsTypes_map.end() || (eT->second != daq_metadata_types::electronicsTypes::FEMINOS &&
+        eT->second != daq_metadata_types::electronicsTypes::ARC)) {
+      std::cout << "Configuration plan only available for FEMINOS or ARC electronics, " << electronicsType << " found" << std::endl;
+      return;
+    }
+
+  const auto dialect = eT->second == daq_metadata_types::electronicsTypes::ARC ? FEMConfig::dialect::ARC : FEMConfig::dialect::FEMINOS;
+
+    for (const auto& fec : daqMetadata.GetFECs()) {
+      FEMConfig::registerMap registers;
+      if (managerMetadata.UseConfigCache())
+        FEMConfig::LoadCache(FEMConfig::GetCacheFile(managerMetadata.GetCacheDirectory(), fec), registers);
+
+      int sent = 0, skipped = 0;
+      std::cout << "FEM " << fec.id << " configuration plan" << std::endl;
+        for (const auto& block : FEMConfig::Compile(fec, dialect)) {
+          const bool applied = managerMetadata.UseConfigCache() && FEMConfig::IsApplied(block, registers);
+            for (const auto& cmd : block) std::cout << (applied ? "  [cached] " : "  ") << cmd << std::endl;
+            if (applied) skipped += block.size();
+            else sent += block.size();
+        }
+
+      std::cout << "FEM " << fec.id << ": " << sent << " commands to send, " << skipped << " already applied" << std::endl;
+        //The channel mask is only configured with the FEMINOS firmware
+        if (dialect == FEMConfig::dialect::FEMINOS) {
+          const int legacy = FEMConfig::LegacyChannelMaskSize(fec);
+          const int planned = FEMConfig::PlanChannelMask(fec).size();
+          std::cout << "Channel mask: " << planned << " commands instead of " << legacy << ", " << legacy - planned
+                    << " round trips saved" << std::endl;
+        }
+    }
+}
+
 void TRESTDAQManager::run() {
     int shmid;
     sharedMemoryStruct* sharedMemory;
@@ -261,7 +379,7 @@ void TRESTDAQManager::run() {
             sharedMemory->status = 0;
             sharedMemory->startDAQ = 0;
             std::cout << "DAQ stopped" << std::endl;
-            TRESTDAQ::event_cnt = 0;
+            runControl.SetEvents(0);
         }
 
         DetachSharedMemory(&sharedMemory);
@@ -270,7 +388,7 @@ void TRESTDAQManager::run() {
 }
 
 bool TRESTDAQManager::GetSharedMemory(int& sid, sharedMemoryStruct** sM, int flag, bool verbose) {
-    if ((sid = shmget(TRESTDAQManager::key, sizeof(sharedMemoryStruct), flag)) == -1) {
+    if ((sid = shmget(DAQInstance::GetKey(DAQInstance::segment::CONTROL), sizeof(sharedMemoryStruct), flag)) == -1) {
         if(verbose)std::cerr << "Error while creating shared memory (shmget) " << std::strerror(errno) << std::endl;
         return false;
     }
@@ -296,6 +414,12 @@ void TRESTDAQManager::PrintSharedMemory(sharedMemoryStruct* sM) {
     std::cout << "Number of events to acquire: " << sM->nEvents << std::endl;
     std::cout << "RunName: " << sM->runName << std::endl;
     std::cout << "Exit Manager: " << sM->exitManager << std::endl;
+    for (int i = 0; i < sM->nBackends && i < maxBackends; i++)
+        std::cout << "Backend " << sM->backends[i].name << ": " << sM->backends[i].events << " events built, " << sM->backends[i].merged
+                  << " merged, " << sM->backends[i].queued << " queued" << std::endl;
+    for (int i = 0; i < sM->nFEMs && i < maxFEMs; i++)
+        std::cout << "FEM " << sM->fems[i].id << ": " << sM->fems[i].datagrams << " datagrams received, " << sM->fems[i].kernelDrops
+                  << " dropped by the kernel, " << sM->fems[i].bufferDrops << " dropped with the buffer full" << std::endl;
 }
 
 void TRESTDAQManager::InitializeSharedMemory(sharedMemoryStruct* sM) {
@@ -310,6 +434,59 @@ void TRESTDAQManager::InitializeSharedMemory(sharedMemoryStruct* sM) {
     sM->nEvents = -1;
     sM->exitManager = 0;
     sM->abortRun = 0;
+    sM->nBackends = 0;
+    sM->nFEMs = 0;
+}
+
+//Per backend statistics of a TRESTDAQMulti, in the control block
+void TRESTDAQManager::PublishBackendStats(const std::vector<EventMerger::inputStats>& stats) {
+    int shmid;
+    sharedMemoryStruct* sharedMemory;
+    if (!GetSharedMemory(shmid, &sharedMemory, 0, false)) return;
+
+    sharedMemory->nBackends = std::min((int)stats.size(), maxBackends);
+      for (int i = 0; i < sharedMemory->nBackends; i++) {
+        snprintf(sharedMemory->backends[i].name, sizeof(sharedMemory->backends[i].name), "%s", stats[i].name.c_str());
+        sharedMemory->backends[i].events = stats[i].events;
+        sharedMemory->backends[i].merged = stats[i].merged;
+        sharedMemory->backends[i].queued = stats[i].queued;
+      }
+    DetachSharedMemory(&sharedMemory);
+}
+
+//Socket counters of the FEMs, in the control block. Updated by FEC id, the backends of a TRESTDAQMulti publish their own FEMs
+void TRESTDAQManager::PublishSocketCounters(const std::vector<TRESTDAQSocket::counters>& counters) {
+    int shmid;
+    sharedMemoryStruct* sharedMemory;
+    if (!GetSharedMemory(shmid, &sharedMemory, 0, false)) return;
+
+      for (const auto& c : counters) {
+        int i = 0;
+        while (i < sharedMemory->nFEMs && sharedMemory->fems[i].id != c.id) i++;
+        if (i == maxFEMs) break;
+        if (i == sharedMemory->nFEMs) sharedMemory->nFEMs++;
+        sharedMemory->fems[i].id = c.id;
+        sharedMemory->fems[i].datagrams = c.datagrams;
+        sharedMemory->fems[i].kernelDrops = c.kernelDrops;
+        sharedMemory->fems[i].bufferDrops = c.bufferDrops;
+      }
+    DetachSharedMemory(&sharedMemory);
+}
+
+//TRestRawDAQMetadata sections of the backends, with the acquisition type of the run. The number of events
+//is checked on the merged events, the backends are not limited
+std::vector<std::unique_ptr<TRestRawDAQMetadata> > TRESTDAQManager::LoadBackends(const std::string& cfgFile, TRestDAQManagerMetadata& mM, TRestRawDAQMetadata& dM) {
+
+    std::vector<std::unique_ptr<TRestRawDAQMetadata> > backends;
+      for (const auto& name : mM.GetBackends()) {
+        auto metadata = std::make_unique<TRestRawDAQMetadata>(cfgFile.c_str(), name);
+        metadata->SetAcquisitionType(dM.GetAcquisitionType());
+        metadata->SetNEvents(0);
+        std::cout << "Backend " << name << " electronics " << metadata->GetElectronicsType() << std::endl;
+        backends.push_back(std::move(metadata));
+      }
+
+    return backends;
 }
 
 int TRESTDAQManager::GetFileSize(const std::string &filename){
@@ -318,7 +495,8 @@ int TRESTDAQManager::GetFileSize(const std::string &filename){
   return rc == 0 ? stat_buf.st_size : -1;
 }
 
-void TRESTDAQManager::AbortThread() {
+void TRESTDAQManager::AbortThread(DAQRunControl* rc) {
+    ThreadPolicy::Apply(ThreadPolicy::stage::CONTROL, "daqAbort");
     int shmid;
     sharedMemoryStruct* sharedMemory;
 
@@ -326,16 +504,17 @@ void TRESTDAQManager::AbortThread() {
       do {
         if (!GetSharedMemory(shmid, &sharedMemory)) break;
         abortRun = sharedMemory->abortRun;
-        sharedMemory->eventCount = TRESTDAQ::event_cnt;
+        sharedMemory->eventCount = rc->GetEvents();
         DetachSharedMemory(&sharedMemory);
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
       } while (!abortRun);
 
-    TRESTDAQ::abrt = true;
+    rc->Abort();
 }
 
 
-void TRESTDAQManager::FileSizeThread() {
+void TRESTDAQManager::FileSizeThread(DAQRunControl* rc) {
+    ThreadPolicy::Apply(ThreadPolicy::stage::CONTROL, "daqFileSize");
     int shmid;
     sharedMemoryStruct* sharedMemory;
 
@@ -346,10 +525,9 @@ void TRESTDAQManager::FileSizeThread() {
         DetachSharedMemory(&sharedMemory);
           if(fileSize >= maxFileSize){
             std::cout << runN << " "<< fileSize << " "<<maxFileSize<< std::endl;
-            TRESTDAQ::nextFile = true;
+            rc->RequestNextFile();
           }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-      } while (!TRESTDAQ::abrt && !TRESTDAQ::nextFile);
+      } while (!rc->WaitForStop(std::chrono::milliseconds(50)));
 
 }
 
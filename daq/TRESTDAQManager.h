@@ -17,8 +17,11 @@ Control data acquisition via shared memory, should be always running
 #include <sys/stat.h>
 
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "DAQInstance.h"
 #include "TRESTDAQ.h"
 
 class TRESTDAQManager {
@@ -29,6 +32,22 @@ class TRESTDAQManager {
     void run();
 
     // Shared memory
+    static constexpr int maxBackends = 8;
+    struct backendStats {
+        char name[64];
+        int events;//Built by the backend
+        int merged;//Merged with the events of other backends
+        int queued;
+    };
+
+    static constexpr int maxFEMs = 64;
+    struct femStats {
+        int id;//FEC id
+        long long datagrams;//Received by the receive thread
+        long long kernelDrops;//Dropped by the kernel, socket receive buffer full
+        long long bufferDrops;//Data frames dropped by the receive thread, FEM buffer full
+    };
+
     struct sharedMemoryStruct {
         char cfgFile[1024];
         char runType[256];
@@ -41,30 +60,41 @@ class TRESTDAQManager {
         int nEvents;
         int exitManager;
         int abortRun;
+        int nBackends;//Only when several backends are acquiring
+        backendStats backends[maxBackends];
+        int nFEMs;//Socket counters of the FEMs of the current file
+        femStats fems[maxFEMs];
     };
 
     inline static int maxFileSize = 1000000000;
 
     void dataTaking();
     void startUp();
-    std::unique_ptr<TRESTDAQ> GetTRESTDAQ (TRestRun* rR, TRestRawDAQMetadata* dM);
+    std::unique_ptr<TRESTDAQ> GetTRESTDAQ (TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, const std::vector<TRestRawDAQMetadata*>& backends = {});
+    static std::unique_ptr<TRESTDAQ> CreateDAQ (TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc);
+    static std::vector<std::unique_ptr<TRestRawDAQMetadata> > LoadBackends(const std::string& cfgFile, TRestDAQManagerMetadata& mM, TRestRawDAQMetadata& dM);
+
+    //Abort, next file and event counter of the DAQ driven by this manager
+    DAQRunControl runControl;
 
     // Shared Memory
     static void InitializeSharedMemory(sharedMemoryStruct* sM);
     static void PrintSharedMemory(sharedMemoryStruct* sM);
     static bool GetSharedMemory(int& sid, sharedMemoryStruct** sM, int flag =0, bool verbose=true);
     static void DetachSharedMemory(sharedMemoryStruct** sM);
+    static void PublishBackendStats(const std::vector<EventMerger::inputStats>& stats);
+    static void PublishSocketCounters(const std::vector<TRESTDAQSocket::counters>& counters);
 
     static int GetFileSize(const std::string &filename);
+    //Placement, scheduling and memory locking of the threads of the run, see ThreadPolicy.h
+    static void ConfigureThreadPolicy(const TRestDAQManagerMetadata& mM);
 
     // Control commands
     static void StopRun();
     static void ExitManager();
-    static void AbortThread();
-    static void FileSizeThread();
-
-   private:
-    inline static const key_t key{0x12367};
+    static void AbortThread(DAQRunControl* rc);
+    static void FileSizeThread(DAQRunControl* rc);
+    static void PrintConfigPlan(const std::string& cfgFile);
 };
 
 #endif
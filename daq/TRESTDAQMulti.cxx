@@ -0,0 +1,140 @@
+/*********************************************************************************
+TRESTDAQMulti.cxx
+
+Several electronics backends acquiring in the same run, see TRESTDAQMulti.h
+
+*********************************************************************************/
+
+#include "TRESTDAQMulti.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <thread>
+
+TRESTDAQMulti::TRESTDAQMulti(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc,
+                             const std::vector<TRestRawDAQMetadata*>& backendMetadata, factory create, statsCallback stats) :
+  TRESTDAQ(rR, dM, mM, rc), stats(stats) {
+
+    if(rawArchive){
+      rawArchive.reset();
+      throw (TRESTDAQException("rawArchive is not supported with several backends, please check RML"));
+    }
+
+  std::map<int, std::string> fecIds;
+    for(auto metadata : backendMetadata){
+      const std::string type = metadata->GetElectronicsType().Data();
+        if(type == "REPLAY" || type == "BUILDER")throw (TRESTDAQException(type + " can't be used as a backend, please check RML"));
+        for(const auto &fec : metadata->GetFECs()){
+          auto [it, inserted] = fecIds.emplace(fec.id, metadata->GetName());
+          if(!inserted)std::cout << "Warning: FEC id " << fec.id << " used by backends " << it->second << " and " << metadata->GetName() << ", the signal ids are not unique" << std::endl;
+        }
+    }
+
+  EventMerger::settings st;
+  st.window = managerMetadata->GetMergeWindow();
+  st.timeout = managerMetadata->GetMergeTimeout();
+  st.queueSize = std::max(1, managerMetadata->GetMergeQueueSize());
+  eventMerger = std::make_unique<EventMerger>(st, [this](TRestRawSignalEvent* ev){ FillTree(ev); });
+
+    for(auto metadata : backendMetadata){
+      backend b;
+      b.name = metadata->GetName();
+      b.metadata = metadata;
+      b.runControl = std::make_unique<DAQRunControl>();
+      b.runControl->SetMerger(eventMerger.get());
+      eventMerger->AddInput(b.runControl.get(), b.name);
+      backends.push_back(std::move(b));
+    }
+
+  //Created once they are inputs of the merger, so they don't set up the writing stages
+  try {
+      for(auto &b : backends){
+        std::cout << "Backend " << b.name << ": " << b.metadata->GetElectronicsType() << std::endl;
+        b.daq = create(rR, b.metadata, managerMetadata, b.runControl.get());
+        if(!b.daq)throw (TRESTDAQException("Cannot create backend " + b.name + ", please check RML"));
+      }
+  } catch (...) {//The destructor is not called
+    backends.clear();
+    eventMerger.reset();
+    throw;
+  }
+}
+
+TRESTDAQMulti::~TRESTDAQMulti() {
+  backends.clear();
+  //The pending events are written before the filter and the file are closed
+  eventMerger.reset();
+}
+
+void TRESTDAQMulti::initialize() { }
+
+void TRESTDAQMulti::startUp() {
+  for(auto &b : backends)b.daq->startUp();
+}
+
+void TRESTDAQMulti::configure() {
+  for(auto &b : backends)b.daq->configure();
+}
+
+void TRESTDAQMulti::startDAQ(bool configure) {
+
+  if(!eventMerger)throw (TRESTDAQException("The backends are already stopped, a new DAQ is needed for every file"));
+
+  std::atomic<int> running(backends.size());
+  std::vector<std::exception_ptr> errors(backends.size());
+  std::vector<std::thread> threads;
+    for(size_t i=0; i<backends.size(); i++){
+      threads.emplace_back([&, i]{
+        try {
+          backends[i].daq->startDAQ(configure);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+        running--;
+      });
+    }
+
+  //In data taking runs the run is stopped once any backend stops, pedestal runs wait for all of them
+  const bool pedestalRun = acqType == daq_metadata_types::acqTypes::PEDESTAL;
+    while(running > 0){
+      PublishStats();
+      if(!runControl->Running(daqMetadata->GetNEvents()) || (!pedestalRun && running < (int)backends.size()))break;
+      runControl->WaitForStop(std::chrono::milliseconds(200));
+    }
+
+  for(auto &b : backends)b.runControl->Abort();
+  for(auto &t : threads)t.join();
+  PublishStats();
+
+  for(auto &e : errors)if(e)std::rethrow_exception(e);
+}
+
+void TRESTDAQMulti::stopDAQ() {
+
+  std::exception_ptr error;
+    for(auto &b : backends){
+      try {
+        b.daq->stopDAQ();
+      } catch (...) {
+        if(!error)error = std::current_exception();
+      }
+    }
+
+  //Events built once the backends are stopped
+    if(eventMerger){
+      eventMerger->Flush();
+      eventMerger->PrintSummary();
+      PublishStats();
+    }
+  //Nothing is written after the file is closed, the backends don't push any more events
+  for(auto &b : backends)b.runControl->SetMerger(nullptr);
+  eventMerger.reset();
+
+  if(error)std::rethrow_exception(error);
+}
+
+void TRESTDAQMulti::PublishStats() {
+  if(stats && eventMerger)stats(eventMerger->GetStats());
+}
@@ -0,0 +1,53 @@
+/*********************************************************************************
+TRESTDAQMulti.h
+
+Several electronics backends (e.g. ARC and FEMINOS crates) acquiring in the
+same run. Every backend is a TRESTDAQ with its own TRestRawDAQMetadata
+section, run control and receive and event builder threads, the built events
+are merged by time in EventMerger and written by its thread. Selected when
+the backends are listed in TRestDAQManagerMetadata
+
+*********************************************************************************/
+
+#ifndef __TREST_DAQ_MULTI__
+#define __TREST_DAQ_MULTI__
+
+#include "TRESTDAQ.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TRESTDAQMulti : public TRESTDAQ {
+  public:
+    typedef std::function<std::unique_ptr<TRESTDAQ>(TRestRun*, TRestRawDAQMetadata*, TRestDAQManagerMetadata*, DAQRunControl*)> factory;
+    typedef std::function<void(const std::vector<EventMerger::inputStats>&)> statsCallback;
+
+    TRESTDAQMulti(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc,
+                  const std::vector<TRestRawDAQMetadata*>& backendMetadata, factory create, statsCallback stats = nullptr);
+    ~TRESTDAQMulti();
+
+    void configure() override;
+    void startDAQ(bool configure=true) override;
+    void stopDAQ() override;
+    void initialize() override;
+    void startUp() override;
+
+  private:
+    struct backend {
+      std::string name;
+      TRestRawDAQMetadata* metadata;
+      std::unique_ptr<DAQRunControl> runControl;
+      std::unique_ptr<TRESTDAQ> daq;
+    };
+
+    void PublishStats();
+
+    //The backends push their events to it through their run control
+    std::unique_ptr<EventMerger> eventMerger;
+    std::vector<backend> backends;
+    statsCallback stats;
+};
+
+#endif
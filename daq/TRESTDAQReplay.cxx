@@ -0,0 +1,253 @@
+/*********************************************************************************
+TRESTDAQReplay.cxx
+
+Replay of raw archives through the decoders and event builders of the
+electronics that recorded them
+
+*********************************************************************************/
+
+#include "TRESTDAQReplay.h"
+#include "TRESTDAQFEMINOS.h"
+#include "TRESTDAQARC.h"
+#include "TRESTDAQDCC.h"
+
+#include <map>
+
+TRESTDAQReplay::TRESTDAQReplay(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM, DAQRunControl* rc) : TRESTDAQ(rR, dM, mM, rc) { initialize(); }
+
+void TRESTDAQReplay::initialize() {
+
+  const std::string fileName = managerMetadata->GetReplayFile();
+    if(fileName.empty()){
+      throw (TRESTDAQException("No replay file defined, please check replayFile in TRestDAQManagerMetadata"));
+    }
+
+  reader = std::make_unique<RawArchive::Reader>(fileName);
+    if(!reader->IsOpen()){
+      throw (TRESTDAQException("Cannot open replay file " + fileName));
+    }
+
+  electronics = reader->GetHeader().electronics;
+    if(electronics != "FEMINOS" && electronics != "ARC" && electronics != "DCC"){
+      throw (TRESTDAQException("Unsupported electronics " + electronics + " in replay file " + fileName));
+    }
+
+  //FEMs present in the archive, in increasing id
+  std::map<uint16_t, uint64_t> fems;
+  std::vector<RawArchive::Reader::frame> frames;
+    for(size_t c=0; c<reader->GetNumberOfChunks(); c++){
+      reader->GetFrames(c, frames);
+      for(const auto &f : frames)fems[f.fem]++;
+    }
+
+    for(const auto &[id, nFrames] : fems){
+      FEMProxy FEM(femLocks);
+      FEM.fecMetadata.id = id;
+      if(electronics != "DCC")FEM.AllocateBuffer(managerMetadata->GetFEMBufferSize(), managerMetadata->UseHugePages());
+      FEMArray.emplace_back(std::move(FEM));
+    }
+
+  auto &resume = runControl->replay;
+    if(resume.file != fileName){
+      resume.file = fileName;
+      resume.chunk = resume.frame = 0;
+    }
+
+  std::cout << "Replay of " << fileName << ": " << electronics << " run " << reader->GetHeader().runNumber << "." << reader->GetHeader().subRunNumber
+            << ", " << reader->GetNumberOfChunks() << " chunks from " << fems.size() << " FEMs" << std::endl;
+  if(resume.chunk > 0 || resume.frame > 0)std::cout << "Replay continues at chunk " << resume.chunk << " frame " << resume.frame << std::endl;
+}
+
+void TRESTDAQReplay::configure() {
+  const double speed = managerMetadata->GetReplaySpeed();
+    if(speed > 0)std::cout << "Replay paced at " << speed << " times the original rate" << std::endl;
+    else std::cout << "Replay as fast as possible" << std::endl;
+}
+
+void TRESTDAQReplay::startDAQ(bool configure) {
+
+  replayStart = std::chrono::steady_clock::now();
+
+    if(electronics == "DCC"){
+      ReplayDCC();
+    } else {
+      ReplayFEM();
+    }
+
+  replayEnd = std::chrono::steady_clock::now();
+}
+
+void TRESTDAQReplay::stopDAQ() {
+
+  const double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(replayEnd - replayStart).count() / 1E6;
+  std::cout << "Replay stopped: " << framesReplayed << " frames, " << runControl->GetEvents() << " events in " << elapsed << " s" << std::endl;
+    if(elapsed > 0){
+      std::cout << "Replay rate: " << framesReplayed / elapsed << " frames/s, " << bytesReplayed / elapsed / 1E6 << " MB/s, "
+                << runControl->GetEvents() / elapsed << " events/s" << std::endl;
+    }
+}
+
+//Wait till the original arrival time of the frame, scaled by the replay speed. Not waiting once the replay
+//has to stop, the frames till the end of the events already started are replayed as fast as possible
+void TRESTDAQReplay::Pace(double timestamp) {
+
+  const double speed = managerMetadata->GetReplaySpeed();
+  if(speed <= 0)return;
+
+  if(firstTimestamp < 0)firstTimestamp = timestamp;
+  const auto target = replayStart + std::chrono::microseconds((int64_t)((timestamp - firstTimestamp) / speed * 1E6));
+    while(std::chrono::steady_clock::now() < target && !StopReplay()){
+      //The event limit doesn't wake the wait, checked at least every 100 ms
+      runControl->WaitForStop(std::min<std::chrono::steady_clock::duration>(target - std::chrono::steady_clock::now(), std::chrono::milliseconds(100)));
+    }
+}
+
+//Only kept when the run continues in a new file, otherwise the next run starts from the beginning
+void TRESTDAQReplay::SetResumePoint(size_t chunk, size_t frame) {
+  auto &resume = runControl->replay;
+    if(runControl->NextFile() && !runControl->Aborted()){
+      resume.chunk = chunk;
+      resume.frame = frame;
+    } else {
+      resume.chunk = resume.frame = 0;
+    }
+}
+
+bool TRESTDAQReplay::StopReplay() {
+  return !runControl->Running(daqMetadata->GetNEvents());
+}
+
+//Frames are pushed to the FEM buffers as in the receive thread, the event builder thread is the one of the electronics.
+//The events of the FEMs are built in order, so the replay stops at the first frame of an event not started by any FEM
+//yet, after completing the events already started. The frames of a FEM before its first event are skipped, they
+//belong to the events completed in the previous file
+void TRESTDAQReplay::ReplayFEM() {
+
+  const bool isARC = electronics == "ARC";
+  auto isEventStart = isARC ? TRESTDAQARC::IsEventStart : TRESTDAQFEMINOS::IsEventStart;
+  auto isEventEnd = isARC ? TRESTDAQARC::IsEventEnd : TRESTDAQFEMINOS::IsEventEnd;
+
+  struct femState {
+    FEMProxy* FEM = nullptr;
+    uint64_t events = 0;//Started in this file
+    bool inEvent = false;
+  };
+  std::map<uint16_t, femState> femMap;
+  for(auto &FEM : FEMArray)femMap[FEM.fecMetadata.id].FEM = &FEM;
+
+  StopToken stopBuilder;
+  const std::atomic<bool> isPed(false);
+  std::thread eventBuilderThread( isARC ? TRESTDAQARC::EventBuilderThread : TRESTDAQFEMINOS::EventBuilderThread, &FEMArray, this, &fSignalEvent, &stopBuilder, &isPed);
+
+  std::vector<RawArchive::Reader::frame> frames;
+  uint64_t maxEvents = 0;
+  int inEvent = 0;//FEMs with an event not completed
+  bool stopping = false;//Only the started events are completed
+  size_t c = runControl->replay.chunk, i = runControl->replay.frame;
+  size_t stopChunk = 0, stopFrame = 0;
+    for(; c<reader->GetNumberOfChunks() && !(stopping && inEvent == 0) && !runControl->Aborted(); c++, i=0){
+      reader->GetFrames(c, frames);
+        for(; i<frames.size(); i++){
+          const auto &f = frames[i];
+          femState &st = femMap[f.fem];
+          FEMProxy &FEM = *st.FEM;
+          const uint16_t* data = (const uint16_t*)f.data;
+          const size_t size = f.size/sizeof(uint16_t);
+          const bool start = isEventStart(data, size);
+
+            if(start && !stopping && st.events >= maxEvents && StopReplay()){
+              stopping = true;
+              stopChunk = c;
+              stopFrame = i;
+            }
+
+            if(start && st.inEvent){//End of event lost
+              st.inEvent = false;
+              inEvent--;
+            }
+          if(stopping && inEvent == 0)break;
+          if(!st.inEvent && (!start || stopping))continue;
+
+          if(!stopping)Pace(f.timestamp);
+            if(size > FEM.buffer.capacity()){//Never fits, the replay can't continue
+              stopBuilder.Request();
+              femLocks->data_cv.notify_all();
+              eventBuilderThread.join();
+              throw (TRESTDAQException("Frame of " + std::to_string(f.size) + " bytes of FEM " + std::to_string(f.fem) + " in chunk " + std::to_string(c) +
+                                       " exceeds the FEM buffer capacity of " + std::to_string(FEM.buffer.capacity()*sizeof(uint16_t)) + " bytes, please increase femBufferSize"));
+            }
+          std::unique_lock<std::mutex> lock_mem(FEM.mutex_mem);
+            //The buffer keeps the memory bounded when replaying faster than the builder
+            while(!FEM.buffer.push_back(data, data + size)){
+              if(runControl->Aborted())break;
+              lock_mem.unlock();
+              std::this_thread::sleep_for(std::chrono::milliseconds(1));
+              lock_mem.lock();
+            }
+          if(runControl->Aborted())break;
+          FEM.lastData = std::chrono::steady_clock::now();
+          lock_mem.unlock();
+          femLocks->data_cv.notify_all();
+          framesReplayed++;
+          bytesReplayed += f.size;
+
+            if(start){
+              st.inEvent = true;
+              inEvent++;
+              st.events++;
+              maxEvents = std::max(maxEvents, st.events);
+            }
+            if(st.inEvent && isEventEnd(data, size)){
+              st.inEvent = false;
+              inEvent--;
+            }
+        }
+    }
+
+  if(stopping)SetResumePoint(stopChunk, stopFrame);
+  else SetResumePoint(c, i);
+
+  //The builder stops once the buffers are drained
+  stopBuilder.Request();
+  femLocks->data_cv.notify_all();
+  eventBuilderThread.join();
+}
+
+//DCC frames are decoded as in TRESTDAQDCC::dataTaking, the events are delimited by the FEM event counter
+//and the replay only stops at the first frame of an event
+void TRESTDAQReplay::ReplayDCC() {
+
+  std::vector<RawArchive::Reader::frame> frames;
+  bool stop = false;
+  int ecnt = -1;
+
+  size_t c = runControl->replay.chunk, i = runControl->replay.frame;
+
+  fSignalEvent.Initialize();
+
+    for(; c<reader->GetNumberOfChunks(); c++, i=0){
+      reader->GetFrames(c, frames);
+        for(; i<frames.size(); i++){
+          const auto &f = frames[i];
+          if((stop = runControl->Aborted()))break;
+          unsigned char* buf = (unsigned char*)f.data;//Not modified by the decoder
+          DCCPacket::DataPacket* dp = (DCCPacket::DataPacket*)buf;
+            if( GET_TYPE(ntohs(dp->hdr) ) == RESP_TYPE_ADC_DATA && ntohs(dp->ecnt) != ecnt){
+              if(fSignalEvent.GetNumberOfSignals() >0 )FillTree(&fSignalEvent);
+              if((stop = StopReplay()))break;
+              ecnt = ntohs(dp->ecnt);
+              fSignalEvent.Initialize();
+              fSignalEvent.SetID(runControl->GetEvents());
+              fSignalEvent.SetTime(f.timestamp);
+            }
+          Pace(f.timestamp);
+          TRESTDAQDCC::saveEvent(buf, f.size, &fSignalEvent, zeroSuppression.get(), verboseLevel);
+          framesReplayed++;
+          bytesReplayed += f.size;
+        }
+      if(stop)break;//Keep the position of the first frame of the event
+    }
+
+  if(!stop && fSignalEvent.GetNumberOfSignals() >0 )FillTree(&fSignalEvent);
+  SetResumePoint(c, i);
+}
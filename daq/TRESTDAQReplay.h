@@ -0,0 +1,52 @@
+/*********************************************************************************
+TRESTDAQReplay.h
+
+Replay of raw archives (see RawArchive.h) through the decoders and event
+builders of the electronics that recorded them, the frames are fed to the
+same pipeline used in data taking runs instead of being received from the
+network. Selected with electronicsType REPLAY, the archive is set in
+TRestDAQManagerMetadata. When the run is split in several files the replay
+only stops between events, and the next file continues from that event
+
+*********************************************************************************/
+
+#ifndef __TREST_DAQ_REPLAY__
+#define __TREST_DAQ_REPLAY__
+
+#include "TRESTDAQ.h"
+#include "FEMProxy.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+class TRESTDAQReplay : public TRESTDAQ {
+  public:
+    TRESTDAQReplay(TRestRun* rR, TRestRawDAQMetadata* dM, TRestDAQManagerMetadata* mM = nullptr, DAQRunControl* rc = nullptr);
+
+    void configure() override;
+    void startDAQ(bool configure=true) override;
+    void stopDAQ() override;
+    void initialize() override;
+
+  private:
+    void ReplayFEM();
+    void ReplayDCC();
+    void Pace(double timestamp);
+    bool StopReplay();
+    //The replay continues from the start of this event in the next file of the run, kept in the run control
+    void SetResumePoint(size_t chunk, size_t frame);
+
+    std::unique_ptr<RawArchive::Reader> reader;
+    std::string electronics;
+    std::shared_ptr<FEMProxy::femSet> femLocks = std::make_shared<FEMProxy::femSet>();
+    std::vector<FEMProxy> FEMArray;//One per FEM found in the archive, only the buffers are used
+
+    double firstTimestamp = -1;
+    std::chrono::steady_clock::time_point replayStart;
+    std::chrono::steady_clock::time_point replayEnd;
+    uint64_t framesReplayed = 0;
+    uint64_t bytesReplayed = 0;
+};
+
+#endif
@@ -1,7 +1,16 @@
 
 #include <TRESTDAQSocket.h>
 
-void TRESTDAQSocket::Open(int* rem_ip_base,int rpt) {
+#include <cstring>
+
+#ifndef SO_RCVBUFFORCE
+#define SO_RCVBUFFORCE 33
+#endif
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+void TRESTDAQSocket::Open(int* rem_ip_base,int rpt, const settings& st) {
 
     // Initialize socket
     if ( (client = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP) ) == -1) {
@@ -9,17 +18,29 @@ void TRESTDAQSocket::Open(int* rem_ip_base,int rpt) {
         throw (TRESTDAQException(error));
     }
 
-    // Set socket in non-blocking mode
-    int nb = 1;
-    if (ioctl(client, FIONBIO, &nb) != 0) {
-        std::string error ="ioctl socket failed: " + std::string(strerror(errno));
-        throw (TRESTDAQException(error));
+    if (st.receiveTimeout > 0) {
+      // Blocking mode with timeout, the thread sleeps in the kernel while it waits for the replies
+      struct timeval tv;
+      tv.tv_sec = st.receiveTimeout / 1000;
+      tv.tv_usec = (st.receiveTimeout % 1000) * 1000;
+        if (setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) {
+          std::string error ="setsockopt SO_RCVTIMEO failed: " + std::string(strerror(errno));
+          throw (TRESTDAQException(error));
+        }
+    } else {
+      // Set socket in non-blocking mode
+      int nb = 1;
+        if (ioctl(client, FIONBIO, &nb) != 0) {
+          std::string error ="ioctl socket failed: " + std::string(strerror(errno));
+          throw (TRESTDAQException(error));
+        }
     }
 
     socklen_t optlen = sizeof(int);
-    int rcvsz_req = 200 * 1024;
-    // Set receive socket size
-    if (setsockopt(client, SOL_SOCKET, SO_RCVBUF, &rcvsz_req, optlen) != 0) {
+    int rcvsz_req = st.receiveBuffer;
+    // Set receive socket size, SO_RCVBUFFORCE fails without CAP_NET_ADMIN and SO_RCVBUF is capped to net.core.rmem_max
+    const bool forced = st.force && setsockopt(client, SOL_SOCKET, SO_RCVBUFFORCE, &rcvsz_req, optlen) == 0;
+    if (!forced && setsockopt(client, SOL_SOCKET, SO_RCVBUF, &rcvsz_req, optlen) != 0) {
         std::string error ="setsockopt failed: " + std::string(strerror(errno));
         throw (TRESTDAQException(error));
     }
@@ -41,12 +62,21 @@ void TRESTDAQSocket::Open(int* rem_ip_base,int rpt) {
       throw (TRESTDAQException(error));
     }
 
-    // Check receive socket size
+    // Check receive socket size, the kernel reports twice the size requested
     if (rcvsz_done < rcvsz_req) {
         std::cout << "Warning in socket: recv buffer size set to " << rcvsz_done << " bytes while " << rcvsz_req
-                  << " bytes were requested. Data losses may occur" << std::endl;
+                  << " bytes were requested. Data losses may occur, raise net.core.rmem_max or run with CAP_NET_ADMIN" << std::endl;
     }
 
+    // Count of the datagrams dropped by the kernel in the ancillary data of every datagram
+    int on = 1;
+    if (st.dropCount && setsockopt(client, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) != 0) {
+        std::cout << "Warning in socket: kernel drops can't be counted (SO_RXQ_OVFL): " << strerror(errno) << std::endl;
+    }
+    datagrams = 0;
+    kernelDrops = 0;
+    lastDrops = 0;
+
     // Init target address
     rem_port = rpt;
     target.sin_family = PF_INET;
@@ -59,6 +89,42 @@ void TRESTDAQSocket::Open(int* rem_ip_base,int rpt) {
     remote_size = sizeof(remote);
 }
 
+ssize_t TRESTDAQSocket::Receive(void* buf, size_t len) {
+
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    union {
+        char buf[CMSG_SPACE(sizeof(uint32_t))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &remote;
+    msg.msg_namelen = sizeof(remote);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    const ssize_t length = recvmsg(client, &msg, 0);
+    if (length < 0) return length;
+    remote_size = msg.msg_namelen;
+    datagrams++;
+
+    // Only present once the kernel has dropped datagrams, the difference also covers the wrap around
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL) continue;
+        uint32_t drops;
+        memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+        kernelDrops += (uint32_t)(drops - lastDrops);
+        lastDrops = drops;
+    }
+
+    return length;
+}
+
 void TRESTDAQSocket::Close() {
     close(client);
     client = 0;
@@ -69,5 +135,8 @@ void TRESTDAQSocket::Clear() {
     rem_port = 0;
     remote_size = 0;
     target_adr = (unsigned char*)0;
+    datagrams = 0;
+    kernelDrops = 0;
+    lastDrops = 0;
 }
 
@@ -8,6 +8,7 @@
 #include <arpa/inet.h>
 #include <iostream>
 #include <cerrno>
+#include <cstdint>
 #include <mutex>
 
 #include "TRESTDAQException.h"
@@ -25,9 +26,31 @@ class TRESTDAQSocket {
     unsigned int remote_size;
     int rem_port;
 
+    struct settings {
+      int receiveBuffer = 200 * 1024;//Bytes
+      bool force = false;//SO_RCVBUFFORCE beyond net.core.rmem_max, needs CAP_NET_ADMIN, SO_RCVBUF otherwise
+      bool dropCount = false;//Datagrams dropped by the kernel reported with every datagram (SO_RXQ_OVFL)
+      int receiveTimeout = 0;//ms, 0 non-blocking socket, otherwise Receive blocks till a datagram arrives or the timeout expires (SO_RCVTIMEO)
+    };
+
+    struct counters {
+      int id = 0;//FEC id
+      uint64_t datagrams = 0;//Received since the socket was opened
+      uint64_t kernelDrops = 0;//Dropped by the kernel when the receive buffer was full, known with the next datagram received
+      uint64_t bufferDrops = 0;//Data frames dropped by the receive thread when the FEM buffer was full, see FEMProxy
+    };
+
     void Close();
     void Clear();
-    void Open(int* rem_ip_base, int rpt);
+    void Open(int* rem_ip_base, int rpt, const settings& st);
+    //recvfrom replacement, keeps the counters up to date. Not thread safe
+    ssize_t Receive(void* buf, size_t len);
+    inline counters GetCounters(int id) const { return counters{id, datagrams, kernelDrops, 0}; }
+
+   private:
+    uint64_t datagrams = 0;
+    uint64_t kernelDrops = 0;
+    uint32_t lastDrops = 0;//Last SO_RXQ_OVFL value, a 32 bit counter of the socket
 };
 
 #endif
@@ -0,0 +1,338 @@
+/*************************************************************************
+ * This file is part of the REST software framework.                     *
+ *                                                                       *
+ * Copyright (C) 2016 GIFNA/TREX (University of Zaragoza)                *
+ * For more information see https://gifna.unizar.es/trex                 *
+ *                                                                       *
+ * REST is free software: you can redistribute it and/or modify          *
+ * it under the terms of the GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3 of the License, or     *
+ * (at your option) any later version.                                   *
+ *                                                                       *
+ * REST is distributed in the hope that it will be useful,               *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          *
+ * GNU General Public License for more details.                          *
+ *                                                                       *
+ * You should have a copy of the GNU General Public License along with   *
+ * REST in $REST_PATH/LICENSE.                                           *
+ * If not, see https://www.gnu.org/licenses/.                            *
+ * For the list of contributors see $REST_PATH/CREDITS.                  *
+ *************************************************************************/
+
+/////////////////////////////////////////////////////////////////////////
+/// TRestDAQManagerMetadata holds the settings of restDAQManager which
+/// are not related to the electronics itself (these are defined in
+/// TRestRawDAQMetadata). The section is optional, if it is not present
+/// in the config file the default values are used.
+///
+/// ### Parameters
+/// * **instance**: Instance of restDAQManager acquiring with this config
+/// file, several managers (e.g. one per detector) can run on the same
+/// machine with different shared memory keys, see DAQInstance.h. It selects
+/// the instance of `restDAQManager --c` if `--i` is not given, a manager of
+/// another instance warns about it. Any instance (-1) by default.
+/// * **receiveCPUs**, **builderCPUs**, **writerCPUs**, **controlCPUs**:
+/// CPUs where the threads of every stage of the data path run, as a list
+/// of CPUs and ranges, e.g. `2-3,6`, see ThreadPolicy.h. The receive stage
+/// covers the receive threads of FEMINOS and ARC, the acquisition loop of
+/// the DCC and the links of the event builder, the builder stage the event
+/// builders and DUMMY generators, the writer stage the merger, event filter,
+/// raw archive and event sender threads and the control stage the abort,
+/// file size and monitoring threads. Keeping the receive threads apart from
+/// the others (and from the CPUs of the network interrupts) reduces the
+/// receive jitter. Empty (default) keeps the CPUs of the manager.
+/// * **receivePriority**: The receive threads run with the SCHED_FIFO real
+/// time scheduling at this priority (1-99), so they are not delayed by other
+/// processes when the machine is loaded. It needs CAP_SYS_NICE or an rtprio
+/// limit of the user. 0 (default) keeps the default scheduling.
+/// * **lockMemory**: The memory of the manager is locked (mlockall) and the
+/// shared memory rings are pre-faulted, so the data path doesn't wait for
+/// page faults or swapping. It needs CAP_IPC_LOCK or a large enough memlock
+/// limit. False by default. The CPUs and scheduling granted to the threads
+/// are printed when they start, a run goes on without what is not granted.
+/// * **femBufferSize**: Size in MB of the buffer where the receive thread
+/// leaves the frames of every FEMINOS or ARC FEM for the event builder, see
+/// FrameRing.h. The receive thread never waits for the builder, the frames
+/// that don't fit are dropped and counted with the socket counters, several
+/// hundred MB per FEM absorb long bursts. 64 by default.
+/// * **hugePages**: The FEM buffers are allocated on 2 MB huge pages, reserved
+/// in `/proc/sys/vm/nr_hugepages` or transparent, with a fallback to normal
+/// pages, see PageAllocator.h. True by default.
+/// * **socketBufferSize**: Size in kB of the socket receive buffer of every
+/// FEMINOS, ARC or DCC FEM, where the datagrams wait for the receive thread.
+/// The datagrams that don't fit are dropped by the kernel. 8192 by default.
+/// * **femSocketBuffers**: Receive buffer of some FEMs, as `id:kB` comma
+/// separated, e.g. `2:32768,5:16384`, the others use `socketBufferSize`.
+/// * **socketBufferForce**: The buffers are set with `SO_RCVBUFFORCE`, beyond
+/// `net.core.rmem_max`, when restDAQManager runs as root or with
+/// CAP_NET_ADMIN. Otherwise they are capped to `net.core.rmem_max` and a
+/// warning is printed. True by default.
+/// * **socketDropCount**: The datagrams dropped by the kernel are counted
+/// with `SO_RXQ_OVFL` on every FEM socket. The datagrams received and dropped
+/// per FEM are published in the control block during the run and stored in
+/// this metadata for every file. True by default.
+/// * **configCache**: Keep track of the register values written to the
+/// FEMs and send only the differences when the electronics is configured.
+/// The cache is cleared on start up or if a command doesn't get reply.
+/// False by default.
+/// * **cacheDirectory**: Directory where the local caches are stored,
+/// by default `$HOME/.rest/daq`.
+/// * **softwarePedestals**: The acquired events are not written, instead the
+/// mean and RMS of every channel are accumulated and a single pedestal event
+/// is stored at the end of the run, with the same layout than the pedestal
+/// events from the electronics. Ignored on `pedestal` acquisition type, should
+/// be used with `allchannels` compress mode and without pedestal subtraction.
+/// * **pedestalValidity**: The pedestals and thresholds derived in `pedestal`
+/// runs (FEMINOS and ARC) are stored under `cacheDirectory/pedestals`, data
+/// taking runs reload them in the FEMs if they are not older than this value
+/// in hours and the gain, shaping time, clock divider, pedestal center and
+/// threshold are unchanged. 0 (default) disables the reload.
+/// * **softwareZeroSuppression**: The decoded signals are zero suppressed
+/// in the host before they are added to the event, intended for
+/// `allchannels` compress mode (the DCC doesn't support the zero suppression
+/// parameters of the FEMs). The samples over threshold are kept together
+/// with `zsPrePost` time bins around them, the others are set to 0 and the
+/// channels without samples over threshold are dropped. Not applied on
+/// `pedestal` runs nor with `softwarePedestals`.
+/// * **zsThreshold**: Threshold in sigmas of the baseline of every signal,
+/// used for the channels without stored threshold, 4 by default.
+/// * **zsBaseLineRange**: Time bins where the baseline and its sigma are
+/// computed, (5,55) by default.
+/// * **zsPrePost**: Time bins kept before and after the samples over
+/// threshold, (8,4) by default as the FEM zero suppression.
+/// * **zsUseStore**: The FEMINOS and ARC channels use the thresholds derived
+/// in the last `pedestal` run with the same settings, only if its pedestals
+/// were reloaded in the FEM (see `pedestalValidity`), e.g. not after a power
+/// cycle; the baseline is used otherwise. The next files of a run need
+/// `configCache` to know the pedestals in the FEM. True by default.
+/// * **packedEvents**: The events are written to the `TRestRawPackedEventBranch`
+/// of the output file instead of the `TRestRawSignalEventBranch`, only the
+/// non zero samples are stored, packed in 12 bits or delta encoded (see
+/// TRestRawPackedEvent). Intended for zero suppressed data, from the FEMs
+/// or with `softwareZeroSuppression`. False by default.
+/// * **backends**: Names of several `TRestRawDAQMetadata` sections of the
+/// config file, comma separated, e.g. `arcCrate,feminosCrate`. Every section
+/// is an electronics backend with its own FECs, receive and event builder
+/// threads, acquiring in the same run. The built events are merged by time
+/// and written by a single thread, the first (unnamed) `TRestRawDAQMetadata`
+/// section sets the acquisition type, number of events and file size of the
+/// run. The sections are stored in the output file and the events built and
+/// merged by every backend are published in the control block. The event
+/// times of all the backends have to share the same clock and the FEC ids
+/// have to be unique. `rawArchive` can't be used. Empty by default (single
+/// electronics).
+/// * **mergeWindow**: Maximum time difference in seconds between the events
+/// of different backends merged in the same event, 1E-5 by default.
+/// * **mergeTimeout**: Seconds a built event waits for the events of the
+/// other backends, so an idle backend doesn't stop the others, 1 by default.
+/// * **mergeQueueSize**: Built events queued per backend, its event builder
+/// waits when the queue is full, 256 by default.
+/// * **builderAddress**: Event builder of a distributed DAQ, as `host:port`.
+/// The events built by this node are sent to the builder (packed as in
+/// `packedEvents`) instead of being written, the output file only keeps the
+/// metadata. The builder is a restDAQManager with `electronicsType` `BUILDER`,
+/// it merges the events of all the nodes with the same event counter within
+/// `mergeWindow` and writes them, so the FEMs of all the nodes have to share
+/// the trigger and the clock. Empty by default (the events are written).
+/// * **builderPort**: Port where the event builder waits for the nodes, 7070
+/// by default.
+/// * **builderNodes**: Number of nodes the event builder waits for before
+/// the run is started, 1 by default.
+/// * **builderCredits**: Events sent by a node and not yet queued by the
+/// builder, the node waits for the builder beyond it, 64 by default.
+/// * **rawArchive**: The data frames are written as received from the
+/// electronics (FEMINOS, ARC and DCC) to a binary archive next to the
+/// output file (same name with `.daq` extension) and the events are not
+/// built. The archive is made of chunks with an index of the frames per FEM,
+/// see RawArchive.h. The number of events is only checked for DCC, in any
+/// case a new archive is started when `maxFileSize` is reached.
+/// * **archiveChunkSize**: Size of the raw archive chunks in MB, 4 by default.
+/// * **replayFile**: Raw archive to be replayed when the `electronicsType` of
+/// TRestRawDAQMetadata is `REPLAY`. The frames go through the decoders and
+/// event builders of the electronics that recorded the archive and the events
+/// are written as in a data taking run.
+/// * **replaySpeed**: Replay rate relative to the original arrival time of
+/// the frames (1 reproduces the original timing), 0 (default) replays as fast
+/// as possible.
+/// * **dummyRate**: Event rate of the `DUMMY` electronics in Hz, 50 by
+/// default, 0 generates the events as fast as they can be written.
+/// * **dummyChannels**: Number of signals per event of the `DUMMY`
+/// electronics, 10 by default.
+/// * **dummySamples**: Number of time bins of the `DUMMY` signals, 512 by
+/// default.
+/// * **dummyNoise**: RMS in ADC units of the gaussian noise added on top of
+/// the baseline of the `DUMMY` signals, 0 (default) for a flat baseline.
+/// * **dummyThreads**: Number of threads generating the `DUMMY` events, the
+/// events are written by the acquisition thread.
+/// * **dummyBankSize**: Number of pulse shapes precomputed from the reference
+/// pulse with different amplitudes and peaking times, the `DUMMY` signals are
+/// drawn from this bank.
+/// * **eventRingSlots**: Number of built events kept in a shared memory ring,
+/// where they are read by the GUI while the run is ongoing, 32 by default.
+/// The output file is not read by the GUI and the periodic `AutoSave` of the
+/// event tree is only done when the ring is disabled (0).
+/// * **eventRingSlotSize**: Maximum size of an event in the ring in kB, the
+/// signals that don't fit are not published, 1024 by default.
+/// * **eventRingPrescale**: Only one of every N events is published in the
+/// ring, 1 (default) publishes all of them.
+/// * **monitorInterval**: The built events are analyzed in restDAQManager
+/// and accumulated in the online monitoring histograms (event amplitude
+/// spectrum, hits and mean amplitude per channel, rates), a snapshot is
+/// published in shared memory every `monitorInterval` seconds (1 by default)
+/// and drawn by the GUI. 0 disables the monitoring.
+/// * **monitorBaseLineRange**: Time bins where the baseline and its sigma
+/// are computed, (5,55) by default.
+/// * **monitorSignalThreshold**: Minimum amplitude above the baseline of a
+/// signal in sigmas of the baseline, 2 by default.
+/// * **monitorBins**: Number of bins of the spectrum, 1000 by default.
+/// * **monitorSpectrumMax**: Maximum event amplitude of the spectrum, 100000
+/// by default.
+/// * **monitorChannels**: Size of the per channel histograms, the signals
+/// with a larger id are only counted, 65536 by default.
+/// * **eventFilter**: Online software trigger, the built events are
+/// evaluated with the cuts below and only the accepted ones are written
+/// (and monitored and published in the ring). The number of evaluated and
+/// written events of every file is stored in this metadata, `nEvents` of
+/// the run counts the evaluated events. Not applied on
+/// `pedestal` runs nor with `softwarePedestals` or `rawArchive`. False by
+/// default.
+/// * **filterThreads**: Number of threads evaluating the cuts, the accepted
+/// events are written in the order they were built by a dedicated thread.
+/// 0 (default) evaluates and writes them in the acquisition thread.
+/// * **filterBaseLineRange**: Time bins where the baseline and its sigma
+/// are computed, (5,55) by default.
+/// * **filterSignalThreshold**: Minimum amplitude above the baseline of a
+/// signal in sigmas of the baseline, 3 by default.
+/// * **filterMultiplicity**: Minimum and maximum number of signals over
+/// threshold, (1,0) by default, a maximum of 0 means no limit.
+/// * **filterAmplitude**: Minimum and maximum summed amplitude of the
+/// signals over threshold, (0,0) by default, a maximum of 0 means no limit.
+/// * **filterChannels**: At least one signal over threshold is required in
+/// these channel ranges, e.g. `0-71,288-359`, empty (default) for any.
+/// * **filterMinTimeDiff**: Minimum time in seconds since the previous
+/// built event, 0 by default.
+/// * **filterPrescale**: Only one of every N accepted events is written, 1
+/// by default.
+///
+/// ### Examples
+/// \code
+///  <TRestManager>
+///    <TRestDAQManagerMetadata name="DAQManager" title="DAQ Manager settings" verboseLevel="info">
+///        <parameter name="instance" value="1"/>
+///        <parameter name="receiveCPUs" value="2"/>
+///        <parameter name="builderCPUs" value="3"/>
+///        <parameter name="receivePriority" value="80"/>
+///        <parameter name="lockMemory" value="true"/>
+///        <parameter name="femBufferSize" value="256"/>
+///        <parameter name="socketBufferSize" value="16384"/>
+///        <parameter name="femSocketBuffers" value="2:32768"/>
+///        <parameter name="configCache" value="true"/>
+///        <parameter name="cacheDirectory" value="/data/daq/cache"/>
+///        <parameter name="softwarePedestals" value="false"/>
+///        <parameter name="pedestalValidity" value="24"/>
+///        <parameter name="softwareZeroSuppression" value="false"/>
+///        <parameter name="zsPrePost" value="(8,4)"/>
+///        <parameter name="rawArchive" value="false"/>
+///        <parameter name="backends" value="arcCrate,feminosCrate"/>
+///        <parameter name="mergeWindow" value="1E-5"/>
+///        <parameter name="eventFilter" value="true"/>
+///        <parameter name="filterThreads" value="2"/>
+///        <parameter name="filterMultiplicity" value="(3,0)"/>
+///        <parameter name="filterChannels" value="0-71"/>
+///    </TRestDAQManagerMetadata>
+///  </TRestManager>
+/// \endcode
+///
+///----------------------------------------------------------------------
+///
+/// REST-for-Physics - Software for Rare Event Searches Toolkit
+///
+/// History of developments:
+///
+/// 2024-October: First implementation of TRestDAQManagerMetadata
+///
+/// \class TRestDAQManagerMetadata
+///
+/// <hr>
+///
+
+#include "TRestDAQManagerMetadata.h"
+
+#include <fstream>
+#include <sstream>
+
+ClassImp(TRestDAQManagerMetadata);
+
+///////////////////////////////////////////////
+/// \brief Default constructor
+///
+TRestDAQManagerMetadata::TRestDAQManagerMetadata() {
+    Initialize();
+}
+
+/////////////////////////////////////////////
+/// \brief Constructor loading data from a config file, the default
+/// values are kept if the section is not defined in the file
+///
+TRestDAQManagerMetadata::TRestDAQManagerMetadata(const char* configFilename, std::string name) : TRestMetadata(configFilename) {
+    Initialize();
+    if (!IsDefinedIn(configFilename)) return;
+
+    LoadConfigFromFile(fConfigFileName, name);
+
+    if (GetVerboseLevel() >= TRestStringOutput::REST_Verbose_Level::REST_Info) PrintMetadata();
+}
+
+///////////////////////////////////////////////
+/// \brief Default destructor
+///
+TRestDAQManagerMetadata::~TRestDAQManagerMetadata() {
+}
+
+///////////////////////////////////////////////
+/// \brief Function to initialize input/output event members and define
+/// the section name
+///
+void TRestDAQManagerMetadata::Initialize() {
+    SetSectionName(this->ClassName());
+}
+
+///////////////////////////////////////////////
+/// \brief Returns the directory where the local caches are stored
+///
+std::string TRestDAQManagerMetadata::GetCacheDirectory() const {
+    if (!fCacheDirectory.IsNull()) return fCacheDirectory.Data();
+
+    const char* home = getenv("HOME");
+    return std::string(home ? home : "/tmp") + "/.rest/daq";
+}
+
+///////////////////////////////////////////////
+/// \brief Returns the names of the TRestRawDAQMetadata sections of the
+/// backends, empty for a single electronics
+///
+std::vector<std::string> TRestDAQManagerMetadata::GetBackends() const {
+    std::vector<std::string> backends;
+    std::stringstream ss(fBackends.Data());
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (!name.empty()) backends.push_back(name);
+    }
+    return backends;
+}
+
+///////////////////////////////////////////////
+/// \brief Check whether a TRestDAQManagerMetadata section is defined in
+/// the config file, LoadConfigFromFile exits if the section is not found
+///
+bool TRestDAQManagerMetadata::IsDefinedIn(const std::string& cfgFile) {
+    std::ifstream file(cfgFile);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find("<TRestDAQManagerMetadata") != std::string::npos) return true;
+    }
+    return false;
+}
@@ -0,0 +1,367 @@
+/*************************************************************************
+ * This file is part of the REST software framework.                     *
+ *                                                                       *
+ * Copyright (C) 2016 GIFNA/TREX (University of Zaragoza)                *
+ * For more information see https://gifna.unizar.es/trex                 *
+ *                                                                       *
+ * REST is free software: you can redistribute it and/or modify          *
+ * it under the terms of the GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3 of the License, or     *
+ * (at your option) any later version.                                   *
+ *                                                                       *
+ * REST is distributed in the hope that it will be useful,               *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          *
+ * GNU General Public License for more details.                          *
+ *                                                                       *
+ * You should have a copy of the GNU General Public License along with   *
+ * REST in $REST_PATH/LICENSE.                                           *
+ * If not, see https://www.gnu.org/licenses/.                            *
+ * For the list of contributors see $REST_PATH/CREDITS.                  *
+ *************************************************************************/
+
+#ifndef REST_TRestDAQManagerMetadata
+#define REST_TRestDAQManagerMetadata
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TRestMetadata.h"
+#include "TVector2.h"
+
+/// This class holds the host side settings of restDAQManager, complementary to TRestRawDAQMetadata
+class TRestDAQManagerMetadata : public TRestMetadata {
+    private:
+
+    /// Instance of restDAQManager (shared memory keys) of this configuration, -1 if any
+    Int_t fInstance = -1;
+
+    /// CPUs of the receive threads, e.g. "2-3", empty to keep the CPUs of the manager
+    TString fReceiveCPUs = "";
+
+    /// CPUs of the event builder threads
+    TString fBuilderCPUs = "";
+
+    /// CPUs of the merger, event filter, raw archive and event sender threads
+    TString fWriterCPUs = "";
+
+    /// CPUs of the abort, file size and monitoring threads
+    TString fControlCPUs = "";
+
+    /// SCHED_FIFO priority (1-99) of the receive threads, 0 for the default scheduling
+    Int_t fReceivePriority = 0;
+
+    /// Lock the memory of the manager (mlockall) and pre-fault the shared memory rings
+    Bool_t fLockMemory = false;
+
+    /// Size in MB of the buffer of the frames received from every FEMINOS or ARC FEM
+    Int_t fFEMBufferSize = 64;
+
+    /// Allocate the FEM buffers on 2 MB huge pages when available
+    Bool_t fHugePages = true;
+
+    /// Size in kB of the socket receive buffer of every FEM
+    Int_t fSocketBufferSize = 8192;
+
+    /// Socket receive buffer of some FEMs, as "id:kB" comma separated, overrides fSocketBufferSize
+    TString fFEMSocketBuffers = "";
+
+    /// Set the socket receive buffers beyond net.core.rmem_max (SO_RCVBUFFORCE) when privileged
+    Bool_t fSocketBufferForce = true;
+
+    /// Count the datagrams dropped by the kernel on every FEM socket (SO_RXQ_OVFL)
+    Bool_t fSocketDropCount = true;
+
+    /// Datagrams received from every FEM (by FEC id) in this file
+    std::map<Int_t, Long64_t> fSocketDatagrams;
+
+    /// Datagrams of every FEM dropped by the kernel in this file, socket receive buffer full
+    std::map<Int_t, Long64_t> fSocketKernelDrops;
+
+    /// Data frames of every FEM dropped in this file because its buffer was full, see fFEMBufferSize
+    std::map<Int_t, Long64_t> fSocketBufferDrops;
+
+    /// Keep track of the registers written to the FEMs and send only the differences on configure
+    Bool_t fConfigCache = false;
+
+    /// Directory where the local DAQ caches are stored, if empty $HOME/.rest/daq is used
+    TString fCacheDirectory = "";
+
+    /// Compute the pedestals in the host from the acquired waveforms instead of writing the events
+    Bool_t fSoftwarePedestals = false;
+
+    /// Maximum age in hours of the stored pedestals to be reloaded in data taking runs, 0 disables the reload
+    Double_t fPedestalValidity = 0;
+
+    /// Zero suppression of the decoded waveforms in the host before they are added to the event
+    Bool_t fSoftwareZeroSuppression = false;
+
+    /// Threshold of the software zero suppression in sigmas of the baseline, for the channels without stored threshold
+    Double_t fZSThreshold = 4;
+
+    /// Time bins where the baseline of the signals is computed for the software zero suppression
+    TVector2 fZSBaseLineRange = TVector2(5, 55);
+
+    /// Time bins kept before and after the samples over threshold
+    TVector2 fZSPrePost = TVector2(8, 4);
+
+    /// Use the thresholds of the pedestal store for the FEMINOS and ARC channels
+    Bool_t fZSUseStore = true;
+
+    /// Write the events in the packed format (TRestRawPackedEvent) instead of TRestRawSignalEvent
+    Bool_t fPackedEvents = false;
+
+    /// Names of the TRestRawDAQMetadata sections acquired together, comma separated, empty for a single electronics
+    TString fBackends = "";
+
+    /// Maximum time difference in seconds between the events of different backends merged in one event
+    Double_t fMergeWindow = 1E-5;
+
+    /// Seconds an event waits for the events of the other backends before it is written
+    Double_t fMergeTimeout = 1;
+
+    /// Number of built events queued per backend before its event builder waits for the merger
+    Int_t fMergeQueueSize = 256;
+
+    /// Event builder (host:port) the built events are sent to instead of being written, empty to write them
+    TString fBuilderAddress = "";
+
+    /// Port where the event builder (electronicsType BUILDER) waits for the nodes
+    Int_t fBuilderPort = 7070;
+
+    /// Number of nodes the event builder waits for
+    Int_t fBuilderNodes = 1;
+
+    /// Events in flight per node before it waits for the event builder
+    Int_t fBuilderCredits = 64;
+
+    /// Write the received data frames to a raw archive instead of building the events
+    Bool_t fRawArchive = false;
+
+    /// Size of the raw archive chunks in MB
+    Int_t fArchiveChunkSize = 4;
+
+    /// Raw archive replayed with electronicsType REPLAY
+    TString fReplayFile = "";
+
+    /// Replay speed relative to the original frame arrival times, 0 replays as fast as possible
+    Double_t fReplaySpeed = 0;
+
+    /// Event rate of the DUMMY electronics in Hz, 0 generates as fast as possible
+    Double_t fDummyRate = 50;
+
+    /// Number of signals per event of the DUMMY electronics
+    Int_t fDummyChannels = 10;
+
+    /// Number of time bins of the DUMMY signals
+    Int_t fDummySamples = 512;
+
+    /// RMS of the gaussian noise added to the DUMMY signals in ADC units, 0 for a flat baseline
+    Double_t fDummyNoise = 0;
+
+    /// Number of threads generating the DUMMY events
+    Int_t fDummyThreads = 1;
+
+    /// Number of precomputed pulse shapes of the DUMMY electronics
+    Int_t fDummyBankSize = 1024;
+
+    /// Number of events kept in the shared memory ring read by the GUI, 0 disables the ring
+    Int_t fEventRingSlots = 32;
+
+    /// Maximum size of an event in the shared memory ring in kB
+    Int_t fEventRingSlotSize = 1024;
+
+    /// Only one of every N events is published in the shared memory ring
+    Int_t fEventRingPrescale = 1;
+
+    /// Seconds between the snapshots of the online monitoring histograms, 0 disables the monitoring
+    Double_t fMonitorInterval = 1;
+
+    /// Time bins where the baseline of the signals is computed for the monitoring
+    TVector2 fMonitorBaseLineRange = TVector2(5, 55);
+
+    /// Minimum amplitude of a monitored signal in sigmas of the baseline
+    Double_t fMonitorSignalThreshold = 2;
+
+    /// Number of bins of the monitoring spectrum
+    Int_t fMonitorBins = 1000;
+
+    /// Maximum amplitude of the monitoring spectrum
+    Double_t fMonitorSpectrumMax = 100000;
+
+    /// Number of channels of the monitoring histograms, the signals with a larger id are only counted
+    Int_t fMonitorChannels = 65536;
+
+    /// Online software trigger, only the built events which pass the filter cuts are written
+    Bool_t fEventFilter = false;
+
+    /// Number of threads evaluating the filter cuts, 0 evaluates them in the acquisition thread
+    Int_t fFilterThreads = 0;
+
+    /// Time bins where the baseline of the signals is computed for the event filter
+    TVector2 fFilterBaseLineRange = TVector2(5, 55);
+
+    /// Minimum amplitude of a signal over threshold in sigmas of the baseline
+    Double_t fFilterSignalThreshold = 3;
+
+    /// Minimum and maximum number of signals over threshold, a maximum of 0 means no limit
+    TVector2 fFilterMultiplicity = TVector2(1, 0);
+
+    /// Minimum and maximum summed amplitude of the signals over threshold, a maximum of 0 means no limit
+    TVector2 fFilterAmplitude = TVector2(0, 0);
+
+    /// Channel ranges where at least one signal over threshold is required, e.g. "0-71,288-359", empty for any channel
+    TString fFilterChannels = "";
+
+    /// Minimum time since the previous built event in seconds
+    Double_t fFilterMinTimeDiff = 0;
+
+    /// Only one of every N accepted events is written
+    Int_t fFilterPrescale = 1;
+
+    /// Number of built events evaluated by the event filter in this file
+    Long64_t fFilterEvents = 0;
+
+    /// Number of events written by the event filter in this file
+    Long64_t fFilterAccepted = 0;
+
+    void Initialize() override;
+
+public:
+
+    inline const Int_t GetInstance() const { return fInstance; }
+    inline std::string GetReceiveCPUs() const { return fReceiveCPUs.Data(); }
+    inline std::string GetBuilderCPUs() const { return fBuilderCPUs.Data(); }
+    inline std::string GetWriterCPUs() const { return fWriterCPUs.Data(); }
+    inline std::string GetControlCPUs() const { return fControlCPUs.Data(); }
+    inline const Int_t GetReceivePriority() const { return fReceivePriority; }
+    inline const Bool_t LockMemory() const { return fLockMemory; }
+    inline const Int_t GetFEMBufferSize() const { return fFEMBufferSize; }
+    inline const Bool_t UseHugePages() const { return fHugePages; }
+    inline const Int_t GetSocketBufferSize() const { return fSocketBufferSize; }
+    inline std::string GetFEMSocketBuffers() const { return fFEMSocketBuffers.Data(); }
+    inline const Bool_t UseSocketBufferForce() const { return fSocketBufferForce; }
+    inline const Bool_t UseSocketDropCount() const { return fSocketDropCount; }
+    inline const std::map<Int_t, Long64_t>& GetSocketDatagrams() const { return fSocketDatagrams; }
+    inline const std::map<Int_t, Long64_t>& GetSocketKernelDrops() const { return fSocketKernelDrops; }
+    inline const std::map<Int_t, Long64_t>& GetSocketBufferDrops() const { return fSocketBufferDrops; }
+    inline const Bool_t UseConfigCache() const { return fConfigCache; }
+
+    std::string GetCacheDirectory() const;
+
+    inline const Bool_t UseSoftwarePedestals() const { return fSoftwarePedestals; }
+    inline const Double_t GetPedestalValidity() const { return fPedestalValidity; }
+    inline std::string GetPedestalDirectory() const { return GetCacheDirectory() + "/pedestals"; }
+    inline const Bool_t UseSoftwareZeroSuppression() const { return fSoftwareZeroSuppression; }
+    inline const Double_t GetZSThreshold() const { return fZSThreshold; }
+    inline const TVector2 GetZSBaseLineRange() const { return fZSBaseLineRange; }
+    inline const TVector2 GetZSPrePost() const { return fZSPrePost; }
+    inline const Bool_t UseZSStore() const { return fZSUseStore; }
+    inline const Bool_t UsePackedEvents() const { return fPackedEvents; }
+    std::vector<std::string> GetBackends() const;
+    inline const Double_t GetMergeWindow() const { return fMergeWindow; }
+    inline const Double_t GetMergeTimeout() const { return fMergeTimeout; }
+    inline const Int_t GetMergeQueueSize() const { return fMergeQueueSize; }
+    inline std::string GetBuilderAddress() const { return fBuilderAddress.Data(); }
+    inline const Int_t GetBuilderPort() const { return fBuilderPort; }
+    inline const Int_t GetBuilderNodes() const { return fBuilderNodes; }
+    inline const Int_t GetBuilderCredits() const { return fBuilderCredits; }
+    inline const Bool_t UseRawArchive() const { return fRawArchive; }
+    inline const Int_t GetArchiveChunkSize() const { return fArchiveChunkSize; }
+    inline std::string GetReplayFile() const { return fReplayFile.Data(); }
+    inline void SetReplayFile(const std::string& file) { fReplayFile = file; }
+    inline const Double_t GetReplaySpeed() const { return fReplaySpeed; }
+    inline const Double_t GetDummyRate() const { return fDummyRate; }
+    inline const Int_t GetDummyChannels() const { return fDummyChannels; }
+    inline const Int_t GetDummySamples() const { return fDummySamples; }
+    inline const Double_t GetDummyNoise() const { return fDummyNoise; }
+    inline const Int_t GetDummyThreads() const { return fDummyThreads; }
+    inline const Int_t GetDummyBankSize() const { return fDummyBankSize; }
+    inline const Int_t GetEventRingSlots() const { return fEventRingSlots; }
+    inline const Int_t GetEventRingSlotSize() const { return fEventRingSlotSize; }
+    inline const Int_t GetEventRingPrescale() const { return fEventRingPrescale; }
+    inline const Double_t GetMonitorInterval() const { return fMonitorInterval; }
+    inline const TVector2 GetMonitorBaseLineRange() const { return fMonitorBaseLineRange; }
+    inline const Double_t GetMonitorSignalThreshold() const { return fMonitorSignalThreshold; }
+    inline const Int_t GetMonitorBins() const { return fMonitorBins; }
+    inline const Double_t GetMonitorSpectrumMax() const { return fMonitorSpectrumMax; }
+    inline const Int_t GetMonitorChannels() const { return fMonitorChannels; }
+    inline const Bool_t UseEventFilter() const { return fEventFilter; }
+    inline const Int_t GetFilterThreads() const { return fFilterThreads; }
+    inline const TVector2 GetFilterBaseLineRange() const { return fFilterBaseLineRange; }
+    inline const Double_t GetFilterSignalThreshold() const { return fFilterSignalThreshold; }
+    inline const TVector2 GetFilterMultiplicity() const { return fFilterMultiplicity; }
+    inline const TVector2 GetFilterAmplitude() const { return fFilterAmplitude; }
+    inline std::string GetFilterChannels() const { return fFilterChannels.Data(); }
+    inline const Double_t GetFilterMinTimeDiff() const { return fFilterMinTimeDiff; }
+    inline const Int_t GetFilterPrescale() const { return fFilterPrescale; }
+    inline const Long64_t GetFilterEvents() const { return fFilterEvents; }
+    inline const Long64_t GetFilterAccepted() const { return fFilterAccepted; }
+
+    inline void SetFilterCounters(Long64_t events, Long64_t accepted) { fFilterEvents = events; fFilterAccepted = accepted; }
+    inline void SetSocketCounters(Int_t fecId, Long64_t datagrams, Long64_t kernelDrops, Long64_t bufferDrops) {
+        fSocketDatagrams[fecId] = datagrams;
+        fSocketKernelDrops[fecId] = kernelDrops;
+        fSocketBufferDrops[fecId] = bufferDrops;
+    }
+
+    static bool IsDefinedIn(const std::string& cfgFile);
+
+    void PrintMetadata() override {
+        TRestMetadata::PrintMetadata();
+
+        if (fInstance >= 0) RESTMetadata << "Instance : " << fInstance << RESTendl;
+        if (fReceiveCPUs != "" || fBuilderCPUs != "" || fWriterCPUs != "" || fControlCPUs != "")
+            RESTMetadata << "Thread CPUs : receive \"" << fReceiveCPUs << "\", builder \"" << fBuilderCPUs << "\", writer \"" << fWriterCPUs
+                         << "\", control \"" << fControlCPUs << "\"" << RESTendl;
+        if (fReceivePriority > 0) RESTMetadata << "Receive threads : SCHED_FIFO " << fReceivePriority << RESTendl;
+        RESTMetadata << "Lock memory : " << (fLockMemory ? "ON" : "OFF") << RESTendl;
+        RESTMetadata << "FEM buffers : " << fFEMBufferSize << " MB, huge pages " << (fHugePages ? "ON" : "OFF") << RESTendl;
+        RESTMetadata << "Socket buffers : " << fSocketBufferSize << " kB";
+        if (fFEMSocketBuffers != "") RESTMetadata << ", FEMs \"" << fFEMSocketBuffers << "\"";
+        RESTMetadata << ", force " << (fSocketBufferForce ? "ON" : "OFF") << ", drop count " << (fSocketDropCount ? "ON" : "OFF") << RESTendl;
+        for (const auto& [id, datagrams] : fSocketDatagrams)
+            RESTMetadata << "FEM " << id << " socket : " << datagrams << " datagrams received, " << fSocketKernelDrops[id] << " dropped by the kernel, "
+                         << fSocketBufferDrops[id] << " dropped with the buffer full" << RESTendl;
+        RESTMetadata << "Config cache : " << (fConfigCache ? "ON" : "OFF") << RESTendl;
+        RESTMetadata << "Cache directory : " << GetCacheDirectory() << RESTendl;
+        RESTMetadata << "Software pedestals : " << (fSoftwarePedestals ? "ON" : "OFF") << RESTendl;
+        RESTMetadata << "Pedestal validity : " << fPedestalValidity << " h" << RESTendl;
+        RESTMetadata << "Software zero suppression : " << (fSoftwareZeroSuppression ? "ON" : "OFF") << RESTendl;
+        if (fSoftwareZeroSuppression)
+            RESTMetadata << "ZS threshold : " << fZSThreshold << " sigmas, baseline ( " << fZSBaseLineRange.X() << " , " << fZSBaseLineRange.Y()
+                         << " ), pre/post " << fZSPrePost.X() << "/" << fZSPrePost.Y() << ", stored thresholds " << (fZSUseStore ? "ON" : "OFF") << RESTendl;
+        RESTMetadata << "Packed events : " << (fPackedEvents ? "ON" : "OFF") << RESTendl;
+        if (fBackends != "")
+            RESTMetadata << "Backends : " << fBackends << ", merge window " << fMergeWindow << " s, timeout " << fMergeTimeout << " s, queue "
+                         << fMergeQueueSize << " events" << RESTendl;
+        if (fBuilderAddress != "") RESTMetadata << "Event builder : " << fBuilderAddress << ", " << fBuilderCredits << " events in flight" << RESTendl;
+        RESTMetadata << "Raw archive : " << (fRawArchive ? "ON" : "OFF") << RESTendl;
+        if (fRawArchive) RESTMetadata << "Archive chunk size : " << fArchiveChunkSize << " MB" << RESTendl;
+        if (fReplayFile != "") RESTMetadata << "Replay file : " << fReplayFile << " speed " << fReplaySpeed << RESTendl;
+        RESTMetadata << "Dummy load : " << fDummyRate << " Hz, " << fDummyChannels << " signals x " << fDummySamples << " samples, noise "
+                     << fDummyNoise << ", " << fDummyThreads << " threads, " << fDummyBankSize << " pulse shapes" << RESTendl;
+        RESTMetadata << "Event ring : " << fEventRingSlots << " events of " << fEventRingSlotSize << " kB, prescale " << fEventRingPrescale << RESTendl;
+        RESTMetadata << "Monitor : every " << fMonitorInterval << " s, baseline ( " << fMonitorBaseLineRange.X() << " , " << fMonitorBaseLineRange.Y()
+                     << " ), threshold " << fMonitorSignalThreshold << " sigmas, " << fMonitorBins << " bins up to " << fMonitorSpectrumMax << ", "
+                     << fMonitorChannels << " channels" << RESTendl;
+        RESTMetadata << "Event filter : " << (fEventFilter ? "ON" : "OFF") << RESTendl;
+        if (fEventFilter) {
+            RESTMetadata << "Filter : baseline ( " << fFilterBaseLineRange.X() << " , " << fFilterBaseLineRange.Y() << " ), threshold "
+                         << fFilterSignalThreshold << " sigmas, multiplicity ( " << fFilterMultiplicity.X() << " , " << fFilterMultiplicity.Y()
+                         << " ), amplitude ( " << fFilterAmplitude.X() << " , " << fFilterAmplitude.Y() << " ), channels \"" << fFilterChannels
+                         << "\", min time diff " << fFilterMinTimeDiff << " s, prescale " << fFilterPrescale << ", " << fFilterThreads << " threads" << RESTendl;
+            if (fFilterEvents > 0) RESTMetadata << "Filter events : " << fFilterAccepted << " of " << fFilterEvents << " written" << RESTendl;
+        }
+        RESTMetadata << "+++++++++++++++++++++++++++++++++++++++++++++++++" << RESTendl;
+    }
+
+    TRestDAQManagerMetadata();
+    TRestDAQManagerMetadata(const char* configFilename, std::string name = "");
+    ~TRestDAQManagerMetadata();
+
+    ClassDefOverride(TRestDAQManagerMetadata, 1);
+
+};
+#endif
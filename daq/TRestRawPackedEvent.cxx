@@ -0,0 +1,363 @@
+/*************************************************************************
+ * This file is part of the REST software framework.                     *
+ *                                                                       *
+ * Copyright (C) 2016 GIFNA/TREX (University of Zaragoza)                *
+ * For more information see https://gifna.unizar.es/trex                 *
+ *                                                                       *
+ * REST is free software: you can redistribute it and/or modify          *
+ * it under the terms of the GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3 of the License, or     *
+ * (at your option) any later version.                                   *
+ *                                                                       *
+ * REST is distributed in the hope that it will be useful,               *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          *
+ * GNU General Public License for more details.                          *
+ *                                                                       *
+ * You should have a copy of the GNU General Public License along with   *
+ * REST in $REST_PATH/LICENSE.                                           *
+ * If not, see https://www.gnu.org/licenses/.                            *
+ * For the list of contributors see $REST_PATH/CREDITS.                  *
+ *************************************************************************/
+
+/////////////////////////////////////////////////////////////////////////
+/// TRestRawPackedEvent is a compact representation of a
+/// TRestRawSignalEvent, written by restDAQManager instead of the
+/// TRestRawSignalEvent branch when `packedEvents` is enabled in
+/// TRestDAQManagerMetadata.
+///
+/// The samples set to 0 by the zero suppression are not stored: every
+/// signal is split in blocks of consecutive non zero samples, each one
+/// with its first time bin, number of samples and encoding:
+/// * **PACKED12**: two 12 bit samples in 3 bytes, used when all the
+/// samples of the block are in [0, 4095], as the AGET/AFTER ADC data.
+/// * **DELTA**: difference with the previous sample (0 before the first
+/// one), zig-zag encoded in 7 bit groups, used for the blocks with other
+/// values or when it is smaller, e.g. flat baselines.
+///
+/// The encoded samples of all the blocks are stored in a single byte
+/// array, so the size on disk and the ROOT compression time scale with the
+/// content of the event instead of the number of channels and time bins.
+/// `Decode` restores the TRestRawSignalEvent, e.g. in a macro:
+/// \code
+///  TRestRawPackedEvent* packed = nullptr;
+///  tree->SetBranchAddress("TRestRawPackedEventBranch", &packed);
+///  tree->GetEntry(0);
+///  TRestRawSignalEvent sEvent;
+///  packed->Decode(&sEvent);
+/// \endcode
+///
+///----------------------------------------------------------------------
+///
+/// REST-for-Physics - Software for Rare Event Searches Toolkit
+///
+/// History of developments:
+///
+/// 2024-November: First implementation of TRestRawPackedEvent
+///
+/// \class TRestRawPackedEvent
+///
+/// <hr>
+///
+
+#include "TRestRawPackedEvent.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+ClassImp(TRestRawPackedEvent);
+
+namespace {
+  //Restrict parameters, so the copy becomes a memmove
+  void CopySignal(Short_t* __restrict data, const TRestRawSignal* __restrict sgnl, int n){
+    for(int i=0; i<n; i++)data[i] = (*sgnl)[i];
+  }
+
+  inline uint32_t ZigZag(int32_t v){ return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+  inline int32_t UnZigZag(uint32_t v){ return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+  inline int VarIntSize(uint32_t v){ return 1 + (v >= (1u << 7)) + (v >= (1u << 14)); }//Deltas of 16 bit samples, branchless
+
+  template <typename T>
+  void Append(std::vector<char>& buffer, const T* data, size_t n){
+    const char* in = (const char*)data;
+    buffer.insert(buffer.end(), in, in + n * sizeof(T));
+  }
+
+  template <typename T>
+  bool Extract(const char*& in, const char* end, std::vector<T>& v, size_t n){
+    if((size_t)(end - in) < n * sizeof(T))return false;
+    v.resize(n);
+    if(n > 0)memcpy(v.data(), in, n * sizeof(T));
+    in += n * sizeof(T);
+    return true;
+  }
+}
+
+///////////////////////////////////////////////
+/// \brief Default constructor
+///
+TRestRawPackedEvent::TRestRawPackedEvent() {
+    Initialize();
+}
+
+///////////////////////////////////////////////
+/// \brief Default destructor
+///
+TRestRawPackedEvent::~TRestRawPackedEvent() {
+}
+
+///////////////////////////////////////////////
+/// \brief Removes all the signals, the allocated memory is kept
+///
+void TRestRawPackedEvent::Initialize() {
+    TRestEvent::Initialize();
+    fSignalID.clear();
+    fNPoints.clear();
+    fNBlocks.clear();
+    fBlockStart.clear();
+    fBlockLength.clear();
+    fBlockEncoding.clear();
+    fData.clear();
+}
+
+///////////////////////////////////////////////
+/// \brief Packs the signals of sEvent, replacing the current content
+///
+void TRestRawPackedEvent::Encode(TRestRawSignalEvent* sEvent) {
+
+  Initialize();
+  SetEventInfo(sEvent);
+
+    for(int s=0; s<sEvent->GetNumberOfSignals(); s++){
+      TRestRawSignal* sgnl = sEvent->GetSignal(s);
+      const int n = sgnl->GetNumberOfPoints();
+      fSamples.resize(n);
+      CopySignal(fSamples.data(), sgnl, n);
+      const Short_t* data = fSamples.data();
+
+      const size_t firstBlock = fBlockStart.size();
+      int i = 0;
+        while(i < n){
+          while(i < n && data[i] == 0)i++;
+          const int start = i;
+          while(i < n && data[i] != 0)i++;
+          if(i == start)break;
+          fBlockStart.push_back(start);
+          fBlockLength.push_back(i - start);
+          EncodeBlock(&data[start], i - start);
+        }
+
+      fSignalID.push_back(sgnl->GetID());
+      fNPoints.push_back(n);
+      fNBlocks.push_back(fBlockStart.size() - firstBlock);
+    }
+}
+
+void TRestRawPackedEvent::EncodeBlock(const Short_t* data, int length) {
+
+  //Size of both encodings, in lanes of fixed width so it is vectorized
+  constexpr int lanes = 16;
+  int laneOver[lanes], laneSize[lanes];
+  for(int l=0; l<lanes; l++){ laneOver[l] = 0; laneSize[l] = 0; }
+  int i = 1;
+    for(; i + lanes <= length; i += lanes){
+      for(int l=0; l<lanes; l++){
+        laneOver[l] |= (uint16_t)data[i + l] >> 12;
+        laneSize[l] += VarIntSize(ZigZag(data[i + l] - data[i + l - 1]));
+      }
+    }
+  int over12 = (uint16_t)data[0] >> 12;
+  int deltaSize = VarIntSize(ZigZag(data[0]));
+    for(; i<length; i++){
+      over12 |= (uint16_t)data[i] >> 12;
+      deltaSize += VarIntSize(ZigZag(data[i] - data[i - 1]));
+    }
+    for(int l=0; l<lanes; l++){
+      over12 |= laneOver[l];
+      deltaSize += laneSize[l];
+    }
+  const bool fits12 = over12 == 0;
+
+  const int packedSize = (length * 3 + 1) / 2;
+  const size_t pos = fData.size();
+
+    if(fits12 && packedSize <= deltaSize){
+      fBlockEncoding.push_back(PACKED12);
+      fData.resize(pos + packedSize);
+      UChar_t* out = &fData[pos];
+      i = 0;
+        for(; i + 1 < length; i += 2){
+          const uint16_t a = data[i], b = data[i + 1];
+          *out++ = a & 0xFF;
+          *out++ = (a >> 8) | ((b & 0xF) << 4);
+          *out++ = b >> 4;
+        }
+        if(i < length){
+          *out++ = data[i] & 0xFF;
+          *out++ = data[i] >> 8;
+        }
+    } else {
+      fBlockEncoding.push_back(DELTA);
+      fData.resize(pos + deltaSize);
+      UChar_t* out = &fData[pos];
+      Short_t prev = 0;
+        for(i=0; i<length; i++){
+          uint32_t v = ZigZag(data[i] - prev);
+          prev = data[i];
+            while(v >= 0x80){
+              *out++ = (v & 0x7F) | 0x80;
+              v >>= 7;
+            }
+          *out++ = v;
+        }
+    }
+}
+
+///////////////////////////////////////////////
+/// \brief Restores the signals in sEvent, the previous signals of sEvent
+/// are removed. Returns false, with no signals in sEvent, if the blocks are
+/// not consistent (see IsValid)
+///
+bool TRestRawPackedEvent::Decode(TRestRawSignalEvent* sEvent) const {
+
+  sEvent->Initialize();
+  sEvent->SetEventInfo(const_cast<TRestRawPackedEvent*>(this));
+
+    if(!IsValid()){
+      std::cerr << "TRestRawPackedEvent: inconsistent blocks in event " << GetID() << ", the event is not decoded" << std::endl;
+      return false;
+    }
+
+  size_t block = 0, pos = 0;
+  std::vector<Short_t> sData;
+    for(size_t s=0; s<fSignalID.size(); s++){
+      sData.assign(fNPoints[s], 0);
+        for(int b=0; b<fNBlocks[s]; b++, block++){
+          const int start = fBlockStart[block];
+          const int length = fBlockLength[block];
+          Short_t* out = &sData[start];
+            if(fBlockEncoding[block] == PACKED12){
+              const UChar_t* in = &fData[pos];
+              int i = 0;
+                for(; i + 1 < length; i += 2, in += 3){
+                  out[i] = in[0] | ((in[1] & 0xF) << 8);
+                  out[i + 1] = (in[1] >> 4) | (in[2] << 4);
+                }
+                if(i < length){
+                  out[i] = in[0] | (in[1] << 8);
+                  in += 2;
+                }
+              pos = in - fData.data();
+            } else {
+              Short_t prev = 0;
+                for(int i=0; i<length; i++){
+                  uint32_t v = 0;
+                  int shift = 0;
+                    while(fData[pos] & 0x80){
+                      v |= (uint32_t)(fData[pos++] & 0x7F) << shift;
+                      shift += 7;
+                    }
+                  v |= (uint32_t)fData[pos++] << shift;
+                  prev = out[i] = prev + UnZigZag(v);
+                }
+            }
+        }
+      TRestRawSignal rawSignal(fSignalID[s], sData);
+      sEvent->AddSignal(rawSignal);
+    }
+
+  return true;
+}
+
+///////////////////////////////////////////////
+/// \brief Checks the blocks against the signals and the encoded data: every
+/// block inside its signal, the blocks of all the signals and the bytes of
+/// their samples matching the stored ones, so Decode doesn't read out of them
+///
+bool TRestRawPackedEvent::IsValid() const {
+
+  const size_t nSignals = fSignalID.size(), nBlocks = fBlockStart.size(), dataSize = fData.size();
+  if(fNPoints.size() != nSignals || fNBlocks.size() != nSignals)return false;
+  if(fBlockLength.size() != nBlocks || fBlockEncoding.size() != nBlocks)return false;
+
+  size_t block = 0, pos = 0;
+    for(size_t s=0; s<nSignals; s++){
+        for(int b=0; b<fNBlocks[s]; b++, block++){
+          if(block >= nBlocks || fBlockStart[block] + fBlockLength[block] > fNPoints[s])return false;
+            if(fBlockEncoding[block] == PACKED12){
+              pos += (fBlockLength[block] * 3 + 1) / 2;
+            } else if(fBlockEncoding[block] == DELTA){
+                for(int i=0; i<fBlockLength[block] && pos <= dataSize; i++){
+                  while(pos < dataSize && (fData[pos] & 0x80))pos++;
+                  pos = pos < dataSize ? pos + 1 : dataSize + 1;//The last byte of every sample has no continuation bit
+                }
+            } else {
+              return false;
+            }
+          if(pos > dataSize)return false;
+        }
+    }
+
+  return block == nBlocks && pos == dataSize;
+}
+
+///////////////////////////////////////////////
+/// \brief Appends the signals to buffer: number of signals, blocks and data
+/// bytes followed by the arrays, in the byte order of the host. The event
+/// id and time are not included.
+///
+void TRestRawPackedEvent::Serialize(std::vector<char>& buffer) const {
+
+  const uint32_t sizes[3] = {(uint32_t)fSignalID.size(), (uint32_t)fBlockStart.size(), (uint32_t)fData.size()};
+  Append(buffer, sizes, 3);
+  Append(buffer, fSignalID.data(), fSignalID.size());
+  Append(buffer, fNPoints.data(), fNPoints.size());
+  Append(buffer, fNBlocks.data(), fNBlocks.size());
+  Append(buffer, fBlockStart.data(), fBlockStart.size());
+  Append(buffer, fBlockLength.data(), fBlockLength.size());
+  Append(buffer, fBlockEncoding.data(), fBlockEncoding.size());
+  Append(buffer, fData.data(), fData.size());
+}
+
+///////////////////////////////////////////////
+/// \brief Restores the signals of Serialize, replacing the current content.
+/// The blocks are checked with IsValid, the content is cleared if they are
+/// not consistent.
+///
+bool TRestRawPackedEvent::Deserialize(const char* data, size_t size) {
+
+  Initialize();
+  const char* in = data;
+  const char* end = data + size;
+
+  std::vector<uint32_t> sizes;
+  if(!Extract(in, end, sizes, 3))return false;
+  const size_t nSignals = sizes[0], nBlocks = sizes[1], dataSize = sizes[2];
+    if(!Extract(in, end, fSignalID, nSignals) || !Extract(in, end, fNPoints, nSignals) || !Extract(in, end, fNBlocks, nSignals) ||
+       !Extract(in, end, fBlockStart, nBlocks) || !Extract(in, end, fBlockLength, nBlocks) || !Extract(in, end, fBlockEncoding, nBlocks) ||
+       !Extract(in, end, fData, dataSize) || in != end || !IsValid()){
+      Initialize();
+      return false;
+    }
+
+  return true;
+}
+
+///////////////////////////////////////////////
+/// \brief Prints the blocks of every signal
+///
+void TRestRawPackedEvent::PrintEvent() const {
+    TRestEvent::PrintEvent();
+
+    std::cout << "Signals : " << fSignalID.size() << ", blocks : " << fBlockStart.size() << ", packed samples : " << fData.size() << " bytes" << std::endl;
+
+    size_t block = 0;
+    for (size_t s = 0; s < fSignalID.size(); s++) {
+        std::cout << " Signal " << fSignalID[s] << " ( " << fNPoints[s] << " points ) :";
+        for (int b = 0; b < fNBlocks[s]; b++, block++)
+            std::cout << " [" << fBlockStart[block] << "," << fBlockStart[block] + fBlockLength[block] << ")"
+                      << (fBlockEncoding[block] == PACKED12 ? "p" : "d");
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,89 @@
+/*************************************************************************
+ * This file is part of the REST software framework.                     *
+ *                                                                       *
+ * Copyright (C) 2016 GIFNA/TREX (University of Zaragoza)                *
+ * For more information see https://gifna.unizar.es/trex                 *
+ *                                                                       *
+ * REST is free software: you can redistribute it and/or modify          *
+ * it under the terms of the GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3 of the License, or     *
+ * (at your option) any later version.                                   *
+ *                                                                       *
+ * REST is distributed in the hope that it will be useful,               *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          *
+ * GNU General Public License for more details.                          *
+ *                                                                       *
+ * You should have a copy of the GNU General Public License along with   *
+ * REST in $REST_PATH/LICENSE.                                           *
+ * If not, see https://www.gnu.org/licenses/.                            *
+ * For the list of contributors see $REST_PATH/CREDITS.                  *
+ *************************************************************************/
+
+#ifndef REST_TRestRawPackedEvent
+#define REST_TRestRawPackedEvent
+
+#include <vector>
+
+#include "TRestEvent.h"
+#include "TRestRawSignalEvent.h"
+
+/// Compact on disk representation of a TRestRawSignalEvent, only the non zero samples are stored
+class TRestRawPackedEvent : public TRestEvent {
+    public:
+
+    enum blockEncoding : UChar_t { PACKED12 = 0, DELTA = 1 };
+
+    private:
+
+    /// Id of every signal
+    std::vector<Int_t> fSignalID;
+
+    /// Number of points of every signal
+    std::vector<UShort_t> fNPoints;
+
+    /// Number of blocks of every signal
+    std::vector<UShort_t> fNBlocks;
+
+    /// First time bin of every block
+    std::vector<UShort_t> fBlockStart;
+
+    /// Number of samples of every block
+    std::vector<UShort_t> fBlockLength;
+
+    /// Encoding of the samples of every block (blockEncoding)
+    std::vector<UChar_t> fBlockEncoding;
+
+    /// Encoded samples of all the blocks
+    std::vector<UChar_t> fData;
+
+    std::vector<Short_t> fSamples;  //! Scratch buffer, not stored
+
+    void EncodeBlock(const Short_t* data, int length);
+
+public:
+
+    void Initialize() override;
+    void PrintEvent() const override;
+
+    void Encode(TRestRawSignalEvent* sEvent);
+    //false if the blocks are not consistent, sEvent is left without signals then
+    bool Decode(TRestRawSignalEvent* sEvent) const;
+    //Blocks inside their signals and matching the encoded data, checked by Decode and Deserialize
+    bool IsValid() const;
+
+    //Flat copy of the signals and blocks (not the event info) appended to buffer, e.g. to be sent over the network
+    void Serialize(std::vector<char>& buffer) const;
+    //Restores the signals and blocks of Serialize, false if the buffer is not consistent
+    bool Deserialize(const char* data, size_t size);
+
+    inline Int_t GetNumberOfSignals() const { return fSignalID.size(); }
+    inline size_t GetNumberOfBlocks() const { return fBlockStart.size(); }
+    inline size_t GetDataSize() const { return fData.size(); }
+
+    TRestRawPackedEvent();
+    ~TRestRawPackedEvent();
+
+    ClassDefOverride(TRestRawPackedEvent, 1);
+};
+#endif
@@ -0,0 +1,211 @@
+/*********************************************************************************
+ThreadPolicy.cxx
+
+Placement and scheduling of the acquisition threads, see ThreadPolicy.h
+
+*********************************************************************************/
+
+#include "ThreadPolicy.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+ThreadPolicy::settings ThreadPolicy::set;
+
+namespace {
+  const char* stageNames[(int)ThreadPolicy::stage::N_STAGES] = {"receive", "builder", "writer", "control"};
+}
+
+const char* ThreadPolicy::GetStageName(stage s){
+  return stageNames[(int)s];
+}
+
+bool ThreadPolicy::ParseCPUs(const std::string& list, cpu_set_t& cpuSet){
+
+  CPU_ZERO(&cpuSet);
+  const long nCPUs = std::min<long>(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE);
+  std::stringstream ss(list);
+  std::string range;
+  int count = 0;
+    while(std::getline(ss, range, ',')){
+      range.erase(0, range.find_first_not_of(" \t"));
+      range.erase(range.find_last_not_of(" \t") + 1);
+      if(range.empty())continue;
+
+      int first, last;
+      char* end;
+      first = last = strtol(range.c_str(), &end, 10);
+      if(*end == '-')last = strtol(end + 1, &end, 10);
+      if(*end != '\0' || !isdigit(range[0]) || first < 0 || last < first || last >= nCPUs)return false;
+
+      for(int c=first; c<=last; c++)CPU_SET(c, &cpuSet);
+      count += last - first + 1;
+    }
+
+  return count > 0;
+}
+
+std::string ThreadPolicy::FormatCPUs(const cpu_set_t& cpuSet){
+
+  std::string list;
+    for(int c=0; c<CPU_SETSIZE; c++){
+      if(!CPU_ISSET(c, &cpuSet))continue;
+      int last = c;
+      while(last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpuSet))last++;
+      if(!list.empty())list += ",";
+      list += std::to_string(c);
+      if(last > c)list += "-" + std::to_string(last);
+      c = last;
+    }
+
+  return list.empty() ? "none" : list;
+}
+
+void ThreadPolicy::Configure(const settings& st){
+
+  std::lock_guard<std::mutex> lock(mutex);
+  set = st;
+  for(auto &r : reports)r.clear();
+
+    for(int s=0; s<(int)stage::N_STAGES; s++){
+      cpu_set_t cpuSet;
+      if(!set.cpus[s].empty() && !ParseCPUs(set.cpus[s], cpuSet)){
+        std::cerr << "Wrong CPU list \"" << set.cpus[s] << "\" of the " << stageNames[s] << " threads, "
+                  << sysconf(_SC_NPROCESSORS_CONF) << " CPUs in this machine, they are not pinned" << std::endl;
+        set.cpus[s].clear();
+      }
+    }
+
+  const int minPriority = sched_get_priority_min(SCHED_FIFO);
+  const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+    if(set.receivePriority != 0 && (set.receivePriority < minPriority || set.receivePriority > maxPriority)){
+      std::cerr << "SCHED_FIFO priority " << set.receivePriority << " out of range (" << minPriority << "-" << maxPriority << "), using "
+                << std::clamp(set.receivePriority, minPriority, maxPriority) << std::endl;
+      set.receivePriority = std::clamp(set.receivePriority, minPriority, maxPriority);
+    }
+
+    if(set.lockMemory && !locked){
+        if(mlockall(MCL_CURRENT | MCL_FUTURE) == 0){
+          locked = true;
+        } else {
+          struct rlimit rl;
+          getrlimit(RLIMIT_MEMLOCK, &rl);
+          std::cerr << "Memory not locked (mlockall) " << std::strerror(errno) << ", memlock limit ";
+          if(rl.rlim_cur == RLIM_INFINITY)std::cerr << "unlimited" << std::endl;
+          else std::cerr << rl.rlim_cur / 1024 << " kB" << std::endl;
+        }
+    } else if (!set.lockMemory && locked){
+      munlockall();
+      locked = false;
+    }
+
+  std::cout << "Thread policy:";
+    for(int s=0; s<(int)stage::N_STAGES; s++){
+      std::cout << " " << stageNames[s] << " CPUs " << (set.cpus[s].empty() ? "any" : set.cpus[s]);
+      if(s == (int)stage::RECEIVE && set.receivePriority > 0)std::cout << " SCHED_FIFO " << set.receivePriority;
+      std::cout << (s + 1 < (int)stage::N_STAGES ? "," : "");
+    }
+  std::cout << ", memory " << (locked ? "locked" : "not locked") << std::endl;
+}
+
+void ThreadPolicy::Apply(stage s, const char* name){
+
+  std::string cpus;
+  int priority;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      cpus = set.cpus[(int)s];
+      priority = s == stage::RECEIVE ? set.receivePriority : 0;
+    }
+
+  const pthread_t self = pthread_self();
+  char threadName[16];
+  snprintf(threadName, sizeof(threadName), "%s", name);
+  pthread_setname_np(self, threadName);
+  if(cpus.empty() && priority == 0)return;//Default placement, nothing to report
+
+  std::string failed;
+  cpu_set_t cpuSet;
+    if(!cpus.empty() && ParseCPUs(cpus, cpuSet)){
+      const int err = pthread_setaffinity_np(self, sizeof(cpuSet), &cpuSet);
+      if(err != 0)failed += ", CPUs " + cpus + " not granted (" + std::strerror(err) + ")";
+    }
+
+    if(priority > 0){
+      struct sched_param param;
+      param.sched_priority = priority;
+      const int err = pthread_setschedparam(self, SCHED_FIFO, &param);
+      if(err != 0)failed += ", SCHED_FIFO " + std::to_string(priority) + " not granted (" + std::strerror(err) + ")";
+    }
+
+  //What the thread actually got
+  std::string report = std::string(name) + ": CPUs ";
+  report += pthread_getaffinity_np(self, sizeof(cpuSet), &cpuSet) == 0 ? FormatCPUs(cpuSet) : "unknown";
+  int policy;
+  struct sched_param param;
+    if(pthread_getschedparam(self, &policy, &param) == 0){
+      if(policy == SCHED_FIFO)report += ", SCHED_FIFO " + std::to_string(param.sched_priority);
+      else if(policy == SCHED_RR)report += ", SCHED_RR " + std::to_string(param.sched_priority);
+      else report += ", default scheduling";
+    }
+
+  Report(s, report + failed);
+}
+
+void ThreadPolicy::Report(stage s, const std::string& report){
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string& printed = reports[(int)s];
+  //Once per thread name and outcome in the run, the threads are started again in every file
+  if(("\n" + printed).find("\n" + report + "\n") != std::string::npos)return;
+  printed += report + "\n";
+
+  std::cout << "Thread policy of the " << stageNames[(int)s] << " thread " << report << std::endl;
+}
+
+ThreadPolicy::Scope::Scope(stage s, const char* name){
+
+  const pthread_t self = pthread_self();
+  if(pthread_getname_np(self, threadName, sizeof(threadName)) != 0)threadName[0] = '\0';
+  restoreCPUs = pthread_getaffinity_np(self, sizeof(cpus), &cpus) == 0;
+  struct sched_param param;
+  restoreScheduling = pthread_getschedparam(self, &policy, &param) == 0;
+  priority = param.sched_priority;
+
+  Apply(s, name);
+}
+
+ThreadPolicy::Scope::~Scope(){
+
+  const pthread_t self = pthread_self();
+  if(threadName[0])pthread_setname_np(self, threadName);
+  if(restoreCPUs)pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+    if(restoreScheduling){
+      struct sched_param param;
+      param.sched_priority = priority;
+      pthread_setschedparam(self, policy, &param);
+    }
+}
+
+void ThreadPolicy::Prefault(void* addr, size_t size){
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(!locked || size == 0)return;
+    }
+
+  //mlock faults in the pages of the mapping, they are already locked by mlockall
+    if(mlock(addr, size) != 0)
+      std::cerr << "Cannot pre-fault " << size / 1024 << " kB (mlock) " << std::strerror(errno) << std::endl;
+}
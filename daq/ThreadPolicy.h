@@ -0,0 +1,90 @@
+/*********************************************************************************
+ThreadPolicy.h
+
+Placement and scheduling of the acquisition threads, set per run from the
+TRestDAQManagerMetadata of the config file. Every thread of the data path
+applies the policy of its pipeline stage when it starts:
+
+  RECEIVE   receive threads of FEMINOS and ARC, acquisition loop of the DCC,
+            links of the event builder
+  BUILDER   event builder threads, DUMMY generators
+  WRITER    merger, event filter, raw archive and event sender threads
+  CONTROL   abort, file size and monitoring threads
+
+A stage can be pinned to a CPU list (e.g. "2-3,6") and the receive threads can
+run with SCHED_FIFO, so a burst of frames is read before the socket buffers
+overflow even when the machine is loaded. The memory of the manager can be
+locked (mlockall) and the shared memory rings are then pre-faulted, so the data
+path doesn't wait for page faults or swapping.
+
+The policy needs privileges (CAP_SYS_NICE and CAP_IPC_LOCK, or the rtprio and
+memlock limits of the user), whatever is not granted is reported and the
+thread keeps the default scheduling, the run is not stopped. The outcome of
+the pinned or real time threads is printed the first time it is applied in a
+run, with the CPUs and scheduling actually granted.
+
+*********************************************************************************/
+
+#ifndef __THREAD_POLICY__
+#define __THREAD_POLICY__
+
+#include <sched.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+class ThreadPolicy {
+  public:
+    enum class stage { RECEIVE = 0, BUILDER, WRITER, CONTROL, N_STAGES };
+
+    struct settings {
+      std::string cpus[(int)stage::N_STAGES];//CPU list of every stage, empty to keep the CPUs of the manager
+      int receivePriority = 0;//SCHED_FIFO priority of the receive threads (1-99), 0 for the default scheduling
+      bool lockMemory = false;//mlockall and pre-fault of the shared memory rings
+    };
+
+    //Locks or unlocks the memory and prints the policy, the outcome of the stages is printed again
+    static void Configure(const settings& st);
+
+    //Policy of the stage in the calling thread, name is shown by top -H and in the report
+    static void Apply(stage s, const char* name);
+
+    //Applies the policy of a stage in the calling thread and restores the previous one when
+    //destroyed, e.g. for the acquisition loop of the DCC which runs in the manager thread
+    class Scope {
+      public:
+        Scope(stage s, const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        char threadName[16];
+        cpu_set_t cpus;
+        bool restoreCPUs = false;
+        int policy = SCHED_OTHER;
+        int priority = 0;
+        bool restoreScheduling = false;
+    };
+
+    //Maps the pages of a buffer (e.g. a shared memory ring) when the memory is locked
+    static void Prefault(void* addr, size_t size);
+
+    //"0-3,6" to a CPU set, false if the list is not valid or has no CPU of this machine
+    static bool ParseCPUs(const std::string& list, cpu_set_t& set);
+    static std::string FormatCPUs(const cpu_set_t& set);
+
+    static const char* GetStageName(stage s);
+
+  private:
+    static void Report(stage s, const std::string& report);
+
+    static settings set;
+    inline static bool locked = false;
+    inline static std::mutex mutex;
+    inline static std::string reports[(int)stage::N_STAGES];//Outcomes printed in this run, one per line
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*********************************************************************************
+ZeroSuppression.cxx
+
+Host side zero suppression of full waveform data, see ZeroSuppression.h
+
+*********************************************************************************/
+
+#include "ZeroSuppression.h"
+#include "PedestalStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+ZeroSuppression::ZeroSuppression(double nSigmas, int baselineStart, int baselineEnd, int preSamples, int postSamples) :
+  nSigmas(nSigmas), baselineStart(std::max(baselineStart, 0)), baselineEnd(baselineEnd),
+  preSamples(std::max(preSamples, 0)), postSamples(std::max(postSamples, 0)) { }
+
+int ZeroSuppression::LoadThresholds(const std::string& storeDir, const TRestRawDAQMetadata::FECMetadata& fec, const FEMConfig::registerMap& registers){
+
+  int loaded = 0;
+    for(int a=0; a<TRestRawDAQMetadata::nAsics; a++){
+      if(!fec.asic_isActive[a])continue;
+      PedestalStore::asicPedestals entry;
+      //Any age, but the FEM has to hold the pedestals of the entry, i.e. reloaded from the store
+      const bool valid = PedestalStore::Load(PedestalStore::GetFileName(storeDir, fec, a), entry) &&
+                         PedestalStore::IsValid(entry, fec, a, entry.timestamp, std::numeric_limits<double>::max()) &&
+                         FEMConfig::IsApplied(PedestalStore::GetCommands(entry), registers);
+      //Same channel numbering than the FEMINOS and ARC decoders, the thresholds of a previous load are cleared
+      for(int c=0; c<TRestRawDAQMetadata::nChannels; c++)
+        SetThreshold(c + a*72 + fec.id*288, valid && (size_t)c < entry.thr.size() ? entry.thr[c] : -1);
+      if(valid)loaded++;
+    }
+
+  std::cout<<"FEM "<<fec.id<<" software zero suppression with stored thresholds for "<<loaded<<" ASICs"<<std::endl;
+  return loaded;
+}
+
+void ZeroSuppression::SetThreshold(int channel, int threshold){
+  if(channel < 0)return;
+  if((size_t)channel >= thresholds.size())thresholds.resize(channel + 1, -1);
+  thresholds[channel] = threshold;
+}
+
+bool ZeroSuppression::Apply(int channel, std::vector<Short_t>& data){
+
+  const int n = data.size();
+  Short_t* __restrict d = data.data();
+
+  double thr;
+    if(channel >= 0 && (size_t)channel < thresholds.size() && thresholds[channel] >= 0){
+      thr = thresholds[channel];
+    } else {
+      const int b1 = std::min(baselineEnd, n);
+      int64_t sum = 0, sum2 = 0;
+        for(int i=baselineStart; i<b1; i++){
+          const int32_t x = d[i];
+          sum += x;
+          sum2 += x * x;
+        }
+      const double nb = b1 - baselineStart;
+      const double mean = nb > 0 ? sum / nb : 0;
+      thr = mean + nSigmas * (nb > 0 ? std::sqrt(std::max(0., sum2 / nb - mean * mean)) : 0);
+    }
+  const Short_t t = std::min(std::floor(thr), (double)std::numeric_limits<Short_t>::max());
+
+  //[zeroFrom, n) are not kept yet
+  int zeroFrom = 0;
+  int kept = 0;
+  auto over = [&](int i){
+    const int start = std::max(zeroFrom, i - preSamples);
+    std::fill(d + zeroFrom, d + start, 0);
+    const int end = std::min(n, i + postSamples + 1);
+      if(end > zeroFrom){
+        kept += end - start;
+        zeroFrom = end;
+      }
+  };
+
+  int i = 0;
+    for(; i + lanes <= n; i += lanes){
+      int found = 0;
+      for(int l=0; l<lanes; l++)found |= d[i + l] > t;
+      if(!found)continue;
+      for(int l=0; l<lanes; l++)if(d[i + l] > t)over(i + l);
+    }
+  for(; i<n; i++)if(d[i] > t)over(i);
+
+  channels.fetch_add(1, std::memory_order_relaxed);
+  samples.fetch_add(n, std::memory_order_relaxed);
+  if(kept == 0)return false;
+
+  std::fill(d + zeroFrom, d + n, 0);
+  keptChannels.fetch_add(1, std::memory_order_relaxed);
+  keptSamples.fetch_add(kept, std::memory_order_relaxed);
+
+  return true;
+}
+
+void ZeroSuppression::PrintSummary(const std::string& name) const {
+
+  const uint64_t nCh = channels, nS = samples;
+  std::cout << "Software zero suppression of " << name << ": " << keptChannels << " of " << nCh << " channels kept, "
+            << (nS ? 100. * keptSamples / nS : 0.) << "% of the samples" << std::endl;
+}
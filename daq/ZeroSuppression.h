@@ -0,0 +1,62 @@
+/*********************************************************************************
+ZeroSuppression.h
+
+Host side zero suppression of full waveform data, applied by the decoders
+before the signals are added to the event
+
+A sample is over threshold if it is above the threshold of its channel: the
+one stored in the pedestal store for FEMINOS and ARC (the FEMs subtract the
+pedestals in data taking runs), only if the FEM holds the pedestals of that
+entry, or for the other channels the baseline of the signal plus a number of
+sigmas of the baseline. The
+samples within pre/post bins of a sample over threshold are kept, the others
+are set to 0 as in the zero suppressed data from the electronics, and the
+channels without samples over threshold are dropped.
+
+The samples are compared in blocks of fixed width, vectorized by the compiler,
+only the blocks with samples over threshold are scanned sample by sample.
+
+*********************************************************************************/
+
+#ifndef __ZERO_SUPPRESSION__
+#define __ZERO_SUPPRESSION__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FEMConfig.h"
+#include "TRestRawDAQMetadata.h"
+#include "TRestRawSignal.h"
+
+class ZeroSuppression {
+  public:
+    static constexpr int lanes = 16;
+
+    ZeroSuppression(double nSigmas, int baselineStart, int baselineEnd, int preSamples, int postSamples);
+
+    //Thresholds of a FEC (FEMINOS and ARC channel numbering) from the pedestal store, number of ASICs loaded.
+    //Only the entries whose pedestals are loaded in the FEM registers are used, e.g. not after a power cycle,
+    //the other ASICs use the baseline. Set while no data is flowing, they are read without locking
+    int LoadThresholds(const std::string& storeDir, const TRestRawDAQMetadata::FECMetadata& fec, const FEMConfig::registerMap& registers);
+    void SetThreshold(int channel, int threshold);
+
+    //false if the channel has to be dropped, thread safe
+    bool Apply(int channel, std::vector<Short_t>& data);
+
+    //Of the backend given by name
+    void PrintSummary(const std::string& name) const;
+
+  private:
+    const double nSigmas;
+    const int baselineStart, baselineEnd;
+    const int preSamples, postSamples;
+
+    std::vector<int> thresholds;//Indexed by physical channel, -1 uses the baseline
+
+    std::atomic<uint64_t> channels{0}, keptChannels{0};
+    std::atomic<uint64_t> samples{0}, keptSamples{0};
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*********************************************************************************
+ARCEmulator.cxx
+
+Framing of the ARC emulator, see ARCPacket.h
+
+*********************************************************************************/
+
+#include "FEMEmulator.h"
+#include "ARCPacket.h"
+
+#include <algorithm>
+
+std::vector<uint16_t> ARCEmulator::ConfigFrame(int error, const std::string& msg){
+
+  std::vector<uint16_t> frame;
+  frame.push_back(PUT_VERSION_ST_SID(PFX_START_OF_CFRAME, CURRENT_FRAMING_VERSION, 0, femId));
+  frame.push_back((uint16_t)error);
+    if(!msg.empty()){
+      const size_t len = msg.size() + 1;//Including the null character
+        if(len <= 0xFF){
+          frame.push_back(PUT_ASCII_LEN(len));
+        } else {
+          frame.push_back(PFX_LONG_ASCII_MSG);
+          frame.push_back(len);
+        }
+        for(size_t j=0; j<len; j+=2){
+          const uint16_t lo = j < msg.size() ? (uint8_t)msg[j] : 0;
+          const uint16_t hi = j + 1 < msg.size() ? (uint8_t)msg[j+1] : 0;
+          frame.push_back(lo | (hi << 8));
+        }
+    }
+  frame.push_back(PFX_END_OF_FRAME);
+
+  return frame;
+}
+
+//The histogram statistics are only included for a single channel, as done with "hped <asic> <channel> getsummary"
+std::vector<uint16_t> ARCEmulator::PedestalFrame(int asic, const std::vector<int>& channels, bool stats){
+
+  std::vector<uint16_t> frame;
+  frame.push_back(PUT_VERSION_ST_SID(PFX_START_OF_MFRAME, CURRENT_FRAMING_VERSION, 0, femId));
+  frame.push_back(0);//Size, filled below
+
+  auto push32 = [&frame](uint32_t v, bool hiFirst){
+    if(hiFirst){ frame.push_back(v >> 16); frame.push_back(v & 0xFFFF); }
+    else { frame.push_back(v & 0xFFFF); frame.push_back(v >> 16); }
+  };
+
+    for(const auto c : channels){
+      const uint32_t mean = GetPedMean(asic, c) * 100;
+      const uint32_t rms = GetPedRms() * 100;
+        if(stats){
+          const uint32_t minBin = std::max(0., GetPedMean(asic, c) - 5 * GetPedRms());
+          frame.push_back(PFX_EXTD_CARD_CHIP_CHAN_HISTO);
+          frame.push_back(PUT_EXTD_CARD_CHIP_CHAN(femId, asic, c));
+          frame.push_back(PFX_PEDESTAL_HSTAT);
+          push32(minBin, true);
+          push32(minBin + 10 * GetPedRms(), true);
+          push32(1, true);
+          push32(10 * GetPedRms() + 1, true);
+          push32(minBin, true);
+          push32(minBin + 10 * GetPedRms(), true);
+          push32(mean, true);
+          push32(rms, true);
+          push32(GetPedEntries(), true);
+        }
+      frame.push_back(PFX_EXTD_CARD_CHIP_CHAN_H_MD);
+      frame.push_back(PUT_EXTD_CARD_CHIP_CHAN(femId, asic, c));
+      push32(mean, false);
+      push32(rms, false);
+    }
+
+  frame.push_back(PFX_END_OF_FRAME);
+  frame[1] = frame.size() * sizeof(uint16_t);
+
+  return frame;
+}
+
+//The event is split in several frames if needed, a channel is never split. Every data frame
+//carries a sequence number after the header
+void ARCEmulator::SendEvent(uint32_t evCount, uint64_t ts, const std::vector<hit>& hits){
+
+  const size_t maxWords = conf.maxFrameSize / sizeof(uint16_t);
+  const size_t tailWords = 5;//End of event and end of frame
+  std::vector<uint16_t> frame;
+  uint32_t eventSize = 0;
+
+  auto newFrame = [&](){
+    frame.clear();
+    frame.push_back(PUT_VERSION_ST_SID(PFX_START_OF_DFRAME, CURRENT_FRAMING_VERSION, 0, femId));
+    frame.push_back(0);//Size, filled when sent
+    frame.push_back(PUT_FRAME_SEQ_NB(frameSeq++));
+  };
+  auto sendFrame = [&](){
+    frame.push_back(PFX_END_OF_FRAME);
+    frame[1] = frame.size() * sizeof(uint16_t);
+    eventSize += frame.size() * sizeof(uint16_t);
+    SendFrame(frame, true);
+  };
+
+  newFrame();
+  frame.push_back(PFX_START_OF_EVENT | (femId & 0x1F));
+  frame.push_back(ts & 0xFFFF);
+  frame.push_back((ts >> 16) & 0xFFFF);
+  frame.push_back((ts >> 32) & 0xFFFF);
+  frame.push_back(evCount & 0xFFFF);
+  frame.push_back(evCount >> 16);
+
+    for(const auto &h : hits){
+      size_t words = 2;
+      for(const auto &[first, last] : h.ranges)words += 1 + last - first;
+        if(frame.size() + words + tailWords > maxWords && frame.size() > 3){
+          sendFrame();
+          newFrame();
+        }
+      frame.push_back(PFX_EXTD_CARD_CHIP_CHAN_HIT_IX);
+      frame.push_back(((femId & 0x1F) << 9) | ((h.asic & 0x3) << 7) | (h.channel & 0x7F));
+        for(const auto &[first, last] : h.ranges){
+          frame.push_back(PFX_TIME_BIN_IX | (first & 0x1FF));
+          for(int s=first; s<last; s++)frame.push_back(PFX_ADC_SAMPLE | (h.samples[s] & 0xFFF));
+        }
+    }
+
+  eventSize += (frame.size() + tailWords) * sizeof(uint16_t);
+  frame.push_back(PFX_END_OF_EVENT | (femId & 0x1F));
+  frame.push_back(0);
+  frame.push_back(eventSize >> 16);
+  frame.push_back(eventSize & 0xFFFF);
+  sendFrame();
+}
@@ -0,0 +1,328 @@
+/*********************************************************************************
+DCCEmulator.cxx
+
+UDP emulator of a DCC with its FEMs and FECs, see DCCPacket.h
+
+*********************************************************************************/
+
+#include "DCCEmulator.h"
+#include "DCCPacket.h"
+#include "TRESTDAQSocket.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace {
+  inline void Put16(std::vector<uint8_t>& pck, uint16_t w){
+    const uint16_t n = htons(w);
+    const uint8_t* b = (const uint8_t*)&n;
+    pck.push_back(b[0]);
+    pck.push_back(b[1]);
+  }
+
+  inline void Set16(std::vector<uint8_t>& pck, size_t word, uint16_t w){
+    const uint16_t n = htons(w);
+    memcpy(&pck[2*word], &n, sizeof(n));
+  }
+}
+
+DCCEmulator::DCCEmulator(const std::string& i, const FEMEmulator::settings& s) :
+  ip(i), conf(s), nSamples(std::min(s.nSamples, 511)), generator(0xDCC, s.noise, s.occupancy) {
+
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(sock < 0){
+      std::string error ="Socket opening failed: " + std::string(strerror(errno));
+      throw (TRESTDAQException(error));
+    }
+
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  //Wake up periodically to check if the emulator is stopped
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 100000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(REMOTE_DST_PORT);
+    if(inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1){
+      close(sock);
+      throw (TRESTDAQException("Invalid IP address " + ip));
+    }
+    if(bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+      std::string error ="Cannot bind " + ip + ":" + std::to_string(REMOTE_DST_PORT) + ": " + std::string(strerror(errno));
+      close(sock);
+      throw (TRESTDAQException(error));
+    }
+
+  //Same pedestals in every execution
+  std::mt19937 gen(0xDCC);
+  std::uniform_real_distribution<double> base(220, 280);
+    for(int f=0; f<nFecs; f++)
+      for(int a=0; a<nAsics; a++)
+        for(int c=0; c<nChannels; c++)chanBase[f][a][c] = base(gen);
+
+  tsStart = triggerTime = std::chrono::steady_clock::now();
+}
+
+DCCEmulator::~DCCEmulator(){
+  Stop();
+  if(sock >= 0)close(sock);
+}
+
+void DCCEmulator::Start(){
+  running = true;
+  commandThread = std::thread(&DCCEmulator::CommandThread, this);
+  std::cout<<"DCC emulator listening on "<<ip<<":"<<REMOTE_DST_PORT<<std::endl;
+}
+
+void DCCEmulator::Stop(){
+  running = false;
+  if(commandThread.joinable())commandThread.join();
+}
+
+void DCCEmulator::PrintStats() const {
+  std::cout<<"DCC ("<<ip<<"): "<<nCommands<<" commands, "<<nEvents<<" events, "<<nPackets<<" data packets ("
+           <<nBytes/1024<<" kB), "<<nDropped<<" packets dropped"<<std::endl;
+}
+
+void DCCEmulator::CommandThread(){
+
+  char buf_rcv[8192];
+    while(running){
+      struct sockaddr_in src;
+      socklen_t src_size = sizeof(src);
+      const ssize_t length = recvfrom(sock, buf_rcv, sizeof(buf_rcv) - 1, 0, (struct sockaddr*)&src, &src_size);
+      if(length <= 0)continue;//Timeout
+
+      buf_rcv[length] = '\0';
+      std::string cmd(buf_rcv);
+      while(!cmd.empty() && (cmd.back() == '\n' || cmd.back() == '\r' || cmd.back() == '\0'))cmd.pop_back();
+
+      nCommands++;
+      const auto reply = HandleCommand(cmd);
+      if(conf.verbose)std::cout<<"DCC command: "<<cmd<<" ("<<reply.size()<<" packets)"<<std::endl;
+
+      if(conf.latency > 0)std::this_thread::sleep_for(std::chrono::microseconds((int64_t)conf.latency));
+
+        for(const auto &pck : reply){
+          const bool binary = pck.size() > 2 && pck[0] == 0 && pck[1] == 0;//Padded
+            if(binary){
+              nPackets++;
+                if(conf.loss > 0 && generator.Uniform() < conf.loss){
+                  nDropped++;
+                  continue;
+                }
+              nBytes += pck.size();
+            }
+            if(sendto(sock, pck.data(), pck.size(), 0, (struct sockaddr*)&src, src_size) < 0){
+              std::cerr<<"DCC sendto failed: "<<strerror(errno)<<std::endl;
+            }
+        }
+    }
+}
+
+//Negative error codes start with '-', which is the error flag checked by the DAQ
+std::vector<uint8_t> DCCEmulator::AsciiReply(int error, const std::string& msg) const {
+  const std::string rep = std::to_string(error) + " " + msg + "\n";
+  return std::vector<uint8_t>(rep.begin(), rep.end());
+}
+
+//Inverse of DCCPacket::Arg12ToFecAsicChannel
+uint16_t DCCEmulator::GetArgs(int fec, int asic, int channel, bool compress){
+  const int index = fec * 4 + asic;
+  const uint16_t arg1 = channel * 6 + index / 5;
+  const uint16_t arg2 = index % 5;
+  return (compress ? 0x2000 : 0) | ((arg2 & 0xF) << 9) | (arg1 & 0x1FF);
+}
+
+uint16_t DCCEmulator::GetDCCHeader(int fec, int asic, bool last) const {
+
+  int flags = FRAME_TYPE_FEM_DATA;
+    if(last){
+      flags |= FRAME_FLAG_EORQ;
+      int lastFec = nFecs - 1;
+      while(lastFec > 0 && !(fecMask & (1 << lastFec)))lastFec--;
+      if(fec == lastFec && asic == nAsics - 1)flags |= FRAME_FLAG_EOEV;
+    }
+
+  return PUT_FRAME_TY_V2(PUT_DCC_INDEX(PUT_FEM_INDEX(0, 0), 0), flags);
+}
+
+//The event is triggered after the SCA start, not before the period given by the rate since the previous one
+bool DCCEmulator::WaitForTrigger(int64_t timeout){
+
+    if(!eventReady && scaRunning){
+      const auto limit = std::chrono::steady_clock::now() + std::chrono::microseconds(std::min<int64_t>(timeout, 1000000));
+      std::this_thread::sleep_until(std::min(limit, triggerTime));
+        if(std::chrono::steady_clock::now() >= triggerTime){
+          eventReady = true;
+          evCount++;
+          nEvents++;
+          ts = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tsStart).count() / 10;
+        }
+    } else if (!eventReady){
+      std::this_thread::sleep_for(std::chrono::microseconds(std::min<int64_t>(timeout, 100000)));
+    }
+
+  return eventReady;
+}
+
+//One packet per channel, only the ones with samples over threshold in zero suppression mode
+void DCCEmulator::DataRequest(int mode, int fec, int asic, int chStart, int chEnd, std::vector<std::vector<uint8_t> >& reply){
+
+  std::vector<uint16_t> samples;
+  std::vector<std::pair<int, int> > ranges;
+  const bool compress = mode == 1;
+
+    for(int c=chStart; c<=chEnd; c++){
+      generator.Waveform(chanBase[fec][asic][c] - ped[fec][asic][c], nSamples, samples);
+        if(compress){
+          SignalGenerator::ZeroSuppress(samples, thr[fec][asic][c], ranges);
+          if(ranges.empty())continue;
+        } else {
+          ranges.assign(1, {0, nSamples});
+        }
+
+      std::vector<uint8_t> pck = {0, 0};//Padding
+      Put16(pck, 0);//Size, filled below
+      Put16(pck, GetDCCHeader(fec, asic, false));
+      Put16(pck, PUT_TYPE(0, RESP_TYPE_ADC_DATA));
+      Put16(pck, GetArgs(fec, asic, c, compress));
+      Put16(pck, ts >> 16);
+      Put16(pck, ts & 0xFFFF);
+      Put16(pck, evCount & 0x3FFF);
+      Put16(pck, 0);//Sample count, filled below
+      uint16_t scnt = 0;
+        for(const auto &[first, last] : ranges){
+          Put16(pck, CELL_INDEX_FLAG | first);
+          for(int s=first; s<last; s++)Put16(pck, samples[s] & 0xFFF);
+          scnt += 1 + last - first;
+        }
+      Put16(pck, 0);//Trailer
+      Put16(pck, 0);
+      Set16(pck, 1, pck.size() - 2);
+      Set16(pck, 8, scnt);
+      reply.emplace_back(std::move(pck));
+    }
+
+    //The request is always closed, with an empty packet if there is no data
+    if(reply.empty()){
+      std::vector<uint8_t> pck = {0, 0};
+      Put16(pck, 0);
+      Put16(pck, GetDCCHeader(fec, asic, false));
+      Put16(pck, PUT_TYPE(0, RESP_TYPE_ADC_DATA));
+      Put16(pck, GetArgs(fec, asic, chStart, compress));
+      Put16(pck, ts >> 16);
+      Put16(pck, ts & 0xFFFF);
+      Put16(pck, evCount & 0x3FFF);
+      for(int i=0; i<5; i++)Put16(pck, 0);//Sample count, two empty samples and trailer
+      Set16(pck, 1, pck.size() - 2);
+      reply.emplace_back(std::move(pck));
+    }
+
+  Set16(reply.back(), 2, GetDCCHeader(fec, asic, true));
+}
+
+std::vector<uint8_t> DCCEmulator::PedestalSummary(int fec, int asic){
+
+  std::vector<uint8_t> pck = {0, 0};//Padding
+  Put16(pck, 10 + 4 * nChannels);
+  Put16(pck, GetDCCHeader(fec, asic, true));
+  Put16(pck, PUT_TYPE(0, RESP_TYPE_HISTOSUMMARY));
+  Put16(pck, GetArgs(fec, asic, 0, false));
+  Put16(pck, 2 * nChannels);
+    for(int c=0; c<nChannels; c++){
+      Put16(pck, pedEntries[fec][asic] > 0 ? (chanBase[fec][asic][c] - ped[fec][asic][c]) * 100 : 0);
+      Put16(pck, pedEntries[fec][asic] > 0 ? conf.noise * 100 : 0);
+    }
+
+  return pck;
+}
+
+std::vector<std::vector<uint8_t> > DCCEmulator::HandleCommand(const std::string& cmd){
+
+  std::istringstream ss(cmd);
+  std::vector<std::string> tk;
+  std::string t;
+  while(ss >> t)tk.push_back(t);
+
+  std::vector<std::vector<uint8_t> > reply;
+  if(tk.empty())return {AsciiReply(-1, "Empty command")};
+
+  double val = 0;
+  std::vector<int> fecs, asics, channels;
+
+    if(tk[0] == "pokeb" && tk.size() == 3 && FEMEmulator::ParseValue(tk[1], val) && val == 0x4 && FEMEmulator::ParseValue(tk[2], val)){
+      fecMask = ~(int)val & 0x3F;//Inverted mask
+    } else if(tk[0] == "sca" && tk.size() == 3 && tk[1] == "cnt" && FEMEmulator::ParseValue(tk[2], val)){
+      nSamples = std::max(1, std::min({(int)val, conf.nSamples, 511}));
+    } else if(tk[0] == "isobus" && tk.size() == 2 && FEMEmulator::ParseValue(tk[1], val)){
+      const int code = val;
+        if(code == 0x4F){//Reset event counter and time stamp
+          evCount = 0;
+          tsStart = std::chrono::steady_clock::now();
+        } else if(code == 0x6C){//SCA start
+          scaRunning = true;
+          eventReady = false;
+          const auto period = std::chrono::nanoseconds(conf.rate > 0 ? (int64_t)(1E9 / conf.rate) : 0);
+          triggerTime = std::max(std::chrono::steady_clock::now(), triggerTime + period);
+        } else if(code == 0x1C){//SCA stop, internal trigger
+          WaitForTrigger(0);
+        }
+    } else if(tk[0] == "wait" && tk.size() == 2 && FEMEmulator::ParseValue(tk[1], val)){
+      if(!WaitForTrigger(val))return {AsciiReply(-1, "wait: timeout")};
+      scaRunning = false;
+    } else if(tk[0] == "areq" && tk.size() == 6){
+      double mode, fec, asic, chStart, chEnd;
+        if(!FEMEmulator::ParseValue(tk[1], mode) || !FEMEmulator::ParseValue(tk[2], fec) || !FEMEmulator::ParseValue(tk[3], asic) || !FEMEmulator::ParseValue(tk[4], chStart) ||
+           !FEMEmulator::ParseValue(tk[5], chEnd) || fec < 0 || fec >= nFecs || asic < 0 || asic >= nAsics || chStart < 0 || chEnd >= nChannels || chStart > chEnd){
+          return {AsciiReply(-1, "Syntax error: " + cmd)};
+        }
+      DataRequest(mode, fec, asic, chStart, chEnd, reply);
+      return reply;
+    } else if(tk[0] == "hped" && tk.size() >= 5){//hped <verb> <fec> <asic> <channels> [args]
+        if(!FEMEmulator::ParseSelector(tk[2], nFecs, fecs) || !FEMEmulator::ParseSelector(tk[3], nAsics, asics) ||
+           !FEMEmulator::ParseSelector(tk[4], nChannels, channels)){
+          return {AsciiReply(-1, "Syntax error: " + cmd)};
+        }
+      std::vector<double> args;
+        for(size_t i=5; i<tk.size(); i++){
+          if(!FEMEmulator::ParseValue(tk[i], val))break;
+          args.push_back(val);
+        }
+
+        if(tk[1] == "clr"){
+          for(const auto f : fecs)
+            for(const auto a : asics)pedEntries[f][a] = 0;
+        } else if(tk[1] == "acc"){
+          for(const auto f : fecs)
+            for(const auto a : asics)pedEntries[f][a] += nSamples;
+        } else if(tk[1] == "getsummary"){
+          return {PedestalSummary(fecs.front(), asics.front())};
+        } else if(tk[1] == "centermean" && args.size() == 1){
+          for(const auto f : fecs)
+            for(const auto a : asics)
+              for(const auto c : channels)ped[f][a][c] = std::round(chanBase[f][a][c]) - args[0];
+        } else if(tk[1] == "setthr" && args.size() == 2){
+          for(const auto f : fecs)
+            for(const auto a : asics)
+              for(const auto c : channels)thr[f][a][c] = args[0] + std::round(args[1] * conf.noise);
+        } else {
+          return {AsciiReply(-1, "Unknown hped command: " + cmd)};
+        }
+    }
+    //Any other command (fem, fec, pokes, asic...) is acknowledged without effect
+
+  return {AsciiReply(0, cmd)};
+}
@@ -0,0 +1,81 @@
+/*********************************************************************************
+DCCEmulator.h
+
+UDP emulator of a DCC with its FEMs and FECs, to test TRESTDAQDCC without
+hardware
+
+The DCC protocol is request/response: every command is answered with an ASCII
+reply, except "areq" and "hped getsummary" which are answered with binary
+packets (see DCCPacket.h). The last packet of a request is flagged with EORQ,
+and with EOEV if it is the last ASIC of the last FEC in the FEC mask. The
+replies can be delayed and dropped to test the timeouts of the readout.
+
+*********************************************************************************/
+
+#ifndef __DCC_EMULATOR__
+#define __DCC_EMULATOR__
+
+#include "FEMEmulator.h"
+#include "SignalGenerator.h"
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+class DCCEmulator {
+  public:
+    static constexpr int nFecs = 6;
+    static constexpr int nAsics = 4;
+    static constexpr int nChannels = 79;
+
+    DCCEmulator(const std::string& ip, const FEMEmulator::settings& s);
+    ~DCCEmulator();
+
+    void Start();
+    void Stop();
+    void PrintStats() const;
+
+  private:
+    void CommandThread();
+    //Returns the packets of the reply
+    std::vector<std::vector<uint8_t> > HandleCommand(const std::string& cmd);
+    std::vector<uint8_t> AsciiReply(int error, const std::string& msg) const;
+    void DataRequest(int mode, int fec, int asic, int chStart, int chEnd, std::vector<std::vector<uint8_t> >& reply);
+    std::vector<uint8_t> PedestalSummary(int fec, int asic);
+    bool WaitForTrigger(int64_t timeout);
+    uint16_t GetDCCHeader(int fec, int asic, bool last) const;
+    static uint16_t GetArgs(int fec, int asic, int channel, bool compress);
+
+    const std::string ip;
+    const FEMEmulator::settings conf;
+
+    int sock = -1;
+    std::thread commandThread;
+    std::atomic<bool> running{false};
+
+    //State set by the commands, only used by the command thread
+    uint8_t fecMask = 0x1;
+    int nSamples = 511;
+    bool scaRunning = false;
+    bool eventReady = false;
+    std::chrono::steady_clock::time_point triggerTime;
+    std::chrono::steady_clock::time_point tsStart;
+    uint32_t evCount = 0;
+    uint32_t ts = 0;
+    int ped[nFecs][nAsics][nChannels] = {};
+    int thr[nFecs][nAsics][nChannels] = {};
+    double chanBase[nFecs][nAsics][nChannels] = {};
+    uint32_t pedEntries[nFecs][nAsics] = {};
+
+    //Statistics
+    std::atomic<uint64_t> nCommands{0}, nEvents{0}, nPackets{0}, nDropped{0}, nBytes{0};
+
+    SignalGenerator generator;
+};
+
+#endif
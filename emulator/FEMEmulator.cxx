@@ -0,0 +1,344 @@
+/*********************************************************************************
+FEMEmulator.cxx
+
+Command server and event generator shared by the FEMINOS and ARC emulators
+
+*********************************************************************************/
+
+#include "FEMEmulator.h"
+#include "TRESTDAQSocket.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+FEMEmulator::FEMEmulator(const std::string& i, int id, const settings& s) :
+  ip(i), femId(id), conf(s), generator(id + 1, s.noise, s.occupancy) {
+
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(sock < 0){
+      std::string error ="Socket opening failed: " + std::string(strerror(errno));
+      throw (TRESTDAQException(error));
+    }
+
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  //Wake up periodically to check if the emulator is stopped
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 100000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(REMOTE_DST_PORT);
+    if(inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1){
+      close(sock);
+      throw (TRESTDAQException("Invalid IP address " + ip));
+    }
+    if(bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+      std::string error ="Cannot bind " + ip + ":" + std::to_string(REMOTE_DST_PORT) + ": " + std::string(strerror(errno));
+      close(sock);
+      throw (TRESTDAQException(error));
+    }
+
+  //Same pedestals for a given FEM in every execution
+  std::mt19937 gen(femId + 1);
+  std::uniform_real_distribution<double> base(220, 280);
+    for(int a=0; a<nAsics; a++)
+      for(int c=0; c<nChannels; c++)chanBase[a][c] = base(gen);
+
+  tsStart = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1E6;
+}
+
+FEMEmulator::~FEMEmulator(){
+  Stop();
+  if(sock >= 0)close(sock);
+}
+
+void FEMEmulator::Start(){
+  running = true;
+  commandThread = std::thread(&FEMEmulator::CommandThread, this);
+  dataThread = std::thread(&FEMEmulator::DataThread, this);
+  std::cout<<"FEM "<<femId<<" emulator listening on "<<ip<<":"<<REMOTE_DST_PORT<<std::endl;
+}
+
+void FEMEmulator::Stop(){
+  running = false;
+  if(commandThread.joinable())commandThread.join();
+  if(dataThread.joinable())dataThread.join();
+}
+
+void FEMEmulator::PrintStats() const {
+  std::cout<<"FEM "<<femId<<" ("<<ip<<"): "<<nCommands<<" commands, "<<nEvents<<" events, "<<nFrames<<" data frames ("
+           <<nBytes/1024<<" kB), "<<nDropped<<" frames dropped"<<std::endl;
+}
+
+//The padding word is prepended as done by the FEM, data frames can be dropped to emulate losses
+void FEMEmulator::SendFrame(const std::vector<uint16_t>& frame, bool data){
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if(!hasClient)return;
+  const struct sockaddr_in dst = client;
+  lock.unlock();
+
+    if(data){
+      nFrames++;
+        if(conf.loss > 0 && generator.Uniform() < conf.loss){
+          nDropped++;
+          return;
+        }
+      nBytes += frame.size() * sizeof(uint16_t);
+    }
+
+  std::vector<uint16_t> buf(frame.size() + 1, 0);
+  std::copy(frame.begin(), frame.end(), buf.begin() + 1);
+    if(sendto(sock, buf.data(), buf.size() * sizeof(uint16_t), 0, (struct sockaddr*)&dst, sizeof(dst)) < 0){
+      std::cerr<<"FEM "<<femId<<" sendto failed: "<<strerror(errno)<<std::endl;
+    }
+}
+
+double FEMEmulator::GetPedMean(int asic, int channel) const {
+  if(subtractPed)return chanBase[asic][channel] - ped[asic][channel];
+  return chanBase[asic][channel];
+}
+
+//Time stamp in 20 ns units since the last "clr tstamp"
+uint64_t FEMEmulator::GetTimeStamp() const {
+  const double now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1E6;
+  return (uint64_t)((now - tsStart) / 2E-8) & 0xFFFFFFFFFFFF;
+}
+
+void FEMEmulator::CommandThread(){
+
+  char buf_rcv[8192];
+    while(running){
+      struct sockaddr_in src;
+      socklen_t src_size = sizeof(src);
+      const ssize_t length = recvfrom(sock, buf_rcv, sizeof(buf_rcv) - 1, 0, (struct sockaddr*)&src, &src_size);
+      if(length <= 0)continue;//Timeout
+
+      buf_rcv[length] = '\0';
+      std::string cmd(buf_rcv);
+      while(!cmd.empty() && (cmd.back() == '\n' || cmd.back() == '\r' || cmd.back() == '\0'))cmd.pop_back();
+
+      std::unique_lock<std::mutex> lock(mutex);
+      client = src;
+      hasClient = true;
+      lock.unlock();
+
+      nCommands++;
+      std::vector<uint16_t> reply;
+      const bool sendReply = HandleCommand(cmd, reply);
+      if(conf.verbose)std::cout<<"FEM "<<femId<<" command: "<<cmd<<(sendReply ? "" : " (no reply)")<<std::endl;
+      if(sendReply)SendFrame(reply, false);
+    }
+}
+
+bool FEMEmulator::ParseValue(const std::string& str, double& value){
+  if(str.empty())return false;
+  char* end;
+  value = str.find("0x") == 0 ? (double)strtol(str.c_str(), &end, 16) : strtod(str.c_str(), &end);
+  return *end == '\0';
+}
+
+//Channel or ASIC selector: "*", "hi:lo" or a single value
+bool FEMEmulator::ParseSelector(const std::string& sel, int max, std::vector<int>& values){
+
+  values.clear();
+    if(sel == "*"){
+      for(int i=0; i<max; i++)values.push_back(i);
+      return true;
+    }
+
+  double hi, lo;
+  const size_t pos = sel.find(':');
+    if(pos != std::string::npos){
+      if(!ParseValue(sel.substr(0, pos), hi) || !ParseValue(sel.substr(pos + 1), lo))return false;
+      if(hi < lo)std::swap(hi, lo);
+    } else {
+      if(!ParseValue(sel, hi))return false;
+      lo = hi;
+    }
+
+  if(lo < 0 || hi >= max)return false;
+  for(int i=lo; i<=hi; i++)values.push_back(i);
+  return true;
+}
+
+//Returns false if the command is not replied, which is the case of the data requests while the data are served
+bool FEMEmulator::HandleCommand(const std::string& cmd, std::vector<uint16_t>& reply){
+
+  std::istringstream ss(cmd);
+  std::vector<std::string> tk;
+  std::string t;
+  while(ss >> t)tk.push_back(t);
+
+    if(tk.empty()){
+      reply = ConfigFrame(-1, "Empty command");
+      return true;
+    }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  double val = 0, val2 = 0;
+  std::vector<int> asics, channels;
+
+    if(tk[0] == "daq"){
+      if(scaEnabled && serveTarget == 1){
+        daqRequest = true;
+        return false;
+      }
+      daqRequest = false;
+    } else if(tk[0] == "sca" && tk.size() == 3 && tk[1] == "enable" && ParseValue(tk[2], val)){
+      scaEnabled = val != 0;
+      if(scaEnabled)triggered = 0;
+      else daqRequest = false;
+    } else if(tk[0] == "serve_target" && tk.size() == 2 && ParseValue(tk[1], val)){
+      serveTarget = val;
+    } else if(tk[0] == "subtract_ped" && tk.size() == 2 && ParseValue(tk[1], val)){
+      subtractPed = val != 0;
+    } else if(tk[0] == "zero_suppress" && tk.size() == 2 && ParseValue(tk[1], val)){
+      zeroSuppress = val != 0;
+    } else if(tk[0] == "zs_pre_post" && tk.size() == 3 && ParseValue(tk[1], val) && ParseValue(tk[2], val2)){
+      zsPre = val;
+      zsPost = val2;
+    } else if(tk[0] == "event_limit" && tk.size() == 2 && ParseValue(tk[1], val)){
+      eventLimit = val == 0 ? 0 : std::pow(10, val - 1);//0x0:infinite; 0x1:1; 0x2:10; 0x3:100...
+    } else if(tk[0] == "asic_mask" && tk.size() == 2 && ParseValue(tk[1], val)){
+      asicMask = val;
+    } else if(tk[0] == "clr" && tk.size() == 2 && tk[1] == "evcnt"){
+      evCount = 0;
+    } else if(tk[0] == "clr" && tk.size() == 2 && tk[1] == "tstamp"){
+      tsStart = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1E6;
+    } else if(tk[0] == "rbf" && tk.size() == 2 && tk[1] == "getpnd"){
+      reply = ConfigFrame(0, "Pending requests: 0");
+      return true;
+    } else if((tk[0] == "ped" || tk[0] == "thr") && tk.size() == 4){
+        if(!ParseSelector(tk[1], nAsics, asics) || !ParseSelector(tk[2], nChannels, channels) || !ParseValue(tk[3], val)){
+          reply = ConfigFrame(-1, "Syntax error: " + cmd);
+          return true;
+        }
+      auto &reg = tk[0] == "ped" ? ped : thr;
+      for(const auto a : asics)
+        for(const auto c : channels)reg[a][c] = val;
+    } else if(tk[0] == "hped" && tk.size() >= 4){
+      //FEMINOS: hped <verb> <asic> <chan> [args], ARC: hped <asic> <chan> <verb> [args]
+      const bool verbFirst = !isdigit(tk[1][0]) && tk[1] != "*";
+      const std::string verb = verbFirst ? tk[1] : tk[3];
+      const std::string asicSel = verbFirst ? tk[2] : tk[1];
+      const std::string chanSel = verbFirst ? tk[3] : tk[2];
+      std::vector<double> args;
+        for(size_t i=4; i<tk.size(); i++){
+          if(!ParseValue(tk[i], val))break;
+          args.push_back(val);
+        }
+
+        if(!ParseSelector(asicSel, nAsics, asics) || !ParseSelector(chanSel, nChannels, channels)){
+          reply = ConfigFrame(-1, "Syntax error: " + cmd);
+          return true;
+        }
+
+        if(verb == "clr"){
+          pedEvents = 0;
+        } else if(verb == "getsummary"){
+          reply = PedestalFrame(asics.front(), channels, channels.size() == 1);
+          return true;
+        } else if(verb == "centermean" && args.size() == 1){
+          for(const auto a : asics)
+            for(const auto c : channels)ped[a][c] = std::round(chanBase[a][c]) - args[0];
+        } else if(verb == "setthr" && args.size() == 2){
+          for(const auto a : asics)
+            for(const auto c : channels)thr[a][c] = args[0] + std::round(args[1] * conf.noise);
+        } else if(verb != "offset"){
+          reply = ConfigFrame(-1, "Unknown hped command: " + cmd);
+          return true;
+        }
+    }
+    //Any other command is acknowledged without effect
+
+  reply = ConfigFrame(0, "");
+  return true;
+}
+
+//Returns false if there is no channel to send
+bool FEMEmulator::GenerateEvent(std::vector<hit>& hits){
+
+  hits.clear();
+  const int nSamples = conf.nSamples;
+
+    for(int a=0; a<nAsics; a++){
+      if(asicMask & (1 << a))continue;
+      for(int c=0; c<nDataChannels; c++){
+        hit h;
+        h.asic = a;
+        h.channel = c;
+        const double base = subtractPed ? chanBase[a][c] - ped[a][c] : chanBase[a][c];
+        generator.Waveform(base, nSamples, h.samples);
+          if(zeroSuppress){
+            SignalGenerator::ZeroSuppress(h.samples, thr[a][c], h.ranges, zsPre, zsPost);
+            if(h.ranges.empty())continue;
+          } else {
+            h.ranges.emplace_back(0, nSamples);
+          }
+
+        hits.emplace_back(std::move(h));
+      }
+    }
+
+  return !hits.empty();
+}
+
+void FEMEmulator::DataThread(){
+
+  const auto period = std::chrono::nanoseconds(conf.rate > 0 ? (int64_t)(1E9 / conf.rate) : 0);
+  auto next = std::chrono::steady_clock::now();
+  std::vector<hit> hits;
+
+    while(running){
+      std::unique_lock<std::mutex> lock(mutex);
+      const bool limit = eventLimit > 0 && triggered >= eventLimit;
+      const bool pedestal = scaEnabled && serveTarget == 2 && !limit;
+      const bool data = scaEnabled && serveTarget == 1 && daqRequest && !limit;
+        if(!pedestal && !data){
+          lock.unlock();
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          next = std::chrono::steady_clock::now();
+          continue;
+        }
+
+      triggered++;
+      const uint32_t ev = evCount++;
+        if(pedestal){
+          pedEvents++;
+          lock.unlock();
+        } else {
+          GenerateEvent(hits);
+          lock.unlock();
+          if(eventSent)eventSent(ev);
+          SendEvent(ev, GetTimeStamp(), hits);
+          nEvents++;
+        }
+
+        if(period.count() > 0){
+          next += period;
+          const auto now = std::chrono::steady_clock::now();
+          if(next < now - std::chrono::seconds(1))next = now;//Don't try to recover long delays
+          std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+FEMEmulator* FEMEmulator::Create(const std::string& electronics, const std::string& ip, int femId, const settings& s){
+  if(electronics == "FEMINOS")return new FEMINOSEmulator(ip, femId, s);
+  if(electronics == "ARC")return new ARCEmulator(ip, femId, s);
+  throw (TRESTDAQException("Unknown electronics " + electronics + " for the emulator"));
+}
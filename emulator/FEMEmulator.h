@@ -0,0 +1,154 @@
+/*********************************************************************************
+FEMEmulator.h
+
+UDP emulator of FEMINOS and ARC cards, to test TRESTDAQFEMINOS and TRESTDAQARC
+without hardware
+
+Every emulated card listens on REMOTE_DST_PORT of its own loopback address
+(e.g. 127.0.0.2), answers the ASCII commands with configuration or monitoring
+frames and streams data frames once the DAQ request is received with the
+SCA enabled. The framing of every electronics is implemented in
+FEMINOSEmulator.cxx and ARCEmulator.cxx, since FEMINOSPacket.h and ARCPacket.h
+cannot be included in the same translation unit.
+
+*********************************************************************************/
+
+#ifndef __FEM_EMULATOR__
+#define __FEM_EMULATOR__
+
+#include "SignalGenerator.h"
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class FEMEmulator {
+  public:
+    static constexpr int nAsics = 4;
+    static constexpr int nChannels = 79;
+    static constexpr int nDataChannels = 72;//Channels sent in data frames, the decoders map 72 channels per chip
+
+    struct settings {
+      double rate = 100;//Events per second, 0: as fast as possible
+      double occupancy = 0.1;//Fraction of channels with a pulse
+      double loss = 0;//Probability to drop a data frame
+      int nSamples = 512;
+      double noise = 4;//Pedestal RMS in ADC units
+      size_t maxFrameSize = 8000;//Bytes, the receive buffer of the DAQ is 8192 bytes
+      double latency = 0;//Reply delay in microseconds (DCC)
+      int verbose = 0;
+    };
+
+    struct hit {
+      int asic;
+      int channel;
+      std::vector<uint16_t> samples;
+      std::vector<std::pair<int, int> > ranges;//Time bins sent [first, last)
+    };
+
+    FEMEmulator(const std::string& ip, int femId, const settings& s);
+    virtual ~FEMEmulator();
+
+    void Start();
+    void Stop();
+    void PrintStats() const;
+
+    inline const std::string& GetIP() const { return ip; }
+    inline uint64_t GetBytesSent() const { return nBytes; }
+    //Called by the data thread with the event counter before the frames of every event are sent, set before Start
+    inline void SetEventCallback(std::function<void(uint32_t)> callback) { eventSent = callback; }
+
+    static FEMEmulator* Create(const std::string& electronics, const std::string& ip, int femId, const settings& s);
+
+    //Command arguments: "*", "hi:lo" or a single value, decimal or hexadecimal
+    static bool ParseSelector(const std::string& sel, int max, std::vector<int>& values);
+    static bool ParseValue(const std::string& str, double& value);
+
+  protected:
+    //Framing of the electronics, the frames don't include the padding word
+    virtual std::vector<uint16_t> ConfigFrame(int error, const std::string& msg) = 0;
+    virtual std::vector<uint16_t> PedestalFrame(int asic, const std::vector<int>& channels, bool stats) = 0;
+    virtual void SendEvent(uint32_t evCount, uint64_t ts, const std::vector<hit>& hits) = 0;
+
+    void SendFrame(const std::vector<uint16_t>& frame, bool data);
+
+    //Pedestal histograms, the mean follows the pedestal subtraction
+    double GetPedMean(int asic, int channel) const;
+    inline double GetPedRms() const { return conf.noise; }
+    inline uint32_t GetPedEntries() const { return pedEvents * conf.nSamples; }
+
+    const std::string ip;
+    const int femId;
+    const settings conf;
+
+  private:
+    void CommandThread();
+    void DataThread();
+    bool HandleCommand(const std::string& cmd, std::vector<uint16_t>& reply);
+    bool GenerateEvent(std::vector<hit>& hits);
+    uint64_t GetTimeStamp() const;
+
+    int sock = -1;
+    struct sockaddr_in client;
+    bool hasClient = false;
+
+    std::thread commandThread, dataThread;
+    std::atomic<bool> running{false};
+    mutable std::mutex mutex;//Protects the state below and the client address
+
+    //State set by the commands
+    bool scaEnabled = false;
+    bool daqRequest = false;
+    int serveTarget = 0;//0: drop data; 1: send to DAQ; 2: feed to pedestal histos
+    bool subtractPed = false;
+    bool zeroSuppress = false;
+    int zsPre = 0;//Time bins kept before and after the ones over threshold
+    int zsPost = 0;
+    uint32_t eventLimit = 0;//0: infinite
+    uint32_t triggered = 0;//Events since the SCA was enabled
+    uint8_t asicMask = 0;//1: ASIC disabled
+    int ped[nAsics][nChannels] = {};
+    int thr[nAsics][nChannels] = {};
+    double chanBase[nAsics][nChannels] = {};
+    uint32_t pedEvents = 0;
+    uint32_t evCount = 0;
+    double tsStart = 0;
+
+    //Statistics
+    std::atomic<uint64_t> nCommands{0}, nEvents{0}, nFrames{0}, nDropped{0}, nBytes{0};
+
+    SignalGenerator generator;
+    std::function<void(uint32_t)> eventSent;
+};
+
+class FEMINOSEmulator : public FEMEmulator {
+  public:
+    using FEMEmulator::FEMEmulator;
+
+  protected:
+    std::vector<uint16_t> ConfigFrame(int error, const std::string& msg) override;
+    std::vector<uint16_t> PedestalFrame(int asic, const std::vector<int>& channels, bool stats) override;
+    void SendEvent(uint32_t evCount, uint64_t ts, const std::vector<hit>& hits) override;
+};
+
+class ARCEmulator : public FEMEmulator {
+  public:
+    using FEMEmulator::FEMEmulator;
+
+  protected:
+    std::vector<uint16_t> ConfigFrame(int error, const std::string& msg) override;
+    std::vector<uint16_t> PedestalFrame(int asic, const std::vector<int>& channels, bool stats) override;
+    void SendEvent(uint32_t evCount, uint64_t ts, const std::vector<hit>& hits) override;
+
+  private:
+    uint16_t frameSeq = 0;
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*********************************************************************************
+SignalGenerator.cxx
+
+Waveforms of the emulated electronics
+
+*********************************************************************************/
+
+#include "SignalGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+SignalGenerator::SignalGenerator(uint32_t seed, double noise, double occ) : occupancy(occ) {
+
+  std::mt19937 gen(seed);
+  rndState = gen() | ((uint64_t)gen() << 32) | 1;
+
+  //The noise is taken from a table, sampling a gaussian for every time bin is too slow
+  std::normal_distribution<double> gaus(0, noise);
+  noiseTable.resize(65536);
+  for(auto &n : noiseTable)n = gaus(gen);
+
+  //Semi-gaussian shaping, normalized to the maximum
+  const double tau = 8;
+    for(int t=0; t<12*tau; t++){
+      const double x = t / tau;
+      pulseShape.push_back(std::pow(x, 3) * std::exp(-3 * (x - 1)));
+    }
+}
+
+bool SignalGenerator::Waveform(double baseline, int nSamples, std::vector<uint16_t>& samples){
+
+  wave.resize(nSamples);
+  samples.resize(nSamples);
+  for(int s=0; s<nSamples; s++)wave[s] = baseline + noiseTable[Random() & 0xFFFF];
+
+  const bool pulse = Uniform() < occupancy;
+    if(pulse){
+      const double amplitude = 100 + Uniform() * 1400;
+      const int t0 = nSamples / 4 + Uniform() * nSamples / 4;
+      for(size_t t=0; t<pulseShape.size() && t0 + t < (size_t)nSamples; t++)wave[t0 + t] += amplitude * pulseShape[t];
+    }
+
+  for(int s=0; s<nSamples; s++)samples[s] = std::min(std::max(std::round(wave[s]), 0.), 4095.);
+
+  return pulse;
+}
+
+void SignalGenerator::ZeroSuppress(const std::vector<uint16_t>& samples, int thr, std::vector<std::pair<int, int> >& ranges, int pre, int post){
+
+  ranges.clear();
+  const int nSamples = samples.size();
+  int first = -1;
+    for(int s=0; s<=nSamples; s++){
+      const bool above = s < nSamples && samples[s] > thr;
+        if(above && first < 0){
+          first = s;
+        } else if(!above && first >= 0){
+          const int begin = std::max(first - pre, 0);
+          const int end = std::min(s + post, nSamples);
+          if(!ranges.empty() && begin <= ranges.back().second)ranges.back().second = end;
+          else ranges.emplace_back(begin, end);
+          first = -1;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+/*********************************************************************************
+SignalGenerator.h
+
+Waveforms of the emulated electronics: pedestal with gaussian noise and
+semi-gaussian pulses on a fraction of the channels
+
+*********************************************************************************/
+
+#ifndef __SIGNAL_GENERATOR__
+#define __SIGNAL_GENERATOR__
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class SignalGenerator {
+  public:
+    SignalGenerator(uint32_t seed, double noise, double occupancy);
+
+    inline uint64_t Random(){//xorshift64
+      rndState ^= rndState << 13;
+      rndState ^= rndState >> 7;
+      rndState ^= rndState << 17;
+      return rndState;
+    }
+    inline double Uniform(){ return (Random() >> 11) * (1.0 / 9007199254740992.0); }
+
+    //Baseline plus noise, a pulse is added with a probability given by the occupancy. Returns true if there is a pulse
+    bool Waveform(double baseline, int nSamples, std::vector<uint16_t>& samples);
+
+    //Consecutive time bins above threshold [first, last), extended by pre bins before and post bins after
+    //as the zs_pre_post command of the FEMs, the overlapping ranges are merged
+    static void ZeroSuppress(const std::vector<uint16_t>& samples, int thr, std::vector<std::pair<int, int> >& ranges, int pre = 0, int post = 0);
+
+  private:
+    double occupancy;
+    uint64_t rndState;
+    std::vector<double> noiseTable;
+    std::vector<double> pulseShape;
+    std::vector<double> wave;
+};
+
+#endif
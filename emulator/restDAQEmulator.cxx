@@ -0,0 +1,128 @@
+/*********************************************************************************
+restDAQEmulator.cxx
+
+Emulator of FEMINOS, ARC and DCC electronics on the loopback interface, the
+FEM ip of the configuration file points to one of the emulated cards
+
+*********************************************************************************/
+
+#include <arpa/inet.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "DCCEmulator.h"
+#include "FEMEmulator.h"
+#include "TRESTDAQException.h"
+
+std::atomic<bool> stop(false);
+
+void signal_handler(int signum) {
+    std::cout << " signal handler " << signum << std::endl;
+    stop = true;
+}
+
+void help() {
+    std::cout << " Rest DAQ Emulator options:" << std::endl;
+    std::cout << "    --feminos <ip> : Emulate a FEMINOS card on <ip> (e.g. 127.0.0.2), can be repeated" << std::endl;
+    std::cout << "    --arc <ip>     : Emulate an ARC card on <ip>, can be repeated" << std::endl;
+    std::cout << "    --dcc <ip>     : Emulate a DCC with 6 FEC on <ip>, can be repeated" << std::endl;
+    std::cout << "    --rate <Hz>    : Event rate per card, 0 for as fast as possible (default 100)" << std::endl;
+    std::cout << "    --occupancy <f>: Fraction of channels with a pulse (default 0.1)" << std::endl;
+    std::cout << "    --loss <p>     : Probability to drop a data frame (default 0)" << std::endl;
+    std::cout << "    --samples <n>  : Number of time bins per channel (default 512, 511 max for the DCC)" << std::endl;
+    std::cout << "    --latency <us> : Delay of the DCC replies (default 0)" << std::endl;
+    std::cout << "    --v            : Print the received commands" << std::endl;
+    std::cout << "    --h            : Print this help" << std::endl;
+    std::cout << "The FEM id is taken from the last byte of the ip, every 127.0.0.x address is served by the loopback interface" << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+    FEMEmulator::settings conf;
+    std::vector<std::pair<std::string, std::string> > cards;
+    std::vector<std::string> dccs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if ((arg == "--feminos" || arg == "--arc") && hasValue) {
+            cards.emplace_back(arg == "--feminos" ? "FEMINOS" : "ARC", argv[++i]);
+        } else if (arg == "--dcc" && hasValue) {
+            dccs.emplace_back(argv[++i]);
+        } else if (arg == "--rate" && hasValue) {
+            conf.rate = std::stod(argv[++i]);
+        } else if (arg == "--occupancy" && hasValue) {
+            conf.occupancy = std::stod(argv[++i]);
+        } else if (arg == "--loss" && hasValue) {
+            conf.loss = std::stod(argv[++i]);
+        } else if (arg == "--samples" && hasValue) {
+            conf.nSamples = std::stoi(argv[++i]);
+        } else if (arg == "--latency" && hasValue) {
+            conf.latency = std::stod(argv[++i]);
+        } else if (arg == "--v") {
+            conf.verbose = 1;
+        } else if (arg == "--h") {
+            help();
+            return 0;
+        } else {  // unmatched options
+            std::cerr << "Warning argument " << arg << " not found" << std::endl;
+            help();
+            return -1;
+        }
+    }
+
+    if (cards.empty() && dccs.empty()) {
+        std::cerr << "Please provide at least one card with --feminos, --arc or --dcc" << std::endl;
+        help();
+        return -1;
+    }
+
+    if (conf.nSamples < 1 || conf.nSamples > 512) {
+        std::cerr << "Number of samples must be between 1 and 512" << std::endl;
+        return -1;
+    }
+
+    std::vector<std::unique_ptr<FEMEmulator> > emulators;
+    std::vector<std::unique_ptr<DCCEmulator> > dccEmulators;
+    try {
+        for (const auto& [electronics, ip] : cards) {
+            struct in_addr addr;
+            if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+                std::cerr << "Invalid ip " << ip << std::endl;
+                return -1;
+            }
+            const int femId = (ntohl(addr.s_addr) & 0xFF) & 0x1F;
+            emulators.emplace_back(FEMEmulator::Create(electronics, ip, femId, conf));
+            std::cout << electronics << " FEM " << femId << " on " << ip << std::endl;
+        }
+        for (const auto& ip : dccs) dccEmulators.emplace_back(new DCCEmulator(ip, conf));
+    } catch (const TRESTDAQException& e) {
+        std::cerr << "Cannot start the emulator: " << e.what() << std::endl;
+        return -1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    for (auto& em : emulators) em->Start();
+    for (auto& dcc : dccEmulators) dcc->Start();
+
+    while (!stop) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (auto& em : emulators) {
+        em->Stop();
+        em->PrintStats();
+    }
+    for (auto& dcc : dccEmulators) {
+        dcc->Stop();
+        dcc->PrintStats();
+    }
+
+    return 0;
+}
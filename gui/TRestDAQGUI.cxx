@@ -12,7 +12,7 @@ std::atomic<bool> TRestDAQGUI::exitGUI(false);
 std::atomic<int> TRestDAQGUI::status(-1);
 
 
-TRestDAQGUI::TRestDAQGUI(const int& p, const int& q, TRestDAQGUIMetadata *mt) {
+TRestDAQGUI::TRestDAQGUI(const int& p, const int& q, TRestDAQGUIMetadata *mt, int instance) {
     fMain = new TGMainFrame(gClient->GetRoot(), p, q, kHorizontalFrame);
 
     fMain->SetCleanup(kDeepCleanup);
@@ -20,7 +20,13 @@ TRestDAQGUI::TRestDAQGUI(const int& p, const int& q, TRestDAQGUIMetadata *mt) {
     guiMetadata = mt;
     
     if(guiMetadata==nullptr) guiMetadata = new TRestDAQGUIMetadata();
-    
+
+    //Shared memory of the manager instance, given or from the metadata
+    if(instance < 0) instance = guiMetadata->GetInstance();
+    if(!DAQInstance::Set(instance)) DAQInstance::Set(0);
+    std::cout << "restDAQManager instance " << DAQInstance::Get() << std::endl;
+    if(DAQInstance::Get() != 0) lastSetFile = "DAQLastSettings." + std::to_string(DAQInstance::Get()) + ".txt";
+
     LoadLastSettings();
     UpdateInputs();
 
@@ -96,7 +102,7 @@ TRestDAQGUI::TRestDAQGUI(const int& p, const int& q, TRestDAQGUIMetadata *mt) {
 
     fECanvas->GetCanvas()->Update();
 
-    fMain->SetWindowName("TRestDAQGUI");
+    fMain->SetWindowName(DAQInstance::Get() == 0 ? "TRestDAQGUI" : ("TRestDAQGUI instance " + std::to_string(DAQInstance::Get())).c_str());
     fMain->MapSubwindows();
     fMain->Resize();
     fMain->Layout();
@@ -684,23 +690,22 @@ void TRestDAQGUI::READ() {
 
         if (status == 1 && !exitGUI) {
 
+            //Wait till the DAQ publishes the events in the shared memory ring or, if the ring is disabled, till filesize is big enough
+            std::unique_ptr<SharedEventRing> eventRing = SharedEventRing::Attach();
             int fSize = TRESTDAQManager::GetFileSize(runN);
-            //Wait till filesize is big enough
-            while (fSize < guiMetadata->GetMinFileSize() && status == 1 && !exitGUI) {
-              fSize = TRESTDAQManager::GetFileSize(runN);
+            while (!eventRing && fSize < guiMetadata->GetMinFileSize() && status == 1 && !exitGUI) {
               std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_TIME));
+              eventRing = SharedEventRing::Attach();
+              fSize = TRESTDAQManager::GetFileSize(runN);
             }
 
-            //Wait till filename is updated
-            while (runN == fName && status == 1 && !exitGUI) {
-              std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_TIME));
-            }
 
             if (resetPlots){
               spectrum->Clear();
               spectrum->Reset();
               hitmap->Clear();
               hitmap->Reset("");
+              if (occupancy) occupancy->Reset();
               instantRateGraph->Set(0);
               instantRateGraph->SetPoint(0, tNow, 0);
               meanRateGraph->Set(0);
@@ -714,6 +719,17 @@ void TRestDAQGUI::READ() {
               parentRunNumber = 0;
             }
 
+            if (eventRing) {
+              ReadEventRing(eventRing.get(), timeUpdate, oldTimeEvent, oldEventCount);
+              resetPlots = true;
+              continue;
+            }
+
+            //Wait till filename is updated
+            while (runN == fName && status == 1 && !exitGUI) {
+              std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_TIME));
+            }
+
             std::cout << "Checking input file " << runN << std::endl;
 
             TRestRun runInfo (runN);
@@ -737,7 +753,14 @@ void TRestDAQGUI::READ() {
 
             TTree* tree = f.Get<TTree>("EventTree");
             TRestRawSignalEvent* fEvent = nullptr;
-            tree->SetBranchAddress("TRestRawSignalEventBranch", &fEvent);
+            TRestRawPackedEvent* packedEvent = nullptr;
+            TRestRawSignalEvent unpackedEvent;
+              if (tree->GetBranch("TRestRawPackedEventBranch")) {//Written with packedEvents
+                tree->SetBranchAddress("TRestRawPackedEventBranch", &packedEvent);
+                fEvent = &unpackedEvent;
+              } else {
+                tree->SetBranchAddress("TRestRawSignalEventBranch", &fEvent);
+              }
 
             int i = 0;
             int fCount = 0;
@@ -746,6 +769,7 @@ void TRestDAQGUI::READ() {
                 const int entries = tree->GetEntries();
                 while (i < entries && status == 1 && !exitGUI) {
                     tree->GetEntry(i);
+                    if (packedEvent) packedEvent->Decode(&unpackedEvent);
                     double timeEvent = fEvent->GetTime();
                       if (currentEventCount == 0) {
                         startTimeEvent = timeEvent;
@@ -772,6 +796,82 @@ void TRestDAQGUI::READ() {
     std::cout << "Exiting reading thread " << std::endl;
 }
 
+void TRestDAQGUI::ReadEventRing(SharedEventRing* eventRing, double& timeUpdate, double& oldTimeEvent, int& oldEventCount) {
+
+    std::cout << "Reading the events from the shared memory ring" << std::endl;
+
+    TRestRawSignalEvent fEvent;
+    int eventCount = 0, firstEventCount = -1;
+    bool running = true;
+    std::unique_ptr<DAQMonitor> monitor;
+    DAQMonitor::snapshot snap;
+    double lastRateTime = 0;
+
+    while (running && !exitGUI) {
+        running = status == 1;//Read the last events after the run is stopped
+
+        if (!monitor) monitor = DAQMonitor::Attach();
+        if (monitor) {//Spectrum and rates from the DAQ, only the last event is analyzed for the pulses and the hitmap
+            if (monitor->Read(snap) && snap.runNumber == eventRing->GetRunNumber()) UpdateMonitor(snap, lastRateTime);
+            if (eventRing->Latest(fEvent, eventCount)) AnalyzeEvent(&fEvent, timeUpdate, false);
+            else if (tNow > timeUpdate + PLOTS_UPDATE_TIME) DrawPlots(timeUpdate);
+            std::this_thread::sleep_for(std::chrono::milliseconds(RING_POLL_TIME));
+            continue;
+        }
+
+        while (eventRing->Next(fEvent, eventCount) && !exitGUI) {
+            const double timeEvent = fEvent.GetTime();
+              if (firstEventCount < 0) {
+                firstEventCount = eventCount - 1;
+                startTimeEvent = timeEvent;
+                oldTimeEvent = timeEvent;
+              }
+            //The event count of the DAQ is used, the events prescaled or overwritten are not shown but accounted in the rate
+            UpdateRate(timeEvent, oldTimeEvent, eventCount - firstEventCount, oldEventCount);
+            AnalyzeEvent(&fEvent, timeUpdate);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(RING_POLL_TIME));
+    }
+
+    if (eventRing->GetLost() > 0) std::cout << eventRing->GetLost() << " events overwritten in the ring before being shown" << std::endl;
+    std::cout << "Run stopped, detaching from the shared memory ring" << std::endl;
+}
+
+void TRestDAQGUI::UpdateMonitor(const DAQMonitor::snapshot& snap, double& lastRateTime) {
+
+    const int nBins = snap.spectrum.size();
+    if (spectrum->GetNbinsX() != nBins || spectrum->GetXaxis()->GetXmax() != snap.spectrumMax) spectrum->SetBins(nBins, 0, snap.spectrumMax);
+    for (int b = 0; b < nBins; b++) spectrum->SetBinContent(b + 1, snap.spectrum[b]);
+    spectrum->SetEntries(snap.events);
+
+    if (snap.time - lastRateTime >= PLOTS_UPDATE_TIME && snap.events > 0) {
+        instantRateGraph->SetPoint(rateGraphCounter, snap.time, snap.instantRate);
+        meanRateGraph->SetPoint(rateGraphCounter, snap.time, snap.meanRate);
+        rateGraphCounter++;
+        lastRateTime = snap.time;
+    }
+
+    if (hasReadout()) return;
+
+    //Hits per channel in the range of the channels with data
+    int first = -1, last = -1;
+      for (size_t c = 0; c < snap.hits.size(); c++) {
+        if (snap.hits[c] == 0) continue;
+        if (first < 0) first = c;
+        last = c;
+      }
+    if (first < 0) return;
+
+    if (!occupancy) {
+        occupancy = new TH1D("Occupancy", "Occupancy", last - first + 1, first, last + 1);
+        occupancy->GetXaxis()->SetTitle("Channel");
+        occupancy->GetYaxis()->SetTitle("Hits");
+    } else if (occupancy->GetXaxis()->GetXmin() != first || occupancy->GetXaxis()->GetXmax() != last + 1) {
+        occupancy->SetBins(last - first + 1, first, last + 1);
+    }
+    for (int c = first; c <= last; c++) occupancy->SetBinContent(c - first + 1, snap.hits[c]);
+}
+
 void TRestDAQGUI::UpdateRate(const double& currentTimeEv, double& oldTimeEv, const int& currentEventCount, int& oldEventCount) {
 
     if (currentTimeEv - oldTimeEv < PLOTS_UPDATE_TIME) return;
@@ -793,7 +893,7 @@ void TRestDAQGUI::UpdateRate(const double& currentTimeEv, double& oldTimeEv, con
     rateGraphCounter++;
 }
 
-void TRestDAQGUI::AnalyzeEvent(TRestRawSignalEvent* fEvent, double& oldTimeUpdate) {
+void TRestDAQGUI::AnalyzeEvent(TRestRawSignalEvent* fEvent, double& oldTimeUpdate, bool fillSpectrum) {
 
     if(fEvent == nullptr) return;
 
@@ -807,17 +907,19 @@ void TRestDAQGUI::AnalyzeEvent(TRestRawSignalEvent* fEvent, double& oldTimeUpdat
     int evAmplitude = 0;
     std::map<int, int> hmap;
     int color =1;
-    for (int s = 0; s < fEvent->GetNumberOfSignals(); s++) {
-        TRestRawSignal* signal = fEvent->GetSignal(s);
-        const double max = signal->GetAmplitudeFast(TVector2(guiMetadata->GetBaselineRange()), guiMetadata->GetSignalThreshold());
+    const TVector2 range = guiMetadata->GetBaselineRange();
+    signalBatch.Load(fEvent);
+    signalBatch.Process(range.X(), range.Y(), guiMetadata->GetSignalThreshold());
+    for (size_t s = 0; s < signalBatch.GetNumberOfSignals(); s++) {
+        const double max = signalBatch.amplitude[s];
 
         if(max<=0)continue;
 
         evAmplitude +=max;
-        hmap[signal->GetID()] = max;
+        hmap[signalBatch.id[s]] = max;
 
           if (updatePlots){ 
-            auto gr = signal->GetGraph(color);
+            auto gr = fEvent->GetSignal(s)->GetGraph(color);
             pulsesGraph.emplace_back((TGraph*)(gr->Clone()) );
           }
         color++;
@@ -825,33 +927,40 @@ void TRestDAQGUI::AnalyzeEvent(TRestRawSignalEvent* fEvent, double& oldTimeUpdat
 
     if (!hmap.empty() && evAmplitude > 0) FillHitmap(hmap);
 
-    if(evAmplitude > 0)spectrum->Fill(evAmplitude);
+    if(evAmplitude > 0 && fillSpectrum)spectrum->Fill(evAmplitude);
 
-    if (updatePlots) {
-        if (meanRateGraph->GetN() > 0 && instantRateGraph->GetN() > 0) {
-            fECanvas->GetCanvas()->cd(1);
-            instantRateGraph->Draw("ALP");
-            meanRateGraph->Draw("LP");
-        }
+    if (updatePlots) DrawPlots(oldTimeUpdate);
+}
 
-        fECanvas->GetCanvas()->cd(2);
-        spectrum->Draw();
+void TRestDAQGUI::DrawPlots(double& oldTimeUpdate) {
+    if (meanRateGraph->GetN() > 0 && instantRateGraph->GetN() > 0) {
+        fECanvas->GetCanvas()->cd(1);
+        instantRateGraph->Draw("ALP");
+        meanRateGraph->Draw("LP");
+    }
 
-        fECanvas->GetCanvas()->cd(3);
-        for (const auto& gr : pulsesGraph) {
-            gr->Draw("SAME");
-        }
+    fECanvas->GetCanvas()->cd(2);
+    spectrum->Draw();
 
-        #ifdef REST_DetectorLib
-          if(fReadout){
-            fECanvas->GetCanvas()->cd(4);
-            hitmap->Draw("COLZ0");
-          }
-        #endif
+    fECanvas->GetCanvas()->cd(3);
+    for (const auto& gr : pulsesGraph) {
+        gr->Draw("SAME");
+    }
+
+    #ifdef REST_DetectorLib
+      if(fReadout){
+        fECanvas->GetCanvas()->cd(4);
+        hitmap->Draw("COLZ0");
+      }
+    #endif
 
-        fECanvas->GetCanvas()->Update();
-        oldTimeUpdate = tNow;
+    if (occupancy && !hasReadout()) {
+        fECanvas->GetCanvas()->cd(4);
+        occupancy->Draw("HIST");
     }
+
+    fECanvas->GetCanvas()->Update();
+    oldTimeUpdate = tNow;
 }
 
 void TRestDAQGUI::FillHitmap(const std::map<int, int>& hmap) {
@@ -38,6 +38,10 @@
 
 #include "TRestRawSignalEvent.h"
 #include "TRestDAQGUIMetadata.h"
+#include "SharedEventRing.h"
+#include "DAQMonitor.h"
+#include "SignalBatch.h"
+#include "TRestRawPackedEvent.h"
 #ifdef REST_DetectorLib
 #include "TRestDetectorReadout.h"
 #endif
@@ -45,6 +49,7 @@
 
 constexpr int PLOTS_UPDATE_TIME = 5;//Seconds to update the plots
 constexpr int SLEEP_TIME = 500;//Miliseconds to sleep
+constexpr int RING_POLL_TIME = 20;//Miliseconds between reads of the shared memory event ring
 
 class TRestDAQGUI {
    public:
@@ -78,14 +83,16 @@ class TRestDAQGUI {
     static inline TH1* pulses = nullptr;
     static inline TH1I* spectrum = nullptr;
     static inline TH2Poly* hitmap = nullptr;
+    static inline TH1D* occupancy = nullptr;//Hits per channel from the DAQ monitor, shown if there is no readout
     static inline TRootEmbeddedCanvas* fECanvas = nullptr;
 
     static inline TGraph *meanRateGraph = nullptr, *instantRateGraph = nullptr;
     static inline  std::vector<TGraph*> pulsesGraph;
+    static inline SignalBatch signalBatch;
 
     std::thread updateT, readerT;
 
-    TRestDAQGUI(const int& p, const int& q, TRestDAQGUIMetadata *mt);
+    TRestDAQGUI(const int& p, const int& q, TRestDAQGUIMetadata *mt, int instance = -1);
     ~TRestDAQGUI();  // need to delete here created widgets
 
     void SetInputs();
@@ -126,12 +133,15 @@ class TRestDAQGUI {
     static void SetUnknownState();
 
     static void READ();
-    static void AnalyzeEvent(TRestRawSignalEvent* fEvent, double& oldTimeUpdate);
+    static void ReadEventRing(SharedEventRing* eventRing, double& timeUpdate, double& oldTimeEvent, int& oldEventCount);
+    static void AnalyzeEvent(TRestRawSignalEvent* fEvent, double& oldTimeUpdate, bool fillSpectrum = true);
+    static void DrawPlots(double& oldTimeUpdate);
+    static void UpdateMonitor(const DAQMonitor::snapshot& snap, double& lastRateTime);
     static void UpdateRate(const double& currentTimeEv, double& oldTimeEv, const int& currentEventCount, int& oldEventCount);
 
     static bool GetDAQManagerParams(double &lastTimeUpdate);
 
-    const std::string lastSetFile = "DAQLastSettings.txt";
+    std::string lastSetFile = "DAQLastSettings.txt";
     static std::atomic<bool> exitGUI;
     static std::atomic<int> status;
 
@@ -139,6 +149,9 @@ class TRestDAQGUI {
 
     #ifdef REST_DetectorLib
     static inline TRestDetectorReadout* fReadout = nullptr;
+    static bool hasReadout(){ return fReadout != nullptr; }
+    #else
+    static bool hasReadout(){ return false; }
     #endif
 
     ClassDef(TRestDAQGUI, 1)
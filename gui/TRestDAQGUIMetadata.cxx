@@ -33,9 +33,14 @@
 /// is above threshold.
 /// * **binsSpectra**: Number of bins for the spectrum
 /// * **spectraMax**: Maximum value in the spectrum
-/// * **minFileSize**: Minimum file size to start reading a root file (bytes)
+/// * **minFileSize**: Minimum file size to start reading a root file (bytes), only
+/// used when the event ring of TRestDAQManagerMetadata is disabled, otherwise the
+/// events are read from shared memory
 /// * **readoutFile**: File name (root) where the readout is stored
 /// * **readoutName**: Name of the readout stored in the root file.
+/// * **instance**: Instance of restDAQManager controlled by the GUI, when
+/// several managers run in the same machine (`restDAQManager --i`), 0 by
+/// default.
 /// 
 /// ### Examples
 /// Give examples of usage and RML descriptions that can be tested.      
@@ -49,6 +54,7 @@
 ///        <parameter name="minFileSize" value="15360"/>
 ///        <parameter name="readoutFile" value="DummyReadout.root"/>
 ///        <parameter name="readoutName" value="dummy"/>
+///        <parameter name="instance" value="0"/>
 ///    </TRestDAQGUIMetadata>
 ///  </TRestManager>
 /// \endcode
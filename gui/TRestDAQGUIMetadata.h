@@ -50,6 +50,9 @@ class TRestDAQGUIMetadata : public TRestMetadata {
 
     /// Name of the readout inside the file
     TString fReadoutName = "";
+
+    /// Instance of restDAQManager controlled by the GUI
+    Int_t fInstance = 0;
     
 
     void Initialize() override;
@@ -63,6 +66,7 @@ public:
     inline const int GetMinFileSize() const { return fMinFileSize; }
     inline const TString GetReadoutFile() const { return fReadoutFile;}
     inline const TString GetReadoutName() const { return fReadoutName;}
+    inline const Int_t GetInstance() const { return fInstance; }
 
     void PrintMetadata() override {
         TRestMetadata::PrintMetadata();
@@ -74,6 +78,7 @@ public:
         RESTMetadata << "Spectra max: " << fSpectraMax << RESTendl;
         RESTMetadata << "Min file size: " << fMinFileSize << " bytes" << RESTendl;
         RESTMetadata << "Readout file/name: " << fReadoutFile<<" "<<fReadoutName << RESTendl;
+        RESTMetadata << "DAQ manager instance: " << fInstance << RESTendl;
 
         TRestMetadata::PrintMetadata();
 
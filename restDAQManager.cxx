@@ -1,4 +1,3 @@
-#include <dirent.h>
 #include <signal.h>
 
 #include <iostream>
@@ -18,60 +17,29 @@ void help() {
     std::cout << "    --s       : Stop run (if ongoing)" << std::endl;
     std::cout << "    --c       : Set configFile (single run)" << std::endl;
     std::cout << "    --u       : Start up electronics (FEMINOS or ARC)" << std::endl;
+    std::cout << "    --p       : Print the configuration commands for the configFile without sending them (dry run)" << std::endl;
+    std::cout << "    --i       : Instance of the manager, its shared memory keys (0 by default)" << std::endl;
+    std::cout << "    --l       : List the running instances" << std::endl;
     std::cout << "    --h       : Print this help" << std::endl;
     std::cout << "If no arguments are provided it starts at infinite loop which is controller via shared memory" << std::endl;
+    std::cout << "--e and --s apply to the instance given by --i, e.g. " << thisProgram << " --i 1 --s" << std::endl;
 }
 
-bool checkRunning() {
-    DIR* dir;
-    struct dirent* ent;
-    char* endptr;
-
-    int nInstances = 0;
-
-    if (!(dir = opendir("/proc"))) {
-        std::cerr << "Cannot open /proc" << std::endl;
-        return true;
-    }
-
-    while ((ent = readdir(dir)) != NULL) {
-        /* if endptr is not a null character, the directory is not
-         * entirely numeric, so ignore it */
-        long lpid = strtol(ent->d_name, &endptr, 10);
-        if (*endptr != '\0') {
-            continue;
-        }
-        /* try to open the cmdline file */
-        std::string fName = "/proc/" + std::to_string(lpid) + "/status";
-        std::ifstream fin(fName, std::ifstream::in);
-        if (fin.fail()) {
-            std::cerr << "Cannot open " + fName + " skipping..." << std::endl;
-            continue;
-        }
-
-        std::string line;
-        std::getline(fin, line);
-        std::stringstream str;
-        str << line;
-        std::string head, binary;
-        str >> head >> binary;
-        if (thisProgram.substr(0, 15) == binary) {
-            std::cout << binary << " pid: " << lpid << std::endl;
-            nInstances++;
-        }
-        fin.close();
-    }
-    closedir(dir);
-
-    if (nInstances > 1) return true;
-
-    return false;
+void listInstances() {
+    const auto instances = DAQInstance::List();
+    if (instances.empty()) std::cout << "No " << thisProgram << " running" << std::endl;
+    for (const auto& inst : instances)
+        std::cout << "Instance " << inst.instance << " pid " << inst.pid << " shared memory key 0x" << std::hex
+                  << DAQInstance::baseKey + DAQInstance::keysPerInstance * inst.instance << std::dec << std::endl;
 }
 
 int main(int argc, char** argv) {
 
     std::string cfgFile = "";
     bool startUp = false;
+    bool dryRun = false;
+    bool exitManager = false, stopRun = false;
+    int instance = -1;
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -83,14 +51,19 @@ int main(int argc, char** argv) {
         } else if (arg == "--u") {
             std::cout << "Starting up electronics" << std::endl;
             startUp = true;
-        } else if (arg == "--e") {
-            std::cout << "Exiting Rest DAQ Manager" << std::endl;
-            TRESTDAQManager::ExitManager();
+        } else if (arg == "--p") {
+            dryRun = true;
+        } else if (arg == "--i" && i + 1 < argc) {
+            i++;
+            instance = atoi(argv[i]);
+            if (!DAQInstance::Set(instance)) return -1;
+        } else if (arg == "--l") {
+            listInstances();
             return 0;
+        } else if (arg == "--e") {
+            exitManager = true;
         } else if (arg == "--s") {
-            std::cout << "Stopping run if any" << std::endl;
-            TRESTDAQManager::StopRun();
-            return 0;
+            stopRun = true;
         } else if (arg == "--h") {
             help();
             return 0;
@@ -101,12 +74,41 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (checkRunning()) {
-        std::cout << "Another " << thisProgram << " is running, please close it before starting another one, only one instance is allowed" << std::endl;
+    if (dryRun) {
+        if (cfgFile.empty()) {
+            std::cerr << "Please provide a config file with --c for the dry run" << std::endl;
+            return -1;
+        }
+        TRESTDAQManager::PrintConfigPlan(cfgFile);
+        return 0;
+    }
+
+    //The instance of the config file, unless it is given
+    if (instance < 0 && !cfgFile.empty()) {
+        TRestDAQManagerMetadata managerMetadata(cfgFile.c_str());
+        if (managerMetadata.GetInstance() >= 0 && !DAQInstance::Set(managerMetadata.GetInstance())) return -1;
+    }
+
+    if (exitManager || stopRun) {
+        if (!DAQInstance::IsRunning(DAQInstance::Get())) std::cout << "Warning: instance " << DAQInstance::Get() << " is not running" << std::endl;
+        if (exitManager) {
+            std::cout << "Exiting Rest DAQ Manager instance " << DAQInstance::Get() << std::endl;
+            TRESTDAQManager::ExitManager();
+        } else {
+            std::cout << "Stopping run if any, instance " << DAQInstance::Get() << std::endl;
+            TRESTDAQManager::StopRun();
+        }
+        return 0;
+    }
+
+    if (!DAQInstance::Lock()) {
+        std::cout << "Instance " << DAQInstance::Get() << " of " << thisProgram << " is already running, please close it or use another instance (--i)"
+                  << std::endl;
+        listInstances();
         return 0;
     }
 
-    // nice(-20); //We should try to set highest priority
+    //Priority, CPUs and memory locking of the acquisition threads are set for every run, see ThreadPolicy.h
 
     TRESTDAQManager daqManager;
 
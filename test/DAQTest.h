@@ -0,0 +1,34 @@
+/*********************************************************************************
+DAQTest.h
+
+Checks of the regression tests, every test is an executable run by ctest
+that fails if any check fails
+
+*********************************************************************************/
+
+#ifndef __DAQ_TEST__
+#define __DAQ_TEST__
+
+#include <iostream>
+
+namespace DAQTest {
+
+  inline int failures = 0;
+
+  inline void Check(bool ok, const char* what, const char* file, int line){
+    if(ok)return;
+    std::cerr << file << ":" << line << " check failed: " << what << std::endl;
+    failures++;
+  }
+
+  //Exit code of the test
+  inline int Result(){
+    if(failures)std::cerr << failures << " checks failed" << std::endl;
+    return failures ? 1 : 0;
+  }
+
+}
+
+#define DAQ_CHECK(cond) DAQTest::Check((cond), #cond, __FILE__, __LINE__)
+
+#endif
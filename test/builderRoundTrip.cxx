@@ -0,0 +1,116 @@
+/*********************************************************************************
+builderRoundTrip.cxx
+
+Two nodes send their built events to TRESTDAQBuilder, the merged events are
+written to the output file and read back, every signal of the nodes has to
+be in the event with its id
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "TRESTDAQBuilder.h"
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+  const int nEvents = 500;
+  const int nChannels = 3;
+
+  std::vector<Short_t> SignalData(int node, int channel, int event){
+    std::vector<Short_t> data(512, 0);
+    for(int i=100; i<140; i++)data[i] = (i * 7 + channel + event + node) % 4000 - (channel == 2 ? 300 : 0);
+    return data;
+  }
+
+  void Node(int node, int port){
+    DAQRunControl runControl;
+    EventSender::settings st;
+    st.host = "127.0.0.1";
+    st.port = port;
+    st.name = "node" + std::to_string(node);
+    st.queueSize = 8;
+    EventSender sender(st, &runControl);
+
+    TRestRawSignalEvent sEvent;
+      for(int ev=0; ev<nEvents; ev++){
+        sEvent.Initialize();
+        sEvent.SetID(ev);
+        sEvent.SetTime(ev * 1E-3 + node * 1E-7);
+          for(int c=0; c<nChannels; c++){
+            std::vector<Short_t> data = SignalData(node, c, ev);
+            TRestRawSignal signal(node * 1000 + c, data);
+            sEvent.AddSignal(signal);
+          }
+        sender.Send(&sEvent, 0);
+      }
+    sender.Close();
+  }
+
+}
+
+int main(int argc, char** argv) {
+
+  if(argc < 2){
+    std::cout << "Usage: builderRoundTrip <cfg.rml>" << std::endl;
+    return 1;
+  }
+  const std::string cfgFile = argv[1];
+
+  TRestRawDAQMetadata daqMetadata(cfgFile.c_str());
+  TRestDAQManagerMetadata managerMetadata(cfgFile.c_str());
+  TRestRun restRun;
+  restRun.LoadConfigFromFile(cfgFile);
+  restRun.SetRunNumber(1);
+  restRun.SetRunType(daqMetadata.GetAcquisitionType());
+  restRun.FormOutputFile();
+  const std::string fileName = restRun.GetOutputFileName().Data();
+
+  DAQRunControl runControl;
+  std::thread node0(Node, 0, managerMetadata.GetBuilderPort());
+  std::thread node1(Node, 1, managerMetadata.GetBuilderPort());
+    {
+      TRESTDAQBuilder builder(&restRun, &daqMetadata, &managerMetadata, &runControl);
+      builder.configure();
+      builder.startDAQ();
+      builder.stopDAQ();
+    }
+  node0.join();
+  node1.join();
+  restRun.UpdateOutputFile();
+  restRun.CloseFile();
+
+  DAQ_CHECK(runControl.GetEvents() == nEvents);
+
+  TFile file(fileName.c_str());
+  TTree* tree = file.Get<TTree>("EventTree");
+  DAQ_CHECK(tree != nullptr);
+  if(!tree)return DAQTest::Result();
+
+  TRestRawSignalEvent* sEvent = nullptr;
+  tree->SetBranchAddress("TRestRawSignalEventBranch", &sEvent);
+  DAQ_CHECK(tree->GetEntries() == nEvents);
+
+    for(int i=0; i<tree->GetEntries(); i++){
+      tree->GetEntry(i);
+      DAQ_CHECK(sEvent->GetNumberOfSignals() == 2 * nChannels);
+
+      std::map<int, std::vector<Short_t> > signals;
+        for(int s=0; s<sEvent->GetNumberOfSignals(); s++){
+          TRestRawSignal* signal = sEvent->GetSignal(s);
+          std::vector<Short_t>& data = signals[signal->GetID()];
+          for(int p=0; p<signal->GetNumberOfPoints(); p++)data.push_back(signal->GetRawData(p));
+        }
+      for(int node=0; node<2; node++)
+        for(int c=0; c<nChannels; c++)DAQ_CHECK(signals[node * 1000 + c] == SignalData(node, c, sEvent->GetID()));
+    }
+  file.Close();
+
+  return DAQTest::Result();
+}
@@ -0,0 +1,102 @@
+/*********************************************************************************
+femConfigDiff.cxx
+
+The commands compiled for a FEC are applied to an empty register map, then
+only the blocks of the changed settings have to be sent again, also after
+the registers are saved to the configuration cache and loaded back
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "FEMConfig.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+  TRestRawDAQMetadata::FECMetadata MakeFEC(){
+    TRestRawDAQMetadata::FECMetadata fec{};
+    fec.id = 2;
+    fec.ip[0] = 127; fec.ip[1] = 0; fec.ip[2] = 0; fec.ip[3] = 2;
+    fec.chipType = "aget";
+    fec.clockDiv = 2;
+      for(int a=0; a<TRestRawDAQMetadata::nAsics; a++){
+        fec.asic_isActive[a] = true;
+        fec.asic_polarity[a] = 0;
+        fec.asic_gain[a] = 1;
+        fec.asic_shappingTime[a] = 5;
+        for(int c=0; c<TRestRawDAQMetadata::nChannels; c++)fec.asic_channelActive[a][c] = c % 11 != 3;
+      }
+    return fec;
+  }
+
+  //Blocks which would be sent by TRESTDAQFEMINOS::configure
+  std::vector<std::vector<std::string> > Pending(const TRestRawDAQMetadata::FECMetadata& fec, const FEMConfig::registerMap& registers){
+    std::vector<std::vector<std::string> > pending;
+    for(const auto &block : FEMConfig::Compile(fec, FEMConfig::dialect::FEMINOS))
+      if(!FEMConfig::IsApplied(block, registers))pending.push_back(block);
+    return pending;
+  }
+
+}
+
+int main() {
+
+  TRestRawDAQMetadata::FECMetadata fec = MakeFEC();
+  FEMConfig::registerMap registers;
+
+  //Nothing is known of a FEM just started
+  const auto blocks = FEMConfig::Compile(fec, FEMConfig::dialect::FEMINOS);
+  DAQ_CHECK(Pending(fec, registers).size() == blocks.size());
+
+  for(const auto &block : blocks)
+    for(const auto &cmd : block)FEMConfig::Apply(cmd, registers);
+  DAQ_CHECK(Pending(fec, registers).empty());
+
+  //Values are compared as numbers and the wildcards cover the single registers
+  DAQ_CHECK(FEMConfig::IsApplied({"aget 3 mode 1"}, registers));
+  DAQ_CHECK(!FEMConfig::IsApplied({"aget 3 mode 0x2"}, registers));
+  DAQ_CHECK(FEMConfig::IsApplied({"aget 1 gain 7 0x1"}, registers));
+
+  //Only the gain of the changed ASIC is sent
+  fec.asic_gain[1] = 2;
+  auto pending = Pending(fec, registers);
+  DAQ_CHECK(pending.size() == 1);
+  if(pending.size() == 1)DAQ_CHECK(pending[0] == std::vector<std::string>({"aget 1 gain * 0x2"}));
+
+  //A disabled channel changes only the mask block
+  fec = MakeFEC();
+  fec.asic_channelActive[2][40] = false;
+  pending = Pending(fec, registers);
+  DAQ_CHECK(pending.size() == 1);
+  if(pending.size() == 1)DAQ_CHECK(pending[0] == FEMConfig::PlanChannelMask(fec));
+  for(const auto &cmd : FEMConfig::PlanChannelMask(fec))FEMConfig::Apply(cmd, registers);
+  DAQ_CHECK(Pending(fec, registers).empty());
+
+  //Commands not acknowledged by the FEM are sent again
+  FEMConfig::Invalidate("aget 0 time 0x5", registers);
+  pending = Pending(fec, registers);
+  DAQ_CHECK(pending.size() == 1);
+  if(pending.size() == 1)DAQ_CHECK(pending[0] == std::vector<std::string>({"aget 0 time 0x5"}));
+  FEMConfig::Apply("aget 0 time 0x5", registers);
+
+  //Cache round trip
+  const std::string cacheFile = FEMConfig::GetCacheFile("femConfigDiff", fec);
+  DAQ_CHECK(FEMConfig::SaveCache(cacheFile, registers));
+  FEMConfig::registerMap cached;
+  DAQ_CHECK(FEMConfig::LoadCache(cacheFile, cached));
+  DAQ_CHECK(cached == registers);
+  DAQ_CHECK(Pending(fec, cached).empty());
+  std::remove(cacheFile.c_str());
+  DAQ_CHECK(!FEMConfig::LoadCache(cacheFile, cached));
+  DAQ_CHECK(cached.empty());
+
+  //A FEC power cycle resets all the registers
+  FEMConfig::Apply("fec_enable 0x0", registers);
+  DAQ_CHECK(registers.empty());
+  DAQ_CHECK(Pending(fec, registers).size() == blocks.size());
+
+  return DAQTest::Result();
+}
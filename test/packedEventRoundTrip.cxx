@@ -0,0 +1,133 @@
+/*********************************************************************************
+packedEventRoundTrip.cxx
+
+Zero suppressed events with blocks of both encodings (odd length PACKED12
+blocks, DELTA blocks with negative samples) are packed, serialized and
+restored, corrupted buffers have to be rejected leaving the event empty
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "TRestRawPackedEvent.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+  std::vector<std::vector<Short_t> > SignalData(){
+    std::vector<Short_t> odd(100, 0);
+    const Short_t packed[5] = {4095, 1, 2000, 3, 4000};//PACKED12, smaller than the deltas
+    for(int i=0; i<5; i++)odd[10 + i] = packed[i];
+    const Short_t negative[4] = {-5, -300, -32768, 32767};//DELTA, out of the 12 bit range
+    for(int i=0; i<4; i++)odd[50 + i] = negative[i];
+    odd[97] = 4000; odd[98] = 10; odd[99] = 4000;//PACKED12 up to the last point
+
+    std::vector<Short_t> flat(512, 300);//DELTA, smaller for a flat baseline
+    std::vector<Short_t> empty(64, 0);//No blocks
+    return {odd, flat, empty};
+  }
+
+  //Encoded size of the blocks of SignalData
+  const size_t dataSize = 8 + (1 + 2 + 3 + 3) + 5 + (2 + 511);
+
+  void Fill(TRestRawSignalEvent& sEvent){
+    sEvent.Initialize();
+    sEvent.SetID(42);
+    sEvent.SetTime(1.5);
+    auto data = SignalData();
+      for(size_t s=0; s<data.size(); s++){
+        TRestRawSignal signal(100 + s, data[s]);
+        sEvent.AddSignal(signal);
+      }
+  }
+
+  void CheckSignals(TRestRawSignalEvent& sEvent){
+    const auto data = SignalData();
+    DAQ_CHECK(sEvent.GetNumberOfSignals() == (int)data.size());
+    if(sEvent.GetNumberOfSignals() != (int)data.size())return;
+      for(size_t s=0; s<data.size(); s++){
+        TRestRawSignal* signal = sEvent.GetSignal(s);
+        DAQ_CHECK(signal->GetID() == (int)(100 + s));
+        std::vector<Short_t> decoded;
+        for(int p=0; p<signal->GetNumberOfPoints(); p++)decoded.push_back(signal->GetRawData(p));
+        DAQ_CHECK(decoded == data[s]);
+      }
+  }
+
+  //Deserialize of a modified copy of the buffer has to fail and leave the event empty
+  void CheckRejected(const std::vector<char>& buffer, size_t size, size_t offset, int bytes, const void* value){
+    std::vector<char> bad(buffer.begin(), buffer.begin() + std::min(size, buffer.size()));
+    bad.resize(size, 0);
+    if(bytes > 0)memcpy(&bad[offset], value, bytes);
+
+    TRestRawPackedEvent packed;
+    DAQ_CHECK(!packed.Deserialize(bad.data(), bad.size()));
+    DAQ_CHECK(packed.GetNumberOfSignals() == 0 && packed.GetNumberOfBlocks() == 0 && packed.GetDataSize() == 0);
+    TRestRawSignalEvent sEvent;
+    DAQ_CHECK(packed.Decode(&sEvent));
+    DAQ_CHECK(sEvent.GetNumberOfSignals() == 0);
+  }
+
+}
+
+int main() {
+
+  TRestRawSignalEvent sEvent;
+  Fill(sEvent);
+
+  TRestRawPackedEvent packed;
+  packed.Encode(&sEvent);
+  DAQ_CHECK(packed.GetNumberOfSignals() == 3);
+  DAQ_CHECK(packed.GetNumberOfBlocks() == 4);
+  DAQ_CHECK(packed.GetDataSize() == dataSize);
+  DAQ_CHECK(packed.IsValid());
+
+  TRestRawSignalEvent decoded;
+  DAQ_CHECK(packed.Decode(&decoded));
+  DAQ_CHECK(decoded.GetID() == 42);
+  CheckSignals(decoded);
+
+  //Serialize/Deserialize, the event info is not included
+  std::vector<char> buffer;
+  packed.Serialize(buffer);
+  TRestRawPackedEvent restored;
+  DAQ_CHECK(restored.Deserialize(buffer.data(), buffer.size()));
+  DAQ_CHECK(restored.GetNumberOfBlocks() == 4 && restored.GetDataSize() == dataSize);
+  DAQ_CHECK(restored.Decode(&decoded));
+  CheckSignals(decoded);
+
+  //A second event reuses the buffers of the first one
+  sEvent.Initialize();
+  std::vector<Short_t> single(16, 0);
+  single[15] = -1;
+  TRestRawSignal signal(7, single);
+  sEvent.AddSignal(signal);
+  packed.Encode(&sEvent);
+  DAQ_CHECK(packed.GetNumberOfBlocks() == 1 && packed.GetDataSize() == 1);
+  DAQ_CHECK(packed.Decode(&decoded));
+  DAQ_CHECK(decoded.GetNumberOfSignals() == 1 && decoded.GetSignal(0)->GetRawData(15) == -1);
+
+  //Offsets of the Serialize layout, 3 signals and 4 blocks
+  const size_t blockStart = 12 + 3 * (4 + 2 + 2);
+  const size_t blockEncoding = blockStart + 4 * (2 + 2);
+  const size_t data = blockEncoding + 4;
+  DAQ_CHECK(buffer.size() == data + dataSize);
+
+  const uint16_t pastEnd = 98;//The last block of the first signal would end after its 100 points
+  const uint8_t unknown = 7;
+  const uint8_t continuation = 0x80;//The last DELTA sample runs past the data
+  const uint32_t nSignals = 4;
+
+  CheckRejected(buffer, buffer.size() - 1, 0, 0, nullptr);
+  CheckRejected(buffer, buffer.size() + 1, 0, 0, nullptr);
+  CheckRejected(buffer, 11, 0, 0, nullptr);
+  CheckRejected(buffer, buffer.size(), 0, 4, &nSignals);
+  CheckRejected(buffer, buffer.size(), blockStart + 2 * 2, 2, &pastEnd);
+  CheckRejected(buffer, buffer.size(), blockEncoding + 1, 1, &unknown);
+  CheckRejected(buffer, buffer.size(), buffer.size() - 1, 1, &continuation);
+
+  return DAQTest::Result();
+}
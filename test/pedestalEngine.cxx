@@ -0,0 +1,72 @@
+/*********************************************************************************
+pedestalEngine.cxx
+
+Full waveform events with a known mean and RMS per channel are accumulated
+by PedestalEngine, the pedestals and the pedestal event have to match them
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "PedestalEngine.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+  const int nEvents = 200;
+  const int nSamples = 512;
+  const int nChannels = 72;
+
+  //Baseline of the channel, the samples alternate mean +/- rms so the RMS is exact
+  double Mean(int c){ return 250 + 3 * c; }
+  double Rms(int c){ return 2 + c % 5; }
+
+}
+
+int main() {
+
+  PedestalEngine engine;
+  TRestRawSignalEvent sEvent;
+    for(int ev=0; ev<nEvents; ev++){
+      sEvent.Initialize();
+      sEvent.SetID(ev);
+        for(int c=0; c<nChannels; c++){
+          std::vector<Short_t> data(nSamples);
+          for(int i=0; i<nSamples; i++)data[i] = Mean(c) + ((i + ev) % 2 ? Rms(c) : -Rms(c));
+          TRestRawSignal signal(c, data);
+          sEvent.AddSignal(signal);
+        }
+      engine.AddEvent(&sEvent);
+    }
+  DAQ_CHECK(engine.GetNumberOfEvents() == nEvents);
+  DAQ_CHECK(engine.GetNumberOfChannels() == nChannels);
+
+    for(int c=0; c<nChannels; c++){
+      double mean = 0, rms = 0;
+      DAQ_CHECK(engine.GetPedestal(c, mean, rms));
+      DAQ_CHECK(std::abs(mean - Mean(c)) < 1E-6);
+      DAQ_CHECK(std::abs(rms - Rms(c)) < 1E-6);
+    }
+  double mean, rms;
+  DAQ_CHECK(!engine.GetPedestal(nChannels, mean, rms));
+
+  //Same layout than the pedestal events of the electronics, {mean, stdev} in hundredths
+  TRestRawSignalEvent pedEvent;
+  engine.FillPedestalEvent(&pedEvent);
+  DAQ_CHECK(pedEvent.GetNumberOfSignals() == nChannels);
+    for(int s=0; s<pedEvent.GetNumberOfSignals(); s++){
+      TRestRawSignal* signal = pedEvent.GetSignal(s);
+      const int c = signal->GetID();
+      DAQ_CHECK(signal->GetNumberOfPoints() == 2);
+      DAQ_CHECK((uint16_t)signal->GetRawData(0) == std::lround(Mean(c) * 100));
+      DAQ_CHECK((uint16_t)signal->GetRawData(1) == std::lround(Rms(c) * 100));
+    }
+
+  engine.Clear();
+  DAQ_CHECK(engine.GetNumberOfEvents() == 0 && engine.GetNumberOfChannels() == 0);
+  DAQ_CHECK(!engine.GetPedestal(0, mean, rms));
+
+  return DAQTest::Result();
+}
@@ -0,0 +1,83 @@
+/*********************************************************************************
+pedestalStore.cxx
+
+Pedestals and thresholds computed from the summaries of a pedestal run are
+saved to the pedestal store and loaded back, the entry has to be the same
+and valid only for the settings of the pedestal run
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "PedestalStore.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+  double Mean(int c){ return 250 + 3 * c; }
+  double Rms(int c){ return 2 + c % 5; }
+
+  TRestRawDAQMetadata::FECMetadata MakeFEC(){
+    TRestRawDAQMetadata::FECMetadata fec{};
+    fec.id = 1;
+    fec.ip[0] = 127; fec.ip[1] = 0; fec.ip[2] = 0; fec.ip[3] = 1;
+    fec.chipType = "aget";
+    fec.clockDiv = 2;
+      for(int a=0; a<TRestRawDAQMetadata::nAsics; a++){
+        fec.asic_isActive[a] = true;
+        fec.asic_gain[a] = 1;
+        fec.asic_shappingTime[a] = 5;
+        fec.asic_pedCenter[a] = 250;
+        fec.asic_pedThr[a] = 4.5;
+      }
+    return fec;
+  }
+
+}
+
+int main() {
+
+  PedestalStore::pedSummary raw, subtracted;
+    for(int c=0; c<TRestRawDAQMetadata::nChannels; c++){
+      raw[c] = {Mean(c), Rms(c)};
+      subtracted[c] = {250, Rms(c)};
+    }
+
+  TRestRawDAQMetadata::FECMetadata fec = MakeFEC();
+  const int asic = 2;
+  PedestalStore::asicPedestals entry = PedestalStore::Compute(fec, asic, raw, subtracted);
+  entry.timestamp = 1.7E9;
+  entry.runNumber = 123;
+    for(int c=0; c<TRestRawDAQMetadata::nChannels; c++){
+      DAQ_CHECK(entry.ped[c] == std::lround(Mean(c)) - 250);
+      DAQ_CHECK(entry.thr[c] == 250 + std::lround(4.5 * Rms(c)));
+    }
+
+  const std::string fileName = PedestalStore::GetFileName("pedestalStore", fec, asic);
+  DAQ_CHECK(PedestalStore::Save(fileName, entry));
+  PedestalStore::asicPedestals loaded;
+  DAQ_CHECK(PedestalStore::Load(fileName, loaded));
+  std::remove(fileName.c_str());
+  DAQ_CHECK(!PedestalStore::Load(fileName, loaded));
+
+  DAQ_CHECK(loaded.fecId == entry.fecId && loaded.asic == entry.asic);
+  DAQ_CHECK(loaded.gain == entry.gain && loaded.shapingTime == entry.shapingTime && loaded.clockDiv == entry.clockDiv);
+  DAQ_CHECK(loaded.center == entry.center && loaded.pedThr == entry.pedThr);
+  DAQ_CHECK(loaded.timestamp == entry.timestamp && loaded.runNumber == entry.runNumber);
+  DAQ_CHECK(loaded.ped == entry.ped && loaded.thr == entry.thr);
+  DAQ_CHECK(PedestalStore::GetCommands(loaded) == PedestalStore::GetCommands(entry));
+
+  //Valid only for the settings of the pedestal run and up to maxAge
+  DAQ_CHECK(PedestalStore::IsValid(loaded, fec, asic, entry.timestamp + 3600, 7200));
+  DAQ_CHECK(!PedestalStore::IsValid(loaded, fec, asic, entry.timestamp + 3600, 1800));
+  DAQ_CHECK(!PedestalStore::IsValid(loaded, fec, asic + 1, entry.timestamp, 7200));
+  fec.asic_gain[asic] = 2;
+  DAQ_CHECK(!PedestalStore::IsValid(loaded, fec, asic, entry.timestamp, 7200));
+  fec = MakeFEC();
+  fec.asic_pedThr[asic] = 5;
+  DAQ_CHECK(!PedestalStore::IsValid(loaded, fec, asic, entry.timestamp, 7200));
+
+  return DAQTest::Result();
+}
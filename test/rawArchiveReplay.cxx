@@ -0,0 +1,125 @@
+/*********************************************************************************
+rawArchiveReplay.cxx
+
+Frames of several FEMs are written to a raw archive spanning several chunks
+and read back chunk by chunk as TRESTDAQReplay does, every frame has to be
+restored with its FEM, counter and timestamp, in arrival order. A chunk
+with a corrupted index is skipped
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "RawArchive.h"
+#include "TRESTDAQException.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+  const int nFrames = 2000;
+  const int nFems = 3;
+
+  struct sentFrame {
+    uint16_t fem;
+    uint32_t seq;
+    double timestamp;
+    std::vector<uint8_t> data;
+  };
+
+  std::vector<uint8_t> FrameData(int frame){
+    //Sizes not multiple of the 8 bytes padding
+    std::vector<uint8_t> data(13 + (frame * 131) % 1500);
+    for(size_t i=0; i<data.size(); i++)data[i] = (i * 7 + frame) & 0xFF;
+    return data;
+  }
+
+}
+
+int main() {
+
+  const std::string fileName = RawArchive::GetArchiveName("rawArchiveReplay.root");
+  DAQ_CHECK(fileName == "rawArchiveReplay.daq");
+
+  std::vector<sentFrame> sent;
+    {
+      RawArchive archive(fileName, "FEMINOS", 12, 3, 0);//Smallest chunks
+      std::map<uint16_t, uint32_t> seq;
+        for(int f=0; f<nFrames; f++){
+          const uint16_t fem = (f * 5) % nFems + 1;
+          sentFrame frame{fem, seq[fem]++, 100. + f * 1E-3, FrameData(f)};
+          archive.AddFrame(frame.fem, frame.data.data(), frame.data.size(), frame.timestamp);
+          sent.push_back(std::move(frame));
+        }
+
+      //A frame larger than a chunk is not written
+      std::vector<uint8_t> large(1 << 20);
+      bool thrown = false;
+      try { archive.AddFrame(1, large.data(), large.size(), 200); } catch(const TRESTDAQException&){ thrown = true; }
+      DAQ_CHECK(thrown);
+
+      archive.Close();
+      DAQ_CHECK(!archive.IsBad());
+      DAQ_CHECK(archive.GetNumberOfFrames() == nFrames);
+      DAQ_CHECK(archive.GetSize() % RawArchive::blockSize == 0);
+    }
+
+  RawArchive::Reader reader(fileName);
+  DAQ_CHECK(reader.IsOpen());
+  if(!reader.IsOpen())return DAQTest::Result();
+
+  DAQ_CHECK(reader.GetHeader().runNumber == 12 && reader.GetHeader().subRunNumber == 3);
+  DAQ_CHECK(std::string(reader.GetHeader().electronics) == "FEMINOS");
+  DAQ_CHECK(reader.GetNumberOfChunks() > 1);
+
+  //All the frames in arrival order
+  std::vector<RawArchive::Reader::frame> frames;
+  size_t next = 0;
+    for(size_t c=0; c<reader.GetNumberOfChunks(); c++){
+      reader.GetFrames(c, frames);
+      DAQ_CHECK(frames.size() == reader.GetChunkHeader(c).nFrames);
+        for(const auto &frame : frames){
+          if(next >= sent.size())break;
+          const sentFrame &s = sent[next++];
+          DAQ_CHECK(frame.fem == s.fem && frame.seq == s.seq && frame.timestamp == s.timestamp);
+          DAQ_CHECK(frame.size == s.data.size() && memcmp(frame.data, s.data.data(), frame.size) == 0);
+        }
+    }
+  DAQ_CHECK(next == sent.size());
+
+  //The frames of a single FEM, with consecutive counters
+    for(int fem=1; fem<=nFems; fem++){
+      uint32_t seq = 0;
+        for(size_t c=0; c<reader.GetNumberOfChunks(); c++){
+          reader.GetFrames(c, frames, fem);
+            for(const auto &frame : frames){
+              DAQ_CHECK(frame.fem == fem);
+              DAQ_CHECK(frame.seq == seq++);
+            }
+        }
+      uint32_t nSent = 0;
+      for(const auto &s : sent)nSent += s.fem == fem;
+      DAQ_CHECK(seq == nSent);
+    }
+
+  //Index pointing beyond the chunk, the other chunks are still read
+  const size_t nChunks = reader.GetNumberOfChunks();
+  FILE* file = fopen(fileName.c_str(), "r+b");
+  DAQ_CHECK(file != nullptr);
+    if(file){
+      const uint64_t indexOffset = reader.GetChunkHeader(0).chunkBytes;
+      fseek(file, reader.GetHeader().headerSize + offsetof(RawArchive::chunkHeader, indexOffset), SEEK_SET);
+      fwrite(&indexOffset, sizeof(indexOffset), 1, file);
+      fclose(file);
+      RawArchive::Reader corrupted(fileName);
+      DAQ_CHECK(corrupted.IsOpen() && corrupted.GetNumberOfChunks() == nChunks - 1);
+    }
+
+  std::remove(fileName.c_str());
+
+  return DAQTest::Result();
+}
@@ -0,0 +1,152 @@
+/*********************************************************************************
+zeroSuppressionWindow.cxx
+
+The samples kept by the host zero suppression (ZeroSuppression) and by the
+emulated FEMs (SignalGenerator::ZeroSuppress) are compared with the ones
+within pre/post bins of a sample over threshold, on fixed and random signals.
+The stored thresholds are only used while the FEM holds their pedestals
+
+*********************************************************************************/
+
+#include "DAQTest.h"
+#include "PedestalStore.h"
+#include "SignalGenerator.h"
+#include "ZeroSuppression.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+  //Samples within [i - pre, i + post] of a sample i over threshold
+  std::vector<bool> Window(const std::vector<Short_t>& data, int thr, int pre, int post){
+    const int n = data.size();
+    std::vector<bool> keep(n, false);
+    for(int i=0; i<n; i++)
+      if(data[i] > thr)for(int j=std::max(i - pre, 0); j<=std::min(i + post, n - 1); j++)keep[j] = true;
+    return keep;
+  }
+
+  void CheckHost(const std::vector<Short_t>& data, int thr, int pre, int post){
+    ZeroSuppression zs(0, 0, 0, pre, post);
+    zs.SetThreshold(5, thr);
+    std::vector<Short_t> out = data;
+    const std::vector<bool> keep = Window(data, thr, pre, post);
+    bool any = false;
+    for(const bool k : keep)any |= k;
+
+    DAQ_CHECK(zs.Apply(5, out) == any);
+    if(!any)return;
+    for(size_t i=0; i<data.size(); i++)DAQ_CHECK(out[i] == (keep[i] ? data[i] : 0));
+  }
+
+  void CheckEmulator(const std::vector<Short_t>& data, int thr, int pre, int post){
+    const std::vector<uint16_t> samples(data.begin(), data.end());
+    std::vector<std::pair<int, int> > ranges;
+    SignalGenerator::ZeroSuppress(samples, thr, ranges, pre, post);
+
+    std::vector<bool> kept(data.size(), false);
+      for(size_t r=0; r<ranges.size(); r++){
+        DAQ_CHECK(ranges[r].first < ranges[r].second);
+        //Merged, the FEM sends a single range for overlapping or adjacent windows
+        if(r > 0)DAQ_CHECK(ranges[r].first > ranges[r - 1].second);
+        for(int i=ranges[r].first; i<ranges[r].second; i++)kept[i] = true;
+      }
+    DAQ_CHECK(kept == Window(data, thr, pre, post));
+  }
+
+  //Stored thresholds of the first ASIC of a FEC, 259 with a flat baseline of 250
+  void CheckStore(){
+    TRestRawDAQMetadata::FECMetadata fec{};
+    fec.id = 1;
+    fec.ip[0] = 127; fec.ip[1] = 0; fec.ip[2] = 0; fec.ip[3] = 1;
+    fec.chipType = "aget";
+    fec.asic_isActive[0] = true;
+    fec.asic_gain[0] = 1;
+    fec.asic_shappingTime[0] = 5;
+    fec.asic_pedCenter[0] = 250;
+    fec.asic_pedThr[0] = 4.5;
+
+    PedestalStore::pedSummary raw, subtracted;
+      for(int c=0; c<TRestRawDAQMetadata::nChannels; c++){
+        raw[c] = {250, 2};
+        subtracted[c] = {250, 2};
+      }
+    const PedestalStore::asicPedestals entry = PedestalStore::Compute(fec, 0, raw, subtracted);
+    const std::string fileName = PedestalStore::GetFileName(".", fec, 0);
+    DAQ_CHECK(PedestalStore::Save(fileName, entry));
+
+    //Over the baseline but under the stored threshold
+    auto kept = [](ZeroSuppression& zs){
+      std::vector<Short_t> data(512, 250);
+      data[300] = 255;
+      return zs.Apply(1*288, data);
+    };
+
+    ZeroSuppression zs(3, 0, 100, 2, 2);
+    FEMConfig::registerMap registers;
+    DAQ_CHECK(zs.LoadThresholds(".", fec, registers) == 0);//Pedestals in the FEM not known
+    DAQ_CHECK(kept(zs));
+
+    for(const auto &cmd : PedestalStore::GetCommands(entry))FEMConfig::Apply(cmd, registers);
+    DAQ_CHECK(zs.LoadThresholds(".", fec, registers) == 1);
+    DAQ_CHECK(!kept(zs));
+
+    FEMConfig::Apply("fec_enable 0", registers);//Power cycle
+    DAQ_CHECK(zs.LoadThresholds(".", fec, registers) == 0);
+    DAQ_CHECK(kept(zs));
+
+    std::remove(fileName.c_str());
+  }
+
+}
+
+int main() {
+
+  //Pulses at the edges and in the middle, windows clamped to the signal
+  std::vector<Short_t> data(64, 10);
+  data[0] = data[1] = 200;
+  data[20] = 150;
+  data[30] = data[31] = data[32] = 300;
+  data[63] = 120;
+  for(int pre : {0, 1, 4, 12})
+    for(int post : {0, 2, 7, 40}){
+      CheckHost(data, 100, pre, post);
+      CheckEmulator(data, 100, pre, post);
+    }
+
+  //A window covering the whole signal
+  std::vector<std::pair<int, int> > ranges;
+  SignalGenerator::ZeroSuppress(std::vector<uint16_t>(data.begin(), data.end()), 100, ranges, 64, 64);
+  DAQ_CHECK(ranges.size() == 1 && ranges[0] == std::make_pair(0, 64));
+
+  //Channels without samples over threshold are dropped
+  std::vector<Short_t> flat(512, 10);
+  CheckHost(flat, 100, 3, 3);
+  CheckEmulator(flat, 100, 3, 3);
+
+  //Threshold from the baseline, flat so its sigma is 0
+  ZeroSuppression baseline(3, 0, 100, 2, 2);
+  std::vector<Short_t> pulse(512, 250);
+  pulse[300] = 260;
+  DAQ_CHECK(baseline.Apply(7, pulse));
+  for(int i=0; i<512; i++)DAQ_CHECK(pulse[i] == (i >= 298 && i <= 302 ? (i == 300 ? 260 : 250) : 0));
+
+  //Random sparse signals, lengths not multiple of the vector lanes
+  std::mt19937 gen(1234);
+  std::uniform_int_distribution<int> noise(0, 99), length(1, 600), window(0, 20);
+    for(int t=0; t<2000; t++){
+      std::vector<Short_t> rnd(length(gen));
+      for(auto &s : rnd)s = noise(gen) < 97 ? noise(gen) : 100 + noise(gen) * 30;
+      const int pre = window(gen), post = window(gen);
+      CheckHost(rnd, 99, pre, post);
+      CheckEmulator(rnd, 99, pre, post);
+    }
+
+  CheckStore();
+
+  return DAQTest::Result();
+}